@@ -19,6 +19,7 @@
 
 #include "actionrest_p.h"
 #include "context.h"
+#include "keys_p.h"
 #include "controller.h"
 #include "dispatcher.h"
 
@@ -49,24 +50,42 @@ bool ActionREST::doExecute(Context *c)
     return d->dispatchRestMethod(c, c->request()->method());
 }
 
-bool ActionRESTPrivate::dispatchRestMethod(Context *c, const QString &httpMethod) const
+bool ActionREST::dispatcherReady(const Dispatcher *dispatch, Controller *controller)
 {
-    Q_Q(const ActionREST);
-    const QString restMethod = q->name() + QLatin1Char('_') + httpMethod;
-
-    Controller *controller = c->controller();
-    Action *action = controller->actionFor(restMethod);
-    if (!action) {
-        // Look for non registered actions in this controller
-        const ActionList actions = controller->actions();
-        for (Action *controllerAction : actions) {
-            if (controllerAction->name() == restMethod) {
-                action = controllerAction;
-                break;
-            }
+    Q_D(ActionREST);
+
+    // precompute the method -> action table and the Allow header
+    // value so dispatch does not rebuild them on every request
+    QStringList methods;
+    const QString prefix = name() + QLatin1Char('_');
+    const ActionList actions = controller->actions();
+    for (Action *action : actions) {
+        const QString method = action->name();
+        if (method.startsWith(prefix)) {
+            const QString suffix = method.mid(prefix.size());
+            d->methodActions.insert(suffix, action);
+            methods.append(suffix);
         }
     }
 
+    if (methods.contains(Keys::GET)) {
+        methods.append(Keys::HEAD);
+    }
+
+    methods.removeAll(QStringLiteral("not_implemented"));
+    methods.sort();
+    methods.removeDuplicates();
+
+    d->allowedMethods = methods.join(QStringLiteral(", "));
+
+    return Action::dispatcherReady(dispatch, controller);
+}
+
+bool ActionRESTPrivate::dispatchRestMethod(Context *c, const QString &httpMethod) const
+{
+    Q_Q(const ActionREST);
+
+    Action *action = methodActions.value(httpMethod);
     if (action) {
         return c->execute(action);
     }
@@ -76,7 +95,7 @@ bool ActionRESTPrivate::dispatchRestMethod(Context *c, const QString &httpMethod
         ret = returnOptions(c, q->name());
     } else if (httpMethod == QLatin1String("HEAD")) {
         // redispatch to GET
-        ret = dispatchRestMethod(c, QStringLiteral("GET"));
+        ret = dispatchRestMethod(c, Keys::GET);
     } else if (httpMethod != QLatin1String("not_implemented")) {
         // try dispatching to foo_not_implemented
         ret = dispatchRestMethod(c, QStringLiteral("not_implemented"));
@@ -90,11 +109,11 @@ bool ActionRESTPrivate::dispatchRestMethod(Context *c, const QString &httpMethod
 
 bool ActionRESTPrivate::returnOptions(Context *c, const QString &methodName) const
 {
+    Q_UNUSED(methodName)
     Response *response = c->response();
     response->setContentType(QStringLiteral("text/plain"));
     response->setStatus(Response::OK); // 200
-    response->setHeader(QStringLiteral("ALLOW"),
-                        getAllowedMethods(c->controller(), methodName));
+    response->setHeader(Keys::ALLOW, allowedMethods);
     response->body().clear();
     return true;
 }
@@ -103,35 +122,11 @@ bool ActionRESTPrivate::returnNotImplemented(Context *c, const QString &methodNa
 {
     Response *response = c->response();
     response->setStatus(Response::MethodNotAllowed); // 405
-    response->setHeader(QStringLiteral("ALLOW"),
-                        getAllowedMethods(c->controller(), methodName));
+    response->setHeader(Keys::ALLOW, allowedMethods);
     const QString body = QLatin1String("Method ") + c->req()->method()
             + QLatin1String(" not implemented for ") + c->uriFor(methodName).toString();
     response->setBody(body);
     return true;
 }
 
-QString Cutelyst::ActionRESTPrivate::getAllowedMethods(Controller *controller, const QString &methodName) const
-{
-    QStringList methods;
-    const QString name = methodName + QLatin1Char('_');
-    const ActionList actions = controller->actions();
-    for (Action *action : actions) {
-        const QString method = action->name();
-        if (method.startsWith(name)) {
-            methods.append(method.mid(name.size()));
-        }
-    }
-
-    if (methods.contains(QStringLiteral("GET"))) {
-        methods.append(QStringLiteral("HEAD"));
-    }
-
-    methods.removeAll(QStringLiteral("not_implemented"));
-    methods.sort();
-    methods.removeDuplicates();
-
-    return methods.join(QStringLiteral(", "));
-}
-
 #include "moc_actionrest.cpp"
@@ -38,6 +38,8 @@ public:
     explicit ActionREST(QObject *parent = nullptr);
     virtual ~ActionREST();
 
+    bool dispatcherReady(const Dispatcher *dispatch, Controller *controller) override;
+
 protected:
     ActionRESTPrivate *d_ptr;
 
@@ -22,6 +22,8 @@
 
 #include "actionrest.h"
 
+#include <QHash>
+
 namespace Cutelyst {
 
 class ActionRESTPrivate
@@ -31,8 +33,9 @@ public:
     bool dispatchRestMethod(Context *c, const QString &restMethod) const;
     bool returnOptions(Context *c, const QString &methodName) const;
     bool returnNotImplemented(Context *c, const QString &methodName) const;
-    QString getAllowedMethods(Controller *controller, const QString &methodName) const;
 
+    QHash<QString, Action *> methodActions;
+    QString allowedMethods;
     ActionREST *q_ptr;
 };
 
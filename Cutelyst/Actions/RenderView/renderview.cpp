@@ -54,7 +54,7 @@ bool RenderView::init(Cutelyst::Application *application, const QVariantHash &ar
 
 bool RenderView::doExecute(Cutelyst::Context *c)
 {
-    Q_D(const RenderView);
+    Q_D(RenderView);
 
     if (!Action::doExecute(c)) {
         return false;
@@ -65,7 +65,18 @@ bool RenderView::doExecute(Cutelyst::Context *c)
         res->setContentType(QStringLiteral("text/html; charset=utf-8"));
     }
 
-    if (c->req()->method() == QLatin1String("HEAD")) {
+    const QString method = c->req()->method();
+    if (method == QLatin1String("HEAD")) {
+        // the engine would discard the body anyway, skip the render and
+        // advertise the length of the last full render when we have one
+        if (d->lastContentLength >= 0 && !res->hasBody()) {
+            res->setContentLength(d->lastContentLength);
+        }
+        return true;
+    }
+
+    if (method == QLatin1String("OPTIONS") && !res->hasBody()) {
+        res->setContentType(QStringLiteral("text/plain"));
         return true;
     }
 
@@ -79,12 +90,17 @@ bool RenderView::doExecute(Cutelyst::Context *c)
     }
 
     View *view = c->view();
-    if (view) {
-        // Fist check if the user set a view
-        return c->forward(view);
-    } else if (d->view) {
+    if (!view) {
         // Then try to use the action View attribute
-        return c->forward(d->view);
+        view = d->view;
+    }
+
+    if (view) {
+        const bool ret = c->forward(view);
+        if (ret) {
+            d->lastContentLength = res->body().size();
+        }
+        return ret;
     }
 
     qCCritical(CUTELYST_RENDERVIEW) << "Could not find a view to render.";
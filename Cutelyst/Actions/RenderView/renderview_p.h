@@ -29,6 +29,7 @@ class RenderViewPrivate
 {
 public:
     View *view;
+    qint64 lastContentLength = -1;
 };
 
 }
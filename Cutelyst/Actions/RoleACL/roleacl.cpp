@@ -27,6 +27,8 @@
 
 #include <QMap>
 
+#include <algorithm>
+
 using namespace Cutelyst;
 
 RoleACL::RoleACL(QObject *parent) : Component(parent)
@@ -67,6 +69,10 @@ bool RoleACL::init(Cutelyst::Application *application, const QVariantHash &args)
         for (const QString &role : allowed) {
             d->allowedRole.append(role);
         }
+
+        // sorted so canVisit() can use merge style set operations
+        std::sort(d->requiresRole.begin(), d->requiresRole.end());
+        std::sort(d->allowedRole.begin(), d->allowedRole.end());
     }
 
     auto it = attributes.constFind(QLatin1String("ACLDetachTo"));
@@ -94,44 +100,59 @@ bool RoleACL::aroundExecute(Context *c, QStack<Cutelyst::Component *> stack)
     return false;
 }
 
+static bool sortedIntersects(const QStringList &a, const QStringList &b)
+{
+    auto i = a.constBegin();
+    auto j = b.constBegin();
+    while (i != a.constEnd() && j != b.constEnd()) {
+        if (*i < *j) {
+            ++i;
+        } else if (*j < *i) {
+            ++j;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
 // TODO maybe mark this as static for 2.0
 bool RoleACL::canVisit(Context *c) const
 {
     Q_D(const RoleACL);
 
-    const QStringList user_has = Authentication::user(c).value(QStringLiteral("roles")).toStringList();
+    QStringList user_has = Authentication::user(c).value(QStringLiteral("roles")).toStringList();
+    std::sort(user_has.begin(), user_has.end());
+
+    // the decision is a pure function of the user's roles, keying the
+    // cache on them means a role change invalidates the entry on its own
+    const QString cacheKey = user_has.join(QLatin1Char('\n'));
+    auto cached = d->decisionCache.constFind(cacheKey);
+    if (cached != d->decisionCache.constEnd()) {
+        return cached.value();
+    }
 
     const QStringList required = d->requiresRole;
     const QStringList allowed = d->allowedRole;
 
+    bool ret = false;
     if (!required.isEmpty() && !allowed.isEmpty()) {
-        for (const QString &role : required) {
-            if (!user_has.contains(role)) {
-                return false;
-            }
-        }
-
-        for (const QString &role : allowed) {
-            if (user_has.contains(role)) {
-                return true;
-            }
-        }
-    }  else if (!required.isEmpty()) {
-        for (const QString &role : required) {
-            if (!user_has.contains(role)) {
-                return false;
-            }
-        }
-        return true;
+        ret = std::includes(user_has.constBegin(), user_has.constEnd(),
+                            required.constBegin(), required.constEnd())
+                && sortedIntersects(user_has, allowed);
+    } else if (!required.isEmpty()) {
+        ret = std::includes(user_has.constBegin(), user_has.constEnd(),
+                            required.constBegin(), required.constEnd());
     } else if (!allowed.isEmpty()) {
-        for (const QString &role : allowed) {
-            if (user_has.contains(role)) {
-                return true;
-            }
-        }
+        ret = sortedIntersects(user_has, allowed);
     }
 
-    return false;
+    if (d->decisionCache.size() >= 1024) {
+        d->decisionCache.clear();
+    }
+    d->decisionCache.insert(cacheKey, ret);
+
+    return ret;
 }
 
 bool RoleACL::dispatcherReady(const Dispatcher *dispatcher, Cutelyst::Controller *controller)
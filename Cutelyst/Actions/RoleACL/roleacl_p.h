@@ -22,6 +22,8 @@
 
 #include "roleacl.h"
 
+#include <QHash>
+
 namespace Cutelyst {
 
 class RoleACLPrivate
@@ -32,6 +34,7 @@ public:
     QString aclDetachTo;
     QString actionReverse;
     Action *detachTo;
+    mutable QHash<QString, bool> decisionCache;
 };
 
 }
@@ -39,6 +39,12 @@ static thread_local Authentication *auth = nullptr;
 
 #define AUTHENTICATION_USER "__authentication_user"
 #define AUTHENTICATION_USER_REALM "__authentication_user_realm"
+// set once a restore attempt within this request came up empty, so
+// layered begin/auto/action callers do not repeat the realm scan and
+// session-store work just to fail again; a scan over every realm
+// failing means no realm could answer, which makes the negative
+// result valid for any realm for the rest of the request
+#define AUTHENTICATION_USER_TRIED "__authentication_user_tried"
 
 Authentication::Authentication(Application *parent) : Plugin(parent)
   , d_ptr(new AuthenticationPrivate)
@@ -117,8 +123,10 @@ Cutelyst::AuthenticationUser Authentication::user(Cutelyst::Context *c)
 {
     AuthenticationUser ret;
     QVariant user = c->property(AUTHENTICATION_USER);
-    if (user.isNull()) {        
-        ret = AuthenticationPrivate::restoreUser(c, QVariant(), QString());
+    if (user.isNull()) {
+        if (!c->property(AUTHENTICATION_USER_TRIED).toBool()) {
+            ret = AuthenticationPrivate::restoreUser(c, QVariant(), QString());
+        }
     } else {
         ret = user.value<AuthenticationUser>();
     }
@@ -130,10 +138,15 @@ bool Authentication::userExists(Cutelyst::Context *c)
     if (!c->property(AUTHENTICATION_USER).isNull()) {
         return true;
     } else {
+        if (c->property(AUTHENTICATION_USER_TRIED).toBool()) {
+            return false;
+        }
+
         if (auth) {
             if (AuthenticationPrivate::findRealmForPersistedUser(c, auth->d_ptr->realms, auth->d_ptr->realmsOrder)) {
                 return true;
             }
+            c->setProperty(AUTHENTICATION_USER_TRIED, true);
         } else {
             qCCritical(C_AUTHENTICATION, "Authentication plugin not registered!");
         }
@@ -147,6 +160,10 @@ bool Authentication::userInRealm(Cutelyst::Context *c, const QString &realmName)
     if (!user.isNull()) {
         return user.value<AuthenticationUser>().authRealm()->name() == realmName;
     } else {
+        if (c->property(AUTHENTICATION_USER_TRIED).toBool()) {
+            return false;
+        }
+
         if (!auth) {
             qCCritical(C_AUTHENTICATION, "Authentication plugin not registered!");
             return false;
@@ -156,6 +173,7 @@ bool Authentication::userInRealm(Cutelyst::Context *c, const QString &realmName)
         if (realm) {
             return realm->name() == realmName;
         } else {
+            c->setProperty(AUTHENTICATION_USER_TRIED, true);
             return false;
         }
     }
@@ -164,6 +182,9 @@ bool Authentication::userInRealm(Cutelyst::Context *c, const QString &realmName)
 void Authentication::logout(Context *c)
 {
     AuthenticationPrivate::setUser(c, AuthenticationUser());
+    // nothing is restorable past this point, later lookups in this
+    // request can fail without touching the session again
+    c->setProperty(AUTHENTICATION_USER_TRIED, true);
 
     if (auth) {
         AuthenticationRealm *realm = AuthenticationPrivate::findRealmForPersistedUser(c, auth->d_ptr->realms, auth->d_ptr->realmsOrder);
@@ -200,10 +221,14 @@ AuthenticationUser AuthenticationPrivate::restoreUser(Context *c, const QVariant
     }
 
     if (!realmPtr) {
+        c->setProperty(AUTHENTICATION_USER_TRIED, true);
         return ret;
     }
 
     ret = realmPtr->restoreUser(c, frozenUser);
+    if (ret.isNull()) {
+        c->setProperty(AUTHENTICATION_USER_TRIED, true);
+    }
 
     AuthenticationPrivate::setUser(c, ret);
     // TODO
@@ -57,7 +57,11 @@ AuthenticationCredential *AuthenticationRealm::credential() const
 
 AuthenticationUser AuthenticationRealm::findUser(Context *c, const ParamsMultiMap &userinfo)
 {
-    AuthenticationUser ret = m_store->findUser(c, userinfo);
+    // prefer the batched lookup so the user arrives with roles and
+    // attributes populated, keeping RoleACL checks off the store
+    AuthenticationUser ret = m_store->canFindUserComplete()
+            ? m_store->findUserComplete(c, userinfo)
+            : m_store->findUser(c, userinfo);
 
     if (ret.isNull()) {
         if (m_store->canAutoCreateUser()) {
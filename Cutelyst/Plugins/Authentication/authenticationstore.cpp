@@ -53,6 +53,16 @@ AuthenticationUser AuthenticationStore::autoUpdateUser(Context *c, const ParamsM
     return AuthenticationUser();
 }
 
+bool AuthenticationStore::canFindUserComplete() const
+{
+    return false;
+}
+
+AuthenticationUser AuthenticationStore::findUserComplete(Context *c, const ParamsMultiMap &userinfo)
+{
+    return findUser(c, userinfo);
+}
+
 QVariant AuthenticationStore::forSession(Context *c, const AuthenticationUser &user)
 {
     Q_UNUSED(c)
@@ -65,6 +65,26 @@ public:
      */
     virtual AuthenticationUser findUser(Context *c, const ParamsMultiMap &userinfo) = 0;
 
+    /**
+     * Reimplement this if your store can fetch the user together
+     * with its roles and attributes in one round trip
+     */
+    virtual bool canFindUserComplete() const;
+
+    /**
+     * Reimplement this to retrieve the user that matches the user
+     * info with every attribute the application reads later already
+     * populated, notably the "roles" list consumed by RoleACL, so
+     * authorization checks cause no follow-up store traffic. SQL
+     * stores typically join or batch the attribute queries here
+     * instead of answering them lazily one by one.
+     *
+     * The default implementation just calls findUser().
+     *
+     * \since Cutelyst 1.10.0
+     */
+    virtual AuthenticationUser findUserComplete(Context *c, const ParamsMultiMap &userinfo);
+
     /**
      * Reimplement this so that you return a
      * serializable value that can be used to
@@ -120,6 +120,12 @@ void CredentialHttp::setRequireSsl(bool require)
     d->requireSsl = require;
 }
 
+void CredentialHttp::setOffloadVerification(bool enable)
+{
+    Q_D(CredentialHttp);
+    d->offloadVerification = enable;
+}
+
 AuthenticationUser CredentialHttp::authenticate(Cutelyst::Context *c, AuthenticationRealm *realm, const ParamsMultiMap &authinfo)
 {
     Q_D(CredentialHttp);
@@ -167,6 +173,9 @@ bool CredentialHttpPrivate::checkPassword(const AuthenticationUser &user, const
             password.append(password);
         }
 
+        if (offloadVerification) {
+            return CredentialPassword::validatePasswordOffloaded(password.toUtf8(), storedPassword.toUtf8());
+        }
         return CredentialPassword::validatePassword(password.toUtf8(), storedPassword.toUtf8());
     } else if (passwordType == CredentialHttp::SelfCheck) {
         return user.checkPassword(password);
@@ -126,6 +126,15 @@ public:
      */
     void setRequireSsl(bool require);
 
+    /*!
+     * When enabled Hashed password verification runs on the shared
+     * PBKDF2 thread pool while the worker keeps serving its other
+     * connections. \sa CredentialPassword::setOffloadVerification()
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setOffloadVerification(bool enable);
+
     AuthenticationUser authenticate(Context *c, AuthenticationRealm *realm, const ParamsMultiMap &authinfo) final;
 
 protected:
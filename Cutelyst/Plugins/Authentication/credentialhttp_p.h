@@ -47,6 +47,7 @@ public:
     QString passwordPostSalt;
     QString authorizationRequiredMessage;
     bool requireSsl = false;
+    bool offloadVerification = false;
 };
 
 }
@@ -22,8 +22,13 @@
 
 #include <QLoggingCategory>
 #include <QMessageAuthenticationCode>
+#include <QDateTime>
 #include <QUuid>
 #include <QFile>
+#include <QEventLoop>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
 
 using namespace Cutelyst;
 
@@ -105,6 +110,35 @@ void CredentialPassword::setPasswordPostSalt(const QString &passwordPostSalt)
     d->passwordPostSalt = passwordPostSalt;
 }
 
+bool CredentialPassword::offloadVerification() const
+{
+    Q_D(const CredentialPassword);
+    return d->offloadVerification;
+}
+
+void CredentialPassword::setOffloadVerification(bool enable)
+{
+    Q_D(CredentialPassword);
+    d->offloadVerification = enable;
+}
+
+int CredentialPassword::verifiedCredentialsExpiry() const
+{
+    Q_D(const CredentialPassword);
+    return d->verifiedCacheExpiry;
+}
+
+void CredentialPassword::setVerifiedCredentialsExpiry(int seconds)
+{
+    Q_D(CredentialPassword);
+    d->verifiedCacheExpiry = seconds;
+    if (seconds > 0 && d->verifiedCacheSecret.isEmpty()) {
+        // random per-process key so the cached HMACs are useless
+        // outside this worker
+        d->verifiedCacheSecret = QUuid::createUuid().toRfc4122() + QUuid::createUuid().toRfc4122();
+    }
+}
+
 // To avoid timming attack
 bool slowEquals(const QByteArray &a, const QByteArray &b)
 {
@@ -145,6 +179,53 @@ bool CredentialPassword::validatePassword(const QByteArray &password, const QByt
                 );
 }
 
+static QThreadPool *pbkdf2Pool()
+{
+    // Shared small pool so key stretching can never occupy every
+    // core of the machine at once
+    static QThreadPool pool;
+    static bool configured = false;
+    if (!configured) {
+        configured = true;
+        pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    }
+    return &pool;
+}
+
+namespace {
+class ValidateRunnable : public QRunnable
+{
+public:
+    ValidateRunnable(const QByteArray &password, const QByteArray &correctHash, bool *result, QEventLoop *loop)
+        : m_password(password)
+        , m_correctHash(correctHash)
+        , m_result(result)
+        , m_loop(loop)
+    { }
+
+    void run() override {
+        *m_result = CredentialPassword::validatePassword(m_password, m_correctHash);
+        // queued so it wakes the requesting thread's event loop
+        QMetaObject::invokeMethod(m_loop, "quit", Qt::QueuedConnection);
+    }
+
+private:
+    QByteArray m_password;
+    QByteArray m_correctHash;
+    bool *m_result;
+    QEventLoop *m_loop;
+};
+}
+
+bool CredentialPassword::validatePasswordOffloaded(const QByteArray &password, const QByteArray &correctHash)
+{
+    bool result = false;
+    QEventLoop loop;
+    pbkdf2Pool()->start(new ValidateRunnable(password, correctHash, &result, &loop));
+    loop.exec();
+    return result;
+}
+
 QByteArray CredentialPassword::createPassword(const QByteArray &password, QCryptographicHash::Algorithm method, int iterations, int saltByteSize, int hashByteSize)
 {
     QByteArray salt;
@@ -271,7 +352,7 @@ bool CredentialPasswordPrivate::checkPassword(const AuthenticationUser &user, co
             password.append(password);
         }
 
-        return CredentialPassword::validatePassword(password.toUtf8(), storedPassword.toUtf8());
+        return checkHashedPassword(password.toUtf8(), storedPassword.toUtf8());
     } else if (passwordType == CredentialPassword::SelfCheck) {
         return user.checkPassword(password);
     }
@@ -279,6 +360,36 @@ bool CredentialPasswordPrivate::checkPassword(const AuthenticationUser &user, co
     return false;
 }
 
+bool CredentialPasswordPrivate::checkHashedPassword(const QByteArray &password, const QByteArray &correctHash)
+{
+    if (verifiedCacheExpiry <= 0) {
+        return offloadVerification
+                ? CredentialPassword::validatePasswordOffloaded(password, correctHash)
+                : CredentialPassword::validatePassword(password, correctHash);
+    }
+
+    // keyed with the per-process secret, a lookup on the digest
+    // leaks nothing about the password
+    const QByteArray cacheKey = QMessageAuthenticationCode::hash(correctHash + '\0' + password,
+                                                                 verifiedCacheSecret,
+                                                                 QCryptographicHash::Sha256);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const qint64 *expires = verifiedCache.object(cacheKey);
+    if (expires && *expires > now) {
+        return true;
+    }
+
+    const bool ok = offloadVerification
+            ? CredentialPassword::validatePasswordOffloaded(password, correctHash)
+            : CredentialPassword::validatePassword(password, correctHash);
+    if (ok) {
+        verifiedCache.insert(cacheKey, new qint64(now + verifiedCacheExpiry));
+    } else {
+        verifiedCache.remove(cacheKey);
+    }
+    return ok;
+}
+
 QByteArray CredentialPasswordPrivate::cryptoEnumToStr(QCryptographicHash::Algorithm method)
 {
     QByteArray hashmethod;
@@ -89,11 +89,56 @@ public:
      */
     void setPasswordPostSalt(const QString &passwordPostSalt);
 
+    /*!
+     * Returns for how many seconds a successfully verified
+     * credential is cached, 0 (the default) disables the cache.
+     */
+    int verifiedCredentialsExpiry() const;
+
+    /*!
+     * Caches an HMAC of successfully verified credentials for
+     * \p seconds so clients that authenticate on every request, such
+     * as Basic auth API consumers, only pay the full PBKDF2 cost
+     * once per expiry period instead of on each request. The cache
+     * is bounded, per worker and keyed with a random per-process
+     * secret; 0 disables it.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setVerifiedCredentialsExpiry(int seconds);
+
+    /*!
+     * Returns true when hash verification runs on the shared
+     * PBKDF2 thread pool instead of the request thread.
+     */
+    bool offloadVerification() const;
+
+    /*!
+     * When enabled hash verification is submitted to a small shared
+     * thread pool and the worker keeps serving its other connections
+     * while waiting for the result, so one login cannot stall every
+     * request on the core for the duration of the key stretch. Other
+     * handlers may run before authenticate() returns, beware of
+     * re-entrancy in application state.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setOffloadVerification(bool enable);
+
     /*!
      * Validates the given password against the correct hash.
      */
     static bool validatePassword(const QByteArray &password, const QByteArray &correctHash);
 
+    /*!
+     * Same as validatePassword() but runs the PBKDF2 key stretch on
+     * a small shared thread pool, processing the worker's event loop
+     * until the result is ready. \sa setOffloadVerification()
+     *
+     * \since Cutelyst 1.10.0
+     */
+    static bool validatePasswordOffloaded(const QByteArray &password, const QByteArray &correctHash);
+
     /*!
      * Creates a password hash string.
      * \param password
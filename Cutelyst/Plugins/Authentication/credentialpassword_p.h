@@ -22,12 +22,15 @@
 
 #include "credentialpassword.h"
 
+#include <QCache>
+
 namespace Cutelyst {
 
 class CredentialPasswordPrivate
 {
 public:
     bool checkPassword(const AuthenticationUser &user, const ParamsMultiMap &authinfo);
+    bool checkHashedPassword(const QByteArray &password, const QByteArray &correctHash);
     static QByteArray cryptoEnumToStr(QCryptographicHash::Algorithm method);
     static int cryptoStrToEnum(const QByteArray &hashMethod);
 
@@ -35,6 +38,14 @@ public:
     CredentialPassword::Type passwordType = CredentialPassword::None;
     QString passwordPreSalt;
     QString passwordPostSalt;
+
+    // Opt-in cache of HMACs of recently verified credentials,
+    // avoids the full PBKDF2 round count when API clients send the
+    // same credentials on every request
+    QCache<QByteArray, qint64> verifiedCache;
+    QByteArray verifiedCacheSecret;
+    int verifiedCacheExpiry = 0;
+    bool offloadVerification = false;
 };
 
 }
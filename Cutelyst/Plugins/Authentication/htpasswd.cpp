@@ -20,6 +20,9 @@
 #include "htpasswd.h"
 
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
 #include <QTemporaryFile>
 #include <QLoggingCategory>
 
@@ -27,6 +30,48 @@
 
 using namespace Cutelyst;
 
+struct HtpasswdIndex {
+    QDateTime modified;
+    qint64 size = -1;
+    QHash<QString, QString> users;
+};
+
+// Per worker index of the htpasswd file so findUser() is a hash
+// lookup instead of a linear scan, rebuilt when the file changes
+static thread_local QHash<QString, HtpasswdIndex> t_htpasswdIndexes;
+
+static const HtpasswdIndex &htpasswdIndex(const QString &fileName)
+{
+    HtpasswdIndex &index = t_htpasswdIndexes[fileName];
+
+    const QFileInfo info(fileName);
+    if (info.lastModified() == index.modified && info.size() == index.size) {
+        return index;
+    }
+
+    index.modified = info.lastModified();
+    index.size = info.size();
+    index.users.clear();
+
+    QFile file(fileName);
+    if (file.open(QFile::ReadOnly | QFile::Text)) {
+        while (!file.atEnd()) {
+            const QByteArray line = file.readLine();
+            QByteArrayList parts = line.trimmed().split(':');
+            if (parts.size() >= 2 && !parts.first().startsWith('#')) {
+                const QString username = QString::fromLatin1(parts.first());
+                if (!index.users.contains(username)) {
+                    // first entry wins, like the linear scan did
+                    QByteArray password = parts.at(1);
+                    index.users.insert(username, QString::fromLatin1(password.replace(',', ':')));
+                }
+            }
+        }
+    }
+
+    return index;
+}
+
 StoreHtpasswd::StoreHtpasswd(const QString &name, QObject *parent) : AuthenticationStore(parent)
 {
     setProperty("_file", name);
@@ -77,6 +122,10 @@ void StoreHtpasswd::addUser(const ParamsMultiMap &user)
     if (!tmp.rename(fileName)) {
         qCWarning(CUTELYST_UTILS_AUTH) << "Failed to rename temporary file";
     }
+
+    // the mtime check would also catch this, but not within the
+    // same filesystem timestamp granularity
+    t_htpasswdIndexes.remove(fileName);
 }
 
 AuthenticationUser StoreHtpasswd::findUser(Context *c, const ParamsMultiMap &userInfo)
@@ -85,20 +134,13 @@ AuthenticationUser StoreHtpasswd::findUser(Context *c, const ParamsMultiMap &use
     QString username = userInfo.value(QStringLiteral("username"));
 
     QString fileName = property("_file").toString();
-    QFile file(fileName);
-    if (file.open(QFile::ReadOnly | QFile::Text)) {
-        while (!file.atEnd()) {
-            QByteArray line = file.readLine();
-            QByteArrayList parts = line.trimmed().split(':');
-            if (parts.size() >= 2 && !parts.first().startsWith('#') && parts.first() == username.toLatin1()) {
-                ret.insert(QStringLiteral("username"), username);
-                ret.setId(username);
-                QByteArray password = parts.at(1);
-                ret.insert(QStringLiteral("password"), QString::fromLatin1(password.replace(',', ':')));
-                break;
-                // TODO maybe support additional fields
-            }
-        }
+    const HtpasswdIndex &index = htpasswdIndex(fileName);
+    auto it = index.users.constFind(username);
+    if (it != index.users.constEnd()) {
+        ret.insert(QStringLiteral("username"), username);
+        ret.setId(username);
+        ret.insert(QStringLiteral("password"), it.value());
+        // TODO maybe support additional fields
     }
     return ret;
 }
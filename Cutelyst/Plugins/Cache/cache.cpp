@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "cache_p.h"
+
+#include <Cutelyst/Application>
+#include <Cutelyst/Context>
+#include <Cutelyst/Engine>
+
+#include <QtCore/QDateTime>
+#include <QtCore/QLoggingCategory>
+
+using namespace Cutelyst;
+
+Q_LOGGING_CATEGORY(C_CACHE, "cutelyst.plugin.cache")
+
+static thread_local Cache *m_instance = nullptr;
+
+Cache::Cache(Application *parent) : Plugin(parent)
+  , d_ptr(new CachePrivate(this))
+{
+
+}
+
+Cache::~Cache()
+{
+    delete d_ptr;
+}
+
+bool Cache::setup(Application *app)
+{
+    Q_D(Cache);
+
+    const QVariantMap config = app->engine()->config(QLatin1String("Cutelyst_Cache_Plugin"));
+    d->defaultExpires = config.value(QLatin1String("expires"), 300).toInt();
+    d->entries.setMaxCost(config.value(QLatin1String("max_entries"), 1024).toInt());
+    d->staleGrace = config.value(QLatin1String("stale_grace"), 60).toInt();
+    d->refillTimeout = config.value(QLatin1String("refill_timeout"), 10).toInt();
+
+    connect(app, &Application::postForked, this, &CachePrivate::_q_postFork);
+
+    return true;
+}
+
+QVariant Cache::get(Context *c, const QString &key, const QVariant &defaultValue)
+{
+    Q_UNUSED(c)
+    if (Q_UNLIKELY(!m_instance)) {
+        qCCritical(C_CACHE) << "Cache plugin not registered";
+        return defaultValue;
+    }
+
+    CachePrivate *d = m_instance->d_ptr;
+    CachePrivate::CacheEntry *entry = d->entries.object(key);
+    if (!entry) {
+        return defaultValue;
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (entry->expires <= now) {
+        // keep the entry around for the stale grace window so that
+        // fetch() can serve it while a refill runs
+        if (entry->expires + qint64(d->staleGrace) * 1000 <= now) {
+            d->entries.remove(key);
+        }
+        return defaultValue;
+    }
+
+    return entry->value;
+}
+
+void Cache::set(Context *c, const QString &key, const QVariant &value, int expires)
+{
+    Q_UNUSED(c)
+    if (Q_UNLIKELY(!m_instance)) {
+        qCCritical(C_CACHE) << "Cache plugin not registered";
+        return;
+    }
+
+    CachePrivate *d = m_instance->d_ptr;
+    auto entry = new CachePrivate::CacheEntry;
+    entry->value = value;
+    entry->expires = QDateTime::currentMSecsSinceEpoch()
+            + qint64(expires > 0 ? expires : d->defaultExpires) * 1000;
+    d->entries.insert(key, entry);
+}
+
+bool Cache::remove(Context *c, const QString &key)
+{
+    Q_UNUSED(c)
+    if (Q_UNLIKELY(!m_instance)) {
+        qCCritical(C_CACHE) << "Cache plugin not registered";
+        return false;
+    }
+
+    return m_instance->d_ptr->entries.remove(key);
+}
+
+void Cache::clear(Context *c)
+{
+    Q_UNUSED(c)
+    if (Q_UNLIKELY(!m_instance)) {
+        qCCritical(C_CACHE) << "Cache plugin not registered";
+        return;
+    }
+
+    m_instance->d_ptr->entries.clear();
+}
+
+QVariant Cache::fetch(Context *c, const QString &key, const std::function<QVariant ()> &compute, int expires)
+{
+    if (Q_UNLIKELY(!m_instance)) {
+        qCCritical(C_CACHE) << "Cache plugin not registered";
+        return compute();
+    }
+
+    CachePrivate *d = m_instance->d_ptr;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    QVariant stale;
+    CachePrivate::CacheEntry *entry = d->entries.object(key);
+    if (entry) {
+        if (entry->expires > now) {
+            return entry->value;
+        }
+
+        if (entry->expires + qint64(d->staleGrace) * 1000 > now) {
+            // Expired but within the grace window: the first caller
+            // claims the refill, everyone else keeps getting the stale
+            // value instead of piling onto the backend. A refill that
+            // never finished is taken over once refill_timeout passes.
+            if (entry->refilling &&
+                    entry->refillStarted + qint64(d->refillTimeout) * 1000 > now) {
+                return entry->value;
+            }
+            entry->refilling = true;
+            entry->refillStarted = now;
+            // set() below deletes the entry, keep the fallback value
+            stale = entry->value;
+        } else {
+            d->entries.remove(key);
+            entry = nullptr;
+        }
+    }
+
+    const QVariant ret = compute();
+    if (!ret.isNull()) {
+        set(c, key, ret, expires);
+        return ret;
+    }
+
+    // the refill failed, let go of the claim so a later request
+    // retries, and keep serving the old value for now if there is one
+    entry = d->entries.object(key);
+    if (entry) {
+        entry->refilling = false;
+    }
+    return stale.isNull() ? ret : stale;
+}
+
+void CachePrivate::_q_postFork(Application *app)
+{
+    m_instance = app->plugin<Cache *>();
+}
+
+#include "moc_cache.cpp"
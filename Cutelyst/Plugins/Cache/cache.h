@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef CCACHE_H
+#define CCACHE_H
+
+#include <QtCore/QVariant>
+
+#include <Cutelyst/plugin.h>
+#include <Cutelyst/cutelyst_global.h>
+
+#include <functional>
+
+namespace Cutelyst {
+
+class Context;
+class CachePrivate;
+
+/**
+ * In process cache with TTL and least recently used eviction.
+ *
+ * Each worker core runs its own Application clone and with it its own
+ * Cache instance, so lookups never contend across threads and the
+ * cache is sharded over the cores by construction. The price is that
+ * each core warms its own copy of an entry.
+ */
+class CUTELYST_PLUGIN_CACHE_EXPORT Cache : public Plugin
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(Cache)
+public:
+    /**
+     * Constructs a new cache object with the given parent.
+     */
+    Cache(Application *parent);
+    virtual ~Cache();
+
+    /**
+     * If config has
+     * [Cutelyst_Cache_Plugin]
+     * expires = 1234
+     * max_entries = 1234
+     * stale_grace = 60
+     * refill_timeout = 10
+     * it will change the default expiration which is 300 seconds, the
+     * entry bound which is 1024 entries per worker core, how long past
+     * its TTL an entry may still be served by fetch() while one caller
+     * recomputes it, and after how many seconds a refill that never
+     * finished may be taken over.
+     */
+    virtual bool setup(Application *app) final;
+
+    /**
+     * Returns the cached value for key, or defaultValue when the key
+     * is missing or its TTL has passed.
+     */
+    static QVariant get(Context *c, const QString &key, const QVariant &defaultValue = QVariant());
+
+    /**
+     * Stores value under key for expires seconds, 0 takes the
+     * configured default expiration.
+     */
+    static void set(Context *c, const QString &key, const QVariant &value, int expires = 0);
+
+    /**
+     * Removes the entry for key, returns false when it did not exist.
+     */
+    static bool remove(Context *c, const QString &key);
+
+    /**
+     * Removes every entry of this worker core's cache.
+     */
+    static void clear(Context *c);
+
+    /**
+     * Returns the cached value for key, computing and storing it with
+     * the given TTL when missing or expired. Within a worker core the
+     * fetch-or-compute pair is atomic since the cache is never shared
+     * between threads.
+     *
+     * When an entry expires it is served stale for the configured
+     * grace window while a single caller recomputes it, so an expiry
+     * boundary costs one backend round trip per worker core instead
+     * of one per concurrent request.
+     */
+    static QVariant fetch(Context *c, const QString &key, const std::function<QVariant ()> &compute, int expires = 0);
+
+protected:
+    CachePrivate *d_ptr;
+};
+
+}
+
+#endif // CCACHE_H
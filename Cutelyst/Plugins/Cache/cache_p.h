@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef CCACHE_P_H
+#define CCACHE_P_H
+
+#include "cache.h"
+
+#include <QtCore/QCache>
+
+namespace Cutelyst {
+
+class CachePrivate
+{
+public:
+    struct CacheEntry {
+        QVariant value;
+        qint64 expires;
+        // set while one fetch() call is recomputing this entry, the
+        // others keep serving the stale value meanwhile
+        qint64 refillStarted = 0;
+        bool refilling = false;
+    };
+
+    CachePrivate(Cache *q) : q_ptr(q) {}
+
+    static void _q_postFork(Application *app);
+
+    // cost is one per entry, QCache evicts least recently used
+    QCache<QString, CacheEntry> entries;
+    int defaultExpires = 300;
+    // how long past its TTL an entry may still be served while a
+    // refill runs, and when a stuck refill may be taken over
+    int staleGrace = 60;
+    int refillTimeout = 10;
+    Cache *q_ptr;
+};
+
+}
+
+#endif // CCACHE_P_H
@@ -27,10 +27,15 @@
 #include <Cutelyst/Engine>
 
 #include <QUuid>
+#include <QFile>
 #include <QHostAddress>
+#include <QDataStream>
+#include <QDateTime>
 #include <QLoggingCategory>
 #include <QCoreApplication>
 
+#include <cstring>
+
 using namespace Cutelyst;
 
 Q_LOGGING_CATEGORY(C_SESSION, "cutelyst.plugin.session")
@@ -190,6 +195,11 @@ void Session::setValue(Cutelyst::Context *c, const QString &key, const QVariant
     }
 
     QVariantHash data = session.toHash();
+    auto it = data.constFind(key);
+    if (it != data.constEnd() && it.value() == value) {
+        // Nothing changed, do not force a store write
+        return;
+    }
     data.insert(key, value);
 
     c->setProperty(SESSION_VALUES, data);
@@ -213,7 +223,9 @@ void Session::deleteValue(Context *c, const QString &key)
     }
 
     QVariantHash data = session.toHash();
-    data.remove(key);
+    if (!data.remove(key)) {
+        return;
+    }
 
     c->setProperty(SESSION_VALUES, data);
     c->setProperty(SESSION_UPDATED, true);
@@ -236,8 +248,12 @@ void Session::deleteValues(Context *c, const QStringList &keys)
     }
 
     QVariantHash data = session.toHash();
+    int removed = 0;
     for (const QString &key : keys) {
-        data.remove(key);
+        removed += data.remove(key);
+    }
+    if (!removed) {
+        return;
     }
 
     c->setProperty(SESSION_VALUES, data);
@@ -251,7 +267,43 @@ bool Session::isValid(Cutelyst::Context *c)
 
 QString SessionPrivate::generateSessionId()
 {
-    return QString::fromLatin1(QUuid::createUuid().toRfc4122().toHex());
+    // A login surge creates hundreds of sessions in a burst and a
+    // kernel randomness read per sid clusters syscalls badly. Each
+    // worker thread keeps a small entropy pool and slices sids off
+    // it, amortizing one 4 KB read over 256 sids.
+    enum { SidBytes = 16, PoolSize = 4096 };
+    static thread_local QByteArray pool;
+    static thread_local int poolPos = PoolSize;
+
+    if (poolPos + int(SidBytes) > pool.size()) {
+        QFile random(QStringLiteral("/dev/urandom"));
+        if (random.open(QIODevice::ReadOnly)) {
+            pool = random.read(PoolSize);
+        } else {
+            pool.clear();
+        }
+        poolPos = 0;
+
+        if (pool.size() < int(SidBytes)) {
+            // no kernel randomness available on this platform
+            return QString::fromLatin1(QUuid::createUuid().toRfc4122().toHex());
+        }
+    }
+
+    const quint8 *raw = reinterpret_cast<const quint8 *>(pool.constData()) + poolPos;
+    poolPos += SidBytes;
+
+    // hex encode straight into the final QString, toHex() would
+    // allocate an intermediate byte array just to convert it
+    static const char hexChars[] = "0123456789abcdef";
+    QString sid;
+    sid.resize(SidBytes * 2);
+    QChar *dst = sid.data();
+    for (int i = 0; i < int(SidBytes); ++i) {
+        *dst++ = QLatin1Char(hexChars[raw[i] >> 4]);
+        *dst++ = QLatin1Char(hexChars[raw[i] & 0xf]);
+    }
+    return sid;
 }
 
 QString SessionPrivate::loadSessionId(Context *c, const QString &sessionName)
@@ -322,20 +374,20 @@ QString SessionPrivate::createSessionId(Session *session, Context *c, quint64 ex
 
 void SessionPrivate::_q_saveSession(Context *c)
 {
-    // fix cookie before we send headers
-    saveSessionExpires(c);
-
     // Force extension of session_expires before finalizing headers, so a pos
     // up to date. First call to session_expires will extend the expiry, methods
     // just return the previously extended value.
     Session::expires(c);
 
+    // fix cookie before we send headers and persist the extended
+    // expires, the extension above makes a single store write enough
+    saveSessionExpires(c);
+
     // Persist data
     if (Q_UNLIKELY(!m_instance)) {
         qCCritical(C_SESSION) << "Session plugin not registered";
         return;
     }
-    saveSessionExpires(c);
 
     if (!c->property(SESSION_UPDATED).toBool()) {
         return;
@@ -436,18 +488,25 @@ QVariant SessionPrivate::loadSession(Context *c)
 
 bool SessionPrivate::validateSessionId(const QString &id)
 {
-    auto it = id.constBegin();
-    auto end = id.constEnd();
+    // sids have a fixed shape, 32 lowercase hex characters (16
+    // random bytes from generateSessionId()); checking the length
+    // first rejects malformed or hostile ids with one comparison,
+    // before any store access, and bounds the charset scan
+    if (id.size() != 32) {
+        return false;
+    }
+
+    const QChar *it = id.constData();
+    const QChar *end = it + 32;
     while (it != end) {
-        QChar c = *it;
-        if ((c >= QLatin1Char('a') && c <= QLatin1Char('f')) || (c >= QLatin1Char('0') && c <= QLatin1Char('9'))) {
-            ++it;
-            continue;
+        const ushort u = it->unicode();
+        if ((u < '0' || u > '9') && (u < 'a' || u > 'f')) {
+            return false;
         }
-        return false;
+        ++it;
     }
 
-    return id.size();
+    return true;
 }
 
 quint64 SessionPrivate::extendSessionExpires(Session *session, Context *c, quint64 expires)
@@ -600,4 +659,426 @@ SessionStore::SessionStore(QObject *parent) : QObject(parent)
 
 }
 
+// Default session data codec: one tag byte per value followed by
+// varint sized payloads, against QDataStream's QVariant encoding
+// which spells out a type id, a null byte and a length-prefixed
+// UTF-16 key for every entry. Types outside the tag set round-trip
+// through a QDataStream escape so nothing is lost. Doubles are
+// stored in host byte order, session stores are not shared across
+// architectures.
+enum SessionCodecTag : quint8 {
+    TagNull = 0x00,
+    TagFalse,
+    TagTrue,
+    TagInt,        // zigzag varint
+    TagUInt,       // varint
+    TagDouble,     // 8 raw bytes
+    TagString,     // varint byte count + UTF-8
+    TagByteArray,  // varint byte count + raw bytes
+    TagList,       // varint count + values
+    TagHash,       // varint count + string/value pairs
+    TagMap,        // same wire shape as TagHash, decodes ordered
+    TagStringList, // varint count + strings
+    TagDateTime,   // zigzag varint msecs since epoch
+    TagVariant = 0x1F // varint byte count + QDataStream encoding
+};
+
+static const char SessionCodecMagic = char(0xB5);
+
+enum SessionCodecFlag : quint8 {
+    CodecPlain = 0x00,
+    CodecDeflated = 0x01
+};
+
+// Records past this size take the zlib round-trip, below it the
+// compression header overhead eats most of the win
+static const int SessionCodecCompressAbove = 4096;
+
+static void writeVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+static bool readVarint(const char *&p, const char *end, quint64 *value)
+{
+    quint64 ret = 0;
+    int shift = 0;
+    while (p < end && shift < 64) {
+        const quint8 byte = quint8(*p++);
+        ret |= quint64(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = ret;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+static void encodeString(QByteArray &out, const QString &str)
+{
+    const QByteArray utf8 = str.toUtf8();
+    writeVarint(out, quint64(utf8.size()));
+    out.append(utf8);
+}
+
+static void encodeValue(QByteArray &out, const QVariant &value);
+
+static void encodeHash(QByteArray &out, const QVariantHash &hash)
+{
+    writeVarint(out, quint64(hash.size()));
+    auto it = hash.constBegin();
+    while (it != hash.constEnd()) {
+        encodeString(out, it.key());
+        encodeValue(out, it.value());
+        ++it;
+    }
+}
+
+static void encodeValue(QByteArray &out, const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::UnknownType:
+        out.append(char(TagNull));
+        break;
+    case QMetaType::Bool:
+        out.append(value.toBool() ? char(TagTrue) : char(TagFalse));
+        break;
+    case QMetaType::Int:
+    case QMetaType::LongLong:
+    {
+        const qint64 v = value.toLongLong();
+        out.append(char(TagInt));
+        writeVarint(out, (quint64(v) << 1) ^ quint64(v >> 63));
+        break;
+    }
+    case QMetaType::UInt:
+    case QMetaType::ULongLong:
+        out.append(char(TagUInt));
+        writeVarint(out, value.toULongLong());
+        break;
+    case QMetaType::Double:
+    {
+        const double v = value.toDouble();
+        out.append(char(TagDouble));
+        out.append(reinterpret_cast<const char *>(&v), int(sizeof(v)));
+        break;
+    }
+    case QMetaType::QString:
+        out.append(char(TagString));
+        encodeString(out, value.toString());
+        break;
+    case QMetaType::QByteArray:
+    {
+        const QByteArray bytes = value.toByteArray();
+        out.append(char(TagByteArray));
+        writeVarint(out, quint64(bytes.size()));
+        out.append(bytes);
+        break;
+    }
+    case QMetaType::QVariantList:
+    {
+        const QVariantList list = value.toList();
+        out.append(char(TagList));
+        writeVarint(out, quint64(list.size()));
+        for (const QVariant &item : list) {
+            encodeValue(out, item);
+        }
+        break;
+    }
+    case QMetaType::QVariantHash:
+        out.append(char(TagHash));
+        encodeHash(out, value.toHash());
+        break;
+    case QMetaType::QVariantMap:
+    {
+        const QVariantMap map = value.toMap();
+        out.append(char(TagMap));
+        writeVarint(out, quint64(map.size()));
+        auto it = map.constBegin();
+        while (it != map.constEnd()) {
+            encodeString(out, it.key());
+            encodeValue(out, it.value());
+            ++it;
+        }
+        break;
+    }
+    case QMetaType::QStringList:
+    {
+        const QStringList list = value.toStringList();
+        out.append(char(TagStringList));
+        writeVarint(out, quint64(list.size()));
+        for (const QString &str : list) {
+            encodeString(out, str);
+        }
+        break;
+    }
+    case QMetaType::QDateTime:
+    {
+        const QDateTime dt = value.toDateTime();
+        if (!dt.isValid()) {
+            // every value must contribute a tag, the key is already
+            // on the wire
+            out.append(char(TagNull));
+            break;
+        }
+        const qint64 msecs = dt.toMSecsSinceEpoch();
+        out.append(char(TagDateTime));
+        writeVarint(out, (quint64(msecs) << 1) ^ quint64(msecs >> 63));
+        break;
+    }
+    default:
+    {
+        QByteArray raw;
+        QDataStream stream(&raw, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_6);
+        stream << value;
+        out.append(char(TagVariant));
+        writeVarint(out, quint64(raw.size()));
+        out.append(raw);
+    }
+    }
+}
+
+static bool decodeString(const char *&p, const char *end, QString *str)
+{
+    quint64 len;
+    if (!readVarint(p, end, &len) || len > quint64(end - p)) {
+        return false;
+    }
+    *str = QString::fromUtf8(p, int(len));
+    p += len;
+    return true;
+}
+
+static bool decodeValue(const char *&p, const char *end, QVariant *value)
+{
+    if (p >= end) {
+        return false;
+    }
+
+    const quint8 tag = quint8(*p++);
+    switch (tag) {
+    case TagNull:
+        *value = QVariant();
+        return true;
+    case TagFalse:
+        *value = false;
+        return true;
+    case TagTrue:
+        *value = true;
+        return true;
+    case TagInt:
+    {
+        quint64 zz;
+        if (!readVarint(p, end, &zz)) {
+            return false;
+        }
+        *value = qint64(zz >> 1) ^ -qint64(zz & 1);
+        return true;
+    }
+    case TagUInt:
+    {
+        quint64 v;
+        if (!readVarint(p, end, &v)) {
+            return false;
+        }
+        *value = v;
+        return true;
+    }
+    case TagDouble:
+    {
+        double v;
+        if (quint64(end - p) < sizeof(v)) {
+            return false;
+        }
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        *value = v;
+        return true;
+    }
+    case TagString:
+    {
+        QString str;
+        if (!decodeString(p, end, &str)) {
+            return false;
+        }
+        *value = str;
+        return true;
+    }
+    case TagByteArray:
+    {
+        quint64 len;
+        if (!readVarint(p, end, &len) || len > quint64(end - p)) {
+            return false;
+        }
+        *value = QByteArray(p, int(len));
+        p += len;
+        return true;
+    }
+    case TagList:
+    {
+        quint64 count;
+        if (!readVarint(p, end, &count) || count > quint64(end - p)) {
+            return false;
+        }
+        QVariantList list;
+        list.reserve(int(count));
+        for (quint64 i = 0; i < count; ++i) {
+            QVariant item;
+            if (!decodeValue(p, end, &item)) {
+                return false;
+            }
+            list.append(item);
+        }
+        *value = list;
+        return true;
+    }
+    case TagHash:
+    {
+        quint64 count;
+        if (!readVarint(p, end, &count) || count > quint64(end - p)) {
+            return false;
+        }
+        QVariantHash hash;
+        hash.reserve(int(count));
+        for (quint64 i = 0; i < count; ++i) {
+            QString key;
+            QVariant item;
+            if (!decodeString(p, end, &key) || !decodeValue(p, end, &item)) {
+                return false;
+            }
+            hash.insert(key, item);
+        }
+        *value = hash;
+        return true;
+    }
+    case TagMap:
+    {
+        quint64 count;
+        if (!readVarint(p, end, &count) || count > quint64(end - p)) {
+            return false;
+        }
+        QVariantMap map;
+        for (quint64 i = 0; i < count; ++i) {
+            QString key;
+            QVariant item;
+            if (!decodeString(p, end, &key) || !decodeValue(p, end, &item)) {
+                return false;
+            }
+            map.insert(key, item);
+        }
+        *value = map;
+        return true;
+    }
+    case TagStringList:
+    {
+        quint64 count;
+        if (!readVarint(p, end, &count) || count > quint64(end - p)) {
+            return false;
+        }
+        QStringList list;
+        list.reserve(int(count));
+        for (quint64 i = 0; i < count; ++i) {
+            QString str;
+            if (!decodeString(p, end, &str)) {
+                return false;
+            }
+            list.append(str);
+        }
+        *value = list;
+        return true;
+    }
+    case TagDateTime:
+    {
+        quint64 zz;
+        if (!readVarint(p, end, &zz)) {
+            return false;
+        }
+        *value = QDateTime::fromMSecsSinceEpoch(qint64(zz >> 1) ^ -qint64(zz & 1));
+        return true;
+    }
+    case TagVariant:
+    {
+        quint64 len;
+        if (!readVarint(p, end, &len) || len > quint64(end - p)) {
+            return false;
+        }
+        QDataStream stream(QByteArray::fromRawData(p, int(len)));
+        stream.setVersion(QDataStream::Qt_5_6);
+        QVariant v;
+        stream >> v;
+        p += len;
+        *value = v;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+QByteArray SessionStore::serializeSessionData(const QVariantHash &data) const
+{
+    QByteArray payload;
+    encodeHash(payload, data);
+
+    QByteArray ret;
+    if (payload.size() > SessionCodecCompressAbove) {
+        ret.append(SessionCodecMagic);
+        ret.append(char(CodecDeflated));
+        ret.append(qCompress(payload));
+    } else {
+        ret.reserve(payload.size() + 2);
+        ret.append(SessionCodecMagic);
+        ret.append(char(CodecPlain));
+        ret.append(payload);
+    }
+    return ret;
+}
+
+QVariantHash SessionStore::deserializeSessionData(const QByteArray &data) const
+{
+    QVariantHash ret;
+    if (data.size() < 2 || data.at(0) != SessionCodecMagic) {
+        // sessions written before the codec existed carry the
+        // QDataStream encoding, readable until they expire
+        QDataStream in(data);
+        in >> ret;
+        return ret;
+    }
+
+    QByteArray payload;
+    if (data.at(1) == char(CodecDeflated)) {
+        payload = qUncompress(reinterpret_cast<const uchar *>(data.constData()) + 2,
+                              data.size() - 2);
+    } else {
+        payload = QByteArray::fromRawData(data.constData() + 2, data.size() - 2);
+    }
+
+    const char *p = payload.constData();
+    const char *end = p + payload.size();
+    quint64 count;
+    if (!readVarint(p, end, &count) || count > quint64(end - p)) {
+        qCWarning(C_SESSION) << "Corrupt session record, discarding it";
+        return QVariantHash();
+    }
+
+    ret.reserve(int(count));
+    for (quint64 i = 0; i < count; ++i) {
+        QString key;
+        QVariant value;
+        if (!decodeString(p, end, &key) || !decodeValue(p, end, &value)) {
+            qCWarning(C_SESSION) << "Corrupt session record, discarding it";
+            return QVariantHash();
+        }
+        ret.insert(key, value);
+    }
+
+    return ret;
+}
+
 #include "moc_session.cpp"
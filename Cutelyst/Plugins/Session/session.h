@@ -55,6 +55,29 @@ public:
      * Removes all expired sessions which are above expires.
      */
     virtual bool deleteExpiredSessions(Context *c, quint64 expires) = 0;
+
+    /**
+     * Serializes session data into the byte array a store writes out.
+     *
+     * The default implementation uses a compact schema-less binary
+     * encoding that is a fraction of the size of the QDataStream
+     * QVariant format, and deflates records past a few KiB.
+     * Reimplement together with deserializeSessionData() to plug a
+     * different codec into a store.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    virtual QByteArray serializeSessionData(const QVariantHash &data) const;
+
+    /**
+     * Decodes a byte array written by serializeSessionData() back into
+     * session data. The default implementation still reads records in
+     * the QDataStream encoding used before Cutelyst 1.10.0, so
+     * existing sessions survive an upgrade.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    virtual QVariantHash deserializeSessionData(const QByteArray &data) const;
 };
 
 class SessionPrivate;
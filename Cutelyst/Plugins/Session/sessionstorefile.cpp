@@ -22,8 +22,10 @@
 
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCache>
 #include <QLockFile>
-#include <QDataStream>
 #include <QLoggingCategory>
 #include <QCoreApplication>
 
@@ -34,7 +36,19 @@ Q_LOGGING_CATEGORY(C_SESSION_FILE, "cutelyst.plugin.sessionfile")
 #define SESSION_STORE_FILE_SAVE "__session_store_file_save"
 #define SESSION_STORE_FILE_DATA "__session_store_file_data"
 
-static QVariantHash loadSessionData(Context *c, const QString &sid);
+static QVariantHash loadSessionData(SessionStore *store, Context *c, const QString &sid);
+
+struct CachedSession {
+    QVariantHash data;
+    QDateTime modified;
+    qint64 size;
+};
+
+// Per worker cache of recently parsed sessions, entries are
+// validated against the file metadata before use so writes from
+// other workers invalidate them with a stat instead of a full
+// open/parse round-trip
+static thread_local QCache<QString, CachedSession> t_sessionCache(512);
 
 SessionStoreFile::SessionStoreFile(QObject *parent) : SessionStore(parent)
 {
@@ -47,14 +61,14 @@ SessionStoreFile::~SessionStoreFile()
 
 QVariant SessionStoreFile::getSessionData(Context *c, const QString &sid, const QString &key, const QVariant &defaultValue)
 {
-    const QVariantHash data = loadSessionData(c, sid);
+    const QVariantHash data = loadSessionData(this, c, sid);
 
     return data.value(key, defaultValue);
 }
 
 bool SessionStoreFile::storeSessionData(Context *c, const QString &sid, const QString &key, const QVariant &value)
 {
-    QVariantHash data = loadSessionData(c, sid);
+    QVariantHash data = loadSessionData(this, c, sid);
 
     data.insert(key, value);
     c->setProperty(SESSION_STORE_FILE_DATA, data);
@@ -65,7 +79,7 @@ bool SessionStoreFile::storeSessionData(Context *c, const QString &sid, const QS
 
 bool SessionStoreFile::deleteSessionData(Context *c, const QString &sid, const QString &key)
 {
-    QVariantHash data = loadSessionData(c, sid);
+    QVariantHash data = loadSessionData(this, c, sid);
 
     data.remove(key);
     c->setProperty(SESSION_STORE_FILE_DATA, data);
@@ -81,7 +95,7 @@ bool SessionStoreFile::deleteExpiredSessions(Context *c, quint64 expires)
     return true;
 }
 
-QVariantHash loadSessionData(Context *c, const QString &sid)
+QVariantHash loadSessionData(SessionStore *store, Context *c, const QString &sid)
 {
     QVariantHash data;
     const QVariant sessionVariant = c->property(SESSION_STORE_FILE_DATA);
@@ -95,20 +109,10 @@ QVariantHash loadSessionData(Context *c, const QString &sid)
             + QCoreApplication::applicationName()
             + QLatin1String("/session/data");
 
-    auto file = new QFile(root + QLatin1Char('/') + sid, c);
-    if (!file->open(QIODevice::ReadWrite)) {
-        if (!QDir().mkpath(root)) {
-            qCWarning(C_SESSION_FILE) << "Failed to create path for session object" << root;
-            return data;
-        }
-
-        if (!file->open(QIODevice::ReadWrite)) {
-            return data;
-        }
-    }
+    const QString fileName = root + QLatin1Char('/') + sid;
 
     // Commit data when Context gets deleted
-    QObject::connect(c, &Context::destroyed, [=] () {
+    QObject::connect(c, &Context::destroyed, [store, c, sid, fileName] () {
         if (!c->property(SESSION_STORE_FILE_SAVE).toBool()) {
             return;
         }
@@ -116,33 +120,67 @@ QVariantHash loadSessionData(Context *c, const QString &sid)
         QVariantHash data = c->property(SESSION_STORE_FILE_DATA).toHash();
 
         if (data.isEmpty()) {
-            QFile::remove(file->fileName());
+            QFile::remove(fileName);
+            t_sessionCache.remove(sid);
         } else {
-            QLockFile lock(file->fileName() + QLatin1String(".lock"));
+            QLockFile lock(fileName + QLatin1String(".lock"));
             if (lock.lock()) {
-                QDataStream in(file);
-
-                if (file->pos()) {
-                    file->seek(0);
+                QFile file(fileName);
+                if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                    if (!QDir().mkpath(root)) {
+                        qCWarning(C_SESSION_FILE) << "Failed to create path for session object" << root;
+                        lock.unlock();
+                        return;
+                    }
+
+                    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                        lock.unlock();
+                        return;
+                    }
                 }
 
-                in << data;
+                file.write(store->serializeSessionData(data));
+                file.close();
 
-                if (file->pos() < file->size()) {
-                    file->resize(file->pos());
-                }
+                auto entry = new CachedSession;
+                entry->data = data;
+                const QFileInfo info(fileName);
+                entry->modified = info.lastModified();
+                entry->size = info.size();
+                t_sessionCache.insert(sid, entry);
 
-                file->flush();
                 lock.unlock();
             }
         }
     });
 
+    // Serve recently parsed data when the file was not
+    // touched by another worker in the meantime
+    CachedSession *cached = t_sessionCache.object(sid);
+    if (cached) {
+        const QFileInfo info(fileName);
+        if (info.lastModified() == cached->modified && info.size() == cached->size) {
+            data = cached->data;
+            c->setProperty(SESSION_STORE_FILE_DATA, data);
+            return data;
+        }
+        t_sessionCache.remove(sid);
+    }
+
     // Load data
-    QLockFile lock(file->fileName() + QLatin1String(".lock"));
+    QLockFile lock(fileName + QLatin1String(".lock"));
     if (lock.lock()) {
-        QDataStream in(file);
-        in >> data;
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadOnly)) {
+            const QFileInfo info(fileName);
+            data = store->deserializeSessionData(file.readAll());
+
+            auto entry = new CachedSession;
+            entry->data = data;
+            entry->modified = info.lastModified();
+            entry->size = info.size();
+            t_sessionCache.insert(sid, entry);
+        }
         lock.unlock();
     }
 
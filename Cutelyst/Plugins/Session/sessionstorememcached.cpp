@@ -21,7 +21,6 @@
 #include <Cutelyst/Context>
 
 #include <QLoggingCategory>
-#include <QDataStream>
 #include <QCoreApplication>
 
 using namespace Cutelyst;
@@ -31,7 +30,7 @@ Q_LOGGING_CATEGORY(C_SESSION_MEMCACHED, "cutelyst.plugin.sessionmemcached")
 #define SESSION_STORE_MEMCD_SAVE "__session_store_memcd_save"
 #define SESSION_STORE_MEMCD_DATA "__session_store_memcd_data"
 
-static QVariantHash loadMemcSessionData(Context *c, const QString &sid, const std::__cxx11::string &config);
+static QVariantHash loadMemcSessionData(SessionStore *store, Context *c, const QString &sid, const std::__cxx11::string &config);
 
 SessionStoreMemcached::SessionStoreMemcached(QObject *parent) :
     SessionStore(parent), d_ptr(new SessionStoreMemcachedPrivate)
@@ -52,14 +51,14 @@ SessionStoreMemcached::~SessionStoreMemcached()
 
 QVariant SessionStoreMemcached::getSessionData(Context *c, const QString &sid, const QString &key, const QVariant &defaultValue)
 {
-    const QVariantHash data = loadMemcSessionData(c, sid, d_ptr->config);
+    const QVariantHash data = loadMemcSessionData(this, c, sid, d_ptr->config);
 
     return data.value(key, defaultValue);
 }
 
 bool SessionStoreMemcached::storeSessionData(Context *c, const QString &sid, const QString &key, const QVariant &value)
 {
-    QVariantHash data = loadMemcSessionData(c, sid, d_ptr->config);
+    QVariantHash data = loadMemcSessionData(this, c, sid, d_ptr->config);
 
     data.insert(key, value);
     c->setProperty(SESSION_STORE_MEMCD_DATA, data);
@@ -70,7 +69,7 @@ bool SessionStoreMemcached::storeSessionData(Context *c, const QString &sid, con
 
 bool SessionStoreMemcached::deleteSessionData(Context *c, const QString &sid, const QString &key)
 {
-    QVariantHash data = loadMemcSessionData(c, sid, d_ptr->config);
+    QVariantHash data = loadMemcSessionData(this, c, sid, d_ptr->config);
 
     data.remove(key);
     c->setProperty(SESSION_STORE_MEMCD_DATA, data);
@@ -86,7 +85,26 @@ bool SessionStoreMemcached::deleteExpiredSessions(Context *c, quint64 expires)
     return true;
 }
 
-QVariantHash loadMemcSessionData(Context *c, const QString &sid, const std::string &config)
+static memcache::Memcache *threadMemcached(const std::string &config)
+{
+    // One handle per worker thread, memcached_st is not thread safe
+    // and a single shared handle serializes every worker on one
+    // connection
+    static thread_local memcache::Memcache memc(config);
+    static thread_local bool behaviorsSet = false;
+    if (!behaviorsSet) {
+        behaviorsSet = true;
+        // Send requests eagerly on a no-delay socket and hash keys
+        // with ketama so multiple --SERVER entries rebalance
+        // gracefully when one goes away
+        memc.setBehavior(MEMCACHED_BEHAVIOR_TCP_NODELAY, 1);
+        memc.setBehavior(MEMCACHED_BEHAVIOR_NO_BLOCK, 1);
+        memc.setBehavior(MEMCACHED_BEHAVIOR_KETAMA_WEIGHTED, 1);
+    }
+    return &memc;
+}
+
+QVariantHash loadMemcSessionData(SessionStore *store, Context *c, const QString &sid, const std::string &config)
 {
     QVariantHash data;
     const QVariant sessionVariant = c->property(SESSION_STORE_MEMCD_DATA);
@@ -98,9 +116,10 @@ QVariantHash loadMemcSessionData(Context *c, const QString &sid, const std::stri
     const static QString sessionPrefix = QCoreApplication::applicationName() + QLatin1String("_sess_");
     const QString sessionKey = sessionPrefix + sid;
 
-    static memcache::Memcache memc(config);
+    memcache::Memcache *memcPtr = threadMemcached(config);
 
     QObject::connect(c, &Context::destroyed, [=] () {
+        memcache::Memcache &memc = *memcPtr;
         if (!c->property(SESSION_STORE_MEMCD_SAVE).toBool()) {
             return;
         }
@@ -114,9 +133,7 @@ QVariantHash loadMemcSessionData(Context *c, const QString &sid, const std::stri
                 qCWarning(C_SESSION_MEMCACHED) << "Failed to remove session from Memcached:" << QString::fromStdString(errorString);
             }
         } else {
-            QByteArray storeData;
-            QDataStream out(&storeData, QIODevice::WriteOnly);
-            out << data;
+            QByteArray storeData = store->serializeSessionData(data);
 
             if (!memc.set(sessionKey.toStdString(),
                           storeData.data(),
@@ -132,16 +149,11 @@ QVariantHash loadMemcSessionData(Context *c, const QString &sid, const std::stri
     });
 
     std::vector<char> storedData;
-    if (memc.get(sessionKey.toStdString(), storedData)) {
+    if (memcPtr->get(sessionKey.toStdString(), storedData)) {
         if (!storedData.empty()) {
-            QByteArray storedArray;
-            for (auto it = storedData.cbegin(); it != storedData.cend(); ++it) {
-                storedArray.append(*it);
-            }
-            if (!storedArray.isNull()) {
-                QDataStream in(&storedArray, QIODevice::ReadOnly);
-                in >> data;
-            }
+            // deserialize straight out of the vector, no copy
+            const QByteArray storedArray = QByteArray::fromRawData(storedData.data(), int(storedData.size()));
+            data = store->deserializeSessionData(storedArray);
         }
     }
 
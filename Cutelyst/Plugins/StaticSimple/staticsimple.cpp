@@ -17,6 +17,7 @@
  * Boston, MA 02110-1301, USA.
  */
 #include "staticsimple_p.h"
+#include "keys_p.h"
 
 #include "application.h"
 #include "request.h"
@@ -27,6 +28,7 @@
 #include <QFile>
 #include <QDir>
 #include <QDateTime>
+#include <QFileSystemWatcher>
 #include <QLoggingCategory>
 
 using namespace Cutelyst;
@@ -62,6 +64,17 @@ void StaticSimple::setDirs(const QStringList &dirs)
 
 bool StaticSimple::setup(Cutelyst::Application *app)
 {
+    Q_D(StaticSimple);
+
+    // The watcher invalidates cached file metadata when a served
+    // directory changes, so entries can stay valid between changes
+    // instead of being re-stated on a short timer
+    d->watcher = new QFileSystemWatcher(this);
+    connect(d->watcher, &QFileSystemWatcher::directoryChanged, this, [d] (const QString &dir) {
+        qCDebug(C_STATICSIMPLE) << "Directory changed, dropping cached metadata" << dir;
+        d->resolveCache.clear();
+    });
+
     connect(app, &Application::beforePrepareAction,
             this, &StaticSimple::beforePrepareAction);
     return true;
@@ -83,50 +96,191 @@ void StaticSimple::beforePrepareAction(Context *c, bool *skipMethod)
     }
 }
 
+// both positive and negative resolutions stay valid this long when the
+// file's directory could not be watched, an asset storm then costs at
+// most one stat round per second
+#define STATIC_RESOLVE_TTL 1000
+
+// entries whose directory is watched are invalidated by the watcher,
+// the deadline only bounds the damage should a change event get lost
+#define STATIC_WATCHED_TTL 3600000
+
 bool StaticSimple::locateStaticFile(Context *c, const QString &relPath)
 {
-    Q_D(const StaticSimple);
+    Q_D(StaticSimple);
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const ResolvedStatic *cached = d->resolveCache.object(relPath);
+    if (cached && cached->validUntil > now) {
+        if (cached->path.isEmpty()) {
+            // recently probed and absent from every include path
+            return false;
+        }
+        return serveStaticFile(c, *cached);
+    }
 
     for (const QDir &includePath : d->includePaths) {
         QString path = includePath.absoluteFilePath(relPath);
         QFileInfo fileInfo(path);
         if (fileInfo.exists()) {
-            Response *res = c->res();
-            const QDateTime currentDateTime = fileInfo.lastModified();
-            if (currentDateTime == c->req()->headers().ifModifiedSinceDateTime()) {
-                res->setStatus(Response::NotModified);
-                return true;
+            auto resolved = new ResolvedStatic;
+            resolved->path = path;
+            resolved->lastModified = fileInfo.lastModified();
+            resolved->size = fileInfo.size();
+
+            static QMimeDatabase db;
+            // use the extension to match to be faster
+            const QMimeType mimeType = db.mimeTypeForFile(path, QMimeDatabase::MatchExtension);
+            if (mimeType.isValid()) {
+                resolved->contentType = mimeType.name();
+            }
+
+            // weak validator from mtime and size, no need to read the file
+            resolved->etag = QLatin1String("W/\"")
+                    + QString::number(resolved->lastModified.toMSecsSinceEpoch(), 16)
+                    + QLatin1Char('-') + QString::number(resolved->size, 16)
+                    + QLatin1Char('"');
+
+            const QString dir = fileInfo.absolutePath();
+            if (!d->watchedDirs.contains(dir)) {
+                d->watchedDirs.insert(dir);
+                d->watcher->addPath(dir);
             }
+            resolved->validUntil = now + (d->watcher->directories().contains(dir)
+                                          ? STATIC_WATCHED_TTL : STATIC_RESOLVE_TTL);
 
-            QFile *file = new QFile(path);
-            if (file->open(QFile::ReadOnly)) {
-                qCDebug(C_STATICSIMPLE) << "Serving" << path;
-                Headers &headers = res->headers();
+            const bool ret = serveStaticFile(c, *resolved);
+            d->resolveCache.insert(relPath, resolved);
+            return ret;
+        }
+    }
 
-                // set our open file
-                res->setBody(file);
+    d->resolveCache.insert(relPath, new ResolvedStatic{ QString(), QDateTime(), 0, QString(), QString(), now + STATIC_RESOLVE_TTL });
 
-                static QMimeDatabase db;
-                // use the extension to match to be faster
-                QMimeType mimeType = db.mimeTypeForFile(path, QMimeDatabase::MatchExtension);
-                if (mimeType.isValid()) {
-                    headers.setContentType(mimeType.name());
-                }
-                headers.setContentLength(file->size());
+    qCWarning(C_STATICSIMPLE) << "File not found" << relPath;
+    return false;
+}
 
-                headers.setLastModified(currentDateTime);
-                // Tell Firefox & friends its OK to cache, even over SSL
-                headers.setHeader(QStringLiteral("CACHE_CONTROL"), QStringLiteral("public"));
+struct ByteRange {
+    qint64 start = 0;
+    qint64 end = -1;
+    bool valid = false;
+    bool unsatisfiable = false;
+};
 
-                return true;
-            }
+// Parses a single range Range header against the entity size.
+// Multi range answers would need a multipart/byteranges body, those
+// clients get the whole file instead.
+static ByteRange parseRangeHeader(const QString &range, qint64 size)
+{
+    ByteRange ret;
+    if (!range.startsWith(QLatin1String("bytes=")) || range.contains(QLatin1Char(','))) {
+        return ret;
+    }
 
-            qCWarning(C_STATICSIMPLE) << "Could not serve" << path << file->errorString();
-            return false;
+    const int dash = range.indexOf(QLatin1Char('-'), 6);
+    if (dash == -1) {
+        return ret;
+    }
+
+    const QString startStr = range.mid(6, dash - 6).trimmed();
+    const QString endStr = range.mid(dash + 1).trimmed();
+    if (startStr.isEmpty()) {
+        // suffix form, the last N bytes
+        if (endStr.isEmpty()) {
+            return ret;
+        }
+        const qint64 suffix = endStr.toLongLong();
+        if (suffix <= 0) {
+            ret.unsatisfiable = true;
+            return ret;
+        }
+        ret.start = qMax(qint64(0), size - suffix);
+        ret.end = size - 1;
+    } else {
+        bool ok;
+        ret.start = startStr.toLongLong(&ok);
+        if (!ok || ret.start >= size) {
+            ret.unsatisfiable = ret.start >= size;
+            return ret;
+        }
+        ret.end = endStr.isEmpty() ? size - 1 : qMin(endStr.toLongLong(), size - 1);
+        if (ret.end < ret.start) {
+            return ret;
         }
     }
 
-    qCWarning(C_STATICSIMPLE) << "File not found" << relPath;
+    ret.valid = true;
+    return ret;
+}
+
+bool StaticSimple::serveStaticFile(Context *c, const ResolvedStatic &file_info)
+{
+    Response *res = c->res();
+
+    // answered from the cached metadata alone, without touching the file
+    const QString ifNoneMatch = c->req()->headers().header(Keys::IF_NONE_MATCH);
+    if (!ifNoneMatch.isEmpty()) {
+        if (ifNoneMatch == file_info.etag) {
+            res->setStatus(Response::NotModified);
+            res->headers().setHeader(Keys::ETAG, file_info.etag);
+            return true;
+        }
+    } else if (file_info.lastModified == c->req()->headers().ifModifiedSinceDateTime()) {
+        res->setStatus(Response::NotModified);
+        return true;
+    }
+
+    QFile *file = new QFile(file_info.path);
+    if (file->open(QFile::ReadOnly)) {
+        qCDebug(C_STATICSIMPLE) << "Serving" << file_info.path;
+        Headers &headers = res->headers();
+
+        // set our open file
+        res->setBody(file);
+
+        if (!file_info.contentType.isEmpty()) {
+            headers.setContentType(file_info.contentType);
+        }
+        qint64 contentLength = file_info.size;
+
+        headers.setHeader(Keys::ACCEPT_RANGES, QStringLiteral("bytes"));
+
+        const QString rangeHeader = c->req()->headers().header(Keys::RANGE);
+        // an If-Range validator other than our ETag means the client's
+        // copy may be stale, those clients get the whole file
+        const QString ifRange = c->req()->headers().header(Keys::IF_RANGE);
+        if (!rangeHeader.isEmpty()
+                && (ifRange.isEmpty() || ifRange == file_info.etag)) {
+            const ByteRange range = parseRangeHeader(rangeHeader, contentLength);
+            if (range.unsatisfiable) {
+                res->setStatus(Response::RequestedRangeNotSatisfiable);
+                res->setBody(QByteArray());
+                headers.setHeader(Keys::CONTENT_RANGE,
+                                  QLatin1String("bytes */") + QString::number(contentLength));
+                contentLength = 0;
+            } else if (range.valid) {
+                // the engine windows the file body from the
+                // Content-Range header, mapping it to an offset sendfile
+                res->setStatus(Response::PartialContent);
+                headers.setHeader(Keys::CONTENT_RANGE,
+                                  QLatin1String("bytes ") + QString::number(range.start)
+                                  + QLatin1Char('-') + QString::number(range.end)
+                                  + QLatin1Char('/') + QString::number(contentLength));
+                contentLength = range.end - range.start + 1;
+            }
+        }
+        headers.setContentLength(contentLength);
+
+        headers.setLastModified(file_info.lastModified);
+        headers.setHeader(Keys::ETAG, file_info.etag);
+        // Tell Firefox & friends its OK to cache, even over SSL
+        headers.setHeader(Keys::CACHE_CONTROL, QStringLiteral("public"));
+
+        return true;
+    }
+
+    qCWarning(C_STATICSIMPLE) << "Could not serve" << file_info.path << file->errorString();
     return false;
 }
 
@@ -23,8 +23,11 @@
 #include <Cutelyst/plugin.h>
 #include <Cutelyst/context.h>
 
+class QDateTime;
+
 namespace Cutelyst {
 
+struct ResolvedStatic;
 class StaticSimplePrivate;
 class CUTELYST_PLUGIN_STATICSIMPLE_EXPORT StaticSimple : public Plugin
 {
@@ -62,6 +65,7 @@ protected:
 private:
     void beforePrepareAction(Context *c, bool *skipMethod);
     bool locateStaticFile(Context *c, const QString &relPath);
+    bool serveStaticFile(Context *c, const ResolvedStatic &file_info);
 };
 
 }
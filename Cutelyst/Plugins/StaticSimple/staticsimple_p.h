@@ -23,15 +23,40 @@
 
 #include <QRegularExpression>
 #include <QDir>
+#include <QDateTime>
+#include <QCache>
+#include <QSet>
+
+class QFileSystemWatcher;
 
 namespace Cutelyst {
 
+struct ResolvedStatic
+{
+    QString path; // empty when no include path had the file
+    QDateTime lastModified;
+    qint64 size;
+    QString contentType;
+    QString etag;
+    qint64 validUntil;
+};
+
 class StaticSimplePrivate
 {
 public:
     QVector<QDir> includePaths;
     QStringList dirs;
     QRegularExpression re = QRegularExpression(QStringLiteral("\\.[^/]+$"));
+
+    // Cache of positive and negative lookups holding everything a
+    // conditional answer needs, so an asset storm does not stat every
+    // include path again per request and a 304 costs no syscall at all
+    mutable QCache<QString, ResolvedStatic> resolveCache{1024};
+
+    // Directories of served files, watched so entries can outlive the
+    // short revalidation window; files change rarely, requests do not
+    QFileSystemWatcher *watcher = nullptr;
+    QSet<QString> watchedDirs;
 };
 
 }
@@ -19,10 +19,14 @@
 #include "statusmessage.h"
 
 #include <Cutelyst/Application>
+#include <Cutelyst/Engine>
+#include <Cutelyst/Response>
 #include <Cutelyst/Plugins/Session/session.h>
 
 #include <QtCore/QDateTime>
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QMessageAuthenticationCode>
+#include <QtNetwork/QNetworkCookie>
 
 using namespace Cutelyst;
 
@@ -41,6 +45,8 @@ public:
     QString tokenParam = QStringLiteral("mid");
     QString statusMsgStashKey = QStringLiteral("status_msg");
     QString errorMsgStashKey = QStringLiteral("error_msg");
+    QByteArray cookieSecret;
+    int cookieSizeLimit = 2048;
 };
 
 void StatusMessagePrivate::_q_postFork(Application *app)
@@ -109,6 +115,116 @@ void StatusMessage::setErrorMgStashKey(const QString &errorMgStashKey)
     d->errorMsgStashKey = errorMgStashKey;
 }
 
+QByteArray StatusMessage::cookieSecret() const
+{
+    Q_D(const StatusMessage);
+    return d->cookieSecret;
+}
+
+void StatusMessage::setCookieSecret(const QByteArray &cookieSecret)
+{
+    Q_D(StatusMessage);
+    d->cookieSecret = cookieSecret;
+}
+
+int StatusMessage::cookieSizeLimit() const
+{
+    Q_D(const StatusMessage);
+    return d->cookieSizeLimit;
+}
+
+void StatusMessage::setCookieSizeLimit(int cookieSizeLimit)
+{
+    Q_D(StatusMessage);
+    d->cookieSizeLimit = cookieSizeLimit;
+}
+
+static inline QByteArray messageCookieName(StatusMessagePrivate *priv, const QString &token)
+{
+    return priv->sessionPrefix.toLatin1() + '_' + token.toLatin1();
+}
+
+static inline QByteArray signMessagePayload(const QByteArray &payload, const QByteArray &secret)
+{
+    return QMessageAuthenticationCode::hash(payload, secret, QCryptographicHash::Sha256)
+            .toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+}
+
+// Constant-time comparison so the signature check leaks no timing,
+// same as slowEquals() in CredentialPassword, which lives in another
+// plugin library and is not exported
+static bool macEquals(const QByteArray &a, const QByteArray &b)
+{
+    int diff = a.size() ^ b.size();
+    for (int i = 0; i < a.size() && i < b.size(); ++i) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+static bool storeMessageCookie(StatusMessagePrivate *priv, Context *c, const QString &kind, const QString &msg, const QString &token)
+{
+    if (priv->cookieSecret.isEmpty()) {
+        return false;
+    }
+
+    const QByteArray payload = kind.toLatin1() + '|' +
+            msg.toUtf8().toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+    if (payload.size() > priv->cookieSizeLimit) {
+        // too big to travel client-side, use the session store
+        return false;
+    }
+
+    QNetworkCookie cookie(messageCookieName(priv, token),
+                          payload + '.' + signMessagePayload(payload, priv->cookieSecret));
+    cookie.setPath(QStringLiteral("/"));
+    cookie.setHttpOnly(true);
+    c->response()->setCookie(cookie);
+    return true;
+}
+
+static void storeMessage(StatusMessagePrivate *priv, Context *c, const QString &kind, const QString &msg, const QString &token)
+{
+    if (!storeMessageCookie(priv, c, kind, msg, token)) {
+        Session::setValue(c, priv->sessionPrefix + kind + token, msg);
+    }
+}
+
+static bool loadMessageCookie(StatusMessagePrivate *priv, Context *c, const QString &token)
+{
+    const QByteArray raw = c->request()->cookie(priv->sessionPrefix + QLatin1Char('_') + token).toLatin1();
+    if (raw.isEmpty()) {
+        return false;
+    }
+
+    const int dot = raw.lastIndexOf('.');
+    if (dot == -1 || !macEquals(signMessagePayload(raw.left(dot), priv->cookieSecret), raw.mid(dot + 1))) {
+        qCWarning(C_STATUSMESSAGE) << "Discarding status message cookie with bad signature";
+        return false;
+    }
+
+    const QByteArray payload = raw.left(dot);
+    const int sep = payload.indexOf('|');
+    if (sep == -1) {
+        return false;
+    }
+
+    const QString msg = QString::fromUtf8(QByteArray::fromBase64(payload.mid(sep + 1),
+                                                                 QByteArray::Base64UrlEncoding));
+    if (payload.startsWith("error")) {
+        c->setStash(priv->errorMsgStashKey, msg);
+    } else {
+        c->setStash(priv->statusMsgStashKey, msg);
+    }
+
+    // the message was consumed, have the user-agent drop the cookie
+    QNetworkCookie expired(messageCookieName(priv, token), QByteArray());
+    expired.setPath(QStringLiteral("/"));
+    expired.setExpirationDate(QDateTime::fromMSecsSinceEpoch(0));
+    c->response()->setCookie(expired);
+    return true;
+}
+
 void StatusMessage::load(Context *c)
 {
     if (Q_UNLIKELY(!m_instance)) {
@@ -122,6 +238,10 @@ void StatusMessage::load(Context *c)
         return;
     }
 
+    if (!priv->cookieSecret.isEmpty() && loadMessageCookie(priv, c, token)) {
+        return;
+    }
+
     QStringList deleteKeys;
     const QString statusKey = priv->sessionPrefix + QLatin1String("status") + token;
     const QVariant statusValue = Session::value(c, statusKey);
@@ -156,7 +276,7 @@ QString StatusMessage::error(Context *c, const QString &msg)
     }
 
     token = createToken();
-    Session::setValue(c, m_instance->d_ptr->sessionPrefix + QLatin1String("error") + token, msg);
+    storeMessage(m_instance->d_ptr, c, QStringLiteral("error"), msg, token);
     return token;
 }
 
@@ -170,7 +290,7 @@ ParamsMultiMap StatusMessage::errorQuery(Context *c, const QString &msg, ParamsM
     StatusMessagePrivate *priv = m_instance->d_ptr;
 
     const QString token = createToken();
-    Session::setValue(c, priv->sessionPrefix + QLatin1String("error") + token, msg);
+    storeMessage(priv, c, QStringLiteral("error"), msg, token);
     map.insert(priv->tokenParam, token);
     return map;
 }
@@ -184,7 +304,7 @@ QString StatusMessage::status(Context *c, const QString &msg)
     }
 
     token = createToken();
-    Session::setValue(c, m_instance->d_ptr->sessionPrefix + QLatin1String("status") + token, msg);
+    storeMessage(m_instance->d_ptr, c, QStringLiteral("status"), msg, token);
     return token;
 }
 
@@ -198,7 +318,7 @@ ParamsMultiMap StatusMessage::statusQuery(Context *c, const QString &msg, Params
     StatusMessagePrivate *priv = m_instance->d_ptr;
 
     const QString token = createToken();
-    Session::setValue(c, priv->sessionPrefix + QLatin1String("status") + token, msg);
+    storeMessage(priv, c, QStringLiteral("status"), msg, token);
     map.insert(priv->tokenParam, token);
     return map;
 }
@@ -215,6 +335,15 @@ QString StatusMessage::setStatus(Context *c, const QString &msg)
 
 bool StatusMessage::setup(Application *app)
 {
+    Q_D(StatusMessage);
+
+    const QVariantMap config = app->engine()->config(QLatin1String("Cutelyst_StatusMessage_Plugin"));
+    const QString secret = config.value(QLatin1String("cookie_secret")).toString();
+    if (!secret.isEmpty()) {
+        d->cookieSecret = secret.toUtf8();
+    }
+    d->cookieSizeLimit = config.value(QLatin1String("cookie_size_limit"), d->cookieSizeLimit).toInt();
+
     connect(app, &Application::postForked, this, &StatusMessagePrivate::_q_postFork);
     return true;
 }
@@ -77,6 +77,39 @@ public:
      */
     void setErrorMgStashKey(const QString &errorMgStashKey);
 
+    /**
+     * Returns the secret used to sign messages carried on a cookie.
+     */
+    QByteArray cookieSecret() const;
+
+    /**
+     * Sets the secret used to HMAC-sign messages carried client-side on a
+     * cookie instead of the session store. When set, messages that fit
+     * cookieSizeLimit() do not touch the session at all, removing the
+     * store write on the saving request and the read plus delete on the
+     * displaying one. Leave it empty (the default) to keep the session
+     * transport. Can also be set with the cookie_secret entry of the
+     * Cutelyst_StatusMessage_Plugin configuration section.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setCookieSecret(const QByteArray &cookieSecret);
+
+    /**
+     * Returns the maximum encoded size in bytes of a message carried on a cookie. Defaults to 2048.
+     */
+    int cookieSizeLimit() const;
+
+    /**
+     * Sets the maximum encoded size in bytes of a message carried on a
+     * cookie, larger messages fall back to the session store. Can also be
+     * set with the cookie_size_limit entry of the
+     * Cutelyst_StatusMessage_Plugin configuration section.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setCookieSizeLimit(int cookieSizeLimit);
+
     /**
      * Load both messages that match the token param (mid=###) into the stash for display by the view.
      */
@@ -18,6 +18,7 @@
  */
 #include "pagination.h"
 
+#include <QtCore/QDataStream>
 #include <QtCore/QLoggingCategory>
 
 using namespace Cutelyst;
@@ -102,3 +103,64 @@ QVector<int> Pagination::pages() const
 {
     return value(QStringLiteral("pages")).value<QVector<int> >();
 }
+
+QString Pagination::encodeCursor(const QStringList &keyValues)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << keyValues;
+
+    return QString::fromLatin1(data.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+}
+
+QStringList Pagination::decodeCursor(const QString &cursor)
+{
+    QStringList ret;
+
+    if (cursor.isEmpty()) {
+        return ret;
+    }
+
+    const QByteArray data = QByteArray::fromBase64(cursor.toLatin1(), QByteArray::Base64UrlEncoding);
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream >> ret;
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(C_PAGINATION) << "Discarding invalid cursor";
+        ret.clear();
+    }
+
+    return ret;
+}
+
+QString Pagination::cursorWhereClause(const QStringList &columns, bool descending)
+{
+    QString placeholders;
+    for (const QString &column : columns) {
+        if (!placeholders.isEmpty()) {
+            placeholders += QLatin1String(", ");
+        }
+        placeholders += QLatin1String(":cursor_") + column;
+    }
+
+    return QLatin1Char('(') + columns.join(QLatin1String(", "))
+            + (descending ? QLatin1String(") < (") : QLatin1String(") > ("))
+            + placeholders + QLatin1Char(')');
+}
+
+ParamsMultiMap Pagination::cursorParameters(const QStringList &columns, const QString &cursor)
+{
+    ParamsMultiMap ret;
+
+    const QStringList values = decodeCursor(cursor);
+    if (values.size() != columns.size()) {
+        return ret;
+    }
+
+    for (int i = 0; i < columns.size(); ++i) {
+        ret.insert(QLatin1String("cursor_") + columns.at(i), values.at(i));
+    }
+
+    return ret;
+}
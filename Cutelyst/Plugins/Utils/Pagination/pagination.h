@@ -21,6 +21,7 @@
 
 #include <QVariantMap>
 #include <Cutelyst/cutelyst_global.h>
+#include <Cutelyst/paramsmultimap.h>
 
 namespace Cutelyst {
 
@@ -62,6 +63,35 @@ public:
      * Returns the list of pages, with each page number as the integer
      */
     QVector<int> pages() const;
+
+    /**
+     * Returns an opaque continuation cursor built from the key column
+     * values of the last row of the current page, for keyset paging
+     * where OFFSET would force the database to scan the skipped rows.
+     */
+    static QString encodeCursor(const QStringList &keyValues);
+
+    /**
+     * Returns the key column values stored in a cursor created with
+     * encodeCursor(), or an empty list if the cursor is not valid.
+     */
+    static QStringList decodeCursor(const QString &cursor);
+
+    /**
+     * Returns a row value comparison for the WHERE clause of a keyset
+     * query, for example "(created_at, id) > (:cursor_created_at, :cursor_id)"
+     * for the columns created_at and id. Pass \p descending true when
+     * the ORDER BY is DESC so the comparison flips to "<".
+     */
+    static QString cursorWhereClause(const QStringList &columns, bool descending = false);
+
+    /**
+     * Returns the cursor values keyed as cursor_<column>, ready for
+     * Sql::bindParamsToQuery() on a query built with cursorWhereClause().
+     * An empty map is returned when the cursor does not carry one value
+     * per column, which also covers the first page with no cursor.
+     */
+    static ParamsMultiMap cursorParameters(const QStringList &columns, const QString &cursor);
 };
 
 }
@@ -19,9 +19,30 @@
 
 #include "sql.h"
 
+#include <Cutelyst/Context>
+
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QHash>
+#include <QtCore/QCache>
+#include <QtCore/QMutex>
+#include <QtCore/QIODevice>
+#include <QtCore/QDateTime>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
 #include <QThread>
 
+#include <atomic>
+
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlError>
 #include <QtSql/QSqlRecord>
@@ -124,28 +145,249 @@ QVariantHash Sql::queryToIndexedHash(QSqlQuery &query, const QString &key)
     return ret;
 }
 
-void Sql::bindParamsToQuery(QSqlQuery &query, const Cutelyst::ParamsMultiMap &params, bool htmlEscaped)
+static void jsonEscapeString(const QString &str, QByteArray &out)
 {
-    auto it = params.constBegin();
-    if (htmlEscaped) {
-        while (it != params.constEnd()) {
-            if (it.value().isNull()) {
-                query.bindValue(QLatin1Char(':') + it.key(), QVariant());
+    out.append('"');
+    const QByteArray utf8 = str.toUtf8();
+    const char *data = utf8.constData();
+    for (int i = 0; i < utf8.size(); ++i) {
+        const char c = data[i];
+        switch (c) {
+        case '"': out.append("\\\"", 2); break;
+        case '\\': out.append("\\\\", 2); break;
+        case '\b': out.append("\\b", 2); break;
+        case '\f': out.append("\\f", 2); break;
+        case '\n': out.append("\\n", 2); break;
+        case '\r': out.append("\\r", 2); break;
+        case '\t': out.append("\\t", 2); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                const char *hex = "0123456789abcdef";
+                out.append("\\u00", 4);
+                out.append(hex[(c >> 4) & 0xf]);
+                out.append(hex[c & 0xf]);
             } else {
-                query.bindValue(QLatin1Char(':') + it.key(), it.value().toHtmlEscaped());
+                out.append(c);
             }
-            ++it;
         }
-    } else {
-        while (it != params.constEnd()) {
-            if (it.value().isNull()) {
-                query.bindValue(QLatin1Char(':') + it.key(), QVariant());
-            } else {
-                query.bindValue(QLatin1Char(':') + it.key(), it.value());
+    }
+    out.append('"');
+}
+
+static void jsonAppendValue(const QVariant &value, QByteArray &out)
+{
+    if (value.isNull()) {
+        out.append("null", 4);
+        return;
+    }
+
+    switch (value.userType()) {
+    case QMetaType::Bool:
+        out.append(value.toBool() ? "true" : "false");
+        break;
+    case QMetaType::Int:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+    case QMetaType::Short:
+        out.append(QByteArray::number(value.toLongLong()));
+        break;
+    case QMetaType::UInt:
+    case QMetaType::ULong:
+    case QMetaType::ULongLong:
+    case QMetaType::UShort:
+        out.append(QByteArray::number(value.toULongLong()));
+        break;
+    case QMetaType::Double:
+    case QMetaType::Float: {
+        const double d = value.toDouble();
+        if (qIsFinite(d)) {
+            out.append(QByteArray::number(d, 'g', 15));
+        } else {
+            out.append("null", 4);
+        }
+        break;
+    }
+    case QMetaType::QDateTime:
+        jsonEscapeString(value.toDateTime().toString(Qt::ISODate), out);
+        break;
+    case QMetaType::QDate:
+        jsonEscapeString(value.toDate().toString(Qt::ISODate), out);
+        break;
+    case QMetaType::QTime:
+        jsonEscapeString(value.toTime().toString(Qt::ISODate), out);
+        break;
+    default:
+        jsonEscapeString(value.toString(), out);
+    }
+}
+
+qint64 Sql::queryToJsonStream(QSqlQuery &query, QIODevice *out)
+{
+    const QSqlRecord record = query.record();
+    const int columns = record.count();
+
+    // the column layout is fixed, escape the keys once
+    QVector<QByteArray> cols;
+    cols.reserve(columns);
+    for (int i = 0; i < columns; ++i) {
+        QByteArray key;
+        jsonEscapeString(record.fieldName(i), key);
+        key.append(':');
+        cols.append(key);
+    }
+
+    QByteArray buf;
+    buf.reserve(65536);
+    buf.append('[');
+
+    qint64 rows = 0;
+    while (query.next()) {
+        if (rows++) {
+            buf.append(',');
+        }
+
+        buf.append('{');
+        for (int i = 0; i < columns; ++i) {
+            if (i) {
+                buf.append(',');
             }
-            ++it;
+            buf.append(cols.at(i));
+            jsonAppendValue(query.value(i), buf);
+        }
+        buf.append('}');
+
+        if (buf.size() >= 32768) {
+            out->write(buf);
+            buf.clear();
         }
     }
+
+    buf.append(']');
+    out->write(buf);
+
+    return rows;
+}
+
+qint64 Sql::bulkInsert(const QString &table, const QStringList &columns, const QVector<QVariantList> &rows, QSqlDatabase db)
+{
+    if (columns.isEmpty() || rows.isEmpty()) {
+        return 0;
+    }
+
+    QSqlDatabase database = db.isValid() ? db : QSqlDatabase::database();
+    const int cols = columns.size();
+
+    // SQLite refuses statements with more than 999 placeholders by
+    // default, the other drivers take far larger statements
+    const int maxPlaceholders =
+            database.driverName() == QLatin1String("QSQLITE") ? 999 : 32000;
+    const int rowsPerBatch = qMax(1, maxPlaceholders / cols);
+
+    const QString prefix = QLatin1String("INSERT INTO ") + table
+            + QLatin1String(" (") + columns.join(QLatin1String(", "))
+            + QLatin1String(") VALUES ");
+    QString rowTemplate = QLatin1String("(?");
+    for (int i = 1; i < cols; ++i) {
+        rowTemplate += QLatin1String(",?");
+    }
+    rowTemplate += QLatin1Char(')');
+
+    const bool transaction = database.transaction();
+
+    QSqlQuery query(database);
+    qint64 inserted = 0;
+    int preparedRows = 0;
+    int i = 0;
+    while (i < rows.size()) {
+        const int batch = qMin(rowsPerBatch, rows.size() - i);
+        if (batch != preparedRows) {
+            // full batches reuse one prepared statement, only the
+            // final partial batch needs a second prepare
+            QString sql = prefix;
+            sql.reserve(prefix.size() + batch * (rowTemplate.size() + 1));
+            for (int r = 0; r < batch; ++r) {
+                if (r) {
+                    sql += QLatin1Char(',');
+                }
+                sql += rowTemplate;
+            }
+
+            if (!query.prepare(sql)) {
+                qCCritical(C_SQL) << "Failed to prepare bulk insert into" << table << query.lastError().databaseText();
+                if (transaction) {
+                    database.rollback();
+                }
+                return -1;
+            }
+            preparedRows = batch;
+        }
+
+        for (int r = 0; r < batch; ++r) {
+            const QVariantList &row = rows.at(i + r);
+            if (Q_UNLIKELY(row.size() != cols)) {
+                qCCritical(C_SQL) << "Bulk insert row" << i + r << "has" << row.size() << "values, expected" << cols;
+                if (transaction) {
+                    database.rollback();
+                }
+                return -1;
+            }
+            for (const QVariant &value : row) {
+                query.addBindValue(value);
+            }
+        }
+
+        if (!query.exec()) {
+            qCCritical(C_SQL) << "Failed to execute bulk insert into" << table << query.lastError().databaseText();
+            if (transaction) {
+                database.rollback();
+            }
+            return -1;
+        }
+
+        inserted += batch;
+        i += batch;
+    }
+
+    if (transaction) {
+        database.commit();
+    }
+    return inserted;
+}
+
+// toHtmlEscaped() builds a new string character by character even
+// when there is nothing to escape, which is the common case for form
+// values; a scan ahead lets those bind the original shared string.
+static inline bool needsHtmlEscape(const QString &value)
+{
+    const QChar *ch = value.constData();
+    const int size = value.size();
+    for (int i = 0; i < size; ++i) {
+        switch (ch[i].unicode()) {
+        case '<':
+        case '>':
+        case '&':
+        case '"':
+            return true;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+void Sql::bindParamsToQuery(QSqlQuery &query, const Cutelyst::ParamsMultiMap &params, bool htmlEscaped)
+{
+    auto it = params.constBegin();
+    while (it != params.constEnd()) {
+        if (it.value().isNull()) {
+            query.bindValue(QLatin1Char(':') + it.key(), QVariant());
+        } else if (htmlEscaped && needsHtmlEscape(it.value())) {
+            query.bindValue(QLatin1Char(':') + it.key(), it.value().toHtmlEscaped());
+        } else {
+            query.bindValue(QLatin1Char(':') + it.key(), it.value());
+        }
+        ++it;
+    }
 }
 
 QSqlQuery Sql::preparedQuery(const QString &query, QSqlDatabase db, bool forwardOnly)
@@ -158,12 +400,166 @@ QSqlQuery Sql::preparedQuery(const QString &query, QSqlDatabase db, bool forward
     return sqlQuery;
 }
 
+struct WarmQuery {
+    QString query;
+    QString dbName;
+    bool forwardOnly;
+};
+
+// Statements prepared through preparedQueryThread(), persisted to a
+// warm-state file so a respawned worker can replay them in one batch;
+// the master never prepares anything itself, so its memory image
+// cannot carry the list across a fork
+static QMutex warmQueriesMutex;
+static QVector<WarmQuery> warmQueries;
+static bool warmQueriesLoaded = false;
+
+#define WARM_QUERIES_MAGIC quint32(0x43535157) // "CSQW"
+#define WARM_QUERIES_VERSION quint16(1)
+
+static QString warmQueriesPath()
+{
+    // a per-user directory, never the shared temp dir: every
+    // statement in this file is sent to the database on preload, so
+    // it must not be a path another local user can have planted
+    QString dir = QString::fromLocal8Bit(qgetenv("XDG_RUNTIME_DIR"));
+    if (dir.isEmpty()) {
+        dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        QDir().mkpath(dir);
+    }
+    return dir + QLatin1String("/cutelyst-")
+            + QCoreApplication::applicationName()
+            + QLatin1String("-sql-warmup");
+}
+
+#ifdef Q_OS_UNIX
+static bool ownWarmQueriesFile(const QFile &file)
+{
+    struct stat st;
+    if (fstat(file.handle(), &st) != 0 || st.st_uid != getuid()) {
+        qCWarning(C_SQL) << "Ignoring SQL warm-state file not owned by the current user:"
+                         << file.fileName();
+        return false;
+    }
+    return true;
+}
+#endif
+
+static bool containsWarmQueryLocked(const WarmQuery &warm)
+{
+    for (const WarmQuery &known : qAsConst(warmQueries)) {
+        if (known.forwardOnly == warm.forwardOnly &&
+                known.dbName == warm.dbName &&
+                known.query == warm.query) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void loadWarmQueriesLocked()
+{
+    if (warmQueriesLoaded) {
+        return;
+    }
+    warmQueriesLoaded = true;
+
+    QFile file(warmQueriesPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+#ifdef Q_OS_UNIX
+    if (!ownWarmQueriesFile(file)) {
+        return;
+    }
+#endif
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != WARM_QUERIES_MAGIC || version != WARM_QUERIES_VERSION) {
+        return;
+    }
+
+    qint32 count = 0;
+    in >> count;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        WarmQuery warm;
+        in >> warm.query >> warm.dbName >> warm.forwardOnly;
+        if (in.status() == QDataStream::Ok && !containsWarmQueryLocked(warm)) {
+            warmQueries.append(warm);
+        }
+    }
+}
+
+static void saveWarmQueriesLocked()
+{
+    // atomic replace through an O_EXCL temporary; concurrent workers
+    // race here but every writer merged the file on load first, so
+    // the last one wins harmlessly
+    QSaveFile file(warmQueriesPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    QDataStream out(&file);
+    out << WARM_QUERIES_MAGIC << WARM_QUERIES_VERSION << qint32(warmQueries.size());
+    for (const WarmQuery &warm : qAsConst(warmQueries)) {
+        out << warm.query << warm.dbName << warm.forwardOnly;
+    }
+    file.commit();
+}
+
+static void recordWarmQuery(const QString &query, const QString &dbName, bool forwardOnly)
+{
+    QMutexLocker locker(&warmQueriesMutex);
+    loadWarmQueriesLocked();
+
+    const WarmQuery warm = { query, dbName, forwardOnly };
+    if (!containsWarmQueryLocked(warm)) {
+        warmQueries.append(warm);
+        saveWarmQueriesLocked();
+    }
+}
+
 QSqlQuery Sql::preparedQueryThread(const QString &query, const QString &dbName, bool forwardOnly)
 {
-    QSqlQuery sqlQuery(QSqlDatabase::database(databaseNameThread(dbName)));
+    // Cache of prepared queries per worker thread, preparing the
+    // same statement again is a full driver round trip and keeps
+    // the server from reusing its plan
+    static thread_local QHash<QString, QSqlQuery> preparedQueries;
+
+    QSqlDatabase db = QSqlDatabase::database(databaseNameThread(dbName));
+    const QString cacheKey = db.connectionName()
+            + (forwardOnly ? QLatin1Char('f') : QLatin1Char('s'))
+            + QLatin1Char('\n') + query;
+
+    auto it = preparedQueries.find(cacheKey);
+    if (it != preparedQueries.end()) {
+        if (Q_LIKELY(db.isOpen())) {
+            return it.value();
+        }
+        // the connection went away and took the plan with it
+        preparedQueries.erase(it);
+    }
+
+    if (!db.isOpen() && db.isValid()) {
+        // reopen a lost connection instead of failing the request
+        if (!db.open()) {
+            qCWarning(C_SQL) << "Failed to reopen database connection" << db.connectionName() << db.lastError().databaseText();
+        }
+    }
+
+    QSqlQuery sqlQuery(db);
     sqlQuery.setForwardOnly(forwardOnly);
     if (!sqlQuery.prepare(query)) {
         qCCritical(C_SQL) << "Failed to prepare query:" << query << sqlQuery.lastError().databaseText();
+    } else {
+        preparedQueries.insert(cacheKey, sqlQuery);
+        recordWarmQuery(query, dbName, forwardOnly);
     }
     return sqlQuery;
 }
@@ -172,3 +568,190 @@ QString Sql::databaseNameThread(const QString &dbName)
 {
     return dbName + QLatin1Char('-') + QThread::currentThread()->objectName();
 }
+
+bool Sql::openDatabaseThread(const QString &dbName)
+{
+    const QString threadName = databaseNameThread(dbName);
+
+    QSqlDatabase db = QSqlDatabase::database(threadName, false);
+    if (!db.isValid()) {
+        const QSqlDatabase base = QSqlDatabase::database(dbName, false);
+        if (!base.isValid()) {
+            qCCritical(C_SQL) << "No database connection" << dbName << "to clone for this thread";
+            return false;
+        }
+        db = QSqlDatabase::cloneDatabase(base, threadName);
+    }
+
+    if (db.isOpen() || db.open()) {
+        return true;
+    }
+
+    qCCritical(C_SQL) << "Failed to open database connection" << threadName << db.lastError().databaseText();
+    return false;
+}
+
+int Sql::preloadPreparedQueries(const QString &dbName)
+{
+    QVector<WarmQuery> entries;
+    {
+        QMutexLocker locker(&warmQueriesMutex);
+        loadWarmQueriesLocked();
+        entries = warmQueries;
+    }
+
+    int ret = 0;
+    for (const WarmQuery &warm : qAsConst(entries)) {
+        if (warm.dbName != dbName) {
+            continue;
+        }
+
+        QSqlQuery query = preparedQueryThread(warm.query, dbName, warm.forwardOnly);
+        if (!query.lastError().isValid()) {
+            ++ret;
+        }
+    }
+
+    if (ret) {
+        qCDebug(C_SQL) << "Preloaded" << ret << "prepared statements on" << databaseNameThread(dbName);
+    }
+    return ret;
+}
+
+bool Sql::applyDeadline(Context *c, const QString &dbName)
+{
+    QSqlDatabase db = QSqlDatabase::database(databaseNameThread(dbName));
+    if (!db.isValid() || !db.isOpen()) {
+        return false;
+    }
+
+    const qint64 remaining = c->deadlineRemaining();
+
+    const QString driver = db.driverName();
+    QString sql;
+    if (driver == QLatin1String("QPSQL")) {
+        // 0 lifts the limit; an expired deadline becomes 1 ms so the
+        // statement fails fast instead of running unbounded
+        sql = QStringLiteral("SET statement_timeout = %1")
+                .arg(remaining < 0 ? 0 : qMax(remaining, static_cast<qint64>(1)));
+    } else if (driver == QLatin1String("QMYSQL")) {
+        sql = QStringLiteral("SET SESSION max_execution_time = %1")
+                .arg(remaining < 0 ? 0 : qMax(remaining, static_cast<qint64>(1)));
+    } else {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    if (!query.exec(sql)) {
+        qCWarning(C_SQL) << "Failed to propagate deadline:" << query.lastError().databaseText();
+        return false;
+    }
+    return true;
+}
+
+void Sql::execDeferred(Context *c, QSqlQuery query)
+{
+    // Runs when the Context is destroyed, which happens on this
+    // same worker thread after the response was finalized, so the
+    // client never waits for the round trip
+    QObject::connect(c, &QObject::destroyed, [query] () mutable {
+        if (!query.exec()) {
+            qCCritical(C_SQL) << "Failed to execute deferred query:" << query.lastQuery() << query.lastError().databaseText();
+        }
+    });
+}
+
+namespace {
+
+// one version counter per table name, shared by all threads of this
+// process; the registry only locks to hand out the counter pointer,
+// validation on the hot path is a plain atomic load
+struct TableVersions
+{
+    std::atomic<quint64> *get(const QString &table)
+    {
+        QMutexLocker locker(&mutex);
+        std::atomic<quint64> *&version = versions[table];
+        if (!version) {
+            version = new std::atomic<quint64>(0);
+        }
+        return version;
+    }
+
+    QMutex mutex;
+    QHash<QString, std::atomic<quint64> *> versions;
+};
+Q_GLOBAL_STATIC(TableVersions, s_tableVersions)
+
+struct CachedResult
+{
+    QVariantList rows;
+    // counter and the value it had when the result was filled
+    QVector<QPair<std::atomic<quint64> *, quint64>> deps;
+};
+
+thread_local QCache<QString, CachedResult> t_resultCache(256);
+
+}
+
+void Sql::bumpTableVersion(const QString &table)
+{
+    s_tableVersions->get(table)->fetch_add(1, std::memory_order_release);
+}
+
+QVariantList Sql::cachedQueryMapList(const QString &query, const QVariantList &params, const QStringList &tables, const QString &dbName)
+{
+    QString key;
+    key.reserve(dbName.size() + query.size() + params.size() * 8 + 4);
+    key += dbName;
+    key += QLatin1Char('\x1f');
+    key += query;
+    for (const QVariant &param : params) {
+        key += QLatin1Char('\x1f');
+        if (param.isNull()) {
+            // tell a NULL apart from an empty string
+            key += QLatin1Char('\x1e');
+        } else {
+            key += param.toString();
+        }
+    }
+
+    CachedResult *cached = t_resultCache.object(key);
+    if (cached) {
+        bool valid = true;
+        for (const auto &dep : cached->deps) {
+            if (dep.first->load(std::memory_order_acquire) != dep.second) {
+                valid = false;
+                break;
+            }
+        }
+        if (valid) {
+            return cached->rows;
+        }
+        t_resultCache.remove(key);
+    }
+
+    // snapshot the versions before running the query, a write racing
+    // the fill then invalidates the entry instead of going unseen
+    auto entry = new CachedResult;
+    entry->deps.reserve(tables.size());
+    for (const QString &table : tables) {
+        std::atomic<quint64> *version = s_tableVersions->get(table);
+        entry->deps.append(qMakePair(version, version->load(std::memory_order_acquire)));
+    }
+
+    QSqlQuery sqlQuery = preparedQueryThread(query, dbName);
+    for (const QVariant &param : params) {
+        sqlQuery.addBindValue(param);
+    }
+    if (!sqlQuery.exec()) {
+        qCCritical(C_SQL) << "Failed to execute cached query:" << query << sqlQuery.lastError().databaseText();
+        delete entry;
+        return QVariantList();
+    }
+
+    entry->rows = queryToMapList(sqlQuery);
+    const QVariantList ret = entry->rows;
+    t_resultCache.insert(key, entry);
+    return ret;
+}
@@ -21,13 +21,18 @@
 #define CSQL_H
 
 #include <QtCore/QVariant>
+#include <QtCore/QStringList>
 #include <QtSql/QSqlDatabase>
 
 #include <Cutelyst/cutelyst_global.h>
 #include <Cutelyst/paramsmultimap.h>
 
+class QIODevice;
+
 namespace Cutelyst {
 
+class Context;
+
 namespace Sql
 {
     /**
@@ -66,13 +71,44 @@ namespace Sql
      */
     CUTELYST_PLUGIN_UTILS_SQL_EXPORT QVariantHash queryToIndexedHash(QSqlQuery &query, const QString &key);
 
+    /**
+     * Walks the result set once writing a JSON array of objects
+     * straight to \p out, skipping the QVariant row materialization
+     * of queryToMapList(). Pass c->response() as the device to stream
+     * large reports to the client without building them in memory.
+     * Returns the number of rows written.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    CUTELYST_PLUGIN_UTILS_SQL_EXPORT qint64 queryToJsonStream(QSqlQuery &query, QIODevice *out);
+
     /**
      * Bind params to the query, using the param name as
      * the placeholder prebended with ':', if htmlEscaped
-     * is true the bound values will be the return of toHtmlEscaped()
+     * is true the bound values will be the return of toHtmlEscaped().
+     * Values without a character to escape are bound as is, sharing
+     * the parameter's string data instead of copying it.
      */
     CUTELYST_PLUGIN_UTILS_SQL_EXPORT void bindParamsToQuery(QSqlQuery &query, const Cutelyst::ParamsMultiMap &params, bool htmlEscaped = true);
 
+    /**
+     * Inserts \p rows into \p table with multi-row VALUES statements
+     * wrapped in one transaction, so ingesting thousands of rows
+     * costs a handful of round trips instead of one per row. Each
+     * entry of \p rows must hold one value per name in \p columns,
+     * in the same order. The rows per statement are sized to the
+     * driver's placeholder limit.
+     *
+     * \p table and \p columns are spliced into the statement and must
+     * come from the application, never from request data.
+     *
+     * Returns the number of rows inserted, or -1 when a statement
+     * failed, in which case the transaction is rolled back.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    CUTELYST_PLUGIN_UTILS_SQL_EXPORT qint64 bulkInsert(const QString &table, const QStringList &columns, const QVector<QVariantList> &rows, QSqlDatabase db = QSqlDatabase());
+
     /**
      * Returns a QSqlQuery object prepared with \pa query using the \pa db database
      * This is specially useful to avoid pointers to prepered queries.
@@ -112,6 +148,81 @@ namespace Sql
      * database connection and thread_local on CUTELYST_PLUGIN_UTILS_SQL_EXPORT objects to be thread-safe.
      */
     CUTELYST_PLUGIN_UTILS_SQL_EXPORT QSqlQuery preparedQueryThread(const QString &query, const QString &dbName = QString(), bool forwardOnly = true);
+
+    /**
+     * Clones the application-wide \pa dbName connection
+     * configuration for the current thread as databaseNameThread()
+     * and opens it, so the TLS and authentication handshake happens
+     * at worker start instead of on the first user request. Call it
+     * from Application::postFork() for each worker thread; returns
+     * true when the connection is open.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    CUTELYST_PLUGIN_UTILS_SQL_EXPORT bool openDatabaseThread(const QString &dbName = QString());
+
+    /**
+     * Prepares every statement this application is known to use on
+     * the current thread connection for \pa dbName in one batch.
+     * preparedQueryThread() records each statement it prepares into a
+     * per-application warm-state file, so after a worker respawn the
+     * replacement replays the whole list at Application::postFork()
+     * time, right after openDatabaseThread(), instead of re-learning
+     * it organically over its first requests. Returns the number of
+     * statements prepared.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    CUTELYST_PLUGIN_UTILS_SQL_EXPORT int preloadPreparedQueries(const QString &dbName = QString());
+
+    /**
+     * Executes the already bound \pa query once the response for
+     * \pa c was sent, on the same worker thread that owns the
+     * database connection. Useful for fire-and-forget writes such
+     * as audit logs or counters whose round trip should not add to
+     * the request latency; failures are only logged.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    CUTELYST_PLUGIN_UTILS_SQL_EXPORT void execDeferred(Cutelyst::Context *c, QSqlQuery query);
+
+    /**
+     * Propagates the remaining time budget of \p c, see
+     * Context::setDeadline(), to the database server behind the
+     * thread connection for \p dbName, so a query cannot keep running
+     * after the request that issued it gave up. Sets
+     * statement_timeout on PostgreSQL and max_execution_time on
+     * MySQL 5.7 or later; other drivers are left untouched and false
+     * is returned. Call it per request before running queries; for a
+     * request without a deadline the limit is lifted again.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    CUTELYST_PLUGIN_UTILS_SQL_EXPORT bool applyDeadline(Cutelyst::Context *c, const QString &dbName = QString());
+
+    /**
+     * Runs \p query with \p params bound in order through
+     * preparedQueryThread() and returns the rows as with
+     * queryToMapList(), caching the result per worker thread keyed
+     * by statement and parameters. A cached result is served until
+     * bumpTableVersion() is called for one of the \p tables it was
+     * declared to depend on, so static data like country lists stops
+     * costing a round trip per request.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    CUTELYST_PLUGIN_UTILS_SQL_EXPORT QVariantList cachedQueryMapList(const QString &query, const QVariantList &params, const QStringList &tables, const QString &dbName = QString());
+
+    /**
+     * Marks \p table as changed, invalidating every result
+     * cachedQueryMapList() derived from it on any thread of this
+     * process. Call it after writes. In prefork deployments each
+     * process tracks its own versions, so writes must be announced
+     * in the worker that performs them.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    CUTELYST_PLUGIN_UTILS_SQL_EXPORT void bumpTableVersion(const QString &table);
 }
 
 }
@@ -21,6 +21,7 @@
 #include <Cutelyst/context.h>
 #include <Cutelyst/request.h>
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QSet>
 
 using namespace Cutelyst;
 
@@ -105,7 +106,15 @@ ValidatorResult Validator::validate(const ParamsMultiMap &params, ValidatorFlags
     const bool stopOnFirstError = flags.testFlag(StopOnFirstError);
     const bool noTrimming = flags.testFlag(NoTrimming);
 
+    // once a field failed a rule the remaining rules for that field
+    // are skipped, only the first error per field is reported
+    QSet<QString> failedFields;
+
     for (ValidatorRule *v : d->validators) {
+        if (failedFields.contains(v->field())) {
+            continue;
+        }
+
         v->setParameters(params);
 
         if (v->label().isEmpty()) {
@@ -124,6 +133,8 @@ ValidatorResult Validator::validate(const ParamsMultiMap &params, ValidatorFlags
             if (stopOnFirstError) {
                 return result;
             }
+
+            failedFields.insert(v->field());
         }
     }
 
@@ -164,6 +164,13 @@ class ValidatorRule;
  * The sensible data of the password fields is not part of the stash, but the other values can be used to prefill the form fields for the next attempt of
  * our little Schalke fan and can give him some hints what was wrong.
  *
+ * \par Reusing a Validator
+ *
+ * Constructing the Validator allocates every rule object, so on hot paths it pays off to build it once
+ * as a member of your Controller (which lives as long as the Application) and call validate() on it for
+ * every request instead of rebuilding the rule set each time. Fields are checked until their first
+ * failing rule, the remaining rules for an already failed field are skipped.
+ *
  * \par Usage with Grantlee
  *
  * The following example shows possible usage of the error data with \link GrantleeView Grantlee \endlink and the Bootstrap framework.
@@ -43,7 +43,12 @@ QString ValidatorAlpha::validate() const
 {
     QString result;
 
-    if (!value().isEmpty() && !value().contains(QRegularExpression(QStringLiteral("^[\\pL\\pM]+$")))) {
+    // compiled once for the whole process, matching against a shared
+    // pattern is thread-safe
+    static const QRegularExpression regex(QStringLiteral("^[\\pL\\pM]+$"),
+                                          QRegularExpression::OptimizeOnFirstUsageOption);
+
+    if (!value().isEmpty() && !value().contains(regex)) {
         result = validationError();
     }
 
@@ -43,7 +43,10 @@ QString ValidatorAlphaDash::validate() const
 {
     QString result;
 
-    if (!value().isEmpty() && !value().contains(QRegularExpression(QStringLiteral("^[\\pL\\pM\\pN_-]+$")))) {
+    static const QRegularExpression regex(QStringLiteral("^[\\pL\\pM\\pN_-]+$"),
+                                          QRegularExpression::OptimizeOnFirstUsageOption);
+
+    if (!value().isEmpty() && !value().contains(regex)) {
         result = validationError();
     }
 
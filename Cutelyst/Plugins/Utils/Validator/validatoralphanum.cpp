@@ -43,7 +43,10 @@ QString ValidatorAlphaNum::validate() const
 {
     QString result;
 
-    if (!value().isEmpty() && !value().contains(QRegularExpression(QStringLiteral("^[\\pL\\pM\\pN]+$")))) {
+    static const QRegularExpression regex(QStringLiteral("^[\\pL\\pM\\pN]+$"),
+                                          QRegularExpression::OptimizeOnFirstUsageOption);
+
+    if (!value().isEmpty() && !value().contains(regex)) {
         result = validationError();
     }
 
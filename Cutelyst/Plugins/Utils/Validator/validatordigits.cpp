@@ -19,8 +19,6 @@
 
 #include "validatordigits_p.h"
 
-#include <QRegularExpression>
-
 using namespace Cutelyst;
 
 ValidatorDigits::ValidatorDigits(const QString &field, int length, const QString &label, const QString &customError) :
@@ -37,6 +35,18 @@ ValidatorDigits::~ValidatorDigits()
 {
 }
 
+// a plain scan beats spinning up the regex engine for a single
+// character class, and this is the commonest type check on a POST
+static bool isAllDigits(const QString &v)
+{
+    for (const QChar c : v) {
+        if (c < QLatin1Char('0') || c > QLatin1Char('9')) {
+            return false;
+        }
+    }
+    return true;
+}
+
 QString ValidatorDigits::validate() const
 {
     QString result;
@@ -45,7 +55,7 @@ QString ValidatorDigits::validate() const
 
     if (!value().isEmpty()) {
 
-        if (value().contains(QRegularExpression(QStringLiteral("^[0-9]+$")))) {
+        if (isAllDigits(value())) {
             if ((d->length > 0) && (value().length() != d->length)) {
                 result = validationError();
             }
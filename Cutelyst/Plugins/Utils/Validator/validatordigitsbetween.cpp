@@ -19,8 +19,6 @@
 
 #include "validatordigitsbetween_p.h"
 
-#include <QRegularExpression>
-
 using namespace Cutelyst;
 
 ValidatorDigitsBetween::ValidatorDigitsBetween(const QString &field, int min, int max, const QString &label, const QString &customError) :
@@ -37,6 +35,16 @@ ValidatorDigitsBetween::~ValidatorDigitsBetween()
 {
 }
 
+static bool isAllDigits(const QString &v)
+{
+    for (const QChar c : v) {
+        if (c < QLatin1Char('0') || c > QLatin1Char('9')) {
+            return false;
+        }
+    }
+    return true;
+}
+
 QString ValidatorDigitsBetween::validate() const
 {
     QString result;
@@ -44,7 +52,7 @@ QString ValidatorDigitsBetween::validate() const
     Q_D(const ValidatorDigitsBetween);
 
     if (!value().isEmpty()) {
-        if (value().contains(QRegularExpression(QStringLiteral("^[0-9]+$")))) {
+        if (isAllDigits(value())) {
 
             if ((d->min > 0) && (d->max > d->min)) {
                 if ((value().length() < d->min) || (value().length() > d->max)) {
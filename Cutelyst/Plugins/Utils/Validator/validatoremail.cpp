@@ -36,44 +36,96 @@ ValidatorEmail::~ValidatorEmail()
 {
 }
 
+static inline bool isAtextChar(ushort c)
+{
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+        return true;
+    }
+
+    switch (c) {
+    case '!': case '#': case '$': case '%': case '&': case '\'':
+    case '*': case '+': case '-': case '/': case '=': case '?':
+    case '^': case '_': case '`': case '{': case '|': case '}':
+    case '~':
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Certifies the common ASCII "dot-atom @ dot-atom" form with a single
+// scan instead of spinning up the regex engine. A false return means
+// undecided, not invalid - the full RFC 5322 grammar then decides.
+static bool isSimpleAddress(const QString &v)
+{
+    int atPos = -1;
+    bool prevDot = true; // neither part may start with a dot
+    for (int i = 0; i < v.size(); ++i) {
+        const ushort c = v.at(i).unicode();
+        if (c == '@') {
+            if (atPos != -1 || prevDot) {
+                return false;
+            }
+            atPos = i;
+            prevDot = true;
+        } else if (c == '.') {
+            if (prevDot) {
+                return false;
+            }
+            prevDot = true;
+        } else if (isAtextChar(c)) {
+            prevDot = false;
+        } else {
+            return false;
+        }
+    }
+
+    return atPos > 0 && !prevDot;
+}
+
 QString ValidatorEmail::validate() const
 {
     QString result;
 
 //    bool isEmail = value().contains(QRegularExpression(QStringLiteral("^[a-zA-Z0-9.!#$%&'*+/=?^_`{|}~-]+@[a-zA-Z0-9](?:[a-zA-Z0-9-]{0,61}[a-zA-Z0-9])?(?:\\.[a-zA-Z0-9](?:[a-zA-Z0-9-]{0,61}[a-zA-Z0-9])?)*$")));
 
-    if (!value().isEmpty() && !value().contains(QRegularExpression(QStringLiteral("(?(DEFINE)"
-                                                                                 "(?<addr_spec> (?&local_part) @ (?&domain) )"
-                                                                                 "(?<local_part> (?&dot_atom) | (?&quoted_string) | (?&obs_local_part) )"
-                                                                                 "(?<domain> (?&dot_atom) | (?&domain_literal) | (?&obs_domain) )"
-                                                                                 "(?<domain_literal> (?&CFWS)? \\[ (?: (?&FWS)? (?&dtext) )* (?&FWS)? \\] (?&CFWS)? )"
-                                                                                 "(?<dtext> [\\x21-\\x5a] | [\\x5e-\\x7e] | (?&obs_dtext) )"
-                                                                                 "(?<quoted_pair> \\\\ (?: (?&VCHAR) | (?&WSP) ) | (?&obs_qp) )"
-                                                                                 "(?<dot_atom> (?&CFWS)? (?&dot_atom_text) (?&CFWS)? )"
-                                                                                 "(?<dot_atom_text> (?&atext) (?: \\. (?&atext) )* )"
-                                                                                 "(?<atext> [a-zA-Z0-9!#$%&'*+\\/=?^_`{|}~-]+ )"
-                                                                                 "(?<atom> (?&CFWS)? (?&atext) (?&CFWS)? )"
-                                                                                 "(?<word> (?&atom) | (?&quoted_string) )"
-                                                                                 "(?<quoted_string> (?&CFWS)? \" (?: (?&FWS)? (?&qcontent) )* (?&FWS)? \" (?&CFWS)? )"
-                                                                                 "(?<qcontent> (?&qtext) | (?&quoted_pair) )"
-                                                                                 "(?<qtext> \\x21 | [\\x23-\\x5b] | [\\x5d-\\x7e] | (?&obs_qtext) )"
-                                                                                 "(?<FWS> (?: (?&WSP)* \\r\\n )? (?&WSP)+ | (?&obs_FWS) )"
-                                                                                 "(?<CFWS> (?: (?&FWS)? (?&comment) )+ (?&FWS)? | (?&FWS) )"
-                                                                                 "(?<comment> \\( (?: (?&FWS)? (?&ccontent) )* (?&FWS)? \\) )"
-                                                                                 "(?<ccontent> (?&ctext) | (?&quoted_pair) | (?&comment) )"
-                                                                                 "(?<ctext> [\\x21-\\x27] | [\\x2a-\\x5b] | [\\x5d-\\x7e] | (?&obs_ctext) )"
-                                                                                 "(?<obs_domain> (?&atom) (?: \\. (?&atom) )* )"
-                                                                                 "(?<obs_local_part> (?&word) (?: \\. (?&word) )* )"
-                                                                                 "(?<obs_dtext> (?&obs_NO_WS_CTL) | (?&quoted_pair) )"
-                                                                                 "(?<obs_qp> \\\\ (?: \\x00 | (?&obs_NO_WS_CTL) | \\n | \\r ) )"
-                                                                                 "(?<obs_FWS> (?&WSP)+ (?: \\r\\n (?&WSP)+ )* )"
-                                                                                 "(?<obs_ctext> (?&obs_NO_WS_CTL) )"
-                                                                                 "(?<obs_qtext> (?&obs_NO_WS_CTL) )"
-                                                                                 "(?<obs_NO_WS_CTL> [\\x01-\\x08] | \\x0b | \\x0c | [\\x0e-\\x1f] | \\x7f )"
-                                                                                 "(?<VCHAR> [\\x21-\\x7E] )"
-                                                                                 "(?<WSP> [ \\t] )"
-                                                                             ")"
-                                                                             "^(?&addr_spec)$"), QRegularExpression::ExtendedPatternSyntaxOption))) {
+    // The RFC 5322 grammar below is expensive to compile, do it once
+    // for the whole process
+    static const QRegularExpression regex(QStringLiteral("(?(DEFINE)"
+                                                         "(?<addr_spec> (?&local_part) @ (?&domain) )"
+                                                         "(?<local_part> (?&dot_atom) | (?&quoted_string) | (?&obs_local_part) )"
+                                                         "(?<domain> (?&dot_atom) | (?&domain_literal) | (?&obs_domain) )"
+                                                         "(?<domain_literal> (?&CFWS)? \\[ (?: (?&FWS)? (?&dtext) )* (?&FWS)? \\] (?&CFWS)? )"
+                                                         "(?<dtext> [\\x21-\\x5a] | [\\x5e-\\x7e] | (?&obs_dtext) )"
+                                                         "(?<quoted_pair> \\\\ (?: (?&VCHAR) | (?&WSP) ) | (?&obs_qp) )"
+                                                         "(?<dot_atom> (?&CFWS)? (?&dot_atom_text) (?&CFWS)? )"
+                                                         "(?<dot_atom_text> (?&atext) (?: \\. (?&atext) )* )"
+                                                         "(?<atext> [a-zA-Z0-9!#$%&'*+\\/=?^_`{|}~-]+ )"
+                                                         "(?<atom> (?&CFWS)? (?&atext) (?&CFWS)? )"
+                                                         "(?<word> (?&atom) | (?&quoted_string) )"
+                                                         "(?<quoted_string> (?&CFWS)? \" (?: (?&FWS)? (?&qcontent) )* (?&FWS)? \" (?&CFWS)? )"
+                                                         "(?<qcontent> (?&qtext) | (?&quoted_pair) )"
+                                                         "(?<qtext> \\x21 | [\\x23-\\x5b] | [\\x5d-\\x7e] | (?&obs_qtext) )"
+                                                         "(?<FWS> (?: (?&WSP)* \\r\\n )? (?&WSP)+ | (?&obs_FWS) )"
+                                                         "(?<CFWS> (?: (?&FWS)? (?&comment) )+ (?&FWS)? | (?&FWS) )"
+                                                         "(?<comment> \\( (?: (?&FWS)? (?&ccontent) )* (?&FWS)? \\) )"
+                                                         "(?<ccontent> (?&ctext) | (?&quoted_pair) | (?&comment) )"
+                                                         "(?<ctext> [\\x21-\\x27] | [\\x2a-\\x5b] | [\\x5d-\\x7e] | (?&obs_ctext) )"
+                                                         "(?<obs_domain> (?&atom) (?: \\. (?&atom) )* )"
+                                                         "(?<obs_local_part> (?&word) (?: \\. (?&word) )* )"
+                                                         "(?<obs_dtext> (?&obs_NO_WS_CTL) | (?&quoted_pair) )"
+                                                         "(?<obs_qp> \\\\ (?: \\x00 | (?&obs_NO_WS_CTL) | \\n | \\r ) )"
+                                                         "(?<obs_FWS> (?&WSP)+ (?: \\r\\n (?&WSP)+ )* )"
+                                                         "(?<obs_ctext> (?&obs_NO_WS_CTL) )"
+                                                         "(?<obs_qtext> (?&obs_NO_WS_CTL) )"
+                                                         "(?<obs_NO_WS_CTL> [\\x01-\\x08] | \\x0b | \\x0c | [\\x0e-\\x1f] | \\x7f )"
+                                                         "(?<VCHAR> [\\x21-\\x7E] )"
+                                                         "(?<WSP> [ \\t] )"
+                                                         ")"
+                                                         "^(?&addr_spec)$"),
+                                          QRegularExpression::ExtendedPatternSyntaxOption | QRegularExpression::OptimizeOnFirstUsageOption);
+
+    if (!value().isEmpty() && !isSimpleAddress(value()) && !value().contains(regex)) {
         result = validationError();
     }
 
@@ -44,7 +44,10 @@ QString ValidatorInteger::validate() const
 
     const QString v = value();
 
-    if (!v.isEmpty() && !v.contains(QRegularExpression(QStringLiteral("^-?\\d+$")))) {
+    static const QRegularExpression regex(QStringLiteral("^-?\\d+$"),
+                                          QRegularExpression::OptimizeOnFirstUsageOption);
+
+    if (!v.isEmpty() && !v.contains(regex)) {
         result = validationError();
     }
 
@@ -47,8 +47,11 @@ QString ValidatorIp::validate() const
 
     if (!v.isEmpty()) {
 
+        static const QRegularExpression ipv4Regex(QStringLiteral("^\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}$"),
+                                                  QRegularExpression::OptimizeOnFirstUsageOption);
+
         // simple check for an IPv4 address with four parts, because QHostAddress also tolerates addresses like 192.168.2 and fills them with 0 somewhere
-        if (!v.contains(QLatin1Char(':')) && !v.contains(QRegularExpression(QStringLiteral("^\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}$")))) {
+        if (!v.contains(QLatin1Char(':')) && !v.contains(ipv4Regex)) {
 
             result = validationError();
 
@@ -40,7 +40,10 @@ QString ValidatorNumeric::validate() const
 {
     QString result;
 
-    if (!value().isEmpty() && !value().contains(QRegularExpression(QStringLiteral("^-?\\d+(\\.|,)?\\d*(e|E)?\\d+$")))) {
+    static const QRegularExpression regex(QStringLiteral("^-?\\d+(\\.|,)?\\d*(e|E)?\\d+$"),
+                                          QRegularExpression::OptimizeOnFirstUsageOption);
+
+    if (!value().isEmpty() && !value().contains(regex)) {
         result = validationError();
     }
 
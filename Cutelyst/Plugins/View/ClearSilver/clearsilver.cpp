@@ -215,7 +215,53 @@ HDF *ClearSilverPrivate::hdfForStash(Context *c, const QVariantHash &stash) cons
     HDF *hdf = 0;
     hdf_init(&hdf);
 
-    serializeHash(hdf, stash);
+    const QStringList staticKeys = stash.value(QStringLiteral("cs_static_keys")).toStringList();
+    if (staticKeys.isEmpty()) {
+        serializeHash(hdf, stash);
+    } else {
+        // subtrees the handler declared static are marshalled once and
+        // kept as an HDF text dump until the generation counter changes
+        const int generation = stash.value(QStringLiteral("cs_static_generation")).toInt();
+        if (generation != staticGeneration || staticDump.isEmpty()) {
+            HDF *staticHdf = 0;
+            hdf_init(&staticHdf);
+            for (const QString &key : staticKeys) {
+                auto it = stash.constFind(key);
+                if (it != stash.constEnd()) {
+                    serializeVariant(staticHdf, it.value(), key);
+                }
+            }
+
+            char *dump = 0;
+            NEOERR *error = hdf_write_string(staticHdf, &dump);
+            if (error) {
+                nerr_ignore(&error);
+            } else if (dump) {
+                staticDump = QByteArray(dump);
+                staticGeneration = generation;
+                free(dump);
+            }
+            hdf_destroy(&staticHdf);
+        }
+
+        if (!staticDump.isEmpty()) {
+            NEOERR *error = hdf_read_string(hdf, staticDump.constData());
+            if (error) {
+                nerr_ignore(&error);
+            }
+        }
+
+        // only the per request values are marshalled every time
+        auto it = stash.constBegin();
+        while (it != stash.constEnd()) {
+            if (!staticKeys.contains(it.key())
+                    && it.key() != QLatin1String("cs_static_keys")
+                    && it.key() != QLatin1String("cs_static_generation")) {
+                serializeVariant(hdf, it.value(), it.key());
+            }
+            ++it;
+        }
+    }
 
     const QMetaObject *meta = c->metaObject();
     for (int i = 0; i < meta->propertyCount(); ++i) {
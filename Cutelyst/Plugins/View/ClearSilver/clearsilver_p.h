@@ -39,6 +39,11 @@ public:
     QStringList includePaths;
     QString extension = QStringLiteral(".html");
     QString wrapper;
+
+    // HDF text dump of the stash subtrees declared static through the
+    // cs_static_keys stash entry, rebuilt when cs_static_generation changes
+    mutable QByteArray staticDump;
+    mutable int staticGeneration = -1;
 };
 
 }
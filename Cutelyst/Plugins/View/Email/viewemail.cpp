@@ -24,6 +24,7 @@
 #include <Cutelyst/response.h>
 
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QThread>
 
 #include <SimpleMail/mimemessage.h>
 #include <SimpleMail/emailaddress.h>
@@ -42,6 +43,7 @@ ViewEmail::ViewEmail(QObject *parent, const QString &name) : View(parent, name)
 
 ViewEmail::~ViewEmail()
 {
+    setAsyncDelivery(false);
     delete d_ptr;
 }
 
@@ -165,6 +167,46 @@ void ViewEmail::setSenderPassword(const QString &password)
     d->sender->setPassword(password);
 }
 
+bool ViewEmail::asyncDelivery() const
+{
+    Q_D(const ViewEmail);
+    return d->deliveryThread;
+}
+
+void ViewEmail::setAsyncDelivery(bool enable)
+{
+    Q_D(ViewEmail);
+    if (enable == (d->deliveryThread != nullptr)) {
+        return;
+    }
+
+    if (enable) {
+        qRegisterMetaType<SimpleMail::MimeMessage*>();
+
+        auto worker = new EmailDeliveryWorker;
+        worker->host = d->sender->host();
+        worker->port = d->sender->port();
+        worker->connectionType = d->sender->connectionType();
+        worker->authMethod = d->sender->authMethod();
+        worker->user = d->sender->user();
+        worker->password = d->sender->password();
+
+        auto thread = new QThread(this);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        thread->start();
+
+        d->deliveryThread = thread;
+        d->deliveryWorker = worker;
+    } else {
+        d->deliveryThread->quit();
+        d->deliveryThread->wait();
+        delete d->deliveryThread;
+        d->deliveryThread = nullptr;
+        d->deliveryWorker = nullptr;
+    }
+}
+
 QByteArray ViewEmail::render(Context *c) const
 {
     Q_D(const ViewEmail);
@@ -175,34 +217,35 @@ QByteArray ViewEmail::render(Context *c) const
         return ret;
     }
 
-    MimeMessage message;
+    QVariant body = email.value(QStringLiteral("body"));
+    QVariant parts = email.value(QStringLiteral("parts"));
+    if (body.isNull() && parts.isNull()) {
+        c->error(QStringLiteral("Can't send email without parts or body, check stash"));
+        return ret;
+    }
+
+    // on the heap so asynchronous delivery can take ownership
+    auto message = new MimeMessage;
 
     QVariant value;
     value = email.value(QStringLiteral("to"));
     if (value.type() == QVariant::String && !value.toString().isEmpty()) {
-        message.addTo(value.toString());
+        message->addTo(value.toString());
     }
 
     value = email.value(QStringLiteral("cc"));
     if (value.type() == QVariant::String && !value.toString().isEmpty()) {
-        message.addCc(value.toString());
+        message->addCc(value.toString());
     }
 
     value = email.value(QStringLiteral("from"));
     if (value.type() == QVariant::String && !value.toString().isEmpty()) {
-        message.setSender(value.toString());
+        message->setSender(value.toString());
     }
 
     value = email.value(QStringLiteral("subject"));
     if (value.type() == QVariant::String && !value.toString().isEmpty()) {
-        message.setSubject(value.toString());
-    }
-
-    QVariant body = email.value(QStringLiteral("body"));
-    QVariant parts = email.value(QStringLiteral("parts"));
-    if (body.isNull() && parts.isNull()) {
-        c->error(QStringLiteral("Can't send email without parts or body, check stash"));
-        return ret;
+        message->setSubject(value.toString());
     }
 
     if (!parts.isNull()) {
@@ -210,7 +253,7 @@ QByteArray ViewEmail::render(Context *c) const
         for (const QVariant &part : partsVariant) {
             MimePart *mime = part.value<MimePart*>();
             if (mime) {
-                message.addPart(mime);
+                message->addPart(mime);
             } else {
                 qCCritical(CUTELYST_VIEW_EMAIL) << "Failed to cast MimePart";
             }
@@ -222,22 +265,31 @@ QByteArray ViewEmail::render(Context *c) const
                 && !contentTypeIt.value().toString().isEmpty()) {
             const QByteArray contentType = contentTypeIt.value().toString().toLatin1();
             qCDebug(CUTELYST_VIEW_EMAIL) << "Using specified content_type" << contentType;
-            message.getContent().setContentType(contentType);
+            message->getContent().setContentType(contentType);
         } else if (!d->defaultContentType.isEmpty()) {
             qCDebug(CUTELYST_VIEW_EMAIL) << "Using default content_type" << d->defaultContentType;
-            message.getContent().setContentType(d->defaultContentType);
+            message->getContent().setContentType(d->defaultContentType);
         }
     } else {
         MimeText *part = new MimeText(body.toString());
         d->setupAttributes(part, email);
-        message.setContent(part);
+        message->setContent(part);
+    }
+
+    if (d->deliveryWorker) {
+        // the worker deletes the message once it is on the wire
+        QMetaObject::invokeMethod(d->deliveryWorker, "deliver", Qt::QueuedConnection,
+                                  Q_ARG(SimpleMail::MimeMessage*, message));
+        return ret;
     }
 
-    if (!d->sender->sendMail(message)) {
+    if (!d->sender->sendMail(*message)) {
         c->error(QString::fromLatin1(d->sender->responseText()));
+        delete message;
         return ret;
     }
 
+    delete message;
     return ret;
 }
 
@@ -315,6 +367,32 @@ void ViewEmailPrivate::setupAttributes(MimePart *part, const QVariantHash &attrs
     }
 }
 
+EmailDeliveryWorker::EmailDeliveryWorker(QObject *parent) : QObject(parent)
+{
+}
+
+void EmailDeliveryWorker::deliver(SimpleMail::MimeMessage *message)
+{
+    if (!m_sender) {
+        // created on first use so it has affinity with this thread and
+        // its connection persists across messages
+        m_sender = new Sender(this);
+        m_sender->setHost(host);
+        m_sender->setPort(port);
+        m_sender->setConnectionType(connectionType);
+        m_sender->setAuthMethod(authMethod);
+        m_sender->setUser(user);
+        m_sender->setPassword(password);
+    }
+
+    if (!m_sender->sendMail(*message)) {
+        qCCritical(CUTELYST_VIEW_EMAIL) << "Failed to deliver email:"
+                                        << m_sender->responseText();
+    }
+
+    delete message;
+}
+
 void ViewEmailPrivate::setupEncoding(MimePart *part, const QByteArray &encoding) const
 {
     if (encoding == "7bit") {
@@ -37,6 +37,7 @@ class CUTELYST_VIEW_EMAIL_EXPORT ViewEmail : public Cutelyst::View
     Q_PROPERTY(QByteArray defaultContentType READ defaultContentType WRITE setDefaultContentType)
     Q_PROPERTY(QByteArray defaultCharset READ defaultCharset WRITE setDefaultCharset)
     Q_PROPERTY(QByteArray defaultEncoding READ defaultEncoding WRITE setDefaultEncoding)
+    Q_PROPERTY(bool asyncDelivery READ asyncDelivery WRITE setAsyncDelivery)
 public:
     /**  This value defines which kind of connection should be used */
     enum ConnectionType
@@ -168,6 +169,23 @@ public:
      */
     void setSenderPassword(const QString &password);
 
+    /**
+     * Returns true when messages are delivered on a background thread
+     */
+    bool asyncDelivery() const;
+
+    /**
+     * When enabled render() only composes the message and hands it to a
+     * delivery thread owning a persistent SMTP sender, returning right
+     * away instead of holding the request for the SMTP dialogue.
+     * Delivery failures are then logged instead of being reported as a
+     * request error. Call this after the sender settings are in place,
+     * the delivery thread copies them when it is created.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setAsyncDelivery(bool enable);
+
     /**
      * Renders the EMail
      */
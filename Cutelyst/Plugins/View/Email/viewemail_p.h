@@ -26,9 +26,36 @@
 
 #include <SimpleMail/sender.h>
 
+class QThread;
+
 using namespace SimpleMail;
 namespace Cutelyst {
 
+/**
+ * Lives on its own thread and owns a persistent Sender, so delivery
+ * does not hold the request thread and the SMTP connection is reused
+ * across messages instead of being opened per message.
+ */
+class EmailDeliveryWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EmailDeliveryWorker(QObject *parent = nullptr);
+
+    QString host;
+    int port = 25;
+    Sender::ConnectionType connectionType = Sender::TcpConnection;
+    Sender::AuthMethod authMethod = Sender::AuthNone;
+    QString user;
+    QString password;
+
+public Q_SLOTS:
+    void deliver(SimpleMail::MimeMessage *message);
+
+private:
+    Sender *m_sender = nullptr;
+};
+
 class ViewEmailPrivate
 {
 public:
@@ -41,9 +68,13 @@ public:
     QByteArray defaultEncoding;
     QStringList exposeKeys;
     Sender *sender;
+    QThread *deliveryThread = nullptr;
+    EmailDeliveryWorker *deliveryWorker = nullptr;
 };
 
 }
 
+Q_DECLARE_METATYPE(SimpleMail::MimeMessage*)
+
 #endif // VIEWJSON_P_H
 
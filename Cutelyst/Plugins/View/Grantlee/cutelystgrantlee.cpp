@@ -19,6 +19,7 @@
 #include "cutelystgrantlee.h"
 
 #include "urifor.h"
+#include "fragmentcache.h"
 
 CutelystGrantlee::CutelystGrantlee(QObject *parent) : QObject(parent)
 {
@@ -31,6 +32,7 @@ QHash<QString, Grantlee::AbstractNodeFactory *> CutelystGrantlee::nodeFactories(
     QHash<QString, Grantlee::AbstractNodeFactory *> ret;
 
     ret.insert(QStringLiteral("c_uri_for"), new UriForTag());
+    ret.insert(QStringLiteral("c_cache"), new FragmentCacheTag());
 
     return ret;
 }
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "fragmentcache.h"
+
+#include <grantlee/exception.h>
+#include <grantlee/parser.h>
+
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QTextStream>
+
+struct CachedFragment {
+    QString content;
+    qint64 expires;
+};
+
+// Shared by all engines so a fragment is rendered once per expiry,
+// not once per worker thread
+static QMutex fragmentsMutex;
+static QHash<QString, CachedFragment> fragments;
+
+FragmentCache::FragmentCache(const QString &name, const QString &expiry, Grantlee::Parser *parser) : Grantlee::Node(parser)
+  , m_name(name, parser)
+{
+    if (!expiry.isEmpty()) {
+        bool ok;
+        m_expirySeconds = expiry.toInt(&ok);
+        if (!ok || m_expirySeconds < 0) {
+            throw Grantlee::Exception(Grantlee::TagSyntaxError, QStringLiteral("c_cache expiry must be a number of seconds"));
+        }
+    }
+}
+
+void FragmentCache::setNodeList(const Grantlee::NodeList &nodeList)
+{
+    m_nodeList = nodeList;
+}
+
+void FragmentCache::render(Grantlee::OutputStream *stream, Grantlee::Context *gc) const
+{
+    QString key;
+    const QVariant nameVar = m_name.resolve(gc);
+    if (nameVar.userType() == qMetaTypeId<Grantlee::SafeString>()) {
+        key = nameVar.value<Grantlee::SafeString>().get();
+    } else {
+        key = nameVar.toString();
+    }
+
+    if (key.isEmpty()) {
+        m_nodeList.render(stream, gc);
+        return;
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    {
+        QMutexLocker locker(&fragmentsMutex);
+        const auto it = fragments.constFind(key);
+        if (it != fragments.constEnd() && (!it.value().expires || it.value().expires > now)) {
+            *stream << Grantlee::SafeString(it.value().content, true);
+            return;
+        }
+    }
+
+    QString content;
+    {
+        QTextStream textStream(&content);
+        Grantlee::OutputStream os(&textStream);
+        m_nodeList.render(&os, gc);
+    }
+
+    {
+        QMutexLocker locker(&fragmentsMutex);
+        fragments.insert(key, { content, m_expirySeconds ? now + m_expirySeconds * 1000 : 0 });
+    }
+
+    *stream << Grantlee::SafeString(content, true);
+}
+
+Grantlee::Node *FragmentCacheTag::getNode(const QString &tagContent, Grantlee::Parser *p) const
+{
+    QStringList parts = smartSplit(tagContent);
+
+    parts.removeFirst(); // Not interested in the name of the tag.
+    if (parts.isEmpty()) {
+        throw Grantlee::Exception(Grantlee::TagSyntaxError, QStringLiteral("c_cache requires at least the fragment name"));
+    }
+
+    auto node = new FragmentCache(parts.at(0), parts.value(1), p);
+    const Grantlee::NodeList nodeList = p->parse(node, QStringLiteral("end_c_cache"));
+    node->setNodeList(nodeList);
+    p->removeNextToken();
+
+    return node;
+}
+
+#include "moc_fragmentcache.cpp"
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef FRAGMENTCACHE_H
+#define FRAGMENTCACHE_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <grantlee/filter.h>
+#include <grantlee/safestring.h>
+#include <grantlee/util.h>
+#include <grantlee/node.h>
+
+class FragmentCacheTag : public Grantlee::AbstractNodeFactory
+{
+    Grantlee::Node *getNode(const QString &tagContent, Grantlee::Parser *p) const override;
+};
+
+class FragmentCache : public Grantlee::Node
+{
+    Q_OBJECT
+public:
+    explicit FragmentCache(const QString &name, const QString &expiry, Grantlee::Parser *parser = nullptr);
+
+    void setNodeList(const Grantlee::NodeList &nodeList);
+
+    void render(Grantlee::OutputStream *stream, Grantlee::Context *gc) const override;
+
+private:
+    Grantlee::FilterExpression m_name;
+    Grantlee::NodeList m_nodeList;
+    int m_expirySeconds = 0;
+};
+
+#endif
+
+#endif // FRAGMENTCACHE_H
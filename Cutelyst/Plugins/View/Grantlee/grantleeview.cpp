@@ -29,6 +29,8 @@
 
 #include <QString>
 #include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
 #include <QtCore/QLoggingCategory>
 
 Q_LOGGING_CATEGORY(CUTELYST_GRANTLEE, "cutelyst.grantlee")
@@ -55,6 +57,14 @@ GrantleeView::GrantleeView(QObject *parent, const QString &name) : View(parent,
         // If CUTELYST_VAR is set the template might have become
         // {{ Cutelyst.req.base }} instead of {{ c.req.base }}
         d->cutelystVar = app->config(QStringLiteral("CUTELYST_VAR"), QStringLiteral("c")).toString();
+
+        // Compile every template on the worker process so the cost is
+        // not paid by the first requests it serves
+        connect(app, &Application::postForked, this, [this] {
+            if (isCaching()) {
+                preloadTemplates();
+            }
+        });
     } else {
         // make sure templates can be found on the current directory
         setIncludePaths({ QDir::currentPath() });
@@ -129,6 +139,49 @@ Grantlee::Engine *GrantleeView::engine() const
     return d->engine;
 }
 
+// Warns about {% include %} and {% extends %} targets that do not
+// resolve against the loader. Only literal names can be checked,
+// references through variables are only known at render time.
+static void verifyTemplateReferences(const QString &name, const QString &content,
+                                     Grantlee::CachingLoaderDecorator *cache)
+{
+    int pos = 0;
+    Q_FOREVER {
+        pos = content.indexOf(QLatin1String("{%"), pos);
+        if (pos == -1) {
+            break;
+        }
+        const int end = content.indexOf(QLatin1String("%}"), pos + 2);
+        if (end == -1) {
+            break;
+        }
+        const QString tag = content.mid(pos + 2, end - pos - 2).trimmed();
+        pos = end + 2;
+
+        QString ref;
+        if (tag.startsWith(QLatin1String("include "))) {
+            ref = tag.mid(8).trimmed();
+        } else if (tag.startsWith(QLatin1String("extends "))) {
+            ref = tag.mid(8).trimmed();
+        } else {
+            continue;
+        }
+
+        if (ref.size() >= 2 &&
+                (ref.startsWith(QLatin1Char('"')) || ref.startsWith(QLatin1Char('\'')))) {
+            const QChar quote = ref.at(0);
+            const int close = ref.indexOf(quote, 1);
+            if (close > 1) {
+                const QString target = ref.mid(1, close - 1);
+                if (!cache->canLoadTemplate(target)) {
+                    qCWarning(CUTELYST_GRANTLEE) << "Template" << name
+                                                 << "references missing template" << target;
+                }
+            }
+        }
+    }
+}
+
 void GrantleeView::preloadTemplates()
 {
     Q_D(GrantleeView);
@@ -145,7 +198,9 @@ void GrantleeView::preloadTemplates()
                         QDir::Files | QDir::NoDotAndDotDot,
                         QDirIterator::Subdirectories);
         while (it.hasNext()) {
-            QString path = it.next();
+            const QString filePath = it.next();
+            const QDateTime lastModified = it.fileInfo().lastModified();
+            QString path = filePath;
             path.remove(includePath);
             if (path.startsWith(QLatin1Char('/'))) {
                 path.remove(0, 1);
@@ -153,6 +208,16 @@ void GrantleeView::preloadTemplates()
 
             if (d->cache->canLoadTemplate(path)) {
                 d->cache->loadByName(path, d->engine);
+                d->templateMTimes.insert(path, lastModified);
+
+                // the include graph is static text, broken references
+                // can be reported now instead of by the first request
+                // that renders the template
+                QFile file(filePath);
+                if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                    verifyTemplateReferences(path, QString::fromUtf8(file.readAll()),
+                                             d->cache.data());
+                }
             }
         }
     }
@@ -208,7 +273,7 @@ QByteArray GrantleeView::render(Context *c) const
 
     gc.setLocalizer(localizer);
 
-    Grantlee::Template tmpl = d->engine->loadByName(templateFile);
+    Grantlee::Template tmpl = d->loadTemplate(templateFile);
     QString content = tmpl->render(&gc);
     if (tmpl->error() != Grantlee::NoError) {
         c->res()->setBody(c->translate("Cutelyst::GrantleeView", "Internal server error."));
@@ -217,7 +282,7 @@ QByteArray GrantleeView::render(Context *c) const
     }
 
     if (!d->wrapper.isEmpty()) {
-        Grantlee::Template wrapper = d->engine->loadByName(d->wrapper);
+        Grantlee::Template wrapper = d->loadTemplate(d->wrapper);
         Grantlee::SafeString safeContent(content, true);
         gc.insert(QStringLiteral("content"), safeContent);
         content = wrapper->render(&gc);
@@ -233,6 +298,38 @@ QByteArray GrantleeView::render(Context *c) const
     return ret;
 }
 
+QDateTime GrantleeViewPrivate::templateLastModified(const QString &name) const
+{
+    for (const QString &includePath : includePaths) {
+        const QFileInfo fi(includePath + QLatin1Char('/') + name);
+        if (fi.exists()) {
+            return fi.lastModified();
+        }
+    }
+    return QDateTime();
+}
+
+Grantlee::Template GrantleeViewPrivate::loadTemplate(const QString &name) const
+{
+    if (!cache.isNull()) {
+        // The decorator keeps compiled templates forever, stat the
+        // source file so an edit on disk drops the stale copy
+        const QDateTime lastModified = templateLastModified(name);
+        const auto it = templateMTimes.constFind(name);
+        if (it == templateMTimes.constEnd()) {
+            templateMTimes.insert(name, lastModified);
+        } else if (it.value() != lastModified) {
+            // the changed template may be included or extended by
+            // other cached ones, start over
+            cache->clear();
+            templateMTimes.clear();
+            templateMTimes.insert(name, lastModified);
+        }
+    }
+
+    return engine->loadByName(name);
+}
+
 void GrantleeView::addTranslator(const QLocale &locale, QTranslator *translator)
 {
     Q_D(GrantleeView);
@@ -45,6 +45,14 @@ class GrantleeViewPrivate;
  * {% c_uri_for "/path" "arg1" "arg2" QUERY "foo=bar" c.req.queryParams %}
  *
  * Where only the path is required, and QUERY keyword must preceed query parameters
+ *
+ * There is also a tag that caches the rendered output of its block,
+ * for expensive fragments that rarely change such as navigation menus:
+ *
+ * {% c_cache "nav-menu" 300 %} ... {% end_c_cache %}
+ *
+ * Where the first argument names the fragment and the optional second
+ * one is the time to live in seconds, caching forever when omitted
  */
 class CUTELYST_VIEW_GRANTLEE_EXPORT GrantleeView : public View
 {
@@ -22,6 +22,8 @@
 
 #include "grantleeview.h"
 
+#include <QDateTime>
+
 #include <grantlee/engine.h>
 #include <grantlee/templateloader.h>
 #include <grantlee/cachingloaderdecorator.h>
@@ -31,6 +33,9 @@ namespace Cutelyst {
 class GrantleeViewPrivate
 {
 public:
+    Grantlee::Template loadTemplate(const QString &name) const;
+    QDateTime templateLastModified(const QString &name) const;
+
     QStringList includePaths;
     QString extension = QStringLiteral(".html");
     QString wrapper;
@@ -38,6 +43,7 @@ public:
     Grantlee::Engine *engine;
     QSharedPointer<Grantlee::FileSystemTemplateLoader> loader;
     QSharedPointer<Grantlee::CachingLoaderDecorator> cache;
+    mutable QHash<QString, QDateTime> templateMTimes;
     QHash<QLocale, QTranslator*> translators;
     QHash<QString, QString> translationCatalogs;
 };
@@ -24,6 +24,10 @@
 
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonValue>
+#include <QtCore/QMetaType>
+#include <QtCore/QHash>
 
 using namespace Cutelyst;
 
@@ -63,6 +67,18 @@ void ViewJson::setOutputFormat(JsonFormat format)
     }
 }
 
+ViewJson::JsonSerializer ViewJson::serializer() const
+{
+    Q_D(const ViewJson);
+    return d->serializer;
+}
+
+void ViewJson::setSerializer(JsonSerializer serializer)
+{
+    Q_D(ViewJson);
+    d->serializer = serializer;
+}
+
 ViewJson::ExposeMode ViewJson::exposeStashMode() const
 {
     Q_D(const ViewJson);
@@ -90,30 +106,228 @@ void ViewJson::setExposeStashRegularExpression(const QRegularExpression &re)
     d->exposeRE = re;
 }
 
+static void serializeJsonValue(const QVariant &value, QByteArray &out);
+
+static void serializeJsonString(const QString &str, QByteArray &out)
+{
+    out.append('"');
+    const QByteArray utf8 = str.toUtf8();
+    const char *data = utf8.constData();
+    for (int i = 0; i < utf8.size(); ++i) {
+        const char c = data[i];
+        switch (c) {
+        case '"': out.append("\\\"", 2); break;
+        case '\\': out.append("\\\\", 2); break;
+        case '\b': out.append("\\b", 2); break;
+        case '\f': out.append("\\f", 2); break;
+        case '\n': out.append("\\n", 2); break;
+        case '\r': out.append("\\r", 2); break;
+        case '\t': out.append("\\t", 2); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                const char *hex = "0123456789abcdef";
+                out.append("\\u00", 4);
+                out.append(hex[(c >> 4) & 0xf]);
+                out.append(hex[c & 0xf]);
+            } else {
+                out.append(c);
+            }
+        }
+    }
+    out.append('"');
+}
+
+static void serializeJsonHash(const QVariantHash &hash, QByteArray &out)
+{
+    out.append('{');
+    auto it = hash.constBegin();
+    while (it != hash.constEnd()) {
+        if (it != hash.constBegin()) {
+            out.append(',');
+        }
+        serializeJsonString(it.key(), out);
+        out.append(':');
+        serializeJsonValue(it.value(), out);
+        ++it;
+    }
+    out.append('}');
+}
+
+static void serializeJsonMap(const QVariantMap &map, QByteArray &out,
+                             QHash<QString, QByteArray> *keyCache = nullptr)
+{
+    out.append('{');
+    auto it = map.constBegin();
+    while (it != map.constEnd()) {
+        if (it != map.constBegin()) {
+            out.append(',');
+        }
+
+        if (keyCache) {
+            auto key = keyCache->constFind(it.key());
+            if (key == keyCache->constEnd()) {
+                QByteArray escaped;
+                serializeJsonString(it.key(), escaped);
+                key = keyCache->insert(it.key(), escaped);
+            }
+            out.append(key.value());
+        } else {
+            serializeJsonString(it.key(), out);
+        }
+
+        out.append(':');
+        serializeJsonValue(it.value(), out);
+        ++it;
+    }
+    out.append('}');
+}
+
+static void serializeJsonJson(const QJsonValue &json, QByteArray &out)
+{
+    switch (json.type()) {
+    case QJsonValue::Bool:
+        out.append(json.toBool() ? "true" : "false");
+        break;
+    case QJsonValue::Double:
+        serializeJsonValue(QVariant(json.toDouble()), out);
+        break;
+    case QJsonValue::String:
+        serializeJsonString(json.toString(), out);
+        break;
+    case QJsonValue::Array:
+        out.append(QJsonDocument(json.toArray()).toJson(QJsonDocument::Compact));
+        break;
+    case QJsonValue::Object:
+        out.append(QJsonDocument(json.toObject()).toJson(QJsonDocument::Compact));
+        break;
+    default:
+        out.append("null", 4);
+    }
+}
+
+static void serializeJsonValue(const QVariant &value, QByteArray &out)
+{
+    switch (value.userType()) {
+    case QMetaType::UnknownType:
+        out.append("null", 4);
+        break;
+    case QMetaType::Bool:
+        out.append(value.toBool() ? "true" : "false");
+        break;
+    case QMetaType::Int:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+    case QMetaType::Short:
+    case QMetaType::SChar:
+        out.append(QByteArray::number(value.toLongLong()));
+        break;
+    case QMetaType::UInt:
+    case QMetaType::ULong:
+    case QMetaType::ULongLong:
+    case QMetaType::UShort:
+    case QMetaType::UChar:
+        out.append(QByteArray::number(value.toULongLong()));
+        break;
+    case QMetaType::Double:
+    case QMetaType::Float: {
+        const double d = value.toDouble();
+        if (!qIsFinite(d)) {
+            out.append("null", 4);
+            break;
+        }
+
+        QByteArray number = QByteArray::number(d, 'g', 15);
+        if (number.toDouble() != d) {
+            // 15 digits do not round-trip, pay for the full form
+            number = QByteArray::number(d, 'g', 17);
+        }
+        out.append(number);
+        break;
+    }
+    case QMetaType::QString:
+        serializeJsonString(value.toString(), out);
+        break;
+    case QMetaType::QVariantHash:
+        serializeJsonHash(value.toHash(), out);
+        break;
+    case QMetaType::QVariantMap:
+        serializeJsonMap(value.toMap(), out);
+        break;
+    case QMetaType::QVariantList: {
+        const QVariantList list = value.toList();
+        out.append('[');
+        // row sets from Sql::queryToMapList share one column layout,
+        // escape the keys once and size the buffer from the first row
+        QHash<QString, QByteArray> keyCache;
+        const int listStart = out.size();
+        for (int i = 0; i < list.size(); ++i) {
+            if (i) {
+                out.append(',');
+            }
+
+            const QVariant &item = list.at(i);
+            if (item.userType() == QMetaType::QVariantMap) {
+                serializeJsonMap(item.toMap(), out, &keyCache);
+            } else {
+                serializeJsonValue(item, out);
+            }
+
+            if (i == 0) {
+                out.reserve(listStart + (out.size() - listStart + 8) * list.size());
+            }
+        }
+        out.append(']');
+        break;
+    }
+    case QMetaType::QStringList: {
+        const QStringList list = value.toStringList();
+        out.append('[');
+        for (int i = 0; i < list.size(); ++i) {
+            if (i) {
+                out.append(',');
+            }
+            serializeJsonString(list.at(i), out);
+        }
+        out.append(']');
+        break;
+    }
+    default:
+        if (value.userType() == qMetaTypeId<QJsonValue>()) {
+            serializeJsonJson(value.value<QJsonValue>(), out);
+        } else if (value.userType() == qMetaTypeId<QJsonObject>()) {
+            serializeJsonJson(QJsonValue(value.value<QJsonObject>()), out);
+        } else if (value.userType() == qMetaTypeId<QJsonArray>()) {
+            serializeJsonJson(QJsonValue(value.value<QJsonArray>()), out);
+        } else {
+            // Dates, urls and custom types take the QJsonValue
+            // conversion rules so both serializers agree
+            serializeJsonJson(QJsonValue::fromVariant(value), out);
+        }
+    }
+}
+
 QByteArray ViewJson::render(Context *c) const
 {
     Q_D(const ViewJson);
 
-    QJsonObject obj;
+    QVariantHash exposedStash;
 
     const QVariantHash stash = c->stash();
 
     switch (d->exposeMode) {
     case All:
-        obj = QJsonObject::fromVariantHash(stash);
+        exposedStash = stash;
         break;
     case String:
     {
         auto it = stash.constFind(d->exposeKey);
         if (it != stash.constEnd()) {
-            obj.insert(d->exposeKey, QJsonValue::fromVariant(it.value()));
+            exposedStash.insert(d->exposeKey, it.value());
         }
         break;
     }
     case StringList:
     {
-        QVariantHash exposedStash;
-
         auto it = stash.constBegin();
         while (it != stash.constEnd()) {
             const QString key = it.key();
@@ -122,12 +336,10 @@ QByteArray ViewJson::render(Context *c) const
             }
             ++it;
         }
-        obj = QJsonObject::fromVariantHash(exposedStash);
         break;
     }
     case RegularExpression:
     {
-        QVariantHash exposedStash;
         QRegularExpression re = d->exposeRE; // thread safety
 
         auto it = stash.constBegin();
@@ -138,14 +350,20 @@ QByteArray ViewJson::render(Context *c) const
             }
             ++it;
         }
-        obj = QJsonObject::fromVariantHash(exposedStash);
         break;
     }
     }
 
     c->response()->setContentType(QStringLiteral("application/json"));
 
-    return QJsonDocument(obj).toJson(d->format);
+    if (d->serializer == DirectBuffer && d->format == QJsonDocument::Compact) {
+        QByteArray ret;
+        ret.reserve(1024);
+        serializeJsonHash(exposedStash, ret);
+        return ret;
+    }
+
+    return QJsonDocument(QJsonObject::fromVariantHash(exposedStash)).toJson(d->format);
 }
 
 #include "moc_viewjson.cpp"
@@ -59,6 +59,28 @@ public:
      */
     void setOutputFormat(JsonFormat format);
 
+    /**  This value defines the serializer producing the JSON byte array */
+    enum JsonSerializer {
+        QtJson, /**< The output is built with QJsonDocument */
+        DirectBuffer /**< The stash variants are serialized straight into the output buffer, skipping the QJsonDocument representation */
+    };
+    Q_ENUM(JsonSerializer)
+
+    /**
+     * Returns the serializer used to produce the JSON output,
+     * defaults to QtJson
+     */
+    JsonSerializer serializer() const;
+
+    /**
+     * Defines the serializer used to produce the JSON output.
+     *
+     * DirectBuffer skips building a QJsonObject of the exposed stash
+     * which is measurably faster on big payloads. It always produces
+     * Compact output, so the Indented format keeps using QtJson.
+     */
+    void setSerializer(JsonSerializer serializer);
+
     /**  This value defines which kind of exposition was defined */
     enum ExposeMode {
         All,
@@ -36,6 +36,7 @@ public:
     QStringList exposeKeys;
     QRegularExpression exposeRE;
     QJsonDocument::JsonFormat format = QJsonDocument::Compact;
+    ViewJson::JsonSerializer serializer = ViewJson::QtJson;
 };
 
 }
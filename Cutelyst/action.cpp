@@ -43,6 +43,8 @@ void Action::setMethod(const QMetaMethod &method)
 {
     Q_D(Action);
     d->method = method;
+    // cached for the direct metacall in doExecute()
+    d->methodIndex = method.methodIndex();
     if (method.returnType() == QMetaType::Bool) {
         d->evaluateBool = true;
     }
@@ -155,36 +157,34 @@ bool Action::doExecute(Context *c)
         return false;
     }
 
+    // The signature was validated when the action was registered, so
+    // the call goes through QMetaObject::metacall() directly with a
+    // hand-packed argument array; QMetaMethod::invoke() would check
+    // every argument type name again on each invocation.
+    bool methodRet = false;
+    void *returnSlot = d->evaluateBool ? &methodRet : nullptr;
+
     bool ret;
-    if (d->evaluateBool) {
-        bool methodRet;
-
-        if (d->listSignature) {
-            ret = d->method.invoke(d->controller,
-                                   Qt::DirectConnection,
-                                   Q_RETURN_ARG(bool, methodRet),
-                                   Q_ARG(Cutelyst::Context*, c),
-                                   Q_ARG(QStringList,  c->request()->args()));
-        } else {
-            QStringList args = c->request()->args();
-            // Fill the missing arguments
-            args.append(d->emptyArgs);
-
-            ret = d->method.invoke(d->controller,
-                                   Qt::DirectConnection,
-                                   Q_RETURN_ARG(bool, methodRet),
-                                   Q_ARG(Cutelyst::Context*, c),
-                                   Q_ARG(QString, args.at(0)),
-                                   Q_ARG(QString, args.at(1)),
-                                   Q_ARG(QString, args.at(2)),
-                                   Q_ARG(QString, args.at(3)),
-                                   Q_ARG(QString, args.at(4)),
-                                   Q_ARG(QString, args.at(5)),
-                                   Q_ARG(QString, args.at(6)),
-                                   Q_ARG(QString, args.at(7)),
-                                   Q_ARG(QString, args.at(8)));
-        }
+    if (d->listSignature) {
+        Context *context = c;
+        QStringList args = c->request()->args();
+        void *argv[] = { returnSlot, &context, &args };
+        ret = QMetaObject::metacall(d->controller, QMetaObject::InvokeMetaMethod,
+                                    d->methodIndex, argv) < 0;
+    } else {
+        QStringList args = c->request()->args();
+        // Fill the missing arguments
+        args.append(d->emptyArgs);
+
+        Context *context = c;
+        void *argv[] = { returnSlot, &context,
+                         &args[0], &args[1], &args[2], &args[3], &args[4],
+                         &args[5], &args[6], &args[7], &args[8] };
+        ret = QMetaObject::metacall(d->controller, QMetaObject::InvokeMetaMethod,
+                                    d->methodIndex, argv) < 0;
+    }
 
+    if (d->evaluateBool) {
         if (ret) {
             c->setState(methodRet);
             return methodRet;
@@ -195,33 +195,10 @@ bool Action::doExecute(Context *c)
         c->setState(false);
 
         return false;
-    } else {
-        if (d->listSignature) {
-            ret = d->method.invoke(d->controller,
-                                   Qt::DirectConnection,
-                                   Q_ARG(Cutelyst::Context*, c),
-                                   Q_ARG(QStringList, c->request()->args()));
-        } else {
-            QStringList args = c->request()->args();
-            // Fill the missing arguments
-            args.append(d->emptyArgs);
-
-            ret = d->method.invoke(d->controller,
-                                   Qt::DirectConnection,
-                                   Q_ARG(Cutelyst::Context*, c),
-                                   Q_ARG(QString, args.at(0)),
-                                   Q_ARG(QString, args.at(1)),
-                                   Q_ARG(QString, args.at(2)),
-                                   Q_ARG(QString, args.at(3)),
-                                   Q_ARG(QString, args.at(4)),
-                                   Q_ARG(QString, args.at(5)),
-                                   Q_ARG(QString, args.at(6)),
-                                   Q_ARG(QString, args.at(7)),
-                                   Q_ARG(QString, args.at(8)));
-        }
-        c->setState(ret);
-        return ret;
     }
+
+    c->setState(ret);
+    return ret;
 }
 
 #include "moc_action.cpp"
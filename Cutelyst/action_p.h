@@ -35,6 +35,8 @@ public:
             << QString() << QString() << QString()
             << QString() << QString() << QString()
             << QString() << QString() << QString();
+    // absolute index of method, for the direct metacall in doExecute()
+    int methodIndex = -1;
     qint8 numberOfArgs = -1;
     qint8 numberOfCaptures = -1;
     bool evaluateBool = false;
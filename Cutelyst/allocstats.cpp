@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "allocstats_p.h"
+
+#ifdef CUTELYST_ALLOC_STATS
+
+#include <cstdlib>
+#include <new>
+
+// Plain thread locals: the counters are only ever touched by their
+// own thread, so the hot path is two increments with no atomics.
+static thread_local quint64 t_allocations = 0;
+static thread_local quint64 t_bytes = 0;
+
+// Replacing the global allocation functions interposes every C++
+// object allocation of the process, including the ones Qt makes on
+// behalf of the application.
+void *operator new(std::size_t size)
+{
+    ++t_allocations;
+    t_bytes += size;
+    void *ptr = std::malloc(size);
+    if (Q_UNLIKELY(!ptr)) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](std::size_t size)
+{
+    ++t_allocations;
+    t_bytes += size;
+    void *ptr = std::malloc(size);
+    if (Q_UNLIKELY(!ptr)) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace Cutelyst {
+namespace AllocStats {
+
+Counters read()
+{
+    Counters ret;
+    ret.allocations = t_allocations;
+    ret.bytes = t_bytes;
+    return ret;
+}
+
+}
+}
+
+#endif // CUTELYST_ALLOC_STATS
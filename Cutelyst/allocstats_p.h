@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef CUTELYST_ALLOCSTATS_P_H
+#define CUTELYST_ALLOCSTATS_P_H
+
+#include <QtCore/QtGlobal>
+
+namespace Cutelyst {
+
+/**
+ * Per-thread allocation counters, live only in builds configured with
+ * -DENABLE_ALLOC_STATS=ON which replaces the global operator new.
+ *
+ * The counters cover every C++ object allocation in the process,
+ * which is where per-request churn regressions come from; raw
+ * malloc() calls, such as Qt container payload buffers, are not
+ * interposed and stay invisible.
+ */
+namespace AllocStats {
+
+struct Counters {
+    quint64 allocations = 0;
+    quint64 bytes = 0;
+};
+
+#ifdef CUTELYST_ALLOC_STATS
+/**
+ * Returns the calling thread's counters since thread start; callers
+ * diff two reads to attribute the allocations in between.
+ */
+Counters read();
+#else
+inline Counters read() { return Counters(); }
+#endif
+
+}
+
+}
+
+#endif // CUTELYST_ALLOCSTATS_P_H
@@ -18,6 +18,7 @@
  */
 
 #include "application_p.h"
+#include "keys_p.h"
 
 #include "config.h"
 #include "common.h"
@@ -350,6 +351,8 @@ bool Application::setup(Engine *engine)
                                                         QLatin1String("Loaded components:")).constData();
         }
 
+        ControllerPrivate::loadActionAttributesCache();
+
         const auto controllers = d->controllers;
         for (Controller *controller : controllers) {
             controller->d_ptr->init(this, d->dispatcher);
@@ -357,6 +360,8 @@ bool Application::setup(Engine *engine)
 
         d->dispatcher->setupActions(d->controllers, d->dispatchers, d->engine->workerCore() == 0);
 
+        ControllerPrivate::saveActionAttributesCache();
+
         if (zeroCore) {
             qCInfo(CUTELYST_CORE) << QString::fromLatin1("%1 powered by Cutelyst %2, Qt %3.")
                                      .arg(QCoreApplication::applicationName(), QLatin1String(Application::cutelystVersion()), QLatin1String(qVersion()))
@@ -392,6 +397,7 @@ Context *Application::handleRequest2(Request *req)
     if (d->useStats) {
         stats = new Stats(this);
         priv->stats = stats;
+        stats->stageReached(Stats::StageReceived);
     }
 
     // Process request
@@ -405,21 +411,42 @@ Context *Application::handleRequest2(Request *req)
         }
 
         d->dispatcher->prepareAction(c);
+        if (stats) {
+            stats->stageReached(Stats::StagePrepared);
+        }
 
         Q_EMIT beforeDispatch(c);
 
         d->dispatcher->dispatch(c);
+        if (stats) {
+            stats->stageReached(Stats::StageDispatched);
+        }
 
         Q_EMIT afterDispatch(c);
     }
 
+    if (priv->asyncDetached > 0) {
+        // An action called detachAsync(), finalize is deferred and the
+        // context deleted when the last attachAsync() resumes it
+        priv->asyncFinalize = true;
+        delete stats;
+        priv->stats = nullptr;
+        return nullptr;
+    }
+
     engine->finalize(c);
 
+    priv->schedulePostResponseJobs();
+
     if (stats) {
+        stats->stageReached(Stats::StageFinalized);
+        stats->traceFinished(req->path(), c->response()->status(),
+                             req->headers().header(QStringLiteral("TRACEPARENT")));
+
         qCDebug(CUTELYST_STATS, "Response Code: %d; Content-Type: %s; Content-Length: %s",
                 c->response()->status(),
-                c->response()->headers().header(QStringLiteral("CONTENT_TYPE"), QStringLiteral("unknown")).toLatin1().data(),
-                c->response()->headers().header(QStringLiteral("CONTENT_LENGTH"), QStringLiteral("unknown")).toLatin1().data());
+                c->response()->headers().header(Keys::CONTENT_TYPE, QStringLiteral("unknown")).toLatin1().data(),
+                c->response()->headers().header(Keys::CONTENT_LENGTH, QStringLiteral("unknown")).toLatin1().data());
 
         RequestPrivate *reqPriv = req->d_ptr;
         reqPriv->endOfRequest = engine->time();
@@ -440,6 +467,33 @@ Context *Application::handleRequest2(Request *req)
     return c;
 }
 
+// Touches the lazily initialized per-worker state so the first real
+// requests after a deploy do not pay for it.
+static void warmupWorker()
+{
+    enum { WarmObjects = 64 };
+
+    // Fill the per-thread free lists of the request-scoped objects;
+    // the first requests then recycle warm, already-faulted memory
+    // instead of going to the allocator
+    void *contexts[WarmObjects];
+    void *requests[WarmObjects];
+    void *responses[WarmObjects];
+    for (int i = 0; i < WarmObjects; ++i) {
+        contexts[i] = MemoryPool<ContextPrivate>::allocate(sizeof(ContextPrivate));
+        requests[i] = MemoryPool<RequestPrivate>::allocate(sizeof(RequestPrivate));
+        responses[i] = MemoryPool<ResponsePrivate>::allocate(sizeof(ResponsePrivate));
+    }
+    for (int i = 0; i < WarmObjects; ++i) {
+        MemoryPool<ContextPrivate>::deallocate(contexts[i], sizeof(ContextPrivate));
+        MemoryPool<RequestPrivate>::deallocate(requests[i], sizeof(RequestPrivate));
+        MemoryPool<ResponsePrivate>::deallocate(responses[i], sizeof(ResponsePrivate));
+    }
+
+    // builds the status-line table on this first call
+    Engine::httpStatusMessage(Response::OK);
+}
+
 bool Application::enginePostFork()
 {
     Q_D(Application);
@@ -455,6 +509,10 @@ bool Application::enginePostFork()
         }
     }
 
+    warmupWorker();
+
+    // applications that want a deeper warmup, like replaying a canned
+    // request set against themselves, can do it from this signal
     Q_EMIT postForked(this);
 
     return true;
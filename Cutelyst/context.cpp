@@ -26,6 +26,7 @@
 #include "dispatcher.h"
 #include "controller.h"
 #include "application.h"
+#include "engine.h"
 #include "stats.h"
 
 #include "config.h"
@@ -34,6 +35,9 @@
 #include <QUrlQuery>
 #include <QCoreApplication>
 #include <QBuffer>
+#include <QTimer>
+
+#include <memory>
 
 using namespace Cutelyst;
 
@@ -60,6 +64,16 @@ Context::~Context()
     delete d_ptr;
 }
 
+void *Context::operator new(size_t size)
+{
+    return MemoryPool<Context>::allocate(size);
+}
+
+void Context::operator delete(void *ptr, size_t size)
+{
+    MemoryPool<Context>::deallocate(ptr, size);
+}
+
 bool Context::error() const
 {
     Q_D(const Context);
@@ -155,6 +169,32 @@ Dispatcher *Context::dispatcher() const
     return d->dispatcher;
 }
 
+quint64 Context::deadline() const
+{
+    Q_D(const Context);
+    return d->deadline;
+}
+
+void Context::setDeadline(qint64 msecs)
+{
+    Q_D(Context);
+    d->deadline = Engine::time() + static_cast<quint64>(msecs) * 1000;
+}
+
+qint64 Context::deadlineRemaining() const
+{
+    Q_D(const Context);
+    if (!d->deadline) {
+        return -1;
+    }
+
+    const quint64 now = Engine::time();
+    if (now >= d->deadline) {
+        return 0;
+    }
+    return static_cast<qint64>((d->deadline - now) / 1000);
+}
+
 QString Cutelyst::Context::controllerName() const
 {
     Q_D(const Context);
@@ -216,6 +256,33 @@ void Context::setStash(const QString &key, const ParamsMultiMap &map)
     d->stash.insert(key, QVariant::fromValue(map));
 }
 
+int Context::registerStashSlot()
+{
+    static QAtomicInt slotCount;
+    return slotCount.fetchAndAddRelaxed(1);
+}
+
+QVariant Context::stashSlot(int slot) const
+{
+    Q_D(const Context);
+    if (slot >= 0 && size_t(slot) < d->stashSlots.size()) {
+        return d->stashSlots[size_t(slot)];
+    }
+    return QVariant();
+}
+
+void Context::setStashSlot(int slot, const QVariant &value)
+{
+    Q_D(Context);
+    if (slot < 0) {
+        return;
+    }
+    if (size_t(slot) >= d->stashSlots.size()) {
+        d->stashSlots.resize(size_t(slot) + 1);
+    }
+    d->stashSlots[size_t(slot)] = value;
+}
+
 QStack<Component *> Context::stack() const
 {
     Q_D(const Context);
@@ -324,6 +391,70 @@ void Context::detach(Action *action)
     d->detached = true;
 }
 
+void Context::detachAsync()
+{
+    Q_D(Context);
+    ++d->asyncDetached;
+}
+
+void Context::attachAsync()
+{
+    Q_D(Context);
+    if (d->asyncDetached <= 0) {
+        qCWarning(CUTELYST_CORE) << "attachAsync called without a matching detachAsync";
+        return;
+    }
+
+    if (--d->asyncDetached == 0 && d->asyncFinalize) {
+        d->engine->finalize(this);
+        d->schedulePostResponseJobs();
+        deleteLater();
+    }
+}
+
+// Bounds the jobs a worker may have queued but not yet run; past it
+// deferPostResponse() rejects, so a traffic burst degrades to inline
+// execution instead of an unbounded backlog on the event loop
+#define POST_RESPONSE_PENDING_MAX 1024
+
+static thread_local int t_postResponsePending = 0;
+
+bool Context::deferPostResponse(std::function<void()> job)
+{
+    Q_D(Context);
+    if (!job) {
+        return false;
+    }
+
+    if (t_postResponsePending + int(d->postResponseJobs.size()) >= POST_RESPONSE_PENDING_MAX) {
+        qCWarning(CUTELYST_CORE) << "deferPostResponse queue is full, job rejected";
+        return false;
+    }
+
+    d->postResponseJobs.push_back(std::move(job));
+    return true;
+}
+
+void ContextPrivate::schedulePostResponseJobs()
+{
+    if (postResponseJobs.empty()) {
+        return;
+    }
+
+    t_postResponsePending += int(postResponseJobs.size());
+
+    // next event-loop turn, so socket events that arrived while the
+    // request was handled are serviced before the background work;
+    // the jobs outlive the Context that queued them
+    auto jobs = std::make_shared<std::vector<std::function<void()> > >(std::move(postResponseJobs));
+    QTimer::singleShot(0, [jobs] () {
+        for (const std::function<void()> &job : *jobs) {
+            job();
+            --t_postResponsePending;
+        }
+    });
+}
+
 bool Context::forward(Component *action)
 {
     Q_D(Context);
@@ -29,6 +29,8 @@
 #include <Cutelyst/request.h>
 #include <Cutelyst/cutelyst_global.h>
 
+#include <functional>
+
 namespace Cutelyst {
 
 class Action;
@@ -71,6 +73,19 @@ public:
     Context(Application *app);
     virtual ~Context();
 
+    /*!
+     * \internal
+     * One Context is allocated per request, so the blocks are
+     * recycled through a per worker-core pool like the private
+     * request data already is.
+     */
+    void *operator new(size_t size);
+
+    /*!
+     * \internal
+     */
+    void operator delete(void *ptr, size_t size);
+
     /*!
      * Returns true if an error was set.
      */
@@ -152,6 +167,37 @@ public:
      */
     Dispatcher *dispatcher() const;
 
+    /**
+     * Returns the absolute deadline of this request in microseconds
+     * since the epoch, on the clock of Engine::time(), or 0 when no
+     * deadline is set.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    quint64 deadline() const;
+
+    /**
+     * Gives this request a time budget of \p msecs from now. Routes
+     * can declare it with the Timeout(msecs) action attribute, which
+     * is applied at dispatch unless a deadline was already set, for
+     * example by a beforeDispatch hook. A request whose deadline
+     * passed before its action runs is answered with 503 Service
+     * Unavailable instead of being dispatched, and handlers and the
+     * Sql plugin can propagate the remaining budget to upstreams so
+     * a hung dependency cannot occupy the worker forever.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setDeadline(qint64 msecs);
+
+    /**
+     * Returns the milliseconds left until the deadline, 0 when it
+     * already passed or -1 when no deadline is set.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    qint64 deadlineRemaining() const;
+
     /**
      * The current controller name
      */
@@ -244,6 +290,33 @@ public:
      */
     void setStash(const QString &key, const ParamsMultiMap &map);
 
+    /**
+     * Registers a stash slot and returns its index, to be kept by
+     * the application, typically in a function local static. Slots
+     * give middleware style code per-request storage addressed by an
+     * array index instead of hashing a string key per access.
+     *
+     * Thread safe; meant to run once per slot at startup.
+     * \since 1.10.0
+     */
+    static int registerStashSlot();
+
+    /**
+     * Returns the value of the stash slot \p slot for this request,
+     * or an invalid QVariant when nothing was set.
+     *
+     * \note slot values are per-request plumbing between application
+     * layers; unlike the named stash they are not handed to the view.
+     * \since 1.10.0
+     */
+    QVariant stashSlot(int slot) const;
+
+    /**
+     * Sets the value of the stash slot \p slot for this request.
+     * \since 1.10.0
+     */
+    void setStashSlot(int slot, const QVariant &value);
+
     /**
      * Returns the internal execution stack (actions that are currently executing).
      */
@@ -346,6 +419,41 @@ public:
      */
     void detach(Action *action = nullptr);
 
+    /**
+     * Suspends this request: once the dispatch chain returns the
+     * response is not finalized until attachAsync() is called, so an
+     * action can wait for a QNetworkReply or a database result and
+     * give the thread back to the event loop instead of blocking.
+     *
+     * Each call must be paired with a later attachAsync(), multiple
+     * pending operations can each hold their own pair.
+     */
+    void detachAsync();
+
+    /**
+     * Resumes a request suspended with detachAsync(). When the last
+     * pending detachAsync() is attached back the response is
+     * finalized and this context is deleted, so it must not be
+     * accessed afterwards.
+     */
+    void attachAsync();
+
+    /**
+     * Queues \p job to run on the worker's event loop once the
+     * response has been finalized and handed to the client, so work
+     * the client does not need to wait for, like audit logging or
+     * webhook delivery, stops adding to user-visible latency.
+     *
+     * Jobs run in queueing order on the worker thread after pending
+     * socket events are serviced; they must not touch this Context,
+     * which is deleted before they execute. The per-worker queue is
+     * bounded, when it is full the job is rejected and false is
+     * returned so the caller can fall back to running it inline.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    bool deferPostResponse(std::function<void()> job);
+
     /**
      * This is one way of calling another action (method) in the same or
      * a different controller. You can also use directly call another method
@@ -499,7 +607,16 @@ private:
 };
 
 inline void Context::stash(const QVariantHash &unite)
-{ stash().unite(unite); }
+{
+    // not QHash::unite(), which keeps the old value as a hidden
+    // duplicate node on every repeated key
+    QVariantHash &st = stash();
+    auto it = unite.constBegin();
+    while (it != unite.constEnd()) {
+        st.insert(it.key(), it.value());
+        ++it;
+    }
+}
 
 inline QUrl Context::uriFor(const QString &path, const ParamsMultiMap &queryValues) const
 { return uriFor(path, QStringList(), queryValues); }
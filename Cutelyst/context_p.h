@@ -25,27 +25,41 @@
 #include "response.h"
 #include "request_p.h"
 
+#include "memorypool_p.h"
+
 #include <QVariantHash>
 #include <QStack>
 
+#include <vector>
+
 namespace Cutelyst {
 
 class Stats;
 class ContextPrivate
 {
 public:
+    CUTELYST_MEMORY_POOLED(ContextPrivate)
+
     inline ContextPrivate(Application *_app, Engine *_ngine, Dispatcher *_dispatcher, const QVector<Plugin *> &_plugins)
         : plugins(_plugins)
         , app(_app)
         , engine(_ngine)
         , dispatcher(_dispatcher)
-    { }
+    {
+        // every layer of a request touches the stash, size the bucket
+        // table for the common case once instead of rehashing as the
+        // first entries trickle in
+        stash.reserve(8);
+    }
 
     QString statsStartExecute(Component *code);
     void statsFinishExecute(const QString &statsInfo);
+    void schedulePostResponseJobs();
 
     QStringList error;
     QVariantHash stash;
+    // registered slot storage, grown on first write per request
+    std::vector<QVariant> stashSlots;
     QLocale locale;
     QStack<Component *> stack;
     QVector<Plugin *> plugins;
@@ -62,6 +76,12 @@ public:
     Action *action = nullptr;
     View *view = nullptr;
     Stats *stats = nullptr;
+    std::vector<std::function<void()> > postResponseJobs;
+    // absolute request deadline in Engine::time() microseconds, 0 is
+    // unbounded; see Context::setDeadline()
+    quint64 deadline = 0;
+    int asyncDetached = 0;
+    bool asyncFinalize = false;
     bool detached = false;
     bool state = false;
 };
@@ -23,11 +23,113 @@
 #include "action.h"
 #include "common.h"
 
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
 #include <QMetaClassInfo>
+#include <QMutex>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
 
 using namespace Cutelyst;
 
+// Every worker thread registers the same controller classes, and the
+// parsed attributes only depend on the static meta object (the path
+// prefix is derived from it as well), so share them process wide
+// instead of re-parsing the class info strings once per thread
+static QMutex attributesCacheMutex;
+static QHash<QByteArray, QMap<QString, QString> > attributesCache;
+static bool attributesCacheLoaded = false;
+static bool attributesCacheDirty = false;
+
+// versioned header so a cache written by another build or an older
+// format is silently discarded
+#define ATTRIBUTES_CACHE_MAGIC quint32(0x43544443) // "CTDC"
+#define ATTRIBUTES_CACHE_VERSION quint32(1)
+
+static QString attributesCachePath()
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (dir.isEmpty()) {
+        return QString();
+    }
+    return dir + QLatin1String("/dispatch-attributes.cache");
+}
+
+static QByteArray applicationBuildId()
+{
+    // mtime and size of the binary stand in for a build id, deploying
+    // a different build invalidates the cache
+    const QFileInfo app(QCoreApplication::applicationFilePath());
+    return QByteArray::number(app.lastModified().toMSecsSinceEpoch())
+            + '-' + QByteArray::number(app.size());
+}
+
+void ControllerPrivate::loadActionAttributesCache()
+{
+    QMutexLocker locker(&attributesCacheMutex);
+    if (attributesCacheLoaded) {
+        return;
+    }
+    attributesCacheLoaded = true;
+
+    const QString path = attributesCachePath();
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        return;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray buildId;
+    in >> magic >> version >> buildId;
+    if (magic != ATTRIBUTES_CACHE_MAGIC ||
+            version != ATTRIBUTES_CACHE_VERSION ||
+            buildId != applicationBuildId()) {
+        return;
+    }
+
+    in >> attributesCache;
+    if (in.status() != QDataStream::Ok) {
+        attributesCache.clear();
+    }
+}
+
+void ControllerPrivate::saveActionAttributesCache()
+{
+    QMutexLocker locker(&attributesCacheMutex);
+    if (!attributesCacheDirty) {
+        return;
+    }
+    attributesCacheDirty = false;
+
+    const QString path = attributesCachePath();
+    if (path.isEmpty()) {
+        return;
+    }
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << ATTRIBUTES_CACHE_MAGIC << ATTRIBUTES_CACHE_VERSION << applicationBuildId();
+    out << attributesCache;
+    file.commit();
+}
+
 Controller::Controller(QObject *parent) : QObject(parent)
   , d_ptr(new ControllerPrivate(this))
 {
@@ -233,6 +335,16 @@ Action *ControllerPrivate::createAction(const QVariantHash &args, const QMetaMet
 
 void ControllerPrivate::registerActionMethods(const QMetaObject *meta, Controller *controller, Application *app)
 {
+    // Collect the class info attributes once per metaobject instead
+    // of rescanning the whole list for every method; moc emits one
+    // entry per C_ATTR, so this is the method name -> attribute
+    // string mapping the loop below consumes
+    QHash<QByteArray, QByteArray> attributeArrays;
+    for (int i = meta->classInfoCount() - 1; i >= 0; --i) {
+        QMetaClassInfo classInfo = meta->classInfo(i);
+        attributeArrays[QByteArray(classInfo.name())].append(classInfo.value());
+    }
+
     // Setup actions
     for (int i = 0; i < meta->methodCount(); ++i) {
         const QMetaMethod method = meta->method(i);
@@ -245,15 +357,25 @@ void ControllerPrivate::registerActionMethods(const QMetaObject *meta, Controlle
                 (method.methodType() == QMetaMethod::Method || method.methodType() == QMetaMethod::Slot) &&
                 (method.parameterCount() && method.parameterType(0) == qMetaTypeId<Cutelyst::Context *>())) {
 
-            // Build up the list of attributes for the class info
-            QByteArray attributeArray;
-            for (int i = meta->classInfoCount() - 1; i >= 0; --i) {
-                QMetaClassInfo classInfo = meta->classInfo(i);
-                if (name == classInfo.name()) {
-                    attributeArray.append(classInfo.value());
+            const QByteArray attributeArray = attributeArrays.value(name);
+            // the full signature, overloads parse to different Args counts
+            const QByteArray cacheKey = QByteArray(meta->className()) + "::" + method.methodSignature();
+            QMap<QString, QString> attrs;
+            bool cacheHit = false;
+            {
+                QMutexLocker locker(&attributesCacheMutex);
+                auto cacheIt = attributesCache.constFind(cacheKey);
+                if (cacheIt != attributesCache.constEnd()) {
+                    attrs = cacheIt.value();
+                    cacheHit = true;
                 }
             }
-            QMap<QString, QString> attrs = parseAttributes(method, attributeArray, name);
+            if (!cacheHit) {
+                attrs = parseAttributes(method, attributeArray, name);
+                QMutexLocker locker(&attributesCacheMutex);
+                attributesCache.insert(cacheKey, attrs);
+                attributesCacheDirty = true;
+            }
 
             QString reverse;
             if (controller->ns().isEmpty()) {
@@ -45,6 +45,11 @@ public:
     QObject *instantiateClass(const QByteArray &name, const QByteArray &super);
     bool superIsClassName(const QMetaObject *super, const QByteArray &className);
 
+    // Persisted cache of the parsed action attributes, validated
+    // against the application binary so restarts skip the parsing
+    static void loadActionAttributesCache();
+    static void saveActionAttributesCache();
+
     QString pathPrefix;
     ActionList beginAutoList;
     Action *end = nullptr;
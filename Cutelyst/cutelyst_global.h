@@ -34,6 +34,11 @@
 #else
 #  define CUTELYST_PLUGIN_SESSION_EXPORT Q_DECL_IMPORT
 #endif
+#if defined(cutelyst_qt5_plugin_cache_EXPORTS)
+#  define CUTELYST_PLUGIN_CACHE_EXPORT Q_DECL_EXPORT
+#else
+#  define CUTELYST_PLUGIN_CACHE_EXPORT Q_DECL_IMPORT
+#endif
 #if defined(cutelyst_qt5_plugin_staticsimple_EXPORTS)
 #  define CUTELYST_PLUGIN_STATICSIMPLE_EXPORT Q_DECL_EXPORT
 #else
@@ -23,6 +23,7 @@
 #include "application.h"
 #include "engine.h"
 #include "context.h"
+#include "response.h"
 #include "controller.h"
 #include "controller_p.h"
 #include "action.h"
@@ -30,6 +31,7 @@
 #include "dispatchtypepath.h"
 #include "dispatchtypechained.h"
 #include "utils.h"
+#include "probes_p.h"
 
 #include <QUrl>
 #include <QMetaMethod>
@@ -79,6 +81,7 @@ void Dispatcher::setupActions(const QVector<Controller*> &controllers, const QVe
             // as private actions anyway
             if (registered) {
                 d->actions.insert(action->ns() + QLatin1Char('/') + action->name(), action);
+                d->actionsNs[action->ns()].insert(action->name(), action);
                 d->actionContainer[action->ns()] << action;
                 registeredActions.append(action);
                 instanceUsed = true;
@@ -121,8 +124,24 @@ void Dispatcher::setupActions(const QVector<Controller*> &controllers, const QVe
 
 bool Dispatcher::dispatch(Context *c)
 {
+    CUTELYST_PROBE1(dispatcher_dispatch, c);
+
     Action *action = c->action();
     if (action) {
+        if (!c->deadline()) {
+            const QString timeout = action->attributes().value(QLatin1String("Timeout"));
+            if (!timeout.isEmpty()) {
+                c->setDeadline(timeout.toLongLong());
+            }
+        }
+
+        // a request that spent its whole budget queued is answered
+        // without occupying the worker for its action as well
+        if (c->deadline() && Engine::time() > c->deadline()) {
+            c->response()->setStatus(Response::ServiceUnavailable);
+            return false;
+        }
+
         return action->controller()->_DISPATCH(c);
     } else {
         const QString path = c->req()->path();
@@ -180,6 +199,25 @@ void DispatcherPrivate::prepareAction(Context *c, const QString &requestPath) co
     QString path = normalizePath(requestPath);
     QStringList args;
 
+    // With only lazy dispatch types registered the peeled arguments
+    // are recorded as ranges into the path buffer and null
+    // placeholders keep the match() API fed with the right count; a
+    // foreign dispatch type may read the argument strings during
+    // match, so its presence keeps the eager decoded list
+    RequestPrivate *rd = c->request()->d_ptr;
+    bool lazy = true;
+    for (DispatchType *type : dispatchers) {
+        if (!type->lazyArguments()) {
+            lazy = false;
+            break;
+        }
+    }
+    if (lazy) {
+        rd->argsBuffer = path;
+        rd->argsLazy = true;
+    }
+    int peeled = 0;
+
     //  "foo/bar"
     //  "foo/" skip
     //  "foo"
@@ -200,8 +238,25 @@ void DispatcherPrivate::prepareAction(Context *c, const QString &requestPath) co
 
         int pos = path.lastIndexOf(QLatin1Char('/'));
 
-        QString arg = path.mid(pos + 1);
-        args.prepend(Utils::decodePercentEncoding(&arg));
+        if (lazy && peeled < RequestPrivate::MaxArgRanges) {
+            rd->argRanges[peeled] = { pos + 1, path.size() - pos - 1 };
+            ++peeled;
+            args.prepend(QString());
+        } else {
+            if (lazy) {
+                // out of inline slots, decode what was recorded and
+                // continue with the eager list
+                lazy = false;
+                rd->argsLazy = false;
+                for (int i = 0; i < peeled; ++i) {
+                    QString arg = rd->argsBuffer.mid(rd->argRanges[i].start, rd->argRanges[i].length);
+                    args[peeled - 1 - i] = Utils::decodePercentEncoding(&arg);
+                }
+            }
+
+            QString arg = path.mid(pos + 1);
+            args.prepend(Utils::decodePercentEncoding(&arg));
+        }
 
         path.resize(pos);
     }
@@ -215,12 +270,17 @@ Action *Dispatcher::getAction(const QString &name, const QString &nameSpace) con
         return 0;
     }
 
+    // the namespace-partitioned table answers from the two halves
+    // directly; cleanNamespace() only detaches its copy when the
+    // namespace actually carries redundant slashes
     if (nameSpace.isEmpty()) {
-        return d->actions.value(QLatin1Char('/') + name);
+        const auto it = d->actionsNs.constFind(QString());
+        return it != d->actionsNs.constEnd() ? it->value(name) : nullptr;
     }
 
     const QString ns = DispatcherPrivate::cleanNamespace(nameSpace);
-    return d->actions.value(ns + QLatin1Char('/') + name);
+    const auto it = d->actionsNs.constFind(ns);
+    return it != d->actionsNs.constEnd() ? it->value(name) : nullptr;
 }
 
 Action *Dispatcher::getActionByPath(const QString &path) const
@@ -321,26 +381,7 @@ QString DispatcherPrivate::cleanNamespace(const QString &ns)
 
 QString DispatcherPrivate::normalizePath(const QString &path)
 {
-    QString ret = path;
-    bool lastSlash = true;
-    int i = 0;
-    while (i < ret.size()) {
-        if (ret.at(i) == QLatin1Char('/')) {
-            if (lastSlash) {
-                ret.remove(i, 1);
-                continue;
-            }
-            lastSlash = true;
-        } else {
-            lastSlash = false;
-        }
-        ++i;
-    }
-
-    if (ret.endsWith(QLatin1Char('/'))) {
-        ret.resize(ret.size() - 1);
-    }
-    return ret;
+    return Utils::normalizePath(path);
 }
 
 void DispatcherPrivate::printActions() const
@@ -22,6 +22,8 @@
 
 #include "dispatcher.h"
 
+#include <QtCore/QHash>
+
 namespace Cutelyst {
 
 class DispatcherPrivate
@@ -41,8 +43,12 @@ public:
     static inline QString cleanNamespace(const QString &ns);
     static inline QString normalizePath(const QString &path);
 
-    QMap<QString, Action*> actions;
-    QMap<QString, ActionList> actionContainer;
+    QHash<QString, Action*> actions;
+    // same actions partitioned by namespace then name, so looking
+    // one up from its two halves - forward() by name, actionFor() -
+    // never assembles a "ns/name" key first
+    QHash<QString, QHash<QString, Action*> > actionsNs;
+    QHash<QString, ActionList> actionContainer;
     ActionList rootActions;
     QMap<QString, Controller *> controllers;
     QVector<DispatchType*> dispatchers;
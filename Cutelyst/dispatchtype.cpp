@@ -20,6 +20,7 @@
 #include "dispatchtype.h"
 
 #include "context_p.h"
+#include "request_p.h"
 
 using namespace Cutelyst;
 
@@ -57,9 +58,28 @@ bool DispatchType::isLowPrecedence() const
     return false;
 }
 
+bool DispatchType::lazyArguments() const
+{
+    return false;
+}
+
 void DispatchType::setupMatchedAction(Context *c, Action *action) const
 {
     c->d_ptr->action = action;
 }
 
+void DispatchType::setMatchedArguments(Context *c, const QStringList &args) const
+{
+    RequestPrivate *rd = c->request()->d_ptr;
+    if (rd->argsLazy) {
+        // commit the first peeled ranges, the strings are built when
+        // the arguments are read
+        rd->argRangesSize = args.size();
+        rd->args.clear();
+    } else {
+        rd->args = args;
+        rd->argRangesSize = -1;
+    }
+}
+
 #include "moc_dispatchtype.cpp"
@@ -95,6 +95,16 @@ public:
      */
     virtual bool isLowPrecedence() const;
 
+    /**
+     * Returns true when this dispatch type only inspects the number
+     * of arguments passed to match() and stores the matched ones
+     * through setMatchedArguments(), which allows the dispatcher to
+     * peel path arguments as ranges and decode them only when they
+     * are read. The default is false; the dispatcher then fully
+     * populates the argument strings before calling match().
+     */
+    virtual bool lazyArguments() const;
+
 protected:
     friend class Dispatcher;
     friend class Application;
@@ -103,6 +113,14 @@ protected:
      * Sets the matched action to the Context
      */
     void setupMatchedAction(Context *c, Action *action) const;
+
+    /**
+     * Stores \p args as the request arguments of the match. When the
+     * dispatcher walked the path in lazy mode only their count is
+     * kept, the strings stay as ranges into the path buffer until
+     * Request::arguments() materializes them.
+     */
+    void setMatchedArguments(Context *c, const QStringList &args) const;
 };
 
 }
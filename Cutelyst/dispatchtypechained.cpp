@@ -171,23 +171,34 @@ DispatchType::MatchType DispatchTypeChained::match(Context *c, const QString &pa
 
     Q_D(const DispatchTypeChained);
 
-    const BestActionMatch ret = d->recurseMatch(args.size(), QStringLiteral("/"), path.split(QLatin1Char('/')));
+    const QStringList pathParts = path.split(QLatin1Char('/'));
+    const BestActionMatch ret = d->recurseMatch(args.size(), QStringLiteral("/"), pathParts, 0);
     const ActionList chain = ret.actions;
     if (ret.isNull || chain.isEmpty()) {
         return NoMatch;
     }
 
     QStringList decodedArgs;
-    const QStringList parts = ret.parts;
-    for (const QString &arg : parts) {
-        QString aux = arg;
+    decodedArgs.reserve(pathParts.size() - ret.argsOffset);
+    for (int i = ret.argsOffset; i < pathParts.size(); ++i) {
+        QString aux = pathParts.at(i);
         decodedArgs.append(Utils::decodePercentEncoding(&aux));
     }
 
+    // Only the winning chain gets its captures materialized, the
+    // candidates discarded during the walk never build a list
+    QStringList captures;
+    captures.reserve(ret.captureCount);
+    for (const auto &range : ret.captureRanges) {
+        for (int i = 0; i < range.second; ++i) {
+            captures.append(pathParts.at(range.first + i));
+        }
+    }
+
     ActionChain *action = new ActionChain(chain, c);
     Request *request = c->request();
     request->setArguments(decodedArgs);
-    request->setCaptures(ret.captures);
+    request->setCaptures(captures);
     request->setMatch(QLatin1Char('/') + action->reverse());
     setupMatchedAction(c, action);
 
@@ -261,6 +272,9 @@ bool DispatchTypeChained::registerAction(Action *action)
         d->endPoints.push_back(action);
     }
 
+    // New actions invalidate the precomputed match tables
+    d->matchTablesReady = false;
+
     return true;
 }
 
@@ -269,6 +283,37 @@ QString DispatchTypeChained::uriForAction(Action *action, const QStringList &cap
     Q_D(const DispatchTypeChained);
 
     QString ret;
+    if (d->matchTablesReady) {
+        // Assemble from the precomputed template in one pass, the
+        // chain walk below stays as the fallback and keeps its
+        // detailed warnings for broken chains and capture counts.
+        const auto it = d->uriTemplates.constFind(action);
+        if (it != d->uriTemplates.constEnd() && it->numberOfCaptures == captures.size()) {
+            int size = 1;
+            for (const auto &run : it->runs) {
+                size += run.first.size();
+            }
+            for (const QString &capture : captures) {
+                size += capture.size() + 1;
+            }
+            ret.reserve(size);
+
+            int capture = 0;
+            for (const auto &run : it->runs) {
+                ret += run.first;
+                for (int i = 0; i < run.second; ++i) {
+                    ret += QLatin1Char('/');
+                    ret += captures.at(capture++);
+                }
+            }
+
+            if (ret.isEmpty()) {
+                ret = QStringLiteral("/");
+            }
+            return ret;
+        }
+    }
+
     const QMap<QString, QString> attributes = action->attributes();
     if (!(attributes.contains(QStringLiteral("Chained")) &&
             !attributes.contains(QStringLiteral("CaptureArgs")))) {
@@ -346,18 +391,128 @@ Action *DispatchTypeChained::expandAction(Context *c, Action *action) const
 
 bool DispatchTypeChained::inUse()
 {
-    Q_D(const DispatchTypeChained);
+    Q_D(DispatchTypeChained);
 
     if (d->actions.isEmpty()) {
         return false;
     }
 
     // Optimize end points
+    d->prepareMatchTables();
 
     return true;
 }
 
-BestActionMatch DispatchTypeChainedPrivate::recurseMatch(int reqArgsSize, const QString &parent, const QStringList &pathParts) const
+bool DispatchTypeChained::lazyArguments() const
+{
+    return true;
+}
+
+void DispatchTypeChainedPrivate::prepareMatchTables()
+{
+    if (matchTablesReady) {
+        return;
+    }
+    matchTablesReady = true;
+
+    // Sort the children keys of each parent once, recurseMatch()
+    // used to rebuild and sort this list on every visit.
+    childrenKeys.clear();
+    childrenKeys.reserve(childrenOf.size());
+    auto it = childrenOf.constBegin();
+    while (it != childrenOf.constEnd()) {
+        QStringList keys = it.value().keys();
+        std::sort(keys.begin(), keys.end(), [](const QString &a, const QString &b) -> bool {
+            // action2 then action1 to try the longest part first
+            return b.size() < a.size();
+        });
+        childrenKeys.insert(it.key(), keys);
+        ++it;
+    }
+
+    // Resolve the attributes recurseMatch() needs per visited action
+    actionInfo.clear();
+    actionInfo.reserve(actions.size());
+    auto actionIt = actions.constBegin();
+    while (actionIt != actions.constEnd()) {
+        const Action *action = actionIt.value();
+        const QMap<QString, QString> attributes = action->attributes();
+        ChainedActionInfo info;
+        info.pathParts = attributes.value(QStringLiteral("PathPart")).count(QLatin1Char('/')) + 1;
+        info.hasCaptureArgs = attributes.contains(QStringLiteral("CaptureArgs"));
+        info.hasArgsAttr = !attributes.value(QStringLiteral("Args")).isEmpty();
+        actionInfo.insert(action, info);
+        ++actionIt;
+    }
+
+    // Precompute the reverse-route template of each end point, so
+    // uriForAction() does not walk the chain and query the attribute
+    // maps again on every call.
+    uriTemplates.clear();
+    uriTemplates.reserve(static_cast<int>(endPoints.size()));
+    for (Action *endPoint : endPoints) {
+        // leaf to root, the fixed PathPart of each link and the
+        // number of captures the link consumes
+        std::vector<std::pair<QString, int> > links;
+        QString parent;
+        Action *curr = endPoint;
+        int numberOfCaptures = 0;
+        while (curr) {
+            const QMap<QString, QString> attributes = curr->attributes();
+            int caps = 0;
+            if (attributes.contains(QStringLiteral("CaptureArgs"))) {
+                caps = curr->numberOfCaptures();
+                numberOfCaptures += caps;
+            }
+            links.push_back({ attributes.value(QStringLiteral("PathPart")), caps });
+            parent = attributes.value(QStringLiteral("Chained"));
+            curr = actions.value(parent);
+        }
+
+        if (parent != QLatin1String("/")) {
+            // dangling chain, let uriForAction() warn about it
+            continue;
+        }
+
+        UriForTemplate t;
+        t.numberOfCaptures = numberOfCaptures;
+        QString run;
+        for (auto i = links.rbegin(); i != links.rend(); ++i) {
+            if (!i->first.isEmpty()) {
+                run += QLatin1Char('/') + i->first;
+            }
+            if (i->second) {
+                t.runs.push_back({ run, i->second });
+                run.clear();
+            }
+        }
+        if (!run.isEmpty() || t.runs.empty()) {
+            t.runs.push_back({ run, 0 });
+        }
+        uriTemplates.insert(endPoint, t);
+    }
+}
+
+// Compares tryPart against count consecutive path parts as if they
+// were joined by '/', without materializing the joined string. The
+// parts come from a split so they cannot contain a slash themselves.
+static bool partsEqual(const QString &tryPart, const QStringList &pathParts, int offset, int count)
+{
+    int pos = 0;
+    for (int i = 0; i < count; ++i) {
+        if (i != 0) {
+            ++pos; // the '/' separator consumed by the split
+        }
+        const QString &part = pathParts.at(offset + i);
+        if (tryPart.midRef(pos, part.size()) != part) {
+            return false;
+        }
+        pos += part.size();
+    }
+    return pos == tryPart.size();
+}
+
+BestActionMatch DispatchTypeChainedPrivate::recurseMatch(int reqArgsSize, const QString &parent, const QStringList &pathParts, int offset) const
 {
     BestActionMatch bestAction;
     auto it = childrenOf.constFind(parent);
@@ -366,77 +521,70 @@ BestActionMatch DispatchTypeChainedPrivate::recurseMatch(int reqArgsSize, const
     }
 
     const StringActionsMap children = it.value();
-    QStringList keys = children.keys();
-    std::sort(keys.begin(), keys.end(), [](const QString &a, const QString &b) -> bool {
-        // action2 then action1 to try the longest part first
-        return b.size() < a.size();
-    });
+    const QStringList keys = childrenKeys.value(parent);
 
     for (const QString &tryPart : keys) {
-        QStringList parts = pathParts;
+        int partsOffset = offset;
         if (!tryPart.isEmpty()) {
             // We want to count the number of parts a split would give
-            // and remove the number of parts from tryPart
-            int tryPartCount = tryPart.count(QLatin1Char('/')) + 1;
-            const QStringList possiblePart = parts.mid(0, tryPartCount);
-            if (tryPart != possiblePart.join(QLatin1Char('/'))) {
+            // and consume that number of parts for tryPart
+            const int tryPartCount = tryPart.count(QLatin1Char('/')) + 1;
+            if (pathParts.size() - offset < tryPartCount ||
+                    !partsEqual(tryPart, pathParts, offset, tryPartCount)) {
                 continue;
             }
-            parts = parts.mid(tryPartCount);
+            partsOffset += tryPartCount;
         }
 
+        const int partsLeft = pathParts.size() - partsOffset;
+
         const Actions tryActions = children.value(tryPart);
         for (Action *action : tryActions) {
-            const QMap<QString, QString> attributes = action->attributes();
-            if (attributes.contains(QStringLiteral("CaptureArgs"))) {
+            const ChainedActionInfo info = actionInfo.value(action);
+            if (info.hasCaptureArgs) {
                 const int captureCount = action->numberOfCaptures();
                 // Short-circuit if not enough remaining parts
-                if (parts.size() < captureCount) {
+                if (partsLeft < captureCount) {
                     continue;
                 }
 
-                // strip CaptureArgs into list
-                const QStringList captures = parts.mid(0, captureCount);
-
                 // check if the action may fit, depending on a given test by the app
-                if (!action->matchCaptures(captures.size())) {
+                if (!action->matchCaptures(captureCount)) {
                     continue;
                 }
 
-                const QStringList localParts = parts.mid(captureCount);
-
                 // try the remaining parts against children of this action
-                const BestActionMatch ret = recurseMatch(reqArgsSize, QLatin1Char('/') + action->reverse(), localParts);
+                const BestActionMatch ret = recurseMatch(reqArgsSize, QLatin1Char('/') + action->reverse(), pathParts, partsOffset + captureCount);
 
                 //    No best action currently
                 // OR The action has less parts
                 // OR The action has equal parts but less captured data (ergo more defined)
                 ActionList actions = ret.actions;
-                const QStringList actionCaptures = ret.captures;
-                const QStringList actionParts = ret.parts;
-                int bestActionParts = bestAction.parts.size();
+                const int bestActionArgsOffset = bestAction.argsOffset;
 
                 if (!actions.isEmpty() &&
                         (bestAction.isNull ||
-                         actionParts.size() < bestActionParts ||
-                         (actionParts.size() == bestActionParts &&
-                          actionCaptures.size() < bestAction.captures.size() &&
+                         ret.argsOffset > bestActionArgsOffset ||
+                         (ret.argsOffset == bestActionArgsOffset &&
+                          captureCount + ret.captureCount < bestAction.captureCount &&
                           ret.n_pathParts > bestAction.n_pathParts))) {
                     actions.prepend(action);
-                    int pathparts = attributes.value(QStringLiteral("PathPart")).count(QLatin1Char('/')) + 1;
                     bestAction.actions = actions;
-                    bestAction.captures = captures + actionCaptures;
-                    bestAction.parts = actionParts;
-                    bestAction.n_pathParts = pathparts + ret.n_pathParts;
+                    // this link's captures followed by the ones of the
+                    // rest of the chain
+                    bestAction.captureRanges = ret.captureRanges;
+                    bestAction.captureRanges.insert(bestAction.captureRanges.begin(),
+                                                    { partsOffset, captureCount });
+                    bestAction.captureCount = captureCount + ret.captureCount;
+                    bestAction.argsOffset = ret.argsOffset;
+                    bestAction.n_pathParts = info.pathParts + ret.n_pathParts;
                     bestAction.isNull = false;
                 }
             } else {
-                if (!action->match(reqArgsSize + parts.size())) {
+                if (!action->match(reqArgsSize + partsLeft)) {
                     continue;
                 }
 
-                const QString argsAttr = attributes.value(QStringLiteral("Args"));
-                const int pathparts = attributes.value(QStringLiteral("PathPart")).count(QLatin1Char('/')) + 1;
                 //    No best action currently
                 // OR This one matches with fewer parts left than the current best action,
                 //    And therefore is a better match
@@ -445,12 +593,13 @@ BestActionMatch DispatchTypeChainedPrivate::recurseMatch(int reqArgsSize, const
                 //    but we couldn't chose between then anyway so we'll take the last seen
 
                 if (bestAction.isNull ||
-                        parts.size() < bestAction.parts.size() ||
-                        (parts.isEmpty() && !argsAttr.isEmpty() && action->numberOfArgs() == 0)) {
+                        partsOffset > bestAction.argsOffset ||
+                        (partsLeft == 0 && info.hasArgsAttr && action->numberOfArgs() == 0)) {
                     bestAction.actions = { action };
-                    bestAction.captures = QStringList();
-                    bestAction.parts = parts;
-                    bestAction.n_pathParts = pathparts;
+                    bestAction.captureRanges.clear();
+                    bestAction.captureCount = 0;
+                    bestAction.argsOffset = partsOffset;
+                    bestAction.n_pathParts = info.pathParts;
                     bestAction.isNull = false;
                 }
             }
@@ -41,6 +41,12 @@ public:
 
     virtual MatchType match(Context *c, const QString &path, const QStringList &args) const override;
 
+    /**
+     * Chained only matches when no arguments were peeled yet and
+     * decodes its own, the dispatcher may pass lazy arguments
+     */
+    virtual bool lazyArguments() const override;
+
     virtual bool registerAction(Action *action) override;
 
     virtual QString uriForAction(Action *action, const QStringList &captures) const override;
@@ -31,23 +31,56 @@ typedef QHash<QString, StringActionsMap> StringStringActionsMap;
 
 struct BestActionMatch {
     ActionList actions;
-    QStringList captures;
-    QStringList parts;
+    // capture spans into the split request path: offset of the first
+    // captured part and how many parts the link consumes; only the
+    // winning chain materializes them into strings
+    std::vector<std::pair<int, int> > captureRanges;
+    int captureCount = 0;
+    // offset of the first path part left over as arguments
+    int argsOffset = 0;
     int n_pathParts = 0;
     bool isNull = true;
 };
 
+/**
+ * Attribute data needed on every match, resolved once in
+ * prepareMatchTables() so recurseMatch() does not have to
+ * query the attributes QMap per request.
+ */
+struct ChainedActionInfo {
+    int pathParts = 1;
+    bool hasCaptureArgs = false;
+    bool hasArgsAttr = false;
+};
+
+/**
+ * Reverse-route template of one end point, resolved once in
+ * prepareMatchTables(). The fixed path text is pre-joined into
+ * runs so uriForAction() only splices the captures in between.
+ */
+struct UriForTemplate {
+    // fixed text (with leading slashes) followed by the number
+    // of captures spliced in right after it
+    std::vector<std::pair<QString, int> > runs;
+    int numberOfCaptures = 0;
+};
+
 class DispatchTypeChainedPrivate
 {
 public:
-    BestActionMatch recurseMatch(int reqArgsSize, const QString &parent, const QStringList &pathParts) const;
+    BestActionMatch recurseMatch(int reqArgsSize, const QString &parent, const QStringList &pathParts, int offset) const;
     bool checkArgsAttr(Action *action, const QString &name) const;
+    void prepareMatchTables();
     static QString listExtraHttpMethods(Action *action);
     static QString listExtraConsumes(Action *action);
 
     Actions endPoints;
     StringActionMap actions;
     StringStringActionsMap childrenOf;
+    QHash<QString, QStringList> childrenKeys;
+    QHash<const Action *, ChainedActionInfo> actionInfo;
+    QHash<const Action *, UriForTemplate> uriTemplates;
+    bool matchTablesReady = false;
 };
 
 }
@@ -39,6 +39,19 @@ DispatchTypePath::~DispatchTypePath()
     delete d_ptr;
 }
 
+static void collectPaths(const PathNode *node, const QString &prefix, StringActionsMap &paths)
+{
+    if (!node->actions.empty()) {
+        paths.insert(prefix.isEmpty() ? QStringLiteral("/") : prefix, node->actions);
+    }
+
+    for (const auto &child : node->children) {
+        collectPaths(child.second,
+                     prefix.isEmpty() ? child.first : prefix + QLatin1Char('/') + child.first,
+                     paths);
+    }
+}
+
 QByteArray DispatchTypePath::list() const
 {
     Q_D(const DispatchTypePath);
@@ -47,10 +60,13 @@ QByteArray DispatchTypePath::list() const
 
     QVector<QStringList> table;
 
-    QStringList keys = d->paths.keys();
+    StringActionsMap pathsMap;
+    collectPaths(&d->root, QString(), pathsMap);
+
+    QStringList keys = pathsMap.keys();
     keys.sort(Qt::CaseInsensitive);
     for (const QString &path : keys) {
-        const auto paths = d->paths.value(path);
+        const auto paths = pathsMap.value(path);
         for (Action *action : paths) {
             QString _path = QLatin1Char('/') + path;
             if (action->attribute(QLatin1String("Args")).isEmpty()) {
@@ -84,30 +100,41 @@ Cutelyst::DispatchType::MatchType DispatchTypePath::match(Context *c, const QStr
         _path = QStringLiteral("/");
     }
 
-    const auto it = d->paths.constFind(_path);
-    if (it == d->paths.constEnd()) {
+    // Walk the path index segment by segment, a miss on
+    // the first segment is much cheaper than hashing the
+    // whole candidate path the dispatcher probes with.
+    const PathNode *node = &d->root;
+    if (_path != QLatin1String("/")) {
+        const auto segments = _path.splitRef(QLatin1Char('/'));
+        for (const QStringRef &segment : segments) {
+            node = node->find(segment);
+            if (!node) {
+                return NoMatch;
+            }
+        }
+    }
+
+    if (node->actions.empty()) {
         return NoMatch;
     }
 
     MatchType ret = NoMatch;
     int numberOfArgs = args.size();
-    for (Action *action : it.value()) {
+    for (Action *action : node->actions) {
         // If the number of args is -1 (not defined)
         // it will slurp all args so we don't care
         // about how many args was passed
         if (action->numberOfArgs() == numberOfArgs) {
-            Request *request = c->request();
-            request->setArguments(args);
-            request->setMatch(_path);
+            setMatchedArguments(c, args);
+            c->request()->setMatch(_path);
             setupMatchedAction(c, action);
             return ExactMatch;
         } else if (action->numberOfArgs() == -1 &&
                    !c->action()) {
             // Only setup partial matches if no action is
             // currently set
-            Request *request = c->request();
-            request->setArguments(args);
-            request->setMatch(_path);
+            setMatchedArguments(c, args);
+            c->request()->setMatch(_path);
             setupMatchedAction(c, action);
             ret = PartialMatch;
         }
@@ -135,7 +162,12 @@ bool DispatchTypePath::registerAction(Action *action)
 bool DispatchTypePath::inUse()
 {
     Q_D(const DispatchTypePath);
-    return !d->paths.isEmpty();
+    return !d->root.children.empty() || !d->root.actions.empty();
+}
+
+bool DispatchTypePath::lazyArguments() const
+{
+    return true;
 }
 
 QString DispatchTypePath::uriForAction(Cutelyst::Action *action, const QStringList &captures) const
@@ -168,28 +200,31 @@ bool DispatchTypePathPrivate::registerPath(const QString &path, Action *action)
         _path = QStringLiteral("/");
     }
 
-    auto it = paths.find(_path);
-    if (it != paths.end()) {
-        int actionNumberOfArgs = action->numberOfArgs();
-        for (const Action *regAction : it.value()) {
-            if (regAction->numberOfArgs() == actionNumberOfArgs) {
-                qCCritical(CUTELYST_DISPATCHER) << "Not registering Action"
-                                                << action->name()
-                                                << "of controller"
-                                                << action->controller()->objectName()
-                                                << "because it conflicts with "
-                                                << regAction->name();
-                return false;
-            }
+    PathNode *node = &root;
+    if (_path != QLatin1String("/")) {
+        const auto segments = _path.splitRef(QLatin1Char('/'));
+        for (const QStringRef &segment : segments) {
+            node = node->findOrCreate(segment);
         }
+    }
 
-        it.value().push_back(action);
-        std::sort(it.value().begin(), it.value().end(), [](Action *a, Action *b) -> bool {
-            return a->numberOfArgs() < b->numberOfArgs();
-        });
-    } else {
-        paths.insert(_path, { action });
+    int actionNumberOfArgs = action->numberOfArgs();
+    for (const Action *regAction : node->actions) {
+        if (regAction->numberOfArgs() == actionNumberOfArgs) {
+            qCCritical(CUTELYST_DISPATCHER) << "Not registering Action"
+                                            << action->name()
+                                            << "of controller"
+                                            << action->controller()->objectName()
+                                            << "because it conflicts with "
+                                            << regAction->name();
+            return false;
+        }
     }
+
+    node->actions.push_back(action);
+    std::sort(node->actions.begin(), node->actions.end(), [](Action *a, Action *b) -> bool {
+        return a->numberOfArgs() < b->numberOfArgs();
+    });
     return true;
 }
 
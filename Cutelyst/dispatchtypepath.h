@@ -41,6 +41,12 @@ public:
 
     virtual MatchType match(Context *c, const QString &path, const QStringList &args) const override;
 
+    /**
+     * Only the argument count is inspected during match, the
+     * dispatcher may pass lazy arguments
+     */
+    virtual bool lazyArguments() const override;
+
     virtual bool registerAction(Action *action) override;
 
     virtual bool inUse() override;
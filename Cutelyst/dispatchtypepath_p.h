@@ -22,18 +22,57 @@
 
 #include "dispatchtypepath.h"
 #include <vector>
+#include <utility>
 
 namespace Cutelyst {
 
 typedef std::vector<Action *> Actions;
 typedef QHash<QString, Actions> StringActionsMap;
 
+/**
+ * A node of the radix style path index, each child maps
+ * one path segment to the next level. The fan out per level
+ * is small so children are kept in a vector and compared as
+ * QStringRef, which avoids allocating a segment string on
+ * every lookup.
+ */
+struct PathNode {
+    ~PathNode() {
+        for (const auto &child : children) {
+            delete child.second;
+        }
+    }
+
+    inline const PathNode *find(const QStringRef &segment) const {
+        for (const auto &child : children) {
+            if (segment == child.first) {
+                return child.second;
+            }
+        }
+        return nullptr;
+    }
+
+    inline PathNode *findOrCreate(const QStringRef &segment) {
+        for (const auto &child : children) {
+            if (segment == child.first) {
+                return child.second;
+            }
+        }
+        auto node = new PathNode;
+        children.push_back({ segment.toString(), node });
+        return node;
+    }
+
+    std::vector<std::pair<QString, PathNode *> > children;
+    Actions actions;
+};
+
 class DispatchTypePathPrivate
 {
 public:
     bool registerPath(const QString &path, Action *action);
 
-    StringActionsMap paths;
+    PathNode root;
 };
 
 }
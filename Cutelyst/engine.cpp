@@ -18,20 +18,28 @@
  */
 
 #include "engine_p.h"
+#include "keys_p.h"
 
 #include "common.h"
 #include "request_p.h"
 #include "application.h"
 #include "response_p.h"
 #include "context_p.h"
+#include "action.h"
+#include "probes_p.h"
 
 #include <QUrl>
 #include <QSettings>
 #include <QDir>
 #include <QThread>
 #include <QByteArray>
+#include <QCryptographicHash>
 #include <QJsonDocument>
 
+#include <cstring>
+#include <cstdio>
+#include <utility>
+
 using namespace Cutelyst;
 
 /*!
@@ -103,8 +111,9 @@ bool Engine::finalizeHeaders(Context *c)
     quint16 status = response->status();
     Headers &headers = response->headers();
 
-    // Fix missing content length
-    if (headers.contentLength() < 0) {
+    // Fix missing content length; a 304 never carries a body so an
+    // artificial zero length would misstate the entity's size
+    if (headers.contentLength() < 0 && status != Response::NotModified) {
         qint64 size = response->size();
         if (size >= 0) {
             headers.setContentLength(size);
@@ -113,6 +122,12 @@ bool Engine::finalizeHeaders(Context *c)
 
     finalizeCookies(c);
 
+    // Echo the correlation id so client and server logs can be
+    // matched; applications that set their own win
+    if (!headers.contains(Keys::X_REQUEST_ID)) {
+        headers.pushRawHeader(QByteArrayLiteral("X_REQUEST_ID"), c->request()->requestId());
+    }
+
     // Done
     response->d_ptr->flags |= ResponsePrivate::FinalizedHeaders;
     return finalizeHeadersWrite(c, status, headers, c->request()->engineData());
@@ -127,10 +142,32 @@ void Engine::finalizeBody(Context *c)
         QIODevice *body = response->bodyDevice();
 
         if (body) {
-            body->seek(0);
+            qint64 rangeStart = 0;
+            qint64 remaining = -1;
+            if (response->status() == Response::PartialContent) {
+                // serve the window promised by the Content-Range header
+                // the static file plugins set on the response
+                const QString contentRange = response->headers().header(Keys::CONTENT_RANGE);
+                if (contentRange.startsWith(QLatin1String("bytes "))) {
+                    const int dash = contentRange.indexOf(QLatin1Char('-'), 6);
+                    const int slash = contentRange.indexOf(QLatin1Char('/'), dash);
+                    if (dash != -1 && slash != -1) {
+                        rangeStart = contentRange.mid(6, dash - 6).toLongLong();
+                        const qint64 rangeEnd = contentRange.mid(dash + 1, slash - dash - 1).toLongLong();
+                        remaining = rangeEnd - rangeStart + 1;
+                    }
+                }
+            }
+
+            body->seek(rangeStart);
             char block[64 * 1024];
-            while (!body->atEnd()) {
-                qint64 in = body->read(block, sizeof(block));
+            while (!body->atEnd() && remaining != 0) {
+                qint64 maxRead = static_cast<qint64>(sizeof(block));
+                if (remaining > 0) {
+                    maxRead = qMin(maxRead, remaining);
+                }
+
+                qint64 in = body->read(block, maxRead);
                 if (in <= 0) {
                     break;
                 }
@@ -139,14 +176,41 @@ void Engine::finalizeBody(Context *c)
                     qCWarning(CUTELYST_ENGINE) << "Failed to write body";
                     break;
                 }
+
+                if (remaining > 0) {
+                    remaining -= in;
+                }
             }
         } else {
-            const QByteArray bodyByteArray = response->body();
-            write(c, bodyByteArray.constData(), bodyByteArray.size(), engineData);
+            const QByteArray bodyByteArray = response->d_ptr->bodyData;
+            if (!bodyByteArray.isEmpty() || response->d_ptr->bodyChunks.empty()) {
+                write(c, bodyByteArray.constData(), bodyByteArray.size(), engineData);
+            }
+
+            // pieces appended with appendBody() go out as they are,
+            // they are never flattened into a single buffer
+            for (const QByteArray &chunk : response->d_ptr->bodyChunks) {
+                write(c, chunk.constData(), chunk.size(), engineData);
+            }
         }
     } else if (!(response->d_ptr->flags & ResponsePrivate::ChunkedDone)) {
-        // Write the final '0' chunk
-        doWrite(c, "0\r\n\r\n", 5, engineData);
+        const auto &trailers = response->d_ptr->trailers;
+        if (trailers.empty()) {
+            // Write the final '0' chunk
+            doWrite(c, "0\r\n\r\n", 5, engineData);
+        } else {
+            // the final chunk carries the trailer section with the
+            // fields set by Response::setTrailer()
+            QByteArray lastChunk = QByteArrayLiteral("0\r\n");
+            for (const auto &trailer : trailers) {
+                lastChunk.append(trailer.first.toLatin1());
+                lastChunk.append(": ", 2);
+                lastChunk.append(trailer.second.toLatin1());
+                lastChunk.append("\r\n", 2);
+            }
+            lastChunk.append("\r\n", 2);
+            doWrite(c, lastChunk.constData(), lastChunk.size(), engineData);
+        }
     }
 }
 
@@ -162,7 +226,15 @@ void Engine::finalizeError(Context *c)
     // of ours if we'd give it less than 512 bytes.
     body.reserve(512);
 
-    body.append(c->errors().join(QLatin1Char('\n')).toUtf8());
+    // append straight into the reserved buffer instead of going
+    // through an intermediate joined string
+    const QStringList errs = c->errors();
+    for (int i = 0; i < errs.size(); ++i) {
+        if (i) {
+            body.append('\n');
+        }
+        body.append(errs.at(i).toUtf8());
+    }
 
     res->setBody(body);
 
@@ -242,164 +314,132 @@ quint64 Engine::time()
     return QDateTime::currentMSecsSinceEpoch() * 1000;
 }
 
+bool Engine::supportsChunkedResponse(Context *c, void *engineData)
+{
+    Q_UNUSED(c)
+    Q_UNUSED(engineData)
+    return false;
+}
+
 qint64 Engine::write(Context *c, const char *data, qint64 len, void *engineData)
 {
     Response *response = c->response();
     if (!(response->d_ptr->flags & ResponsePrivate::Chunked)) {
         return doWrite(c, data, len, engineData);
     } else if (!(response->d_ptr->flags & ResponsePrivate::ChunkedDone)) {
-        const QByteArray chunkSize = QByteArray::number(len, 16).toUpper();
-        QByteArray chunk;
-        chunk.reserve(len + chunkSize.size() + 4);
-        chunk.append(chunkSize).append("\r\n", 2)
-                .append(data, len).append("\r\n", 2);
+        const QByteArray chunkHeader = QByteArray::number(len, 16).toUpper().append("\r\n", 2);
 
-        qint64 retWrite = doWrite(c, chunk.data(), chunk.size(), engineData);
+        // Scatter-gather IO frames the chunk without copying the
+        // body into a new buffer
+        const QByteArray chunks[3] = {
+            chunkHeader,
+            QByteArray::fromRawData(data, len),
+            QByteArrayLiteral("\r\n")
+        };
+        qint64 retWrite = doWriteV(c, chunks, 3, engineData);
 
         // Flag if we wrote an empty chunk
         if (!len) {
             response->d_ptr->flags |= ResponsePrivate::ChunkedDone;
         }
 
-        return retWrite == chunk.size() ? len : -1;
+        return retWrite == chunkHeader.size() + len + 2 ? len : -1;
     }
     return -1;
 }
 
+qint64 Engine::doWriteV(Context *c, const QByteArray *chunks, int count, void *engineData)
+{
+    qint64 ret = 0;
+    for (int i = 0; i < count; ++i) {
+        const qint64 wrote = doWrite(c, chunks[i].constData(), chunks[i].size(), engineData);
+        if (wrote != chunks[i].size()) {
+            return -1;
+        }
+        ret += wrote;
+    }
+    return ret;
+}
+
 const char *Engine::httpStatusMessage(quint16 status, int *len)
 {
-    const char *ret;
-    switch (status) {
-    case Response::OK:
-        ret = "HTTP/1.1 200 OK";
-        break;
-    case Response::Found:
-        ret = "HTTP/1.1 302 Found";
-        break;
-    case Response::NotFound:
-        ret = "HTTP/1.1 404 Not Found";
-        break;
-    case Response::InternalServerError:
-        ret = "HTTP/1.1 500 Internal Server Error";
-        break;
-    case Response::MovedPermanently:
-        ret = "HTTP/1.1 301 Moved Permanently";
-        break;
-    case Response::NotModified:
-        ret = "HTTP/1.1 304 Not Modified";
-        break;
-    case Response::SeeOther:
-        ret = "HTTP/1.1 303 See Other";
-        break;
-    case Response::Forbidden:
-        ret = "HTTP/1.1 403 Forbidden";
-        break;
-    case Response::TemporaryRedirect:
-        ret = "HTTP/1.1 307 Temporary Redirect";
-        break;
-    case Response::Unauthorized:
-        ret = "HTTP/1.1 401 Unauthorized";
-        break;
-    case Response::BadRequest:
-        ret = "HTTP/1.1 400 Bad Request";
-        break;
-    case Response::MethodNotAllowed:
-        ret = "HTTP/1.1 405 Method Not Allowed";
-        break;
-    case Response::RequestTimeout:
-        ret = "HTTP/1.1 408 Request Timeout";
-        break;
-    case Response::Continue:
-        ret = "HTTP/1.1 100 Continue";
-        break;
-    case Response::SwitchingProtocols:
-        ret = "HTTP/1.1 101 Switching Protocols";
-        break;
-    case Response::Created:
-        ret = "HTTP/1.1 201 Created";
-        break;
-    case Response::Accepted:
-        ret = "HTTP/1.1 202 Accepted";
-        break;
-    case Response::NonAuthoritativeInformation:
-        ret = "HTTP/1.1 203 Non-Authoritative Information";
-        break;
-    case Response::NoContent:
-        ret = "HTTP/1.1 204 No Content";
-        break;
-    case Response::ResetContent:
-        ret = "HTTP/1.1 205 Reset Content";
-        break;
-    case Response::PartialContent:
-        ret = "HTTP/1.1 206 Partial Content";
-        break;
-    case Response::MultipleChoices:
-        ret = "HTTP/1.1 300 Multiple Choices";
-        break;
-    case Response::UseProxy:
-        ret = "HTTP/1.1 305 Use Proxy";
-        break;
-    case Response::PaymentRequired:
-        ret = "HTTP/1.1 402 Payment Required";
-        break;
-    case Response::NotAcceptable:
-        ret = "HTTP/1.1 406 Not Acceptable";
-        break;
-    case Response::ProxyAuthenticationRequired:
-        ret = "HTTP/1.1 407 Proxy Authentication Required";
-        break;
-    case Response::Conflict:
-        ret = "HTTP/1.1 409 Conflict";
-        break;
-    case Response::Gone:
-        ret = "HTTP/1.1 410 Gone";
-        break;
-    case Response::LengthRequired:
-        ret = "HTTP/1.1 411 Length Required";
-        break;
-    case Response::PreconditionFailed:
-        ret = "HTTP/1.1 412 Precondition Failed";
-        break;
-    case Response::RequestEntityTooLarge:
-        ret = "HTTP/1.1 413 Request Entity Too Large";
-        break;
-    case Response::RequestURITooLong:
-        ret = "HTTP/1.1 414 Request-URI Too Long";
-        break;
-    case Response::UnsupportedMediaType:
-        ret = "HTTP/1.1 415 Unsupported Media Type";
-        break;
-    case Response::RequestedRangeNotSatisfiable:
-        ret = "HTTP/1.1 416 Requested Range Not Satisfiable";
-        break;
-    case Response::ExpectationFailed:
-        ret = "HTTP/1.1 417 Expectation Failed";
-        break;
-    case Response::NotImplemented:
-        ret = "HTTP/1.1 501 Not Implemented";
-        break;
-    case Response::BadGateway:
-        ret = "HTTP/1.1 502 Bad Gateway";
-        break;
-    case Response::ServiceUnavailable:
-        ret = "HTTP/1.1 503 Service Unavailable";
-        break;
-    case Response::GatewayTimeout:
-        ret = "HTTP/1.1 504 Gateway Timeout";
-        break;
-    case Response::HTTPVersionNotSupported:
-        ret = "HTTP/1.1 505 HTTP Version Not Supported";
-        break;
-    case Response::BandwidthLimitExceeded:
-        ret = "HTTP/1.1 509 Bandwidth Limit Exceeded";
-        break;
-    default:
-        ret = QByteArrayLiteral("HTTP/1.1 ").append(QByteArray::number(status)).constData();
-        break;
+    // Complete status lines indexed by code, precomputed once so the
+    // per-response cost is an array load and a bounds check instead
+    // of a forty-way switch; this also lets the header-template cache
+    // reference fully static blocks.
+    struct StatusLine {
+        const char *text;
+        int len;
+    };
+    static const struct Table {
+        StatusLine lines[500];
+        Table() {
+            memset(lines, 0, sizeof(lines));
+            set(Response::Continue, "HTTP/1.1 100 Continue");
+            set(Response::SwitchingProtocols, "HTTP/1.1 101 Switching Protocols");
+            set(Response::OK, "HTTP/1.1 200 OK");
+            set(Response::Created, "HTTP/1.1 201 Created");
+            set(Response::Accepted, "HTTP/1.1 202 Accepted");
+            set(Response::NonAuthoritativeInformation, "HTTP/1.1 203 Non-Authoritative Information");
+            set(Response::NoContent, "HTTP/1.1 204 No Content");
+            set(Response::ResetContent, "HTTP/1.1 205 Reset Content");
+            set(Response::PartialContent, "HTTP/1.1 206 Partial Content");
+            set(Response::MultipleChoices, "HTTP/1.1 300 Multiple Choices");
+            set(Response::MovedPermanently, "HTTP/1.1 301 Moved Permanently");
+            set(Response::Found, "HTTP/1.1 302 Found");
+            set(Response::SeeOther, "HTTP/1.1 303 See Other");
+            set(Response::NotModified, "HTTP/1.1 304 Not Modified");
+            set(Response::UseProxy, "HTTP/1.1 305 Use Proxy");
+            set(Response::TemporaryRedirect, "HTTP/1.1 307 Temporary Redirect");
+            set(Response::BadRequest, "HTTP/1.1 400 Bad Request");
+            set(Response::Unauthorized, "HTTP/1.1 401 Unauthorized");
+            set(Response::PaymentRequired, "HTTP/1.1 402 Payment Required");
+            set(Response::Forbidden, "HTTP/1.1 403 Forbidden");
+            set(Response::NotFound, "HTTP/1.1 404 Not Found");
+            set(Response::MethodNotAllowed, "HTTP/1.1 405 Method Not Allowed");
+            set(Response::NotAcceptable, "HTTP/1.1 406 Not Acceptable");
+            set(Response::ProxyAuthenticationRequired, "HTTP/1.1 407 Proxy Authentication Required");
+            set(Response::RequestTimeout, "HTTP/1.1 408 Request Timeout");
+            set(Response::Conflict, "HTTP/1.1 409 Conflict");
+            set(Response::Gone, "HTTP/1.1 410 Gone");
+            set(Response::LengthRequired, "HTTP/1.1 411 Length Required");
+            set(Response::PreconditionFailed, "HTTP/1.1 412 Precondition Failed");
+            set(Response::RequestEntityTooLarge, "HTTP/1.1 413 Request Entity Too Large");
+            set(Response::RequestURITooLong, "HTTP/1.1 414 Request-URI Too Long");
+            set(Response::UnsupportedMediaType, "HTTP/1.1 415 Unsupported Media Type");
+            set(Response::RequestedRangeNotSatisfiable, "HTTP/1.1 416 Requested Range Not Satisfiable");
+            set(Response::ExpectationFailed, "HTTP/1.1 417 Expectation Failed");
+            set(Response::InternalServerError, "HTTP/1.1 500 Internal Server Error");
+            set(Response::NotImplemented, "HTTP/1.1 501 Not Implemented");
+            set(Response::BadGateway, "HTTP/1.1 502 Bad Gateway");
+            set(Response::ServiceUnavailable, "HTTP/1.1 503 Service Unavailable");
+            set(Response::GatewayTimeout, "HTTP/1.1 504 Gateway Timeout");
+            set(Response::HTTPVersionNotSupported, "HTTP/1.1 505 HTTP Version Not Supported");
+            set(Response::BandwidthLimitExceeded, "HTTP/1.1 509 Bandwidth Limit Exceeded");
+        }
+        void set(quint16 code, const char *text) {
+            lines[code - 100] = { text, static_cast<int>(strlen(text)) };
+        }
+    } table;
+
+    const char *ret = nullptr;
+    int retLen = 0;
+    if (status >= 100 && status < 600) {
+        ret = table.lines[status - 100].text;
+        retLen = table.lines[status - 100].len;
+    }
+
+    if (!ret) {
+        // Codes without an assigned message render into a per-thread
+        // buffer; the old switch returned a pointer into a destroyed
+        // temporary here.
+        static thread_local char unknown[32];
+        retLen = snprintf(unknown, sizeof(unknown), "HTTP/1.1 %u", status);
+        ret = unknown;
     }
 
     if (len) {
-        *len = strlen(ret);
+        *len = retLen;
     }
     return ret;
 }
@@ -414,10 +454,24 @@ Context *Engine::processRequest2(const EngineRequest &req)
 {
     Q_D(Engine);
 
+    // arg1: time the first byte of the request was seen, for queue
+    // delay measurements against the probe firing time
+    CUTELYST_PROBE1(engine_process_request, req.startOfRequest);
+
     auto request = new Request(new RequestPrivate(req, this));
     return d->app->handleRequest2(request);
 }
 
+Context *Engine::processRequest2(EngineRequest &&req)
+{
+    Q_D(Engine);
+
+    CUTELYST_PROBE1(engine_process_request, req.startOfRequest);
+
+    auto request = new Request(new RequestPrivate(std::move(req), this));
+    return d->app->handleRequest2(request);
+}
+
 void Engine::processRequest(const EngineRequest &req)
 {
     delete processRequest2(req);
@@ -432,13 +486,23 @@ QVariantMap Engine::opts() const
 QVariantMap Engine::config(const QString &entity) const
 {
     Q_D(const Engine);
-    return d->config.value(entity).toMap();
+    return d->configSections.value(entity);
 }
 
 void Engine::setConfig(const QVariantMap &config)
 {
     Q_D(Engine);
     d->config = config;
+
+    // Resolve every section up front; configuration is set before the
+    // worker starts serving, so each config() call afterwards hands
+    // out a shared copy of an immutable map.
+    d->configSections.clear();
+    auto it = config.constBegin();
+    while (it != config.constEnd()) {
+        d->configSections.insert(it.key(), it.value().toMap());
+        ++it;
+    }
 }
 
 QVariantMap Engine::loadIniConfig(const QString &filename)
@@ -479,14 +543,80 @@ QVariantMap Engine::loadJsonConfig(const QString &filename)
     return ret;
 }
 
+// Actions marked with the AutoEtag attribute get an entity tag
+// computed over the rendered body; when it matches the validator the
+// client sent the response short-circuits to 304 and the body is
+// never written, the client re-uses its cached copy.
+static void finalizeAutoEtag(Context *c)
+{
+    const Action *action = c->action();
+    if (!action || !action->attributes().contains(QLatin1String("AutoEtag"))) {
+        return;
+    }
+
+    Response *res = c->response();
+    ResponsePrivate *priv = res->d_ptr;
+    if (res->status() != Response::OK || priv->bodyIODevice ||
+            (priv->flags & ResponsePrivate::IOWrite)) {
+        // only complete in-memory bodies can be hashed, streamed
+        // responses went to the wire already
+        return;
+    }
+
+    const QString method = c->request()->method();
+    if (method != Keys::GET && method != Keys::HEAD) {
+        return;
+    }
+
+    Headers &headers = res->headers();
+    QString etag = headers.header(Keys::ETAG);
+    if (etag.isEmpty()) {
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        hash.addData(priv->bodyData);
+        for (const QByteArray &chunk : priv->bodyChunks) {
+            hash.addData(chunk);
+        }
+        // hex encode the digest straight into the quoted QString,
+        // toHex() would allocate an intermediate byte array
+        static const char hexChars[] = "0123456789abcdef";
+        const QByteArray digest = hash.result();
+        etag.resize(digest.size() * 2 + 2);
+        QChar *dst = etag.data();
+        *dst++ = QLatin1Char('"');
+        for (int i = 0; i < digest.size(); ++i) {
+            const quint8 byte = quint8(digest.at(i));
+            *dst++ = QLatin1Char(hexChars[byte >> 4]);
+            *dst++ = QLatin1Char(hexChars[byte & 0xf]);
+        }
+        *dst = QLatin1Char('"');
+        headers.setHeader(Keys::ETAG, etag);
+    }
+
+    const QString match = c->request()->headers().header(Keys::IF_NONE_MATCH);
+    if (!match.isEmpty() && (match == QLatin1String("*") || match.contains(etag))) {
+        res->setStatus(Response::NotModified);
+        priv->bodyData = QByteArray();
+        priv->bodyChunks.clear();
+        priv->bodyChunksSize = 0;
+        headers.removeHeader(Keys::CONTENT_LENGTH);
+    }
+}
+
 void Engine::finalize(Context *c)
 {
+    CUTELYST_PROBE1(engine_finalize, c);
+
     if (c->error()) {
         finalizeError(c);
     }
 
-    if (!(c->response()->d_ptr->flags & ResponsePrivate::FinalizedHeaders) && !finalizeHeaders(c)) {
-        return;
+    ResponsePrivate *priv = c->response()->d_ptr;
+    if (!(priv->flags & ResponsePrivate::FinalizedHeaders)) {
+        finalizeAutoEtag(c);
+
+        if (!finalizeHeaders(c)) {
+            return;
+        }
     }
 
     finalizeBody(c);
@@ -531,6 +661,24 @@ bool Engine::webSocketSendBinaryMessage(Context *c, const QByteArray &message)
     return false;
 }
 
+bool Engine::webSocketBroadcastTextMessage(const QVector<Context *> &contexts, const QString &message)
+{
+    bool ret = true;
+    for (Context *c : contexts) {
+        ret = webSocketSendTextMessage(c, message) && ret;
+    }
+    return ret;
+}
+
+bool Engine::webSocketBroadcastBinaryMessage(const QVector<Context *> &contexts, const QByteArray &message)
+{
+    bool ret = true;
+    for (Context *c : contexts) {
+        ret = webSocketSendBinaryMessage(c, message) && ret;
+    }
+    return ret;
+}
+
 bool Engine::webSocketSendPing(Context *c, const QByteArray &payload)
 {
     Q_UNUSED(c)
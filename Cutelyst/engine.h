@@ -22,6 +22,7 @@
 
 #include <QObject>
 #include <QHostAddress>
+#include <QVector>
 
 #include <Cutelyst/cutelyst_global.h>
 #include <Cutelyst/Headers>
@@ -168,6 +169,23 @@ protected:
      */
     virtual qint64 doWrite(Context *c, const char *data, qint64 len, void *engineData) = 0;
 
+    /**
+     * Writes \p count buffers pointed by \p chunks to the client,
+     * engines that can do scatter-gather IO should reimplement this
+     * to put all chunks on the wire in a single operation. The
+     * default implementation just loops over doWrite().
+     */
+    virtual qint64 doWriteV(Context *c, const QByteArray *chunks, int count, void *engineData);
+
+    /**
+     * Reimplement to return true when the client connection of \p c
+     * understands our chunked transfer encoding, so that a response
+     * body of unknown size is streamed on a kept-alive connection
+     * instead of closing it to mark the end. The default
+     * implementation returns false.
+     */
+    virtual bool supportsChunkedResponse(Context *c, void *engineData);
+
     /**
      * Reimplement if you need a custom way
      * to Set-Cookie, the default implementation
@@ -215,6 +233,20 @@ protected:
 
     virtual bool webSocketSendBinaryMessage(Context *c, const QByteArray &message);
 
+    /**
+     * Sends the same text message to all given websocket contexts, engines
+     * can reimplement this to encode the frame a single time.
+     * Returns false if the message could not be sent to one of them.
+     */
+    virtual bool webSocketBroadcastTextMessage(const QVector<Context *> &contexts, const QString &message);
+
+    /**
+     * Sends the same binary message to all given websocket contexts, engines
+     * can reimplement this to encode the frame a single time.
+     * Returns false if the message could not be sent to one of them.
+     */
+    virtual bool webSocketBroadcastBinaryMessage(const QVector<Context *> &contexts, const QByteArray &message);
+
     virtual bool webSocketSendPing(Context *c, const QByteArray &payload);
 
     virtual bool webSocketClose(Context *c, quint16 code, const QString &reason);
@@ -282,6 +314,19 @@ protected:
      */
     Context *processRequest2(const EngineRequest &req);
 
+    /**
+     * Move-aware overload: the request-scoped payload of \p req
+     * (method, path, query, protocol and headers) is moved into the
+     * Request instead of bumping shared references that detach later,
+     * leaving those fields empty; connection-scoped fields such as
+     * serverAddress and remoteUser are copied and stay valid. Only
+     * call it when the parser refills the moved fields before the
+     * next request reuses \p req.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    Context *processRequest2(EngineRequest &&req);
+
     /**
      * Deprecated
      */
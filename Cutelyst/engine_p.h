@@ -29,6 +29,10 @@ class EnginePrivate
 public:
     QVariantMap opts;
     QVariantMap config;
+    // each section resolved to a plain map once at setConfig() time,
+    // so per-request reads are a hash lookup and a reference-count
+    // bump instead of a QVariant conversion
+    QHash<QString, QVariantMap> configSections;
     Application *app;
     int workerCore;
 };
@@ -19,6 +19,7 @@
 #include "headers_p.h"
 
 #include "common.h"
+#include "internedstrings_p.h"
 
 #include <QStringList>
 
@@ -31,12 +32,12 @@ Headers::Headers()
 
 QString Headers::contentDisposition() const
 {
-    return m_data.value(QStringLiteral("CONTENT_DISPOSITION"));
+    return InternedStrings::fromLatin1(m_data.value(QByteArrayLiteral("CONTENT_DISPOSITION")));
 }
 
 void Headers::setContentDisposition(const QString &contentDisposition)
 {
-    m_data.insert(QStringLiteral("CONTENT_DISPOSITION"), contentDisposition);
+    m_data.insert(QByteArrayLiteral("CONTENT_DISPOSITION"), contentDisposition.toLatin1());
 }
 
 void Headers::setContentDispositionAttachment(const QString &filename)
@@ -50,36 +51,36 @@ void Headers::setContentDispositionAttachment(const QString &filename)
 
 QString Headers::contentEncoding() const
 {
-    return m_data.value(QStringLiteral("CONTENT_ENCODING"));
+    return InternedStrings::fromLatin1(m_data.value(QByteArrayLiteral("CONTENT_ENCODING")));
 }
 
 void Headers::setContentEncoding(const QString &encoding)
 {
-    m_data.insert(QStringLiteral("CONTENT_ENCODING"), encoding);
+    m_data.insert(QByteArrayLiteral("CONTENT_ENCODING"), encoding.toLatin1());
 }
 
 QString Headers::contentType() const
 {
     QString ret;
-    const auto it = m_data.constFind(QStringLiteral("CONTENT_TYPE"));
+    const auto it = m_data.constFind(QByteArrayLiteral("CONTENT_TYPE"));
     if (it != m_data.constEnd()) {
-        const QString ct = it.value();
-        ret = ct.mid(0, ct.indexOf(QLatin1Char(';'))).toLower();
+        const QByteArray ct = it.value();
+        ret = QString::fromLatin1(ct.mid(0, ct.indexOf(';')).toLower());
     }
     return ret;
 }
 
 void Headers::setContentType(const QString &contentType)
 {
-    m_data.insert(QStringLiteral("CONTENT_TYPE"), contentType);
+    m_data.insert(QByteArrayLiteral("CONTENT_TYPE"), contentType.toLatin1());
 }
 
 QString Headers::contentTypeCharset() const
 {
     QString ret;
-    const auto it = m_data.constFind(QStringLiteral("CONTENT_TYPE"));
+    const auto it = m_data.constFind(QByteArrayLiteral("CONTENT_TYPE"));
     if (it != m_data.constEnd()) {
-        const QString contentType = it.value();
+        const QString contentType = QString::fromLatin1(it.value());
         int pos = contentType.indexOf(QLatin1String("charset="), 0, Qt::CaseInsensitive);
         if (pos != -1) {
             int endPos = contentType.indexOf(QLatin1Char(';'), pos);
@@ -92,13 +93,13 @@ QString Headers::contentTypeCharset() const
 
 void Headers::setContentTypeCharset(const QString &charset)
 {
-    const auto it = m_data.constFind(QStringLiteral("CONTENT_TYPE"));
+    const auto it = m_data.constFind(QByteArrayLiteral("CONTENT_TYPE"));
     if (it == m_data.constEnd() || (it.value().isEmpty() && !charset.isEmpty())) {
-        m_data.insert(QStringLiteral("CONTENT_TYPE"), QLatin1String("charset=") + charset);
+        m_data.insert(QByteArrayLiteral("CONTENT_TYPE"), (QLatin1String("charset=") + charset).toLatin1());
         return;
     }
 
-    QString contentType = it.value();
+    QString contentType = QString::fromLatin1(it.value());
     int pos = contentType.indexOf(QLatin1String("charset="), 0, Qt::CaseInsensitive);
     if (pos != -1) {
         int endPos = contentType.indexOf(QLatin1Char(';'), pos);
@@ -106,7 +107,7 @@ void Headers::setContentTypeCharset(const QString &charset)
             if (charset.isEmpty()) {
                 int lastPos = contentType.lastIndexOf(QLatin1Char(';'), pos);
                 if (lastPos == -1) {
-                    m_data.remove(QStringLiteral("CONTENT_TYPE"));
+                    m_data.remove(QByteArrayLiteral("CONTENT_TYPE"));
                     return;
                 } else {
                     contentType.remove(lastPos, contentType.length() - lastPos);
@@ -120,12 +121,12 @@ void Headers::setContentTypeCharset(const QString &charset)
     } else if (!charset.isEmpty()) {
         contentType.append(QLatin1String("; charset=") + charset);
     }
-    m_data.insert(QStringLiteral("CONTENT_TYPE"), contentType);
+    m_data.insert(QByteArrayLiteral("CONTENT_TYPE"), contentType.toLatin1());
 }
 
 bool Headers::contentIsText() const
 {
-    return m_data.value(QStringLiteral("CONTENT_TYPE")).startsWith(QLatin1String("text/"));
+    return m_data.value(QByteArrayLiteral("CONTENT_TYPE")).startsWith("text/");
 }
 
 bool Headers::contentIsHtml() const
@@ -153,7 +154,7 @@ bool Headers::contentIsXml() const
 
 qint64 Headers::contentLength() const
 {
-    auto it = m_data.constFind(QStringLiteral("CONTENT_LENGTH"));
+    auto it = m_data.constFind(QByteArrayLiteral("CONTENT_LENGTH"));
     if (it != m_data.constEnd()) {
         return it.value().toLongLong();
     }
@@ -162,7 +163,7 @@ qint64 Headers::contentLength() const
 
 void Headers::setContentLength(qint64 value)
 {
-    m_data.insert(QStringLiteral("CONTENT_LENGTH"), QString::number(value));
+    m_data.insert(QByteArrayLiteral("CONTENT_LENGTH"), QByteArray::number(value));
 }
 
 QString Headers::setDateWithDateTime(const QDateTime &date)
@@ -171,16 +172,16 @@ QString Headers::setDateWithDateTime(const QDateTime &date)
     // and follow RFC 822
     const QString dt = QLocale::c().toString(date.toUTC(),
                                              QStringLiteral("ddd, dd MMM yyyy hh:mm:ss 'GMT"));
-    m_data.insert(QStringLiteral("DATE"), dt);
+    m_data.insert(QByteArrayLiteral("DATE"), dt.toLatin1());
     return dt;
 }
 
 QDateTime Headers::date() const
 {
     QDateTime ret;
-    auto it = m_data.constFind(QStringLiteral("DATE"));
+    auto it = m_data.constFind(QByteArrayLiteral("DATE"));
     if (it != m_data.constEnd()) {
-        const QString date = it.value();
+        const QString date = QString::fromLatin1(it.value());
 
         if (date.endsWith(QLatin1String(" GMT"))) {
             ret = QLocale::c().toDateTime(date.left(date.size() - 4),
@@ -203,9 +204,9 @@ QString Headers::ifModifiedSince() const
 QDateTime Headers::ifModifiedSinceDateTime() const
 {
     QDateTime ret;
-    auto it = m_data.constFind(QStringLiteral("IF_MODIFIED_SINCE"));
+    auto it = m_data.constFind(QByteArrayLiteral("IF_MODIFIED_SINCE"));
     if (it != m_data.constEnd()) {
-        const QString ifModifiedStr = it.value();
+        const QString ifModifiedStr = QString::fromLatin1(it.value());
 
         if (ifModifiedStr.endsWith(QLatin1String(" GMT"))) {
             ret = QLocale::c().toDateTime(ifModifiedStr.left(ifModifiedStr.size() - 4),
@@ -222,12 +223,12 @@ QDateTime Headers::ifModifiedSinceDateTime() const
 
 QString Headers::lastModified() const
 {
-    return m_data.value(QStringLiteral("LAST_MODIFIED"));
+    return QString::fromLatin1(m_data.value(QByteArrayLiteral("LAST_MODIFIED")));
 }
 
 void Headers::setLastModified(const QString &value)
 {
-    m_data.insert(QStringLiteral("LAST_MODIFIED"), value);
+    m_data.insert(QByteArrayLiteral("LAST_MODIFIED"), value.toLatin1());
 }
 
 QString Headers::setLastModified(const QDateTime &lastModified)
@@ -242,32 +243,32 @@ QString Headers::setLastModified(const QDateTime &lastModified)
 
 QString Headers::server() const
 {
-    return m_data.value(QStringLiteral("SERVER"));
+    return InternedStrings::fromLatin1(m_data.value(QByteArrayLiteral("SERVER")));
 }
 
 void Headers::setServer(const QString &value)
 {
-    m_data.insert(QStringLiteral("SERVER"), value);
+    m_data.insert(QByteArrayLiteral("SERVER"), value.toLatin1());
 }
 
 QString Headers::connection() const
 {
-    return m_data.value(QStringLiteral("CONNECTION"));
+    return InternedStrings::fromLatin1(m_data.value(QByteArrayLiteral("CONNECTION")));
 }
 
 QString Headers::host() const
 {
-    return m_data.value(QStringLiteral("HOST"));
+    return InternedStrings::fromLatin1(m_data.value(QByteArrayLiteral("HOST")));
 }
 
 QString Headers::userAgent() const
 {
-    return m_data.value(QStringLiteral("USER_AGENT"));
+    return InternedStrings::fromLatin1(m_data.value(QByteArrayLiteral("USER_AGENT")));
 }
 
 QString Headers::referer() const
 {
-    return m_data.value(QStringLiteral("REFERER"));
+    return InternedStrings::fromLatin1(m_data.value(QByteArrayLiteral("REFERER")));
 }
 
 void Headers::setReferer(const QString &uri)
@@ -275,25 +276,25 @@ void Headers::setReferer(const QString &uri)
     int fragmentPos = uri.indexOf(QLatin1Char('#'));
     if (fragmentPos != -1) {
         // Strip fragment per RFC 2616, section 14.36.
-        m_data.insert(QStringLiteral("REFERER"), uri.mid(0, fragmentPos));
+        m_data.insert(QByteArrayLiteral("REFERER"), uri.mid(0, fragmentPos).toLatin1());
     } else {
-        m_data.insert(QStringLiteral("REFERER"), uri);
+        m_data.insert(QByteArrayLiteral("REFERER"), uri.toLatin1());
     }
 }
 
 void Headers::setWwwAuthenticate(const QString &value)
 {
-    m_data.insert(QStringLiteral("WWW_AUTHENTICATE"), value);
+    m_data.insert(QByteArrayLiteral("WWW_AUTHENTICATE"), value.toLatin1());
 }
 
 void Headers::setProxyAuthenticate(const QString &value)
 {
-    m_data.insert(QStringLiteral("PROXY_AUTHENTICATE"), value);
+    m_data.insert(QByteArrayLiteral("PROXY_AUTHENTICATE"), value.toLatin1());
 }
 
 QString Headers::authorization() const
 {
-    return m_data.value(QStringLiteral("AUTHORIZATION"));
+    return QString::fromLatin1(m_data.value(QByteArrayLiteral("AUTHORIZATION")));
 }
 
 QString Headers::authorizationBasic() const
@@ -316,7 +317,7 @@ QString Headers::setAuthorizationBasic(const QString &username, const QString &p
 
     const QString result = username + QLatin1Char(':') + password;
     ret = QStringLiteral("Basic ") + QString::fromLatin1(result.toLatin1().toBase64());
-    m_data.insert(QStringLiteral("AUTHORIZATION"), ret);
+    m_data.insert(QByteArrayLiteral("AUTHORIZATION"), ret.toLatin1());
     return ret;
 }
 
@@ -329,7 +330,7 @@ QHash<QString, QString> Headers::authorizationDigest() const
 
 QString Headers::proxyAuthorization() const
 {
-    return m_data.value(QStringLiteral("PROXY_AUTHORIZATION"));
+    return QString::fromLatin1(m_data.value(QByteArrayLiteral("PROXY_AUTHORIZATION")));
 }
 
 QString Headers::proxyAuthorizationBasic() const
@@ -344,17 +345,21 @@ QPair<QString, QString> Headers::proxyAuthorizationBasicPair() const
 
 QString Headers::header(const QString &field) const
 {
-    return m_data.value(HeadersPrivate::normalizeHeaderKey(field));
+    return QString::fromLatin1(m_data.value(HeadersPrivate::normalizeHeaderKey(field)));
 }
 
 QString Headers::header(const QString &field, const QString &defaultValue) const
 {
-    return m_data.value(HeadersPrivate::normalizeHeaderKey(field), defaultValue);
+    const auto it = m_data.constFind(HeadersPrivate::normalizeHeaderKey(field));
+    if (it == m_data.constEnd()) {
+        return defaultValue;
+    }
+    return QString::fromLatin1(it.value());
 }
 
 void Headers::setHeader(const QString &field, const QString &value)
 {
-    m_data.insert(HeadersPrivate::normalizeHeaderKey(field), value);
+    m_data.insert(HeadersPrivate::normalizeHeaderKey(field), value.toLatin1());
 }
 
 void Headers::setHeader(const QString &field, const QStringList &values)
@@ -364,12 +369,12 @@ void Headers::setHeader(const QString &field, const QStringList &values)
 
 void Headers::pushHeader(const QString &field, const QString &value)
 {
-    m_data.insertMulti(HeadersPrivate::normalizeHeaderKey(field), value);
+    m_data.insertMulti(HeadersPrivate::normalizeHeaderKey(field), value.toLatin1());
 }
 
 void Headers::pushHeader(const QString &field, const QStringList &values)
 {
-    m_data.insertMulti(HeadersPrivate::normalizeHeaderKey(field), values.join(QStringLiteral(", ")));
+    m_data.insertMulti(HeadersPrivate::normalizeHeaderKey(field), values.join(QStringLiteral(", ")).toLatin1());
 }
 
 void Headers::removeHeader(const QString &field)
@@ -377,33 +382,118 @@ void Headers::removeHeader(const QString &field)
     m_data.remove(HeadersPrivate::normalizeHeaderKey(field));
 }
 
+QHash<QString, QString> Headers::data() const
+{
+    QHash<QString, QString> ret;
+    ret.reserve(m_data.size());
+    auto it = m_data.constBegin();
+    const auto endIt = m_data.constEnd();
+    while (it != endIt) {
+        ret.insertMulti(QString::fromLatin1(it.key()), QString::fromLatin1(it.value()));
+        ++it;
+    }
+    return ret;
+}
+
 bool Headers::contains(const QString &field)
 {
     return m_data.contains(HeadersPrivate::normalizeHeaderKey(field));
 }
 
-QString &Headers::operator[](const QString &key)
+QByteArray &Headers::operator[](const QByteArray &key)
 {
     return m_data[key];
 }
 
 const QString Headers::operator[](const QString &key) const
 {
-    return m_data[key];
+    return QString::fromLatin1(m_data.value(key.toLatin1()));
 }
 
-QString HeadersPrivate::normalizeHeaderKey(const QString &field)
+static inline bool headerKeyMatches(const char *str, const char *normalized, int size)
 {
-    QString key = field;
+    for (int i = 0; i < size; ++i) {
+        char c = str[i];
+        if (c == '-') {
+            c = '_';
+        } else if (c >= 'a' && c <= 'z') {
+            c -= ('a' - 'A');
+        }
+        if (c != normalized[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Maps the most common header names straight to interned
+// normalized keys, avoiding a detached key allocation when
+// the same headers are set over and over again.
+static QByteArray knownHeaderKey(const char *str, int size)
+{
+    switch (size) {
+    case 4:
+        if (headerKeyMatches(str, "HOST", 4)) return QByteArrayLiteral("HOST");
+        if (headerKeyMatches(str, "DATE", 4)) return QByteArrayLiteral("DATE");
+        if (headerKeyMatches(str, "ETAG", 4)) return QByteArrayLiteral("ETAG");
+        break;
+    case 6:
+        if (headerKeyMatches(str, "ACCEPT", 6)) return QByteArrayLiteral("ACCEPT");
+        if (headerKeyMatches(str, "COOKIE", 6)) return QByteArrayLiteral("COOKIE");
+        if (headerKeyMatches(str, "SERVER", 6)) return QByteArrayLiteral("SERVER");
+        break;
+    case 7:
+        if (headerKeyMatches(str, "REFERER", 7)) return QByteArrayLiteral("REFERER");
+        if (headerKeyMatches(str, "EXPIRES", 7)) return QByteArrayLiteral("EXPIRES");
+        break;
+    case 8:
+        if (headerKeyMatches(str, "LOCATION", 8)) return QByteArrayLiteral("LOCATION");
+        break;
+    case 10:
+        if (headerKeyMatches(str, "CONNECTION", 10)) return QByteArrayLiteral("CONNECTION");
+        if (headerKeyMatches(str, "USER_AGENT", 10)) return QByteArrayLiteral("USER_AGENT");
+        if (headerKeyMatches(str, "SET_COOKIE", 10)) return QByteArrayLiteral("SET_COOKIE");
+        break;
+    case 12:
+        if (headerKeyMatches(str, "CONTENT_TYPE", 12)) return QByteArrayLiteral("CONTENT_TYPE");
+        break;
+    case 13:
+        if (headerKeyMatches(str, "AUTHORIZATION", 13)) return QByteArrayLiteral("AUTHORIZATION");
+        if (headerKeyMatches(str, "CACHE_CONTROL", 13)) return QByteArrayLiteral("CACHE_CONTROL");
+        if (headerKeyMatches(str, "LAST_MODIFIED", 13)) return QByteArrayLiteral("LAST_MODIFIED");
+        if (headerKeyMatches(str, "IF_NONE_MATCH", 13)) return QByteArrayLiteral("IF_NONE_MATCH");
+        break;
+    case 14:
+        if (headerKeyMatches(str, "CONTENT_LENGTH", 14)) return QByteArrayLiteral("CONTENT_LENGTH");
+        break;
+    case 16:
+        if (headerKeyMatches(str, "CONTENT_ENCODING", 16)) return QByteArrayLiteral("CONTENT_ENCODING");
+        break;
+    case 17:
+        if (headerKeyMatches(str, "IF_MODIFIED_SINCE", 17)) return QByteArrayLiteral("IF_MODIFIED_SINCE");
+        break;
+    default:
+        break;
+    }
+    return QByteArray();
+}
+
+QByteArray HeadersPrivate::normalizeHeaderKey(const QString &field)
+{
+    QByteArray key = field.toLatin1();
+
+    const QByteArray known = knownHeaderKey(key.constData(), key.size());
+    if (!known.isNull()) {
+        return known;
+    }
+
     int i = 0;
     while (i < key.size()) {
-        QCharRef c = key[i];
-        if (c.isLetter()) {
-            if (c.isLower()) {
-                c = c.toUpper();
-            }
-        } else if (c == QLatin1Char('-')) {
-            c = QLatin1Char('_');
+        char c = key.at(i);
+        if (c >= 'a' && c <= 'z') {
+            key[i] = c - ('a' - 'A');
+        } else if (c == '-') {
+            key[i] = '_';
         }
         ++i;
     }
@@ -416,7 +506,8 @@ QByteArray HeadersPrivate::decodeBasicAuth(const QString &auth)
     if (!auth.isEmpty() && auth.startsWith(QLatin1String("Basic "))) {
         int pos = auth.lastIndexOf(QLatin1Char(' '));
         if (pos != -1) {
-            ret = QByteArray::fromBase64(auth.mid(pos).toLatin1());
+            // midRef() feeds the codec without an intermediate QString
+            ret = QByteArray::fromBase64(auth.midRef(pos + 1).toLatin1());
         }
     }
     return ret;
@@ -287,6 +287,24 @@ public:
      */
     QString header(const QString &field) const;
 
+    /**
+     * Returns the raw value associated with \p field, which must
+     * already be in it's normalized form, this avoids converting
+     * the stored bytes to UTF-16 and should be preferred by Engines.
+     */
+    inline QByteArray rawHeader(const QByteArray &field) const {
+        return m_data.value(field);
+    }
+
+    /**
+     * Sets the raw header \p field to \p value, the field must
+     * already be in it's normalized form, this avoids converting
+     * from UTF-16 and should be preferred by Engines.
+     */
+    inline void setRawHeader(const QByteArray &field, const QByteArray &value) {
+        m_data.insert(field, value);
+    }
+
     /**
      * Returns the value associated with \p field, if field is not set \p defaultValue is returned
      */
@@ -316,6 +334,14 @@ public:
      */
     inline void pushRawHeader(const QString &field, const QString &value);
 
+    /**
+     * This method directly appends a raw Header, the field must
+     * already be in it's normalized form, no transcoding to UTF-16
+     * is done so this is the fastest way for Engines to fill Headers
+     * while parsing a request.
+     */
+    inline void pushRawHeader(const QByteArray &field, const QByteArray &value);
+
     /**
      * This method appends a header to internal data normalizing the key.
      */
@@ -326,6 +352,15 @@ public:
      */
     void removeHeader(const QString &field);
 
+    /**
+     * This method removes a raw header, the field must already be in
+     * its normalized form, skipping the normalization cost the same
+     * way pushRawHeader() does.
+     */
+    inline void removeRawHeader(const QByteArray &field) {
+        m_data.remove(field);
+    }
+
     /**
      * Clears all headers.
      */
@@ -334,9 +369,17 @@ public:
     }
 
     /**
-     * Returns the internal structure of headers, to be used by Engine subclasses.
+     * Returns a copy of the headers converted to UTF-16,
+     * Engine subclasses should prefer rawData() which is
+     * free of transcoding.
      */
-    inline QHash<QString, QString> data() const {
+    QHash<QString, QString> data() const;
+
+    /**
+     * Returns the internal byte oriented structure of headers,
+     * to be used by Engine subclasses when serializing the response.
+     */
+    inline QHash<QByteArray, QByteArray> rawData() const {
         return m_data;
     }
 
@@ -346,9 +389,10 @@ public:
     bool contains(const QString &field);
 
     /**
-     * Returns the value reference associated with key.
+     * Returns the raw value reference associated with key,
+     * which must already be in it's normalized form.
      */
-    QString &operator[](const QString &key);
+    QByteArray &operator[](const QByteArray &key);
 
     /**
      * Returns the const value associated with key.
@@ -382,14 +426,18 @@ public:
      * Returns this Header internal data as a QVariant for easiness with Q_PROPERTY.
      */
     inline operator QVariant() const {
-        return QVariant::fromValue(m_data);
+        return QVariant::fromValue(data());
     }
 
 private:
-    QHash<QString, QString> m_data;
+    QHash<QByteArray, QByteArray> m_data;
 };
 
 void Headers::pushRawHeader(const QString &field, const QString &value) {
+    m_data.insertMulti(field.toLatin1(), value.toLatin1());
+}
+
+void Headers::pushRawHeader(const QByteArray &field, const QByteArray &value) {
     m_data.insertMulti(field, value);
 }
 
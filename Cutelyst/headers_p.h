@@ -27,7 +27,7 @@ namespace Cutelyst {
 class HeadersPrivate
 {
 public:
-    static inline QString normalizeHeaderKey(const QString &field);
+    static inline QByteArray normalizeHeaderKey(const QString &field);
     static inline QByteArray decodeBasicAuth(const QString &auth);
     static inline QPair<QString, QString> decodeBasicAuthPair(const QString &auth);
 };
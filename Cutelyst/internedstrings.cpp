@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "internedstrings_p.h"
+
+#include <QtCore/QCache>
+
+using namespace Cutelyst;
+
+// Tokens that show up in nearly every request; literal strings carry
+// an immortal reference count, so handing out a copy is free
+static QString universalToken(const QByteArray &value)
+{
+    switch (value.size()) {
+    case 4:
+        if (value == "gzip") return QStringLiteral("gzip");
+        break;
+    case 5:
+        if (value == "close") return QStringLiteral("close");
+        break;
+    case 7:
+        if (value == "deflate") return QStringLiteral("deflate");
+        break;
+    case 8:
+        if (value == "identity") return QStringLiteral("identity");
+        break;
+    case 9:
+        if (value == "text/html") return QStringLiteral("text/html");
+        break;
+    case 10:
+        if (value == "keep-alive") return QStringLiteral("keep-alive");
+        if (value == "text/plain") return QStringLiteral("text/plain");
+        break;
+    case 13:
+        if (value == "gzip, deflate") return QStringLiteral("gzip, deflate");
+        break;
+    case 16:
+        if (value == "application/json") return QStringLiteral("application/json");
+        break;
+    case 33:
+        if (value == "application/x-www-form-urlencoded")
+            return QStringLiteral("application/x-www-form-urlencoded");
+        break;
+    default:
+        break;
+    }
+    return QString();
+}
+
+QString InternedStrings::fromLatin1(const QByteArray &value)
+{
+    if (value.isEmpty()) {
+        return QString();
+    }
+
+    QString ret = universalToken(value);
+    if (!ret.isNull()) {
+        return ret;
+    }
+
+    // Bounded per-thread cache for recurring dynamic values, like the
+    // dozen User-Agent strings internal services send; QCache evicts
+    // the least recently used entry so one-off values cycle through
+    // without pushing the hot ones out. No locks, each worker thread
+    // has its own.
+    static thread_local QCache<QByteArray, QString> cache(256);
+
+    if (QString *cached = cache.object(value)) {
+        return *cached;
+    }
+
+    ret = QString::fromLatin1(value);
+    cache.insert(value, new QString(ret));
+    return ret;
+}
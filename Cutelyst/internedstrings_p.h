@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef CUTELYST_INTERNEDSTRINGS_P_H
+#define CUTELYST_INTERNEDSTRINGS_P_H
+
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+
+namespace Cutelyst {
+
+/**
+ * Shared storage for the request metadata values that repeat across
+ * requests: connection tokens, encodings, content types, the handful
+ * of User-Agent strings internal services send. Universal tokens come
+ * from literal strings whose copies are free; anything else goes
+ * through a bounded per-thread cache, so equal values share one
+ * allocation instead of being materialized fresh on every request.
+ */
+namespace InternedStrings {
+
+/**
+ * Returns \p value as a QString, sharing storage with earlier calls
+ * that saw the same bytes on this thread.
+ */
+QString fromLatin1(const QByteArray &value);
+
+}
+
+}
+
+#endif // CUTELYST_INTERNEDSTRINGS_P_H
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "keys_p.h"
+
+namespace Cutelyst {
+namespace Keys {
+
+const QString CONTENT_TYPE = QStringLiteral("CONTENT_TYPE");
+const QString CONTENT_LENGTH = QStringLiteral("CONTENT_LENGTH");
+const QString CONTENT_RANGE = QStringLiteral("CONTENT_RANGE");
+const QString CONTENT_ENCODING = QStringLiteral("CONTENT_ENCODING");
+const QString TRANSFER_ENCODING = QStringLiteral("TRANSFER_ENCODING");
+const QString CONNECTION = QStringLiteral("CONNECTION");
+const QString LOCATION = QStringLiteral("LOCATION");
+const QString CACHE_CONTROL = QStringLiteral("CACHE_CONTROL");
+const QString COOKIE = QStringLiteral("COOKIE");
+const QString X_REQUEST_ID = QStringLiteral("X_REQUEST_ID");
+const QString ALLOW = QStringLiteral("ALLOW");
+const QString ETAG = QStringLiteral("ETAG");
+const QString RANGE = QStringLiteral("RANGE");
+const QString IF_RANGE = QStringLiteral("IF_RANGE");
+const QString ACCEPT_RANGES = QStringLiteral("ACCEPT_RANGES");
+const QString VARY = QStringLiteral("VARY");
+const QString TRAILER = QStringLiteral("TRAILER");
+const QString IF_NONE_MATCH = QStringLiteral("IF_NONE_MATCH");
+
+const QString GET = QStringLiteral("GET");
+const QString POST = QStringLiteral("POST");
+const QString HEAD = QStringLiteral("HEAD");
+
+}
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef CUTELYST_KEYS_P_H
+#define CUTELYST_KEYS_P_H
+
+#include <QtCore/QString>
+
+#include <Cutelyst/cutelyst_global.h>
+
+namespace Cutelyst {
+
+/**
+ * One shared QString per framework-internal key. Each translation
+ * unit that spells these with its own QStringLiteral carries a
+ * private copy of the string data; routing them through one extern
+ * object shares the data and lets QString's same-data fast path turn
+ * the comparisons into pointer checks.
+ *
+ * These are plain globals with dynamic initializers, safe anywhere
+ * in request handling but not from other static initialization.
+ */
+namespace Keys {
+
+// header fields, normalized form
+CUTELYST_LIBRARY extern const QString CONTENT_TYPE;
+CUTELYST_LIBRARY extern const QString CONTENT_LENGTH;
+CUTELYST_LIBRARY extern const QString CONTENT_RANGE;
+CUTELYST_LIBRARY extern const QString CONTENT_ENCODING;
+CUTELYST_LIBRARY extern const QString TRANSFER_ENCODING;
+CUTELYST_LIBRARY extern const QString CONNECTION;
+CUTELYST_LIBRARY extern const QString LOCATION;
+CUTELYST_LIBRARY extern const QString CACHE_CONTROL;
+CUTELYST_LIBRARY extern const QString COOKIE;
+CUTELYST_LIBRARY extern const QString X_REQUEST_ID;
+CUTELYST_LIBRARY extern const QString ALLOW;
+CUTELYST_LIBRARY extern const QString ETAG;
+CUTELYST_LIBRARY extern const QString RANGE;
+CUTELYST_LIBRARY extern const QString IF_RANGE;
+CUTELYST_LIBRARY extern const QString ACCEPT_RANGES;
+CUTELYST_LIBRARY extern const QString VARY;
+CUTELYST_LIBRARY extern const QString TRAILER;
+CUTELYST_LIBRARY extern const QString IF_NONE_MATCH;
+
+// request methods
+CUTELYST_LIBRARY extern const QString GET;
+CUTELYST_LIBRARY extern const QString POST;
+CUTELYST_LIBRARY extern const QString HEAD;
+
+}
+
+}
+
+#endif // CUTELYST_KEYS_P_H
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef MEMORYPOOL_P_H
+#define MEMORYPOOL_P_H
+
+#include <cstddef>
+#include <vector>
+
+namespace Cutelyst {
+
+/**
+ * Per worker-core (thread) free list used to recycle the
+ * objects allocated on every request. Engines keep deleting
+ * the Context normally, the memory just goes back to the
+ * thread pool instead of the allocator.
+ */
+template <typename T, int MaxFree = 128>
+class MemoryPool
+{
+public:
+    static inline void *allocate(size_t size) {
+        if (size != sizeof(T)) {
+            // a subclass, let the allocator deal with it
+            return ::operator new(size);
+        }
+        std::vector<void *> &pool = freeList();
+        if (!pool.empty()) {
+            void *ptr = pool.back();
+            pool.pop_back();
+            return ptr;
+        }
+        return ::operator new(sizeof(T));
+    }
+
+    static inline void deallocate(void *ptr, size_t size) {
+        if (size == sizeof(T)) {
+            std::vector<void *> &pool = freeList();
+            if (pool.size() < MaxFree) {
+                pool.push_back(ptr);
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+private:
+    static std::vector<void *> &freeList() {
+        static thread_local std::vector<void *> pool;
+        return pool;
+    }
+};
+
+}
+
+/**
+ * Adds pooled operator new/delete to an internal per-request class.
+ */
+#define CUTELYST_MEMORY_POOLED(Class) \
+    inline void *operator new(size_t size) { \
+        return Cutelyst::MemoryPool<Class>::allocate(size); \
+    } \
+    inline void operator delete(void *ptr, size_t size) { \
+        Cutelyst::MemoryPool<Class>::deallocate(ptr, size); \
+    }
+
+#endif // MEMORYPOOL_P_H
@@ -73,117 +73,192 @@ Uploads MultiPartFormDataParser::parse(QIODevice *body, const QString &contentTy
     return ret;
 }
 
+// algorithms digested for each part while the body is scanned, set
+// once at application init before requests are parsed
+static QVector<QCryptographicHash::Algorithm> uploadDigestAlgos;
+
+void MultiPartFormDataParser::setUploadDigests(const QVector<QCryptographicHash::Algorithm> &algorithms)
+{
+    uploadDigestAlgos = algorithms;
+}
+
+MultiPartFormDataParserPrivate::MultiPartFormDataParserPrivate(QIODevice *body, const QByteArray &boundary)
+    : m_body(body)
+    , m_matcher(boundary)
+    , m_hashAlgos(uploadDigestAlgos)
+    , m_boundarySize(boundary.size())
+{
+    for (QCryptographicHash::Algorithm algorithm : qAsConst(m_hashAlgos)) {
+        m_hashes.append(new QCryptographicHash(algorithm));
+    }
+}
+
+MultiPartFormDataParserPrivate::~MultiPartFormDataParserPrivate()
+{
+    qDeleteAll(m_hashes);
+}
+
+bool MultiPartFormDataParserPrivate::feed(const char *data, int len)
+{
+    if (m_failed || len <= 0) {
+        return !m_failed;
+    }
+
+    // Only a boundary-sized window is carried between chunks, so
+    // the parser runs in O(1) memory whatever the body size is
+    QByteArray chunk;
+    if (m_carry.isEmpty()) {
+        chunk = QByteArray::fromRawData(data, len);
+    } else {
+        chunk = m_carry;
+        chunk.append(data, len);
+        m_carry = QByteArray();
+    }
+    m_pos += len;
+
+    const char *buffer = chunk.constData();
+    const int total = chunk.size();
+    int i = 0;
+    while (i < total) {
+        switch (m_state) {
+        case FindBoundary:
+            i += findBoundary(buffer + i, total - i, m_matcher, m_boundarySize, m_state);
+            break;
+        case EndBoundaryCR:
+            // TODO the "--" case
+            if (buffer[i] != '\r') {
+//                qCDebug(CUTELYST_MULTIPART) << "EndBoundaryCR return!";
+                m_failed = true;
+                return false;
+            }
+            m_state = EndBoundaryLF;
+            break;
+        case EndBoundaryLF:
+            if (buffer[i] != '\n') {
+//                qCDebug(CUTELYST_MULTIPART) << "EndBoundaryLF return!";
+                m_failed = true;
+                return false;
+            }
+            m_state = StartHeaders;
+            break;
+        case StartHeaders:
+            if (m_headerLine.isEmpty() && buffer[i] == '\r') {
+                // nothing was read
+                m_state = EndHeaders;
+            } else {
+                const char *pch = static_cast<const char *>(memchr(buffer + i, '\r', total - i));
+                if (pch == NULL) {
+                    m_headerLine.append(buffer + i, total - i);
+                    i = total;
+                } else {
+                    m_headerLine.append(buffer + i, pch - buffer - i);
+                    i = pch - buffer;
+                    m_state = FinishHeader;
+                }
+            }
+            break;
+        case FinishHeader:
+            if (buffer[i] == '\n') {
+                int dotdot = m_headerLine.indexOf(':');
+                m_headers.setHeader(QString::fromLatin1(m_headerLine.left(dotdot)),
+                                    QString::fromLatin1(m_headerLine.mid(dotdot + 1).trimmed()));
+                m_headerLine = QByteArray();
+                m_state = StartHeaders;
+            } else {
+//                qCDebug(CUTELYST_MULTIPART) << "FinishHeader return!";
+                m_failed = true;
+                return false;
+            }
+            break;
+        case EndHeaders:
+            if (buffer[i] == '\n') {
+                m_state = StartData;
+            } else {
+//                qCDebug(CUTELYST_MULTIPART) << "EndHeaders return!";
+                m_failed = true;
+                return false;
+            }
+            break;
+        case StartData:
+//            qCDebug(CUTELYST_MULTIPART) << "StartData" << m_pos - total + i;
+            m_startOffset = m_pos - total + i;
+            m_state = EndData;
+        case EndData: {
+            const int contentStart = i;
+            i += findBoundary(buffer + i, total - i, m_matcher, m_boundarySize, m_state);
+
+            if (m_state == EndBoundaryCR) {
+//                qCDebug(CUTELYST_MULTIPART) << "EndData" << m_pos - total + i - m_boundarySize - 1;
+                qint64 endOffset = m_pos - total + i - m_boundarySize - 1;
+                auto priv = new UploadPrivate(m_body, m_headers, m_startOffset, endOffset);
+                if (!m_hashes.isEmpty()) {
+                    // hash the tail of the part, excluding the CRLF
+                    // that precedes the boundary, and collect digests
+                    const int contentEnd = i - m_boundarySize - 1;
+                    for (int h = 0; h < m_hashes.size(); ++h) {
+                        QCryptographicHash *hash = m_hashes[h];
+                        if (contentEnd > contentStart) {
+                            hash->addData(buffer + contentStart, contentEnd - contentStart);
+                        }
+                        priv->digests.insert(m_hashAlgos[h], hash->result());
+                        hash->reset();
+                    }
+                }
+                uploads.append(new Upload(priv));
+
+                m_headers = Headers();
+            } else if (m_hashes.isEmpty()) {
+                // Boundary was not found, keep the boundary size at the
+                // end to be sure we don't have it split between two chunks
+                m_carry = chunk.right(m_boundarySize - 1);
+            } else {
+                // carry two extra bytes so the CRLF in front of a
+                // boundary split between chunks is never hashed as
+                // part content
+                const int carryFrom = qMax(contentStart, total - (m_boundarySize + 1));
+                for (QCryptographicHash *hash : qAsConst(m_hashes)) {
+                    if (carryFrom > contentStart) {
+                        hash->addData(buffer + contentStart, carryFrom - contentStart);
+                    }
+                }
+                // deep copy, chunk may wrap the caller's raw buffer
+                m_carry = QByteArray(chunk.constData() + carryFrom, total - carryFrom);
+            }
+
+            break;
+        }
+        }
+        ++i;
+    }
+
+    return true;
+}
+
 Uploads MultiPartFormDataParserPrivate::execute(char *buffer, int bufferSize, QIODevice *body, const QByteArray &boundary)
 {
-    Uploads ret;
-    QByteArray headerLine;
-    Headers headers;
-    qint64 startOffset;
-    qint64 pos = 0;
-    qint64 contentLength = body->size();
-    int bufferSkip = 0;
-    int boundarySize = boundary.size();
-    ParserState state = FindBoundary;
-    QByteArrayMatcher matcher(boundary);
+    MultiPartFormDataParserPrivate parser(body, boundary);
 
+    qint64 pos = 0;
+    const qint64 contentLength = body->size();
     while (pos < contentLength) {
-        qint64 len = body->read(buffer + bufferSkip, bufferSize - bufferSkip);
+        const qint64 len = body->read(buffer, bufferSize);
         if (len < 0) {
             qCWarning(CUTELYST_MULTIPART) << "Error while reading POST body" << body->errorString();
-            return ret;
+            break;
+        } else if (len == 0) {
+            break;
         }
 
         pos += len;
-        len += bufferSkip;
-        bufferSkip = 0;
-        int i = 0;
-        while (i < len) {
-            switch (state) {
-            case FindBoundary:
-                i += findBoundary(buffer + i, len - i, matcher, boundarySize, state);
-                break;
-            case EndBoundaryCR:
-                // TODO the "--" case
-                if (buffer[i] != '\r') {
-//                    qCDebug(CUTELYST_MULTIPART) << "EndBoundaryCR return!";
-                    return ret;
-                }
-                state = EndBoundaryLF;
-                break;
-            case EndBoundaryLF:
-                if (buffer[i] != '\n') {
-//                    qCDebug(CUTELYST_MULTIPART) << "EndBoundaryLF return!";
-                    return ret;
-                }
-                state = StartHeaders;
-                break;
-            case StartHeaders:
-                if (headerLine.isEmpty() && buffer[i] == '\r') {
-                    // nothing was read
-                    state = EndHeaders;
-                } else {
-                    char *pch = static_cast<char *>(memchr(buffer + i, '\r', len - i));
-                    if (pch == NULL) {
-                        headerLine.append(buffer + i, len - i);
-                        i = len;
-                    } else {
-                        headerLine.append(buffer + i, pch - buffer - i);
-                        i = pch - buffer;
-                        state = FinishHeader;
-                    }
-                }
-                break;
-            case FinishHeader:
-                if (buffer[i] == '\n') {
-                    int dotdot = headerLine.indexOf(':');
-                    headers.setHeader(QString::fromLatin1(headerLine.left(dotdot)),
-                                      QString::fromLatin1(headerLine.mid(dotdot + 1).trimmed()));
-                    headerLine = QByteArray();
-                    state = StartHeaders;
-                } else {
-//                    qCDebug(CUTELYST_MULTIPART) << "FinishHeader return!";
-                    return ret;
-                }
-                break;
-            case EndHeaders:
-                if (buffer[i] == '\n') {
-                    state = StartData;
-                } else {
-//                    qCDebug(CUTELYST_MULTIPART) << "EndHeaders return!";
-                    return ret;
-                }
-                break;
-            case StartData:
-//                qCDebug(CUTELYST_MULTIPART) << "StartData" << body->pos() - len + i;
-                startOffset = pos - len + i;
-                state = EndData;
-            case EndData:
-                i += findBoundary(buffer + i, len - i, matcher, boundarySize, state);
-
-                if (state == EndBoundaryCR) {
-//                    qCDebug(CUTELYST_MULTIPART) << "EndData" << body->pos() - len + i - boundaryLength - 1;
-                    int endOffset = pos - len + i - boundarySize - 1;
-                    auto upload = new Upload(new UploadPrivate(body, headers, startOffset, endOffset));
-                    ret.append(upload);
-
-                    headers = Headers();
-                } else {
-                    // Boundary was not found so move the boundary size at end of the buffer
-                    // to be sure we don't have the boundary in the middle of two chunks
-                    bufferSkip = boundarySize - 1;
-                    memmove(buffer, buffer + len - bufferSkip, bufferSkip);
-                }
-
-                break;
-            }
-            ++i;
+        if (!parser.feed(buffer, len)) {
+            break;
         }
     }
 
-    return ret;
+    return parser.uploads;
 }
 
-int MultiPartFormDataParserPrivate::findBoundary(char *buffer, int len, const QByteArrayMatcher &matcher, int boundarySize, MultiPartFormDataParserPrivate::ParserState &state)
+int MultiPartFormDataParserPrivate::findBoundary(const char *buffer, int len, const QByteArrayMatcher &matcher, int boundarySize, MultiPartFormDataParserPrivate::ParserState &state)
 {
     int i = matcher.indexIn(buffer, len);
     //    qCDebug(CUTELYST_MULTIPART) << "findBoundary" << QByteArray(buffer, len);
@@ -20,6 +20,8 @@
 #ifndef MULTIPARTFORMDATAINTERNAL_H
 #define MULTIPARTFORMDATAINTERNAL_H
 
+#include <QtCore/qcryptographichash.h>
+
 #include <Cutelyst/upload.h>
 #include <Cutelyst/cutelyst_global.h>
 
@@ -35,6 +37,17 @@ public:
      * @param bufferSize is the internal buffer size used to parse
      */
     static Uploads parse(QIODevice *body, const QString &contentType, int bufferSize = 4096);
+
+    /**
+     * Sets the hash algorithms computed for every upload while the
+     * body is parsed. The parser scans each body byte once anyway, so
+     * digesting inline adds no extra read pass; Upload::digest() then
+     * returns the result without re-reading the content. Set it once
+     * at application init, before requests are parsed.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    static void setUploadDigests(const QVector<QCryptographicHash::Algorithm> &algorithms);
 };
 
 }
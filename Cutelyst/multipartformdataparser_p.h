@@ -21,8 +21,10 @@
 #define MULTIPARTFORMDATA_P_H
 
 #include "multipartformdataparser.h"
+#include "headers.h"
 
 #include <QByteArrayMatcher>
+#include <QCryptographicHash>
 
 namespace Cutelyst {
 
@@ -42,8 +44,36 @@ public:
     };
     Q_ENUM(ParserState)
 
+    MultiPartFormDataParserPrivate(QIODevice *body, const QByteArray &boundary);
+    ~MultiPartFormDataParserPrivate();
+
+    /**
+     * Push interface: consumes one chunk of the body keeping the parser
+     * state between calls, so chunks can be fed as they arrive from the
+     * network with only a boundary-sized window carried over. Completed
+     * parts are appended to uploads. Returns false once the part data
+     * is malformed, subsequent calls become no-ops.
+     */
+    bool feed(const char *data, int len);
+
+    Uploads uploads;
+
     static Uploads execute(char *buffer, int bufferSize, QIODevice *body, const QByteArray &boundary);
-    static inline int findBoundary(char *buffer, int len, const QByteArrayMatcher &matcher, int boundarySize, ParserState &state);
+    static inline int findBoundary(const char *buffer, int len, const QByteArrayMatcher &matcher, int boundarySize, ParserState &state);
+
+private:
+    QIODevice *m_body;
+    QByteArrayMatcher m_matcher;
+    QByteArray m_carry;
+    QByteArray m_headerLine;
+    Headers m_headers;
+    QVector<QCryptographicHash::Algorithm> m_hashAlgos;
+    QVector<QCryptographicHash *> m_hashes;
+    qint64 m_startOffset = 0;
+    qint64 m_pos = 0;
+    int m_boundarySize;
+    ParserState m_state = FindBoundary;
+    bool m_failed = false;
 };
 
 }
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef CUTELYST_PROBES_P_H
+#define CUTELYST_PROBES_P_H
+
+// USDT probe points under the "cutelyst" provider, consumable with
+// bpftrace, SystemTap or perf against an unmodified production binary.
+// An untriggered probe is a single nop; without <sys/sdt.h> at build
+// time the macros expand to nothing.
+//
+// Probe arguments are always evaluated, so only pass integers or
+// pointers that are already at hand.
+#ifdef CUTELYST_HAVE_SDT
+#include <sys/sdt.h>
+#define CUTELYST_PROBE(name) DTRACE_PROBE(cutelyst, name)
+#define CUTELYST_PROBE1(name, a1) DTRACE_PROBE1(cutelyst, name, a1)
+#define CUTELYST_PROBE2(name, a1, a2) DTRACE_PROBE2(cutelyst, name, a1, a2)
+#else
+#define CUTELYST_PROBE(name)
+#define CUTELYST_PROBE1(name, a1)
+#define CUTELYST_PROBE2(name, a1, a2)
+#endif
+
+#endif // CUTELYST_PROBES_P_H
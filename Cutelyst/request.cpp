@@ -17,14 +17,27 @@
  * Boston, MA 02110-1301, USA.
  */
 #include "request_p.h"
+#include "keys_p.h"
 #include "engine.h"
 #include "common.h"
 #include "multipartformdataparser.h"
 #include "utils.h"
 
+#include <QtCore/QBuffer>
+#include <QtCore/QCache>
 #include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QJsonArray>
 #include <QtNetwork/QHostInfo>
 
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include <string.h>
+
 using namespace Cutelyst;
 
 Request::Request(RequestPrivate *prv) :
@@ -38,6 +51,16 @@ Request::~Request()
     delete d_ptr;
 }
 
+void *Request::operator new(size_t size)
+{
+    return MemoryPool<Request>::allocate(size);
+}
+
+void Request::operator delete(void *ptr, size_t size)
+{
+    MemoryPool<Request>::deallocate(ptr, size);
+}
+
 QHostAddress Request::address() const
 {
     Q_D(const Request);
@@ -163,6 +186,9 @@ void Request::setMatch(const QString &match)
 QStringList Request::arguments() const
 {
     Q_D(const Request);
+    if (d->argRangesSize > 0) {
+        d->materializeArguments();
+    }
     return d->args;
 }
 
@@ -170,6 +196,7 @@ void Request::setArguments(const QStringList &arguments)
 {
     Q_D(Request);
     d->args = arguments;
+    d->argRangesSize = -1;
 }
 
 QStringList Request::captures() const
@@ -205,6 +232,12 @@ QVariant Request::bodyData() const
     return d->bodyData;
 }
 
+QJsonValue Request::bodyJsonValue(const QString &pointer) const
+{
+    Q_D(const Request);
+    return d->bodyJsonValueLazy(pointer);
+}
+
 QVariantMap Request::bodyParametersVariant() const
 {
     return RequestPrivate::paramsMultiMapToVariantMap(bodyParameters());
@@ -242,6 +275,18 @@ ParamsMultiMap Request::queryParameters() const
     return d->queryParam;
 }
 
+QString Request::queryParameter(const QString &key, const QString &defaultValue) const
+{
+    Q_D(const Request);
+    return d->queryParamLazy(key, defaultValue);
+}
+
+QStringList Request::queryParameters(const QString &key) const
+{
+    Q_D(const Request);
+    return d->queryParamsLazy(key);
+}
+
 QVariantMap Request::parametersVariant() const
 {
     return RequestPrivate::paramsMultiMapToVariantMap(parameters());
@@ -258,14 +303,108 @@ ParamsMultiMap Request::parameters() const
     return d->param;
 }
 
+QString Request::negotiatedContentType(const QStringList &producible) const
+{
+    if (producible.isEmpty()) {
+        return QString();
+    }
+
+    const QString accept = headers().header(QStringLiteral("ACCEPT"));
+    if (accept.isEmpty()) {
+        return producible.first();
+    }
+
+    // Clients send identical Accept strings on every call, so the
+    // negotiation result is cached per worker thread keyed on the raw
+    // header plus the offered types.
+    static thread_local QCache<QString, QString> negotiationCache(1024);
+    const QString cacheKey = accept + QLatin1Char('\n') + producible.join(QLatin1Char(','));
+    if (const QString *cached = negotiationCache.object(cacheKey)) {
+        return *cached;
+    }
+
+    struct MediaRange {
+        QString type;
+        double q;
+        int specificity;
+    };
+    std::vector<MediaRange> ranges;
+
+    const QStringList parts = accept.split(QLatin1Char(','), QString::SkipEmptyParts);
+    ranges.reserve(parts.size());
+    for (const QString &part : parts) {
+        const QStringList params = part.split(QLatin1Char(';'), QString::SkipEmptyParts);
+        if (params.isEmpty()) {
+            continue;
+        }
+
+        MediaRange range;
+        range.type = params.first().trimmed().toLower();
+        range.q = 1.0;
+        for (int i = 1; i < params.size(); ++i) {
+            const QString param = params.at(i).trimmed();
+            if (param.startsWith(QLatin1String("q="))) {
+                bool ok;
+                const double q = param.mid(2).toDouble(&ok);
+                if (ok) {
+                    range.q = q;
+                }
+            }
+        }
+
+        if (range.type == QLatin1String("*/*")) {
+            range.specificity = 0;
+        } else if (range.type.endsWith(QLatin1String("/*"))) {
+            range.specificity = 1;
+        } else {
+            range.specificity = 2;
+        }
+        ranges.push_back(range);
+    }
+
+    // more specific ranges win among equal q-values, header order
+    // breaks the remaining ties
+    std::stable_sort(ranges.begin(), ranges.end(), [] (const MediaRange &a, const MediaRange &b) {
+        if (a.q != b.q) {
+            return a.q > b.q;
+        }
+        return a.specificity > b.specificity;
+    });
+
+    QString ret;
+    for (const MediaRange &range : ranges) {
+        if (range.q <= 0.0) {
+            // q=0 means explicitly not acceptable
+            continue;
+        }
+
+        for (const QString &offer : producible) {
+            const QString type = offer.toLower();
+            if (range.type == type
+                    || range.type == QLatin1String("*/*")
+                    || (range.type.endsWith(QLatin1String("/*"))
+                        && type.startsWith(range.type.leftRef(range.type.size() - 1)))) {
+                ret = offer;
+                break;
+            }
+        }
+        if (!ret.isEmpty()) {
+            break;
+        }
+    }
+
+    negotiationCache.insert(cacheKey, new QString(ret));
+    return ret;
+}
+
 QString Request::cookie(const QString &name) const
 {
     Q_D(const Request);
-    if (!(d->parserStatus & RequestPrivate::CookiesParsed)) {
-        d->parseCookies();
+    if (d->parserStatus & RequestPrivate::CookiesParsed) {
+        return d->cookies.value(name);
     }
 
-    return d->cookies.value(name);
+    return d->cookieValueLazy(name);
 }
 
 QMap<QString, QString> Request::cookies() const
@@ -292,13 +431,13 @@ QString Request::method() const
 bool Request::isPost() const
 {
     Q_D(const Request);
-    return d->method == QStringLiteral("POST");
+    return d->method == Keys::POST;
 }
 
 bool Request::isGet() const
 {
     Q_D(const Request);
-    return d->method == QStringLiteral("GET");
+    return d->method == Keys::GET;
 }
 
 QString Request::protocol() const
@@ -307,6 +446,12 @@ QString Request::protocol() const
     return d->protocol;
 }
 
+QByteArray Request::requestId() const
+{
+    Q_D(const Request);
+    return d->requestId;
+}
+
 QString Request::remoteUser() const
 {
     Q_D(const Request);
@@ -389,6 +534,133 @@ void *Request::engineData()
     return d->requestPtr;
 }
 
+void RequestPrivate::indexUrlQuery() const
+{
+    // Record the byte ranges of the key=value pairs without decoding
+    // anything, single parameter lookups only pay for what they read
+    if (query.indexOf('=') < 0) {
+        // no parameters, only keywords (if any)
+        parserStatus |= RequestPrivate::QueryIndexed;
+        return;
+    }
+
+    const char *data = query.constData();
+    const int len = query.length();
+    int start = 0;
+    while (start < len) {
+        int amp = query.indexOf('&', start);
+        if (amp == -1) {
+            amp = len;
+        }
+
+        if (amp > start) {
+            int equal = -1;
+            for (int i = start; i < amp; ++i) {
+                if (data[i] == '=') {
+                    equal = i;
+                    break;
+                }
+            }
+
+            QueryRange range;
+            if (equal == -1) {
+                range.keyStart    = start;
+                range.keyLength   = amp - start;
+                range.valueStart  = -1;
+                range.valueLength = 0;
+                queryIndex.push_back(range);
+            } else if (equal + 1 < amp) {
+                range.keyStart    = start;
+                range.keyLength   = equal - start;
+                range.valueStart  = equal + 1;
+                range.valueLength = amp - equal - 1;
+                queryIndex.push_back(range);
+            }
+            // pairs with an empty value are skipped like in parseUrlEncoded()
+        }
+
+        start = amp + 1;
+    }
+
+    parserStatus |= RequestPrivate::QueryIndexed;
+}
+
+bool RequestPrivate::queryKeyMatches(const QueryRange &range, const QString &key, const QByteArray &rawKey) const
+{
+    if (range.keyLength == rawKey.length()
+            && memcmp(query.constData() + range.keyStart, rawKey.constData(), range.keyLength) == 0) {
+        return true;
+    }
+
+    QByteArray candidate = query.mid(range.keyStart, range.keyLength);
+    if (candidate.contains('%') || candidate.contains('+')) {
+        return Utils::decodePercentEncoding(&candidate) == key;
+    }
+    return false;
+}
+
+QString RequestPrivate::queryParamLazy(const QString &key, const QString &defaultValue) const
+{
+    if (parserStatus & RequestPrivate::QueryParsed) {
+        return queryParam.value(key, defaultValue);
+    }
+
+    if (!(parserStatus & RequestPrivate::QueryIndexed)) {
+        indexUrlQuery();
+    }
+
+    const QByteArray rawKey = key.toLatin1();
+    for (const QueryRange &range : queryIndex) {
+        if (!queryKeyMatches(range, key, rawKey)) {
+            continue;
+        }
+
+        if (range.valueStart < 0) {
+            return QString();
+        }
+        QByteArray value = query.mid(range.valueStart, range.valueLength);
+        return Utils::decodePercentEncoding(&value);
+    }
+    return defaultValue;
+}
+
+QStringList RequestPrivate::queryParamsLazy(const QString &key) const
+{
+    if (parserStatus & RequestPrivate::QueryParsed) {
+        return queryParam.values(key);
+    }
+
+    if (!(parserStatus & RequestPrivate::QueryIndexed)) {
+        indexUrlQuery();
+    }
+
+    QStringList ret;
+    const QByteArray rawKey = key.toLatin1();
+    for (const QueryRange &range : queryIndex) {
+        if (!queryKeyMatches(range, key, rawKey)) {
+            continue;
+        }
+
+        if (range.valueStart < 0) {
+            ret.append(QString());
+        } else {
+            QByteArray value = query.mid(range.valueStart, range.valueLength);
+            ret.append(Utils::decodePercentEncoding(&value));
+        }
+    }
+    return ret;
+}
+
+void RequestPrivate::materializeArguments() const
+{
+    // ranges were recorded in peel order, last path segment first
+    for (int i = argRangesSize - 1; i >= 0; --i) {
+        QString arg = argsBuffer.mid(argRanges[i].start, argRanges[i].length);
+        args.append(Utils::decodePercentEncoding(&arg));
+    }
+    argRangesSize = -1;
+}
+
 void RequestPrivate::parseUrlQuery() const
 {
     // TODO move this to the asignment of query
@@ -434,7 +706,7 @@ void RequestPrivate::parseBody() const
             body->seek(0);
         }
 
-        uploads = MultiPartFormDataParser::parse(body, headers.header(QStringLiteral("CONTENT_TYPE")));
+        uploads = MultiPartFormDataParser::parse(body, headers.header(Keys::CONTENT_TYPE));
         auto it = uploads.crbegin();
         while (it != uploads.crend()) {
             Upload *upload = *it;
@@ -447,7 +719,14 @@ void RequestPrivate::parseBody() const
             body->seek(0);
         }
 
-        bodyData = QJsonDocument::fromJson(body->readAll());
+        auto buffer = qobject_cast<QBuffer *>(body);
+        if (buffer) {
+            // Parse straight from the post buffer, readAll()
+            // would copy the whole body first
+            bodyData = QJsonDocument::fromJson(buffer->data());
+        } else {
+            bodyData = QJsonDocument::fromJson(body->readAll());
+        }
     }
 
     if (!sequencial) {
@@ -457,6 +736,225 @@ void RequestPrivate::parseBody() const
     parserStatus |= RequestPrivate::BodyParsed;
 }
 
+static inline const char *jsonSkipWs(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        ++p;
+    }
+    return p;
+}
+
+// p points at the opening quote, returns one past the closing quote
+static inline const char *jsonSkipString(const char *p, const char *end)
+{
+    ++p;
+    while (p < end) {
+        if (*p == '\\') {
+            p += 2;
+        } else if (*p == '"') {
+            return p + 1;
+        } else {
+            ++p;
+        }
+    }
+    return end;
+}
+
+static const char *jsonSkipValue(const char *p, const char *end)
+{
+    p = jsonSkipWs(p, end);
+    if (p >= end) {
+        return end;
+    }
+
+    if (*p == '"') {
+        return jsonSkipString(p, end);
+    }
+
+    if (*p == '{' || *p == '[') {
+        // strings are the only place braces do not nest
+        int depth = 0;
+        while (p < end) {
+            if (*p == '"') {
+                p = jsonSkipString(p, end);
+            } else if (*p == '{' || *p == '[') {
+                ++depth;
+                ++p;
+            } else if (*p == '}' || *p == ']') {
+                ++p;
+                if (--depth == 0) {
+                    return p;
+                }
+            } else {
+                ++p;
+            }
+        }
+        return end;
+    }
+
+    // number, true, false or null
+    while (p < end && *p != ',' && *p != '}' && *p != ']'
+           && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+        ++p;
+    }
+    return p;
+}
+
+QJsonValue RequestPrivate::bodyJsonValueLazy(const QString &pointer) const
+{
+    QJsonValue ret(QJsonValue::Undefined);
+
+    const QVector<QStringRef> tokens = pointer.splitRef(QLatin1Char('/'), QString::SkipEmptyParts);
+    if (tokens.isEmpty() || !body) {
+        return ret;
+    }
+
+    // once the whole document was materialized walking its tree is
+    // cheaper than scanning the bytes again
+    if ((parserStatus & RequestPrivate::BodyParsed)
+            && bodyData.canConvert<QJsonDocument>()) {
+        const QJsonDocument doc = qvariant_cast<QJsonDocument>(bodyData);
+        QJsonValue value = doc.isArray() ? QJsonValue(doc.array()) : QJsonValue(doc.object());
+        for (const QStringRef &token : tokens) {
+            if (value.isObject()) {
+                value = value.toObject().value(token.toString());
+            } else if (value.isArray()) {
+                bool ok;
+                const int index = token.toInt(&ok);
+                if (!ok || index < 0) {
+                    return ret;
+                }
+                value = value.toArray().at(index);
+            } else {
+                return ret;
+            }
+        }
+        return value;
+    }
+
+    if (headers.contentType() != QLatin1String("application/json")) {
+        return ret;
+    }
+
+    QByteArray raw;
+    const qint64 posOrig = body->pos();
+    auto buffer = qobject_cast<QBuffer *>(body);
+    if (buffer) {
+        // scan the post buffer in place
+        raw = buffer->data();
+    } else {
+        if (body->isSequential() && posOrig) {
+            return ret;
+        }
+        if (posOrig) {
+            body->seek(0);
+        }
+        raw = body->readAll();
+        if (!body->isSequential()) {
+            body->seek(posOrig);
+        }
+    }
+
+    const char *p = raw.constData();
+    const char *end = p + raw.size();
+
+    for (const QStringRef &token : tokens) {
+        p = jsonSkipWs(p, end);
+        if (p >= end) {
+            return ret;
+        }
+
+        if (*p == '{') {
+            const QByteArray key = token.toUtf8();
+            ++p;
+            bool found = false;
+            while (p < end) {
+                p = jsonSkipWs(p, end);
+                if (p >= end || *p == '}') {
+                    break;
+                }
+                if (*p == ',') {
+                    ++p;
+                    continue;
+                }
+                if (*p != '"') {
+                    return ret;
+                }
+
+                const char *keyStart = p + 1;
+                const char *keyEnd = jsonSkipString(p, end);
+                p = jsonSkipWs(keyEnd, end);
+                if (p >= end || *p != ':') {
+                    return ret;
+                }
+                ++p;
+
+                if (keyEnd - keyStart - 1 == key.size()
+                        && memcmp(keyStart, key.constData(), size_t(key.size())) == 0) {
+                    // p now sits on the member's value
+                    found = true;
+                    break;
+                }
+                p = jsonSkipValue(p, end);
+            }
+            if (!found) {
+                return ret;
+            }
+        } else if (*p == '[') {
+            bool ok;
+            int index = token.toInt(&ok);
+            if (!ok || index < 0) {
+                return ret;
+            }
+            ++p;
+            while (index-- > 0) {
+                p = jsonSkipValue(p, end);
+                p = jsonSkipWs(p, end);
+                if (p >= end || *p != ',') {
+                    return ret;
+                }
+                ++p;
+            }
+            p = jsonSkipWs(p, end);
+            if (p >= end || *p == ']') {
+                return ret;
+            }
+        } else {
+            return ret;
+        }
+    }
+
+    // materialize just the addressed subtree
+    p = jsonSkipWs(p, end);
+    const char *valueEnd = jsonSkipValue(p, end);
+    if (valueEnd <= p) {
+        return ret;
+    }
+
+    if (*p == '{' || *p == '[') {
+        const QJsonDocument doc = QJsonDocument::fromJson(
+                    QByteArray::fromRawData(p, int(valueEnd - p)));
+        if (doc.isArray()) {
+            ret = doc.array();
+        } else if (doc.isObject()) {
+            ret = doc.object();
+        }
+        return ret;
+    }
+
+    // scalars are not a valid document root on their own
+    QByteArray wrapped;
+    wrapped.reserve(int(valueEnd - p) + 2);
+    wrapped.append('[');
+    wrapped.append(p, int(valueEnd - p));
+    wrapped.append(']');
+    const QJsonDocument doc = QJsonDocument::fromJson(wrapped);
+    if (doc.isArray() && !doc.array().isEmpty()) {
+        ret = doc.array().first();
+    }
+    return ret;
+}
+
 static inline bool isSlit(QChar c)
 {
     return c == QLatin1Char(';') || c == QLatin1Char(',');
@@ -527,7 +1025,7 @@ static std::pair<QString, QString> nextField(const QString &text, int &position)
 void RequestPrivate::parseCookies() const
 {
     std::vector<std::pair<QString, QString> > ret;
-    const QString cookieString = headers.header(QStringLiteral("COOKIE"));
+    const QString cookieString = headers.header(Keys::COOKIE);
     int position = 0;
     const int length = cookieString.length();
     while (position < length) {
@@ -556,35 +1054,97 @@ void RequestPrivate::parseCookies() const
     parserStatus |= RequestPrivate::CookiesParsed;
 }
 
-ParamsMultiMap RequestPrivate::parseUrlEncoded(const QByteArray &line)
+QString RequestPrivate::cookieValueLazy(const QString &name) const
 {
-    ParamsMultiMap ret;
-    int from = line.length();
-    int pos = from;
+    if (cookieCacheSet && cookieCacheName == name) {
+        return cookieCacheValue;
+    }
 
-    while (pos > 0) {
-        from = pos - 1;
-        pos = line.lastIndexOf('&', from);
+    // Single forward scan that stops at the named cookie, without
+    // materializing the map entries for the other cookies. The first
+    // occurrence wins, matching what the parsed map returns.
+    QString value;
+    const QString cookieString = headers.header(Keys::COOKIE);
+    int position = 0;
+    const int length = cookieString.length();
+    while (position < length) {
+        const auto field = nextField(cookieString, position);
+        if (field.first.isEmpty()) {
+            // parsing error
+            break;
+        }
 
-        int len = from - pos;
-        if (len == 0) {
-            // Skip empty strings
-            --from;
-            continue;
+        if (field.first == name && !field.second.isEmpty()) {
+            value = field.second;
+            break;
         }
+        ++position;
+    }
+
+    cookieCacheName = name;
+    cookieCacheValue = value;
+    cookieCacheSet = true;
 
-        QByteArray data = line.mid(pos + 1, len);
+    return value;
+}
 
-        int equal = data.indexOf('=');
-        if (equal != -1) {
-            QByteArray value = data.mid(equal + 1);
-            if (value.length()) {
-                QByteArray key = data.mid(0, equal);
-                ret.insertMulti(Utils::decodePercentEncoding(&key),
-                                Utils::decodePercentEncoding(&value));
+static inline QString decodeUrlEncodedSlice(const QByteArray &line, int start, int length)
+{
+    const char *data = line.constData() + start;
+    int i = 0;
+    while (i < length && data[i] != '%' && data[i] != '+') {
+        ++i;
+    }
+    if (i == length) {
+        // nothing encoded, skip the intermediate buffer
+        return QString::fromUtf8(data, length);
+    }
+
+    QByteArray aux(data, length);
+    return Utils::decodePercentEncoding(&aux);
+}
+
+ParamsMultiMap RequestPrivate::parseUrlEncoded(const QByteArray &line)
+{
+    ParamsMultiMap ret;
+
+    // Single forward pass over the bytes. memchr() is what the libc
+    // vectorizes, so the delimiter scans go through it instead of
+    // per-byte index loops, and each '=' is only looked for inside
+    // its own pair. The pairs are collected first and inserted back
+    // to front because insertMulti() prepends, and the parsed map
+    // must keep the first occurrence of a repeated key in front.
+    struct Pair {
+        int start;
+        int equal; // -1 when the pair has no '='
+        int end;
+    };
+    std::vector<Pair> pairs;
+    pairs.reserve(16);
+
+    const char *data = line.constData();
+    const int size = line.size();
+
+    int start = 0;
+    while (start < size) {
+        auto amp = static_cast<const char *>(memchr(data + start, '&', size_t(size - start)));
+        const int end = amp ? int(amp - data) : size;
+        if (end > start) {
+            auto eq = static_cast<const char *>(memchr(data + start, '=', size_t(end - start)));
+            pairs.push_back({ start, eq ? int(eq - data) : -1, end });
+        }
+        start = end + 1;
+    }
+
+    for (auto it = pairs.crbegin(); it != pairs.crend(); ++it) {
+        if (it->equal != -1) {
+            const int valueLength = it->end - it->equal - 1;
+            if (valueLength) {
+                ret.insertMulti(decodeUrlEncodedSlice(line, it->start, it->equal - it->start),
+                                decodeUrlEncodedSlice(line, it->equal + 1, valueLength));
             }
         } else {
-            ret.insertMulti(Utils::decodePercentEncoding(&data),
+            ret.insertMulti(decodeUrlEncodedSlice(line, it->start, it->end - it->start),
                             QString());
         }
     }
@@ -608,6 +1168,51 @@ RequestPrivate::RequestPrivate(const EngineRequest &req, Engine *_engine)
     , remotePort(req.remotePort)
     , https(req.isSecure)
 {
+    initRequestId();
+}
+
+RequestPrivate::RequestPrivate(EngineRequest &&req, Engine *_engine)
+    : engine(_engine)
+    , method(std::move(req.method))
+    , path(std::move(req.path))
+    , query(std::move(req.query))
+    , protocol(std::move(req.protocol))
+    // connection-scoped fields are copied, the engine keeps them
+    // valid across the requests of a connection
+    , serverAddress(req.serverAddress)
+    , remoteAddress(req.remoteAddress)
+    , remoteUser(req.remoteUser)
+    , headers(std::move(req.headers))
+    , body(req.body)
+    , startOfRequest(req.startOfRequest)
+    , requestPtr(req.requestPtr)
+    , remotePort(req.remotePort)
+    , https(req.isSecure)
+{
+    initRequestId();
+}
+
+void RequestPrivate::initRequestId()
+{
+    // Reuse the correlation id a front proxy already assigned,
+    // otherwise stamp a fixed-width local one: a boot-random prefix
+    // per worker thread plus a counter, formatted once
+    const QString incoming = headers.header(Keys::X_REQUEST_ID);
+    if (!incoming.isEmpty() && incoming.size() <= 64) {
+        requestId = incoming.toLatin1();
+    } else {
+        static thread_local quint64 prefix = 0;
+        static thread_local quint64 counter = 0;
+        if (!prefix) {
+            std::random_device rd;
+            prefix = (quint64(rd()) << 32) | rd();
+        }
+        char buf[32];
+        const int len = snprintf(buf, sizeof(buf), "%016llx-%08llx",
+                                 static_cast<unsigned long long>(prefix),
+                                 static_cast<unsigned long long>(++counter));
+        requestId = QByteArray(buf, len);
+    }
 }
 
 QVariantMap RequestPrivate::paramsMultiMapToVariantMap(const ParamsMultiMap &params)
@@ -22,6 +22,7 @@
 
 #include <QtCore/qobject.h>
 #include <QtCore/qstringlist.h>
+#include <QtCore/qjsonvalue.h>
 
 #include <Cutelyst/cutelyst_global.h>
 #include <Cutelyst/paramsmultimap.h>
@@ -68,6 +69,18 @@ class CUTELYST_LIBRARY Request : public QObject
 public:
     virtual ~Request();
 
+    /*!
+     * \internal
+     * Request shells are created by the engines once per request and
+     * recycled through the per worker-core pool.
+     */
+    void *operator new(size_t size);
+
+    /*!
+     * \internal
+     */
+    void operator delete(void *ptr, size_t size);
+
     /**
      * Returns the address of the client
      */
@@ -206,6 +219,28 @@ public:
      */
     QVariant bodyData() const;
 
+    /**
+     * Returns a single value extracted from an 'application/json'
+     * body without materializing the whole document. \p pointer is a
+     * '/' separated path into the tree, numeric tokens index arrays:
+     *
+     * \code
+     * QString repo = c->req()->bodyJsonValue(QStringLiteral("repository/full_name")).toString();
+     * \endcode
+     *
+     * The raw bytes are scanned and only the addressed subtree is
+     * parsed, so picking a couple of fields out of a large webhook
+     * payload does not pay for a full tree. Object keys are matched
+     * byte-wise against the UTF-8 of the token, keys that need JSON
+     * escaping cannot be addressed this way. Returns an undefined
+     * QJsonValue when the path does not resolve; the bodyData()
+     * QJsonDocument path is unaffected, and once that document was
+     * materialized it is walked instead of scanning again.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    QJsonValue bodyJsonValue(const QString &pointer) const;
+
     /**
      * Returns a QVariantMap of body (POST) parameters, this method
      * is expensive as it creates the map each time it's called, cache
@@ -265,14 +300,16 @@ public:
     ParamsMultiMap queryParameters() const;
 
     /**
-     * Convenience method for geting a single query value passing a key and an optional default value
+     * Convenience method for geting a single query value passing a key and an optional default value,
+     * only the matching parameter is percent-decoded
      */
-    inline QString queryParameter(const QString &key, const QString &defaultValue = QString()) const;
+    QString queryParameter(const QString &key, const QString &defaultValue = QString()) const;
 
     /**
-     * Convenience method for geting all query values passing a key
+     * Convenience method for geting all query values passing a key,
+     * only the matching parameters are percent-decoded
      */
-    inline QStringList queryParameters(const QString &key) const;
+    QStringList queryParameters(const QString &key) const;
 
     /**
      * Short for queryParameters()
@@ -329,6 +366,17 @@ public:
      */
     inline QString contentType() const;
 
+    /**
+     * Returns the entry of producible that best satisfies the
+     * request's Accept header, honoring q-values and wildcard media
+     * ranges. Returns the first entry when there is no Accept header
+     * and a null string when nothing is acceptable. Clients repeat
+     * the same Accept string on every call, so results are cached per
+     * worker thread keyed on the raw header.
+     * \since Cutelyst 1.10.0
+     */
+    QString negotiatedContentType(const QStringList &producible) const;
+
     /**
      * Returns the cookie with the given name
      */
@@ -369,6 +417,18 @@ public:
      */
     QString protocol() const;
 
+    /**
+     * Returns the correlation id of this request. When the client or
+     * a front proxy sent an X-Request-Id header that value is kept,
+     * otherwise a fixed-width id is generated from a per worker
+     * boot-random prefix and a counter, which is far cheaper than a
+     * UUID. The id is echoed back in the response X-Request-Id header
+     * and is meant to be included in application log lines so a
+     * request can be followed across services.
+     * \since 1.10.0
+     */
+    QByteArray requestId() const;
+
     /**
      * Returns the user agent (browser) version string.
      */
@@ -502,6 +562,7 @@ protected:
 private:
     friend class Application;
     friend class Dispatcher;
+    friend class DispatcherPrivate;
     friend class DispatchType;
     Q_DECLARE_PRIVATE(Request)
 };
@@ -524,20 +585,14 @@ inline QString Request::bodyParam(const QString &key, const QString &defaultValu
 inline QStringList Request::bodyParams(const QString &key) const
 { return bodyParameters().values(key); }
 
-inline QString Request::queryParameter(const QString &key, const QString &defaultValue) const
-{ return queryParameters().value(key, defaultValue); }
-
-inline QStringList Request::queryParameters(const QString &key) const
-{ return queryParameters().values(key); }
-
 inline ParamsMultiMap Request::queryParams() const
 { return queryParameters(); }
 
 inline QString Request::queryParam(const QString &key, const QString &defaultValue) const
-{ return queryParameters().value(key, defaultValue); }
+{ return queryParameter(key, defaultValue); }
 
 inline QStringList Request::queryParams(const QString &key) const
-{ return queryParameters().values(key); }
+{ return queryParameters(key); }
 
 inline QString Request::param(const QString &key, const QString &defaultValue) const
 { return parameters().value(key, defaultValue); }
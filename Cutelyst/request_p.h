@@ -24,11 +24,15 @@
 #include "engine.h"
 #include "upload.h"
 
+#include "memorypool_p.h"
+
 #include <QtCore/QStringList>
 #include <QtCore/QUrlQuery>
 #include <QtCore/QUrl>
 #include <QtNetwork/QHostAddress>
 
+#include <vector>
+
 
 namespace Cutelyst {
 
@@ -36,6 +40,8 @@ class Engine;
 class RequestPrivate
 {
 public:
+    CUTELYST_MEMORY_POOLED(RequestPrivate)
+
     enum ParserStatusFlag {
         NotParsed = 0x00,
         UrlParsed = 0x01,
@@ -44,14 +50,34 @@ public:
         QueryParsed = 0x08,
         BodyParsed = 0x10,
         ParamParsed = 0x20,
+        QueryIndexed = 0x40,
     };
     Q_DECLARE_FLAGS(ParserStatus, ParserStatusFlag)
 
+    // Byte range of one key=value pair inside query,
+    // decoded only when the key is actually requested
+    struct QueryRange {
+        int keyStart;
+        int keyLength;
+        int valueStart; // -1 when the pair has no '='
+        int valueLength;
+    };
+
     RequestPrivate(const EngineRequest &req, Engine *_engine);
+    RequestPrivate(EngineRequest &&req, Engine *_engine);
+
+    void initRequestId();
 
     inline void parseUrlQuery() const;
     inline void parseBody() const;
+    QJsonValue bodyJsonValueLazy(const QString &pointer) const;
     inline void parseCookies() const;
+    QString cookieValueLazy(const QString &name) const;
+
+    inline void indexUrlQuery() const;
+    inline bool queryKeyMatches(const QueryRange &range, const QString &key, const QByteArray &rawKey) const;
+    QString queryParamLazy(const QString &key, const QString &defaultValue) const;
+    QStringList queryParamsLazy(const QString &key) const;
 
     static inline ParamsMultiMap parseUrlEncoded(const QByteArray &line);
     static inline QVariantMap paramsMultiMapToVariantMap(const ParamsMultiMap &params);
@@ -68,6 +94,9 @@ public:
     QString remoteUser;
     Headers headers;
     QIODevice *body = nullptr;
+    // Correlation id, generated or taken from the incoming
+    // X-Request-Id header; echoed back when headers are finalized
+    QByteArray requestId;
     mutable QString remoteHostname;
     quint64 startOfRequest;
     quint64 endOfRequest;
@@ -75,14 +104,33 @@ public:
     void *requestPtr = nullptr;
 
     // Engines don't need to touch this
-    QStringList args;
+    mutable QStringList args;
     QStringList captures;
     QString match;
 
+    // Arguments the dispatcher peeled off the path, kept as ranges
+    // into argsBuffer and decoded into args only when they are read;
+    // counts are bounded in practice so the storage is inline
+    enum { MaxArgRanges = 8 };
+    struct ArgRange {
+        int start;
+        int length;
+    };
+    void materializeArguments() const;
+    QString argsBuffer;
+    ArgRange argRanges[MaxArgRanges];
+    mutable int argRangesSize = -1; // committed by the match, -1 when none
+    bool argsLazy = false;
+
     mutable QUrl url;
     mutable QString base;
     mutable QMap<QString, QString> cookies;
+    // One-entry cache for the common handler that reads a single
+    // cookie out of a header carrying a dozen foreign ones
+    mutable QString cookieCacheName;
+    mutable QString cookieCacheValue;
     mutable ParamsMultiMap queryParam;
+    mutable std::vector<QueryRange> queryIndex;
     mutable QString queryKeywords;
     mutable ParamsMultiMap bodyParam;
     mutable QVariant bodyData;
@@ -93,6 +141,7 @@ public:
 
     quint16 remotePort;
     bool https = false;
+    mutable bool cookieCacheSet = false;
 };
 
 }
@@ -18,6 +18,7 @@
  */
 
 #include "response_p.h"
+#include "keys_p.h"
 
 #include "context_p.h"
 #include "engine.h"
@@ -53,29 +54,66 @@ qint64 Response::writeData(const char *data, qint64 len)
 
     // Finalize headers if someone manually writes output
     if (!(d->flags & ResponsePrivate::FinalizedHeaders)) {
-        if (d->headers.header(QStringLiteral("TRANSFER_ENCODING")) == QLatin1String("chunked")) {
-            d->flags |= ResponsePrivate::IOWrite | ResponsePrivate::Chunked;
-        } else {
-            // When chunked encoding is not set the client can only know
-            // that data is finished if we close the connection
-            d->headers.setHeader(QStringLiteral("CONNECTION"), QStringLiteral("close"));
-            d->flags |= ResponsePrivate::IOWrite;
-        }
-        delete d->bodyIODevice;
-        d->bodyIODevice = nullptr;
-        d->bodyData = QByteArray();
-
-        d->engine->finalizeHeaders(d->context);
+        d->beginWrite();
     }
 
     return d->engine->write(d->context, data, len, d->context->engineData());
 }
 
+void ResponsePrivate::beginWrite()
+{
+    if (headers.header(Keys::TRANSFER_ENCODING) == QLatin1String("chunked")) {
+        flags |= IOWrite | Chunked;
+    } else if (headers.contentLength() < 0 &&
+               engine->supportsChunkedResponse(context, context->engineData())) {
+        // The body size is unknown but the client understands
+        // chunked encoding, use it so the connection survives
+        // the streamed response
+        headers.setHeader(Keys::TRANSFER_ENCODING, QStringLiteral("chunked"));
+        flags |= IOWrite | Chunked;
+    } else {
+        // When chunked encoding is not set the client can only know
+        // that data is finished if we close the connection
+        headers.setHeader(Keys::CONNECTION, QStringLiteral("close"));
+        flags |= IOWrite;
+    }
+
+    if (!trailers.empty() && (flags & Chunked)) {
+        // announce the fields following the last chunk, RFC 7230 4.4
+        QString names;
+        for (const auto &trailer : trailers) {
+            if (!names.isEmpty()) {
+                names += QLatin1String(", ");
+            }
+            names += trailer.first;
+        }
+        headers.setHeader(Keys::TRAILER, names);
+    }
+
+    delete bodyIODevice;
+    bodyIODevice = nullptr;
+    bodyData = QByteArray();
+    bodyChunks.clear();
+    bodyChunksSize = 0;
+
+    engine->finalizeHeaders(context);
+}
+
 Response::~Response()
 {
     delete d_ptr;
 }
 
+void *Response::operator new(size_t size)
+{
+    return MemoryPool<Response>::allocate(size);
+}
+
+void Response::operator delete(void *ptr, size_t size)
+{
+    MemoryPool<Response>::deallocate(ptr, size);
+}
+
 quint16 Response::status() const
 {
     Q_D(const Response);
@@ -91,7 +129,7 @@ void Response::setStatus(quint16 status)
 bool Response::hasBody() const
 {
     Q_D(const Response);
-    return !d->bodyData.isEmpty() || d->bodyIODevice || d->flags & ResponsePrivate::IOWrite;
+    return !d->bodyData.isEmpty() || !d->bodyChunks.empty() || d->bodyIODevice || d->flags & ResponsePrivate::IOWrite;
 }
 
 QByteArray &Response::body()
@@ -102,6 +140,9 @@ QByteArray &Response::body()
         d->bodyIODevice = nullptr;
     }
 
+    // handing out the QByteArray requires one flat buffer
+    d->flattenBodyChunks();
+
     return d->bodyData;
 }
 
@@ -130,6 +171,22 @@ void Response::setBody(const QByteArray &body)
     d->setBodyData(body);
 }
 
+void Response::appendBody(const QByteArray &data)
+{
+    Q_D(Response);
+    if (data.isEmpty() || (d->flags & ResponsePrivate::IOWrite)) {
+        return;
+    }
+
+    if (d->bodyIODevice) {
+        delete d->bodyIODevice;
+        d->bodyIODevice = nullptr;
+    }
+
+    d->bodyChunks.push_back(data);
+    d->bodyChunksSize += data.size();
+}
+
 void Response::setJsonBody(const QJsonDocument &documment)
 {
     Q_D(Response);
@@ -221,13 +278,17 @@ void Response::redirect(const QUrl &url, quint16 status)
     d->status = status;
 
     if (url.isValid()) {
-        const QString location = QString::fromLatin1(url.toEncoded(QUrl::FullyEncoded));
+        const QByteArray encoded = url.toEncoded(QUrl::FullyEncoded);
+        const QString location = QString::fromLatin1(encoded);
         qCDebug(CUTELYST_RESPONSE) << "Redirecting to" << location << status;
 
-        d->headers.setHeader(QStringLiteral("LOCATION"), location);
+        d->headers.setHeader(Keys::LOCATION, location);
         d->headers.setContentType(QStringLiteral("text/html; charset=utf-8"));
 
-        const QString buf = QStringLiteral(
+        // The page scaffolding never changes, only the destination is
+        // spliced in; keep the pieces pre-built and assemble the body
+        // in a single allocation
+        static const QByteArray prefix = QByteArrayLiteral(
                     "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0"
                     "Strict//EN\" \"http://www.w3.org/TR/xhtml1/DTD/xhtml1-strict.dtd\">\n"
                     "<html xmlns=\"http://www.w3.org/1999/xhtml\">\n"
@@ -235,17 +296,42 @@ void Response::redirect(const QUrl &url, quint16 status)
                     "    <title>Moved</title>\n"
                     "  </head>\n"
                     "  <body>\n"
-                    "     <p>This item has moved <a href=") + location +
-                QStringLiteral(">here</a>.</p>\n"
-                               "  </body>\n"
-                               "</html>\n");
+                    "     <p>This item has moved <a href=");
+        static const QByteArray suffix = QByteArrayLiteral(
+                    ">here</a>.</p>\n"
+                    "  </body>\n"
+                    "</html>\n");
+
+        QByteArray buf;
+        buf.reserve(prefix.size() + encoded.size() + suffix.size());
+        buf.append(prefix);
+        buf.append(encoded);
+        buf.append(suffix);
         setBody(buf);
     } else {
-        d->headers.removeHeader(QStringLiteral("LOCATION"));
+        d->headers.removeHeader(Keys::LOCATION);
         qCDebug(CUTELYST_ENGINE) << "Invalid redirect removing header" << url << status;
     }
 }
 
+void Response::redirectNoContent(const QUrl &url, quint16 status)
+{
+    Q_D(Response);
+    d->location = url;
+    d->status = status;
+
+    if (url.isValid()) {
+        const QString location = QString::fromLatin1(url.toEncoded(QUrl::FullyEncoded));
+        qCDebug(CUTELYST_RESPONSE) << "Redirecting to" << location << status;
+
+        d->headers.setHeader(Keys::LOCATION, location);
+        setBody(QByteArray());
+    } else {
+        d->headers.removeHeader(Keys::LOCATION);
+        qCDebug(CUTELYST_RESPONSE) << "Invalid redirect removing header" << url << status;
+    }
+}
+
 void Response::redirect(const QString &url, quint16 status)
 {
     redirect(QUrl(url), status);
@@ -292,7 +378,20 @@ qint64 Response::size() const
     } else if (d->bodyIODevice) {
         return d->bodyIODevice->size();
     } else {
-        return d->bodyData.size();
+        return d->bodyData.size() + d->bodyChunksSize;
+    }
+}
+
+void Response::stripDefaultHeaders()
+{
+    Q_D(Response);
+    const auto defaults = d->engine->defaultHeaders().rawData();
+    auto it = defaults.constBegin();
+    while (it != defaults.constEnd()) {
+        // raw keys are already normalized, removeHeader() would
+        // normalize them a second time
+        d->headers.removeRawHeader(it.key());
+        ++it;
     }
 }
 
@@ -326,6 +425,96 @@ bool Response::webSocketClose(quint16 code, const QString &reason)
     return d->engine->webSocketClose(d->context, code, reason);
 }
 
+bool Response::flushHeaders()
+{
+    Q_D(Response);
+    if (d->flags & ResponsePrivate::FinalizedHeaders) {
+        return false;
+    }
+
+    d->beginWrite();
+    return true;
+}
+
+void Response::setTrailer(const QString &field, const QString &value)
+{
+    Q_D(Response);
+    for (auto &trailer : d->trailers) {
+        if (trailer.first == field) {
+            trailer.second = value;
+            return;
+        }
+    }
+    d->trailers.push_back({ field, value });
+}
+
+bool Response::eventStreamStart(quint32 retry)
+{
+    Q_D(Response);
+    if (d->flags & ResponsePrivate::FinalizedHeaders) {
+        return false;
+    }
+
+    d->headers.setContentType(QStringLiteral("text/event-stream"));
+    d->headers.setHeader(Keys::CACHE_CONTROL, QStringLiteral("no-cache"));
+    d->headers.setHeader(Keys::TRANSFER_ENCODING, QStringLiteral("chunked"));
+
+    // the first write pushes the headers out, a retry directive or a
+    // bare comment line carries no event the client would see
+    QByteArray opening;
+    if (retry) {
+        opening = QByteArrayLiteral("retry: ") + QByteArray::number(retry) + QByteArrayLiteral("\n\n");
+    } else {
+        opening = QByteArrayLiteral(":\n\n");
+    }
+    return write(opening) == opening.size();
+}
+
+QByteArray Response::eventStreamFrame(const QByteArray &data, const QByteArray &event, const QByteArray &id)
+{
+    QByteArray frame;
+    frame.reserve(data.size() + event.size() + id.size() + 32);
+
+    if (!event.isEmpty()) {
+        frame.append("event: ", 7);
+        frame.append(event);
+        frame.append('\n');
+    }
+
+    if (!id.isEmpty()) {
+        frame.append("id: ", 4);
+        frame.append(id);
+        frame.append('\n');
+    }
+
+    int start = 0;
+    Q_FOREVER {
+        frame.append("data: ", 6);
+        const int nl = data.indexOf('\n', start);
+        if (nl == -1) {
+            frame.append(data.constData() + start, data.size() - start);
+            frame.append('\n');
+            break;
+        }
+        frame.append(data.constData() + start, nl - start);
+        frame.append('\n');
+        start = nl + 1;
+    }
+    frame.append('\n');
+
+    return frame;
+}
+
+bool Response::sendEvent(const QByteArray &data, const QByteArray &event, const QByteArray &id)
+{
+    return sendEventFrame(eventStreamFrame(data, event, id));
+}
+
+bool Response::sendEventFrame(const QByteArray &frame)
+{
+    return write(frame) == frame.size();
+}
+
 void ResponsePrivate::setBodyData(const QByteArray &body)
 {
     if (!(flags & ResponsePrivate::IOWrite)) {
@@ -333,9 +522,25 @@ void ResponsePrivate::setBodyData(const QByteArray &body)
             delete bodyIODevice;
             bodyIODevice = nullptr;
         }
+        bodyChunks.clear();
+        bodyChunksSize = 0;
         bodyData = body;
         headers.setContentLength(body.size());
     }
 }
 
+void ResponsePrivate::flattenBodyChunks()
+{
+    if (bodyChunks.empty()) {
+        return;
+    }
+
+    bodyData.reserve(bodyData.size() + int(bodyChunksSize));
+    for (const QByteArray &chunk : bodyChunks) {
+        bodyData.append(chunk);
+    }
+    bodyChunks.clear();
+    bodyChunksSize = 0;
+}
+
 #include "moc_response.cpp"
@@ -104,6 +104,18 @@ public:
 
     virtual ~Response();
 
+    /*!
+     * \internal
+     * One Response exists per request, the blocks are recycled
+     * through the per worker-core pool.
+     */
+    void *operator new(size_t size);
+
+    /*!
+     * \internal
+     */
+    void operator delete(void *ptr, size_t size);
+
     /**
      * The current response code status
      */
@@ -154,6 +166,14 @@ public:
      */
     inline void setBody(const QString &body);
 
+    /**
+     * Appends data to the response body without copying what was
+     * appended before, the engine writes the pieces out in sequence.
+     * Prefer this over growing body() when building large responses
+     * incrementally. Content length is set when headers are finalized.
+     */
+    void appendBody(const QByteArray &data);
+
     /**
      * Sets a QJsonDocument as the response body,
      * using toJson(QJsonDocument::Compact) output and setting
@@ -254,6 +274,23 @@ public:
      */
     void redirect(const QString &url, quint16 status = Found);
 
+    /**
+     * Causes the response to redirect to the specified URL without an
+     * HTML body, the default status is 302. Unlike redirect() no "moved
+     * here" page is generated: only the Location header and an empty
+     * body are emitted, which is what every current user agent needs
+     * and is noticeably cheaper on endpoints that issue redirects in
+     * volume, like authentication handlers.
+     *
+     * \note do not give a relative URL as $url, i.e: one that is not fully
+     * qualified ("http://...", etc.) or that starts with a slash "/path/here".
+     * While it may work, it is not guaranteed to do the right thing and is not a
+     * standard behaviour. You may opt to use uriFor() or uriForAction() instead.
+     *
+     * \since 1.10.0
+     */
+    void redirectNoContent(const QUrl &url, quint16 status = Found);
+
     /**
      * Returns the HTTP location set by the redirect
      */
@@ -285,6 +322,17 @@ public:
     virtual qint64 size() const override;
 
 
+    /*!
+     * Removes the application-wide default headers (see
+     * Application::defaultHeaders()) from this response, so internal
+     * endpoints like health checks or metrics scrapes do not pay for
+     * decorative headers on every reply. Headers set explicitly on
+     * this response with the same field names are removed as well.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void stripDefaultHeaders();
+
     /*!
      * Sends the websocket handshake, if no parameters are defined it will use header data.
      * Returns true in case of success, false otherwise, which can be due missing support on
@@ -313,6 +361,77 @@ public:
      */
     bool webSocketClose(quint16 code = Response::CloseCodeNormal, const QString &reason = QString());
 
+    /*!
+     * Sends the status line and the current headers to the client
+     * right away instead of on the first body write, so the time to
+     * first byte does not include computing the body. When no content
+     * length is set the response enters chunked mode, each following
+     * write() goes out as its own chunk; actions streaming a slowly
+     * computed body should flush the headers first and write pieces
+     * as they become ready.
+     *
+     * After this call the headers, status and cookies can no longer
+     * be changed. Returns false if they were already sent.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    bool flushHeaders();
+
+    /*!
+     * Sets the trailing header \p field to \p value, sent after the
+     * last chunk of a chunked response. Trailers carry values that
+     * are only known once the body was streamed, like a checksum or
+     * a record count; they can be set or changed up to the end of
+     * the action. Fields set before the headers are sent are
+     * announced with a Trailer header.
+     *
+     * Trailers are silently dropped when the response does not end
+     * up using chunked transfer encoding.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setTrailer(const QString &field, const QString &value);
+
+    /*!
+     * Promotes this response to a Server-Sent Events stream: sets the
+     * text/event-stream content type, disables caching, enters chunked
+     * mode so the connection survives for the lifetime of the stream
+     * and flushes the headers right away. When \p retry is non zero it
+     * is sent as the stream's reconnection time in milliseconds.
+     *
+     * Returns false if the headers were already sent. The stream stays
+     * open until the action finishes with detachAsync() semantics or
+     * the client disconnects.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    bool eventStreamStart(quint32 retry = 0);
+
+    /*!
+     * Encodes one Server-Sent Events frame with optional \p event type
+     * and \p id fields, splitting multi line \p data over data: lines.
+     * Broadcasters should encode a frame once and hand the same byte
+     * array to sendEventFrame() on every stream, the implicit sharing
+     * makes the fanout copy free.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    static QByteArray eventStreamFrame(const QByteArray &data, const QByteArray &event = QByteArray(), const QByteArray &id = QByteArray());
+
+    /*!
+     * Sends one event on a stream started with eventStreamStart().
+     *
+     * \since Cutelyst 1.10.0
+     */
+    bool sendEvent(const QByteArray &data, const QByteArray &event = QByteArray(), const QByteArray &id = QByteArray());
+
+    /*!
+     * Writes a frame already encoded with eventStreamFrame().
+     *
+     * \since Cutelyst 1.10.0
+     */
+    bool sendEventFrame(const QByteArray &frame);
+
 protected:
     /**
      * Constructs a Response object, for this context c, engine and defaultHeaders.
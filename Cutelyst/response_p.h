@@ -25,8 +25,12 @@
 #include <QtCore/QUrl>
 #include <QtCore/QMap>
 #include <QtCore/QVariant>
+#include "memorypool_p.h"
+
 #include <QtNetwork/QNetworkCookie>
 
+#include <vector>
+
 namespace Cutelyst {
 
 class Context;
@@ -34,6 +38,8 @@ class Engine;
 class ResponsePrivate
 {
 public:
+    CUTELYST_MEMORY_POOLED(ResponsePrivate)
+
     enum ResponseStatusFlag {
         InitialState = 0x00,
         FinalizedHeaders = 0x01,
@@ -45,10 +51,21 @@ public:
 
     inline ResponsePrivate(Context *c, Engine *e, const Headers &h) : headers(h), context(c), engine(e) { }
     inline void setBodyData(const QByteArray &body);
+    void flattenBodyChunks();
+    // finalize and send the headers for manual body writes, dropping
+    // any body set earlier
+    void beginWrite();
 
     Headers headers;
     QMap<QByteArray, QNetworkCookie> cookies;
     QByteArray bodyData;
+    // pieces appended with Response::appendBody(), written out in
+    // sequence after bodyData without being copied into one buffer
+    std::vector<QByteArray> bodyChunks;
+    qint64 bodyChunksSize = 0;
+    // trailing header fields sent after the last chunk of a chunked
+    // response, see Response::setTrailer()
+    std::vector<std::pair<QString, QString> > trailers;
     QUrl location;
     QIODevice *bodyIODevice = nullptr;
     Context *context;
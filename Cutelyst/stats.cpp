@@ -19,6 +19,8 @@
 
 #include "stats_p.h"
 
+#include "allocstats_p.h"
+
 #include "dispatchtype.h"
 #include "application.h"
 #include "engine.h"
@@ -27,9 +29,229 @@
 #include "common.h"
 
 #include <QtCore/QStringList>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QVector>
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
 
 using namespace Cutelyst;
 
+#define HISTOGRAM_BUCKETS 1024
+
+namespace {
+struct ActionHistogram {
+    ActionHistogram(const QString &name) : action(name) {
+        for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    QString action;
+    std::atomic<quint64> count = { 0 };
+    std::atomic<quint64> cpuMicros = { 0 };
+    std::atomic<quint64> allocations = { 0 };
+    std::atomic<quint64> allocatedBytes = { 0 };
+    std::atomic<quint64> buckets[HISTOGRAM_BUCKETS];
+};
+
+struct HistogramSnapshot {
+    quint64 count = 0;
+    quint64 cpuMicros = 0;
+    quint64 allocations = 0;
+    quint64 allocatedBytes = 0;
+    quint64 buckets[HISTOGRAM_BUCKETS] = { 0 };
+};
+}
+
+// All histograms ever created, so a single core can build a report
+// covering the whole process. Entries are never removed, the set of
+// action names is fixed after dispatch setup.
+static QMutex s_histogramsMutex;
+static QVector<ActionHistogram *> s_histograms;
+
+// Recording goes through a thread-local pointer cache so the hot path
+// is a local hash lookup plus two relaxed increments; the mutex is
+// only taken the first time a core sees an action
+static thread_local QHash<QString, ActionHistogram *> t_histograms;
+static thread_local quint64 t_histogramSamples = 0;
+
+// Log-scaled buckets with 16 linear sub-buckets per power of two,
+// which keeps the relative error below ~6% over the whole range
+static inline int bucketIndex(quint64 micros)
+{
+    if (micros < 16) {
+        return int(micros);
+    }
+
+    int msb = 0;
+    quint64 v = micros;
+    while (v >>= 1) {
+        ++msb;
+    }
+
+    const int sub = int((micros >> (msb - 4)) & 15);
+    return qMin(((msb - 3) << 4) + sub, HISTOGRAM_BUCKETS - 1);
+}
+
+static inline quint64 bucketValue(int index)
+{
+    if (index < 16) {
+        return quint64(index);
+    }
+
+    const int msb = (index >> 4) + 3;
+    const quint64 sub = quint64(index & 15);
+    // middle of the sub-bucket
+    return (Q_UINT64_C(1) << msb) + (sub << (msb - 4)) + (Q_UINT64_C(1) << (msb - 5));
+}
+
+static quint64 histogramPercentile(const HistogramSnapshot &hist, double p)
+{
+    if (hist.count == 0) {
+        return 0;
+    }
+
+    quint64 rank = quint64(hist.count * p);
+    if (rank >= hist.count) {
+        rank = hist.count - 1;
+    }
+
+    quint64 seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += hist.buckets[i];
+        if (seen > rank) {
+            return bucketValue(i);
+        }
+    }
+    return 0;
+}
+
+// Merge the live histograms of all cores; readers may race with the
+// relaxed writers, the worst case is a report short by a few samples
+static QMap<QString, HistogramSnapshot> snapshotHistograms()
+{
+    QMap<QString, HistogramSnapshot> ret;
+
+    QMutexLocker locker(&s_histogramsMutex);
+    for (const ActionHistogram *hist : s_histograms) {
+        HistogramSnapshot &snap = ret[hist->action];
+        snap.count += hist->count.load(std::memory_order_relaxed);
+        snap.cpuMicros += hist->cpuMicros.load(std::memory_order_relaxed);
+        snap.allocations += hist->allocations.load(std::memory_order_relaxed);
+        snap.allocatedBytes += hist->allocatedBytes.load(std::memory_order_relaxed);
+        for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            snap.buckets[i] += hist->buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    return ret;
+}
+
+// CPU time the calling thread has consumed, user plus system. Actions
+// run to completion on one worker thread (detachAsync() continuations
+// resume on the same engine thread), so a delta around the execution
+// is the CPU the action itself burned, scheduler wait excluded.
+#ifdef Q_OS_LINUX
+static inline quint64 threadCpuMicros()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+        return 0;
+    }
+    return quint64(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+            + quint64(usage.ru_utime.tv_usec) + quint64(usage.ru_stime.tv_usec);
+}
+#else
+static inline quint64 threadCpuMicros()
+{
+    return 0;
+}
+#endif
+
+static void recordLatency(const QString &action, quint64 micros, quint64 cpuMicros,
+                          quint64 allocs, quint64 allocBytes)
+{
+    // drop the nesting decoration so every call depth aggregates
+    // under the plain action name
+    QString key = action.trimmed();
+    if (key.startsWith(QLatin1String("-> "))) {
+        key = key.mid(3);
+    }
+
+    ActionHistogram *hist = t_histograms.value(key);
+    if (!hist) {
+        hist = new ActionHistogram(key);
+        QMutexLocker locker(&s_histogramsMutex);
+        s_histograms.push_back(hist);
+        locker.unlock();
+        t_histograms.insert(key, hist);
+    }
+
+    hist->count.fetch_add(1, std::memory_order_relaxed);
+    hist->cpuMicros.fetch_add(cpuMicros, std::memory_order_relaxed);
+    hist->buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+
+#ifdef CUTELYST_ALLOC_STATS
+    hist->allocations.fetch_add(allocs, std::memory_order_relaxed);
+    hist->allocatedBytes.fetch_add(allocBytes, std::memory_order_relaxed);
+
+    // Optional hard budget: any action allocating more than
+    // CUTELYST_ALLOC_BUDGET times per execution is called out, which
+    // turns an allocation regression into a log line instead of a
+    // profiling session.
+    static const quint64 allocBudget = qgetenv("CUTELYST_ALLOC_BUDGET").toULongLong();
+    if (allocBudget && allocs > allocBudget) {
+        qCWarning(CUTELYST_STATS) << key << "made" << allocs
+                                  << "allocations (" << allocBytes
+                                  << "bytes), over the per-action budget of" << allocBudget;
+    }
+#else
+    Q_UNUSED(allocs)
+    Q_UNUSED(allocBytes)
+#endif
+
+    if ((++t_histogramSamples & 0x3FFF) == 0) {
+        qCInfo(CUTELYST_STATS, "%s", Stats::histogramReport().constData());
+    }
+}
+
+// The stage clock. rdtsc would shave a few more nanoseconds but needs
+// invariant-TSC detection and is not meaningful across cores; the
+// steady clock is a vDSO read on Linux and costs about the same.
+static inline quint64 monotonicNsecs()
+{
+    return quint64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#define TRACE_RING_SIZE 1024
+
+namespace {
+struct TraceEntry {
+    quint64 stages[Stats::StageCount] = { 0, 0, 0, 0 };
+    quint16 status = 0;
+    QString path;
+    QString traceParent;
+};
+}
+
+// One process-wide ring of recent request traces; a mutex per completed
+// request is noise next to the per-request allocations stats mode
+// already does, and it keeps the QString members safe to drain from
+// another core.
+static QMutex s_traceRingMutex;
+static TraceEntry s_traceRing[TRACE_RING_SIZE];
+static quint64 s_traceRingHead = 0;
+
 Stats::Stats(Application *app) : d_ptr(new StatsPrivate)
 {
     Q_D(Stats);
@@ -41,12 +263,72 @@ Stats::~Stats()
     delete d_ptr;
 }
 
+void Stats::stageReached(Stage stage)
+{
+    Q_D(Stats);
+    d->stages[stage] = monotonicNsecs();
+}
+
+void Stats::traceFinished(const QString &path, quint16 status, const QString &traceParent)
+{
+    Q_D(Stats);
+
+    QMutexLocker locker(&s_traceRingMutex);
+    TraceEntry &entry = s_traceRing[s_traceRingHead++ % TRACE_RING_SIZE];
+    for (int i = 0; i < StageCount; ++i) {
+        entry.stages[i] = d->stages[i];
+    }
+    entry.status = status;
+    entry.path = path;
+    entry.traceParent = traceParent;
+}
+
+static QString stageDelta(quint64 from, quint64 to)
+{
+    if (!from || !to || to < from) {
+        return QStringLiteral("-");
+    }
+    return QString::number((to - from) / 1000000.0, 'f', 3) + QLatin1String("ms");
+}
+
+QByteArray Stats::traceReport()
+{
+    QVector<QStringList> table;
+
+    QMutexLocker locker(&s_traceRingMutex);
+    const quint64 head = s_traceRingHead;
+    const quint64 first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    for (quint64 i = first; i < head; ++i) {
+        const TraceEntry &entry = s_traceRing[i % TRACE_RING_SIZE];
+        table.append({ entry.path,
+                       QString::number(entry.status),
+                       stageDelta(entry.stages[StageReceived], entry.stages[StagePrepared]),
+                       stageDelta(entry.stages[StagePrepared], entry.stages[StageDispatched]),
+                       stageDelta(entry.stages[StageDispatched], entry.stages[StageFinalized]),
+                       stageDelta(entry.stages[StageReceived], entry.stages[StageFinalized]),
+                       entry.traceParent });
+    }
+    locker.unlock();
+
+    return Utils::buildTable(table, {
+                                 QStringLiteral("Path"), QStringLiteral("Status"),
+                                 QStringLiteral("Prepare"), QStringLiteral("Dispatch"),
+                                 QStringLiteral("Finalize"), QStringLiteral("Total"),
+                                 QStringLiteral("Traceparent")
+                             },
+                             QLatin1String("Recent request traces:"));
+}
+
 void Stats::profileStart(const QString &action)
 {
     Q_D(Stats);
     StatsAction stat;
     stat.action = action;
     stat.begin = d->engine->time();
+    stat.beginCpuMicros = threadCpuMicros();
+    const AllocStats::Counters counters = AllocStats::read();
+    stat.beginAllocations = counters.allocations;
+    stat.beginAllocatedBytes = counters.bytes;
     d->actions.push_back(stat);
 }
 
@@ -56,6 +338,11 @@ void Stats::profileEnd(const QString &action)
     for (auto &stat : d->actions) {
         if (stat.action == action) {
             stat.end = d->engine->time();
+            const AllocStats::Counters counters = AllocStats::read();
+            recordLatency(stat.action, stat.end - stat.begin,
+                          threadCpuMicros() - stat.beginCpuMicros,
+                          counters.allocations - stat.beginAllocations,
+                          counters.bytes - stat.beginAllocatedBytes);
             break;
         }
     }
@@ -81,3 +368,162 @@ QByteArray Stats::report()
                             });
     return ret;
 }
+
+QByteArray Stats::histogramReport()
+{
+    QVector<QStringList> table;
+
+    const QMap<QString, HistogramSnapshot> snapshots = snapshotHistograms();
+    auto it = snapshots.constBegin();
+    while (it != snapshots.constEnd()) {
+        const HistogramSnapshot &hist = it.value();
+        QStringList row = { it.key(),
+                            QString::number(hist.count),
+                            QString::number(histogramPercentile(hist, 0.50) / 1000000.0, 'f') + QLatin1Char('s'),
+                            QString::number(histogramPercentile(hist, 0.99) / 1000000.0, 'f') + QLatin1Char('s'),
+                            QString::number(histogramPercentile(hist, 0.999) / 1000000.0, 'f') + QLatin1Char('s') };
+#ifdef CUTELYST_ALLOC_STATS
+        row.append(QString::number(hist.count ? hist.allocations / hist.count : 0));
+        row.append(QString::number(hist.count ? hist.allocatedBytes / hist.count / 1024.0 : 0.0, 'f', 1));
+#endif
+        table.append(row);
+        ++it;
+    }
+
+    QStringList headers = { QStringLiteral("Action"), QStringLiteral("Count"),
+                            QStringLiteral("p50"), QStringLiteral("p99"), QStringLiteral("p99.9") };
+#ifdef CUTELYST_ALLOC_STATS
+    headers.append(QStringLiteral("Allocs/req"));
+    headers.append(QStringLiteral("Alloc KiB/req"));
+#endif
+
+    return Utils::buildTable(table, headers,
+                             QLatin1String("Worker action latencies:"));
+}
+
+// wall time spent in the action, reconstructed from the bucket
+// midpoints with the same ~6% error the percentiles carry
+static quint64 histogramWallMicros(const HistogramSnapshot &hist)
+{
+    quint64 sum = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        sum += hist.buckets[i] * bucketValue(i);
+    }
+    return sum;
+}
+
+QByteArray Stats::topActionsReport(int limit)
+{
+    struct TopAction {
+        QString action;
+        quint64 wallMicros;
+        HistogramSnapshot snap;
+    };
+
+    std::vector<TopAction> top;
+    const QMap<QString, HistogramSnapshot> snapshots = snapshotHistograms();
+    auto it = snapshots.constBegin();
+    while (it != snapshots.constEnd()) {
+        top.push_back({ it.key(), histogramWallMicros(it.value()), it.value() });
+        ++it;
+    }
+
+    // CPU first; with rusage unavailable every CPU total is zero and
+    // the wall time tiebreak orders the table on its own
+    std::sort(top.begin(), top.end(), [] (const TopAction &a, const TopAction &b) {
+        if (a.snap.cpuMicros != b.snap.cpuMicros) {
+            return a.snap.cpuMicros > b.snap.cpuMicros;
+        }
+        return a.wallMicros > b.wallMicros;
+    });
+    if (int(top.size()) > limit) {
+        top.resize(size_t(limit));
+    }
+
+    QVector<QStringList> table;
+    for (const TopAction &entry : top) {
+        const quint64 count = entry.snap.count;
+        QStringList row = { entry.action,
+                            QString::number(count),
+                            QString::number(entry.snap.cpuMicros / 1000000.0, 'f', 3) + QLatin1Char('s'),
+                            QString::number(count ? entry.snap.cpuMicros / 1000.0 / count : 0.0, 'f', 3),
+                            QString::number(entry.wallMicros / 1000000.0, 'f', 3) + QLatin1Char('s') };
+#ifdef CUTELYST_ALLOC_STATS
+        row.append(QString::number(count ? entry.snap.allocations / count : 0));
+        row.append(QString::number(count ? entry.snap.allocatedBytes / count / 1024.0 : 0.0, 'f', 1));
+#endif
+        table.append(row);
+    }
+
+    QStringList headers = { QStringLiteral("Action"), QStringLiteral("Count"),
+                            QStringLiteral("CPU"), QStringLiteral("CPU ms/req"),
+                            QStringLiteral("Wall") };
+#ifdef CUTELYST_ALLOC_STATS
+    headers.append(QStringLiteral("Allocs/req"));
+    headers.append(QStringLiteral("Alloc KiB/req"));
+#endif
+
+    return Utils::buildTable(table, headers,
+                             QLatin1String("Top actions by CPU time:"));
+}
+
+static QString prometheusLabel(const QString &action)
+{
+    QString ret = action;
+    ret.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    ret.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    return ret;
+}
+
+QByteArray Stats::prometheusMetrics()
+{
+    QByteArray ret;
+    ret.append("# HELP cutelyst_action_latency_seconds Action execution time\n"
+               "# TYPE cutelyst_action_latency_seconds summary\n");
+
+    const QMap<QString, HistogramSnapshot> snapshots = snapshotHistograms();
+    auto it = snapshots.constBegin();
+    while (it != snapshots.constEnd()) {
+        const HistogramSnapshot &hist = it.value();
+        const QByteArray label = prometheusLabel(it.key()).toUtf8();
+
+        static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+        for (double q : quantiles) {
+            ret.append("cutelyst_action_latency_seconds{action=\"" + label
+                       + "\",quantile=\"" + QByteArray::number(q) + "\"} "
+                       + QByteArray::number(histogramPercentile(hist, q) / 1000000.0, 'g', 9)
+                       + '\n');
+        }
+
+        ret.append("cutelyst_action_latency_seconds_sum{action=\"" + label + "\"} "
+                   + QByteArray::number(histogramWallMicros(hist) / 1000000.0, 'g', 9) + '\n');
+        ret.append("cutelyst_action_latency_seconds_count{action=\"" + label + "\"} "
+                   + QByteArray::number(hist.count) + '\n');
+
+        ++it;
+    }
+
+    // a family's series have to stay together in the exposition
+    // format, so the CPU and allocation counters get their own passes
+    ret.append("# HELP cutelyst_action_cpu_seconds_total CPU time spent executing the action, thread rusage deltas\n"
+               "# TYPE cutelyst_action_cpu_seconds_total counter\n");
+    it = snapshots.constBegin();
+    while (it != snapshots.constEnd()) {
+        ret.append("cutelyst_action_cpu_seconds_total{action=\"" + prometheusLabel(it.key()).toUtf8() + "\"} "
+                   + QByteArray::number(it.value().cpuMicros / 1000000.0, 'g', 9) + '\n');
+        ++it;
+    }
+
+#ifdef CUTELYST_ALLOC_STATS
+    ret.append("# HELP cutelyst_action_allocated_bytes_total Bytes allocated while executing the action\n"
+               "# TYPE cutelyst_action_allocated_bytes_total counter\n");
+    it = snapshots.constBegin();
+    while (it != snapshots.constEnd()) {
+        ret.append("cutelyst_action_allocated_bytes_total{action=\"" + prometheusLabel(it.key()).toUtf8() + "\"} "
+                   + QByteArray::number(it.value().allocatedBytes) + '\n');
+        ++it;
+    }
+#endif
+
+    return ret;
+}
@@ -38,6 +38,47 @@ public:
     explicit Stats(Application *app);
     virtual ~Stats();
 
+    /**
+     * The pipeline stages a request crosses; used to index the
+     * per-request timestamp array recorded by stageReached().
+     */
+    enum Stage {
+        StageReceived = 0,
+        StagePrepared,
+        StageDispatched,
+        StageFinalized,
+        StageCount
+    };
+
+    /**
+     * Records the monotonic time at which the request crossed the
+     * given pipeline stage.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void stageReached(Stage stage);
+
+    /**
+     * Exports the recorded stage timestamps of a completed request
+     * into the process-wide trace ring buffer that traceReport()
+     * drains. The traceparent of the incoming request, when present,
+     * is kept with the entry so samples can be joined with a
+     * distributed trace.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void traceFinished(const QString &path, quint16 status, const QString &traceParent);
+
+    /**
+     * Returns a table with the most recent completed requests and the
+     * time each spent preparing, dispatching and finalizing. The ring
+     * holds the last 1024 requests of the whole process; draining does
+     * not clear it.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    static QByteArray traceReport();
+
     /**
      * Called before an action is executed to start counting it's time
      */
@@ -53,6 +94,38 @@ public:
      */
     virtual QByteArray report();
 
+    /**
+     * Returns a table with per-action p50/p99/p99.9 latencies
+     * aggregated over every worker core since the process started.
+     * The samples are recorded into per core log-scaled histograms,
+     * so keeping stats enabled does not serialize the workers.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    static QByteArray histogramReport();
+
+    /**
+     * Returns the action latency histograms of every worker core in
+     * the Prometheus text exposition format, as a summary metric with
+     * p50/p90/p99/p99.9 quantiles plus _sum and _count series, and
+     * per-action CPU seconds and allocated bytes counters.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    static QByteArray prometheusMetrics();
+
+    /**
+     * Returns a table with the actions that consumed the most CPU
+     * time since the process started, measured as thread rusage
+     * deltas around each execution, together with their call counts,
+     * wall time and, in builds with allocation stats, allocation
+     * churn. This is the table to read when a worker is busy and
+     * nobody knows which of the hundreds of actions to blame.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    static QByteArray topActionsReport(int limit = 20);
+
 protected:
     StatsPrivate *d_ptr;
 };
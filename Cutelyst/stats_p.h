@@ -30,6 +30,9 @@ struct StatsAction {
     QString action;
     quint64 begin = 0;
     quint64 end = 0;
+    quint64 beginCpuMicros = 0;
+    quint64 beginAllocations = 0;
+    quint64 beginAllocatedBytes = 0;
 };
 
 class Engine;
@@ -37,6 +40,7 @@ class StatsPrivate
 {
 public:
     std::vector<StatsAction> actions;
+    quint64 stages[Stats::StageCount] = { 0, 0, 0, 0 };
     Engine *engine;
 };
 
@@ -22,6 +22,7 @@
 
 #include <QDir>
 #include <QFile>
+#include <QFileDevice>
 #include <QFileInfo>
 #include <QTemporaryFile>
 
@@ -110,6 +111,22 @@ QTemporaryFile *Upload::createTemporaryFile(const QString &templateName)
 
     if (ret->open()) {
         bool error = false;
+
+        // When the body is file backed write the whole part from a
+        // memory map in one go instead of copying it block by block
+        uchar *data = map();
+        if (data) {
+            if (ret->write(reinterpret_cast<const char *>(data), size()) != size()) {
+                setErrorString(QStringLiteral("Failure to write block"));
+                qCWarning(CUTELYST_UPLOAD) << errorString();
+                ret->remove();
+            }
+            unmap(data);
+            ret->seek(0);
+
+            return ret;
+        }
+
         qint64 posOrig = d->pos;
         seek(0);
 
@@ -146,6 +163,67 @@ QTemporaryFile *Upload::createTemporaryFile(const QString &templateName)
     return 0;
 }
 
+uchar *Upload::map(qint64 offset, qint64 size)
+{
+    Q_D(Upload);
+    auto file = qobject_cast<QFileDevice *>(d->device);
+    if (!file || offset < 0 || offset > this->size()) {
+        return nullptr;
+    }
+
+    if (size < 0 || size > this->size() - offset) {
+        size = this->size() - offset;
+    }
+    // The part is a byte range of the body file, translate the offset
+    return file->map(d->startOffset + offset, size);
+}
+
+bool Upload::unmap(uchar *address)
+{
+    Q_D(Upload);
+    auto file = qobject_cast<QFileDevice *>(d->device);
+    if (!file) {
+        return false;
+    }
+    return file->unmap(address);
+}
+
+QByteArray Upload::digest(QCryptographicHash::Algorithm algorithm) const
+{
+    Q_D(const Upload);
+
+    auto it = d->digests.constFind(algorithm);
+    if (it != d->digests.constEnd()) {
+        return it.value();
+    }
+
+    // not computed during the body parse, stream the content through
+    // the hash once and remember the result
+    QIODevice *device = d->device;
+    const qint64 posOrig = device->pos();
+    if (!device->seek(d->startOffset)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(algorithm);
+    qint64 remaining = d->endOffset - d->startOffset;
+    char block[4096];
+    while (remaining > 0) {
+        const qint64 len = device->read(block, qMin(remaining, qint64(sizeof(block))));
+        if (len <= 0) {
+            device->seek(posOrig);
+            return QByteArray();
+        }
+        hash.addData(block, int(len));
+        remaining -= len;
+    }
+    device->seek(posOrig);
+
+    const QByteArray result = hash.result();
+    d->digests.insert(algorithm, result);
+    return result;
+}
+
 qint64 Upload::pos() const
 {
     Q_D(const Upload);
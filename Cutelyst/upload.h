@@ -21,6 +21,7 @@
 #define UPLOAD_H
 
 #include <QtCore/qiodevice.h>
+#include <QtCore/qcryptographichash.h>
 
 #include <Cutelyst/cutelyst_global.h>
 #include <Cutelyst/headers.h>
@@ -77,6 +78,34 @@ public:
      */
     QTemporaryFile *createTemporaryFile(const QString &templateName = QString());
 
+    /**
+     * Maps size bytes of this upload starting at offset into memory,
+     * when the request body device is file backed, so the data can be
+     * processed in place without copying it out first.
+     * Returns zero if the body is not a file or if the map fails.
+     * The pointer remains valid until unmap() is called or this
+     * upload is deleted.
+     */
+    uchar *map(qint64 offset = 0, qint64 size = -1);
+
+    /**
+     * Returns the hash of this upload's content for \p algorithm.
+     * When the algorithm was registered with
+     * MultiPartFormDataParser::setUploadDigests() the digest was
+     * computed while the body was parsed and this call is free;
+     * otherwise the content is streamed through the hash once and
+     * the result cached. Returns an empty array on read failure.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    QByteArray digest(QCryptographicHash::Algorithm algorithm) const;
+
+    /**
+     * Unmaps the memory at address, which must have been
+     * returned by map().
+     */
+    bool unmap(uchar *address);
+
     /**
      * Reimplemented from QIODevice::pos().
      */
@@ -38,6 +38,9 @@ public:
     Headers headers;
     QString name;
     QString filename;
+    // keyed by QCryptographicHash::Algorithm, filled by the multipart
+    // parser when upload digests are enabled, or lazily by digest()
+    mutable QHash<int, QByteArray> digests;
     QIODevice *device;
     qint64 startOffset = 0;
     qint64 endOffset = 0;
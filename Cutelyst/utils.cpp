@@ -22,8 +22,37 @@
 #include <QTextStream>
 #include <QVector>
 
+#include <cstring>
+
 using namespace Cutelyst;
 
+// Value of each character as a hexadecimal digit, -1 for everything
+// that is not one. A single indexed load replaces the three range
+// checks per nibble the decoders used to branch through.
+static const qint8 hexTable[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static inline int hexValue(uint c)
+{
+    return c < 256 ? hexTable[c] : -1;
+}
+
 QByteArray buildTableDivision(const QVector<int> &columnsSize)
 {
     QByteArray buffer;
@@ -124,35 +153,36 @@ QByteArray Utils::buildTable(const QVector<QStringList> &table, const QStringLis
 
 QString Utils::decodePercentEncoding(QString *s)
 {
-    if (s->isEmpty()) {
+    // The common case carries no escapes at all, detect it with one
+    // scan and hand the string back untouched instead of copying it
+    // character by character onto itself
+    int i = s->indexOf(QLatin1Char('%'));
+    if (i == -1) {
         return *s;
     }
 
     QChar *data = s->data();
-    int len = s->size();
-    int outlen = 0;
-    for (int i = 0 ; i < len ; ++i, ++outlen) {
-        QChar c = (*s)[i];
+    const int len = s->size();
+    int w = i;
+    while (i < len) {
+        const QChar c = data[i];
         if (c == QLatin1Char('%') && i + 2 < len) {
-            int a = (*s)[++i].unicode();
-            int b = (*s)[++i].unicode();
-
-            if (a >= '0' && a <= '9') a -= '0';
-            else if (a >= 'a' && a <= 'f') a = a - 'a' + 10;
-            else if (a >= 'A' && a <= 'F') a = a - 'A' + 10;
-
-            if (b >= '0' && b <= '9') b -= '0';
-            else if (b >= 'a' && b <= 'f') b  = b - 'a' + 10;
-            else if (b >= 'A' && b <= 'F') b  = b - 'A' + 10;
-
-            *data++ = (ushort)((a << 4) | b);
-        } else {
-            *data++ = c;
+            const int a = hexValue(data[i + 1].unicode());
+            const int b = hexValue(data[i + 2].unicode());
+            if (a != -1 && b != -1) {
+                data[w++] = QChar(ushort((a << 4) | b));
+                i += 3;
+                continue;
+            }
+            // not a valid escape, keep the '%' as it came
         }
+        data[w++] = c;
+        ++i;
     }
 
-    if (outlen != len)
-        s->truncate(outlen);
+    if (w != len) {
+        s->truncate(w);
+    }
 
     return *s;
 }
@@ -163,40 +193,102 @@ QString Utils::decodePercentEncoding(QByteArray *ba)
         return QString::fromLatin1(*ba);
 
     char *data = ba->data();
-    const char *inputPtr = data;
+    const int len = ba->count();
+
+    // memchr covers the whole array a word (or vector) at a time,
+    // when neither escape marker is present the bytes are already
+    // the decoded form
+    const char *percent = static_cast<const char *>(memchr(data, '%', len));
+    const char *plus = static_cast<const char *>(memchr(data, '+', len));
+    if (!percent && !plus) {
+        return QString::fromUtf8(*ba);
+    }
 
-    int i = 0;
-    int len = ba->count();
-    int outlen = 0;
-    int a, b;
-    char c;
+    int i;
+    if (percent && plus) {
+        i = static_cast<int>(qMin(percent, plus) - data);
+    } else {
+        i = static_cast<int>((percent ? percent : plus) - data);
+    }
+
+    int w = i;
     while (i < len) {
-        c = inputPtr[i];
+        const char c = data[i];
         if (c == '%' && i + 2 < len) {
-            a = inputPtr[++i];
-            b = inputPtr[++i];
-
-            if (a >= '0' && a <= '9') a -= '0';
-            else if (a >= 'a' && a <= 'f') a = a - 'a' + 10;
-            else if (a >= 'A' && a <= 'F') a = a - 'A' + 10;
-
-            if (b >= '0' && b <= '9') b -= '0';
-            else if (b >= 'a' && b <= 'f') b  = b - 'a' + 10;
-            else if (b >= 'A' && b <= 'F') b  = b - 'A' + 10;
-
-            *data++ = (char)((a << 4) | b);
+            const int a = hexValue(uchar(data[i + 1]));
+            const int b = hexValue(uchar(data[i + 2]));
+            if (a != -1 && b != -1) {
+                data[w++] = char((a << 4) | b);
+                i += 3;
+                continue;
+            }
+            // not a valid escape, keep the '%' as it came
+            data[w++] = c;
         } else if (c == '+') {
-            *data++ = ' ';
+            data[w++] = ' ';
         } else {
-            *data++ = c;
+            data[w++] = c;
         }
-
         ++i;
-        ++outlen;
     }
 
-    if (outlen != len)
-        ba->truncate(outlen);
+    if (w != len) {
+        ba->truncate(w);
+    }
 
     return QString::fromUtf8(*ba);
 }
+
+QString Utils::normalizePath(const QString &path)
+{
+    QString ret = path;
+    QChar *data = ret.data();
+    const int len = ret.size();
+
+    int w = 0;
+    int i = 0;
+    while (i < len) {
+        // runs of slashes separate segments just like a single one
+        while (i < len && data[i] == QLatin1Char('/')) {
+            ++i;
+        }
+        if (i >= len) {
+            break;
+        }
+
+        int segEnd = i;
+        while (segEnd < len && data[segEnd] != QLatin1Char('/')) {
+            ++segEnd;
+        }
+        const int segLen = segEnd - i;
+
+        if (segLen == 1 && data[i] == QLatin1Char('.')) {
+            // "." adds nothing to the path
+        } else if (segLen == 2 && data[i] == QLatin1Char('.') && data[i + 1] == QLatin1Char('.')) {
+            // ".." drops the previous segment, or nothing at the root
+            while (w > 0 && data[w - 1] != QLatin1Char('/')) {
+                --w;
+            }
+            if (w > 0) {
+                --w;
+            }
+        } else {
+            if (w > 0) {
+                data[w++] = QLatin1Char('/');
+            }
+            if (w == i) {
+                // segment already in place, nothing to move
+                w = segEnd;
+            } else {
+                for (int j = i; j < segEnd; ++j) {
+                    data[w++] = data[j];
+                }
+            }
+        }
+
+        i = segEnd;
+    }
+
+    ret.truncate(w);
+    return ret;
+}
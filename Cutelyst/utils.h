@@ -32,6 +32,15 @@ namespace Utils {
     CUTELYST_LIBRARY QString decodePercentEncoding(QString *s);
 
     CUTELYST_LIBRARY QString decodePercentEncoding(QByteArray *ba);
+
+    /**
+     * Collapses duplicate slashes, removes "." segments and resolves
+     * ".." segments of \p path in a single pass. The returned path has
+     * neither a leading nor a trailing slash, matching the form the
+     * dispatcher registers actions under.
+     * \since 1.10.0
+     */
+    CUTELYST_LIBRARY QString normalizePath(const QString &path);
 }
 
 }
@@ -17,7 +17,7 @@
  * Boston, MA 02110-1301, USA.
  */
 
-#include "view.h"
+#include "view_p.h"
 
 #include "common.h"
 
@@ -25,17 +25,20 @@
 #include <Cutelyst/Response>
 
 #include <QtCore/QVariant>
+#include <QtCore/QDateTime>
 #include <QtCore/QLoggingCategory>
 
 using namespace Cutelyst;
 
 View::View(QObject *parent, const QString &name) : Component(parent)
+    , d_ptr(new ViewPrivate)
 {
     setName(name);
 }
 
 View::~View()
 {
+    delete d_ptr;
 }
 
 QString View::name() const
@@ -48,14 +51,60 @@ Component::Modifiers View::modifiers() const
     return Component::OnlyExecute;
 }
 
+bool View::renderStream(Context *c, QIODevice *out) const
+{
+    Q_UNUSED(c)
+    Q_UNUSED(out)
+    return false;
+}
+
+void View::setCache(int maxSize, int ttl)
+{
+    Q_D(View);
+    d->cacheEnabled = maxSize > 0;
+    d->cache.setMaxCost(maxSize);
+    d->cacheTtl = ttl;
+}
+
 bool View::doExecute(Context *c)
 {
+    Q_D(View);
+
     Response *response = c->response();
     if (response->hasBody()) {
         // Ignore if we already have a body
         return true;
     }
 
+    QString cacheKey;
+    if (d->cacheEnabled) {
+        cacheKey = c->stash(QStringLiteral("view_cache_key")).toString();
+        if (!cacheKey.isEmpty()) {
+            ViewPrivate::CacheEntry *entry = d->cache.object(cacheKey);
+            if (entry) {
+                if (entry->expires > QDateTime::currentMSecsSinceEpoch()) {
+                    if (!entry->contentType.isEmpty()) {
+                        response->setContentType(entry->contentType);
+                    }
+                    response->setBody(entry->body);
+                    return true;
+                }
+                d->cache.remove(cacheKey);
+            }
+        }
+    }
+
+    if (renderStream(c, response)) {
+        if (Q_UNLIKELY(c->error())) {
+            const auto errors = c->errors();
+            for (const QString &error : errors) {
+                qCCritical(CUTELYST_VIEW) << error;
+            }
+        }
+
+        return !c->error();
+    }
+
     const QByteArray output = render(c);
     if (Q_UNLIKELY(c->error())) {
         const auto errors = c->errors();
@@ -65,6 +114,14 @@ bool View::doExecute(Context *c)
     }
     response->setBody(output);
 
+    if (!cacheKey.isEmpty() && !c->error()) {
+        auto entry = new ViewPrivate::CacheEntry;
+        entry->body = output;
+        entry->contentType = response->contentType();
+        entry->expires = QDateTime::currentMSecsSinceEpoch() + d->cacheTtl * 1000;
+        d->cache.insert(cacheKey, entry, qMax(1, output.size()));
+    }
+
     return !c->error();
 }
 
@@ -25,9 +25,12 @@
 #include <Cutelyst/cutelyst_global.h>
 #include <Cutelyst/component.h>
 
+class QIODevice;
+
 namespace Cutelyst {
 
 class Context;
+class ViewPrivate;
 
 /*! \class View view.h Cutelyst/View
  * @brief %Cutelyst %View abstract view component
@@ -62,7 +65,43 @@ public:
      */
     virtual QByteArray render(Context *c) const = 0;
 
+    /**
+     * Reimplement this to stream the output as it is generated instead
+     * of building one complete byte array with render(), keeping memory
+     * usage bounded no matter the body size.
+     *
+     * The \p out device is the Response itself, each write() is sent to
+     * the client right away, with chunked encoding when the connection
+     * supports it or closing the connection at the end otherwise.
+     *
+     * Return true when the response was handled here, the default
+     * implementation returns false which makes the view fall back
+     * to render().
+     *
+     * \since Cutelyst 1.10.0
+     */
+    virtual bool renderStream(Context *c, QIODevice *out) const;
+
+    /**
+     * Enables caching of render() results, bounded to \p maxSize bytes
+     * of body data with least recently used eviction, each entry valid
+     * for \p ttl seconds. The cache is opt-in twice: besides calling
+     * this the handler must set a "view_cache_key" stash entry naming
+     * the page variant being rendered, requests without the stash key
+     * are rendered normally. A \p maxSize of 0 disables the cache.
+     *
+     * Streamed responses (renderStream()) are never cached.
+     *
+     * \since Cutelyst 1.10.0
+     */
+    void setCache(int maxSize, int ttl = 60);
+
+protected:
+    ViewPrivate *d_ptr;
+
 private:
+    Q_DECLARE_PRIVATE(View)
+
     /**
      * This is used by Component execute() when
      * using an ActionView
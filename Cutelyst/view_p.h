@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2013-2015 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef VIEW_P_H
+#define VIEW_P_H
+
+#include "view.h"
+
+#include <QtCore/QCache>
+
+namespace Cutelyst {
+
+class ViewPrivate
+{
+public:
+    struct CacheEntry {
+        QByteArray body;
+        QString contentType;
+        qint64 expires;
+    };
+
+    // cost is the body size in bytes, QCache evicts least recently used
+    QCache<QString, CacheEntry> cache;
+    int cacheTtl = 60;
+    bool cacheEnabled = false;
+};
+
+}
+
+#endif // VIEW_P_H
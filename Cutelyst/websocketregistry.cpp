@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "websocketregistry.h"
+
+#include "context.h"
+#include "request.h"
+#include "engine.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMultiHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+
+#include <vector>
+
+using namespace Cutelyst;
+
+namespace {
+
+// One shard per worker thread. The indexes are only ever touched from
+// their own thread: subscribers run there by construction, and
+// publishes arrive through the thread's event loop, so the hot
+// lookups never take a lock.
+struct Shard {
+    QObject anchor; // thread affinity target for queued publishes
+    QMultiHash<QString, Context *> byTopic;
+    QHash<Context *, QVector<QString> > byContext;
+};
+
+// All live shards, walked only when publishing. A shard is created
+// the first time its worker thread subscribes a connection and is
+// never destroyed, worker threads live as long as the process.
+QMutex s_shardsMutex;
+std::vector<Shard *> s_shards;
+
+Shard *localShard()
+{
+    static thread_local Shard *shard = nullptr;
+    if (!shard) {
+        shard = new Shard;
+        QMutexLocker locker(&s_shardsMutex);
+        s_shards.push_back(shard);
+    }
+    return shard;
+}
+
+void dropContext(Shard *shard, Context *c)
+{
+    const QVector<QString> topics = shard->byContext.take(c);
+    for (const QString &topic : topics) {
+        shard->byTopic.remove(topic, c);
+    }
+    // also drops the close handler installed by subscribe()
+    QObject::disconnect(c->request(), nullptr, &shard->anchor, nullptr);
+}
+
+template <typename Payload, typename Sender>
+void publish(const QString &topic, const Payload &message, Sender send)
+{
+    QMutexLocker locker(&s_shardsMutex);
+    for (Shard *shard : s_shards) {
+        // queued onto the shard's own thread, where its index can be
+        // read without synchronization
+        QTimer::singleShot(0, &shard->anchor, [shard, topic, message, send] {
+            QVector<Context *> contexts;
+            auto it = shard->byTopic.constFind(topic);
+            while (it != shard->byTopic.constEnd() && it.key() == topic) {
+                contexts.append(it.value());
+                ++it;
+            }
+
+            if (!contexts.isEmpty()) {
+                // contexts on one shard all belong to this thread's
+                // engine, the frame is encoded once for all of them
+                send(contexts.first()->engine(), contexts, message);
+            }
+        });
+    }
+}
+
+// Installed once before the workers handle traffic, read-only after
+std::function<void(const QString &, const QByteArray &, bool)> s_forwarder;
+
+}
+
+void WebSocketRegistry::subscribe(Context *c, const QString &topic)
+{
+    Shard *shard = localShard();
+
+    QVector<QString> &topics = shard->byContext[c];
+    if (topics.contains(topic)) {
+        return;
+    }
+
+    if (topics.isEmpty()) {
+        // first subscription of this connection, drop it from every
+        // topic once the websocket goes away
+        QObject::connect(c->request(), &Request::webSocketClosed, &shard->anchor, [shard, c] {
+            dropContext(shard, c);
+        });
+    }
+
+    topics.append(topic);
+    shard->byTopic.insert(topic, c);
+}
+
+void WebSocketRegistry::unsubscribe(Context *c, const QString &topic)
+{
+    Shard *shard = localShard();
+
+    auto it = shard->byContext.find(c);
+    if (it == shard->byContext.end() || !it.value().removeOne(topic)) {
+        return;
+    }
+
+    shard->byTopic.remove(topic, c);
+    if (it.value().isEmpty()) {
+        dropContext(shard, c);
+    }
+}
+
+void WebSocketRegistry::unsubscribeAll(Context *c)
+{
+    Shard *shard = localShard();
+
+    if (shard->byContext.contains(c)) {
+        dropContext(shard, c);
+    }
+}
+
+void WebSocketRegistry::publishTextMessage(const QString &topic, const QString &message)
+{
+    publishLocalTextMessage(topic, message);
+    if (s_forwarder) {
+        s_forwarder(topic, message.toUtf8(), false);
+    }
+}
+
+void WebSocketRegistry::publishBinaryMessage(const QString &topic, const QByteArray &message)
+{
+    publishLocalBinaryMessage(topic, message);
+    if (s_forwarder) {
+        s_forwarder(topic, message, true);
+    }
+}
+
+void WebSocketRegistry::setPublishForwarder(std::function<void(const QString &, const QByteArray &, bool)> forwarder)
+{
+    s_forwarder = forwarder;
+}
+
+void WebSocketRegistry::publishLocalTextMessage(const QString &topic, const QString &message)
+{
+    publish(topic, message, [] (Engine *engine, const QVector<Context *> &contexts, const QString &msg) {
+        engine->webSocketBroadcastTextMessage(contexts, msg);
+    });
+}
+
+void WebSocketRegistry::publishLocalBinaryMessage(const QString &topic, const QByteArray &message)
+{
+    publish(topic, message, [] (Engine *engine, const QVector<Context *> &contexts, const QByteArray &msg) {
+        engine->webSocketBroadcastBinaryMessage(contexts, msg);
+    });
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef WEBSOCKETREGISTRY_H
+#define WEBSOCKETREGISTRY_H
+
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+
+#include <Cutelyst/cutelyst_global.h>
+
+#include <functional>
+
+namespace Cutelyst {
+
+class Context;
+
+/**
+ * Topic based publish/subscribe registry for websocket connections.
+ *
+ * The registry is sharded per worker thread: a connection is indexed
+ * on the thread that owns it, subscribe and unsubscribe therefore must
+ * be called from the connection's own thread, which is where actions
+ * and websocket signals are delivered anyway. Lookups on the
+ * subscription index never take a lock, each shard is only touched
+ * from its own thread.
+ *
+ * Publishing is allowed from any thread: the message is handed to
+ * every shard through its event loop and fanned out there with the
+ * engine's broadcast path, so the frame is encoded once per worker
+ * rather than once per connection.
+ *
+ * Subscriptions are dropped automatically when the websocket closes.
+ *
+ * \since 1.10.0
+ */
+namespace WebSocketRegistry {
+    /**
+     * Subscribes the websocket connection of \p c to \p topic.
+     * Must be called from the thread that handles the connection.
+     */
+    CUTELYST_LIBRARY void subscribe(Context *c, const QString &topic);
+
+    /**
+     * Removes the subscription of \p c to \p topic, if any.
+     * Must be called from the thread that handles the connection.
+     */
+    CUTELYST_LIBRARY void unsubscribe(Context *c, const QString &topic);
+
+    /**
+     * Removes every subscription of \p c. Called automatically when
+     * the websocket closes.
+     * Must be called from the thread that handles the connection.
+     */
+    CUTELYST_LIBRARY void unsubscribeAll(Context *c);
+
+    /**
+     * Sends \p message as a text frame to every connection subscribed
+     * to \p topic, on all worker threads. Safe to call from any
+     * thread; delivery is asynchronous.
+     */
+    CUTELYST_LIBRARY void publishTextMessage(const QString &topic, const QString &message);
+
+    /**
+     * Sends \p message as a binary frame to every connection
+     * subscribed to \p topic, on all worker threads. Safe to call
+     * from any thread; delivery is asynchronous.
+     */
+    CUTELYST_LIBRARY void publishBinaryMessage(const QString &topic, const QByteArray &message);
+
+    /**
+     * Installs a hook invoked once for every publish, with the topic,
+     * the payload bytes (UTF-8 for text frames) and whether the frame
+     * is binary. Servers running multiple worker processes use it to
+     * forward the message to their siblings; each sibling then calls
+     * one of the publishLocal functions with what it received. Must
+     * be installed before the workers start handling traffic, it is
+     * read without synchronization afterwards.
+     */
+    CUTELYST_LIBRARY void setPublishForwarder(std::function<void(const QString &topic, const QByteArray &payload, bool binary)> forwarder);
+
+    /**
+     * Like publishTextMessage() but fans out to this process only,
+     * without invoking the forwarder. Servers call this for messages
+     * received from a sibling worker process.
+     */
+    CUTELYST_LIBRARY void publishLocalTextMessage(const QString &topic, const QString &message);
+
+    /**
+     * Like publishBinaryMessage() but fans out to this process only,
+     * without invoking the forwarder. Servers call this for messages
+     * received from a sibling worker process.
+     */
+    CUTELYST_LIBRARY void publishLocalBinaryMessage(const QString &topic, const QByteArray &message);
+}
+
+}
+
+#endif // WEBSOCKETREGISTRY_H
@@ -20,6 +20,11 @@ bool EventDispatcherEPoll::processEvents(QEventLoop::ProcessEventsFlags flags)
     return d->processEvents(flags);
 }
 
+QByteArray EventDispatcherEPoll::lagMetrics(void)
+{
+    return EventDispatcherEPollPrivate::lagMetrics();
+}
+
 bool EventDispatcherEPoll::hasPendingEvents(void)
 {
     extern uint qGlobalPostedEventsCount();
@@ -39,6 +39,16 @@ public:
     virtual void interrupt(void);
     virtual void flush(void);
 
+    /**
+     * Returns the dispatch-duration histograms of every event loop
+     * of the process in the Prometheus text exposition format, one
+     * series per core. Empty unless the environment variable
+     * CUTELYST_EVENT_LOOP_LAG_WARN is set to a threshold in
+     * milliseconds, which also logs every callback that blocks the
+     * loop longer than the threshold.
+     */
+    static QByteArray lagMetrics(void);
+
 private:
     Q_DISABLE_COPY(EventDispatcherEPoll)
     Q_DECLARE_PRIVATE(EventDispatcherEPoll)
@@ -1,15 +1,42 @@
 #include <QtCore/QCoreApplication>
+#include <QtCore/QMutex>
 #include <unistd.h>
+#include <time.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <errno.h>
 #include "eventdispatcher_epoll.h"
 #include "eventdispatcher_epoll_p.h"
 
+// every live dispatcher of the process, so lagMetrics() can report
+// all worker cores from whichever thread scrapes it
+static QMutex s_lag_mutex;
+static std::vector<EventDispatcherEPollPrivate*> s_lag_instances;
+
+static inline qint64 lag_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
 EventDispatcherEPollPrivate::EventDispatcherEPollPrivate(EventDispatcherEPoll* const q)
     : q_ptr(q)
 {
+    bool ok;
+    const qint64 lagWarnMs = qgetenv("CUTELYST_EVENT_LOOP_LAG_WARN").toLongLong(&ok);
+    if (ok && lagWarnMs > 0) {
+        m_lag_warn_us = lagWarnMs * 1000;
+        QMutexLocker locker(&s_lag_mutex);
+        s_lag_instances.push_back(this);
+    }
+
+    // Register socket notifiers edge-triggered so a socket whose
+    // buffered data was already consumed does not re-fire epoll_wait()
+    m_edge_trigger = qEnvironmentVariableIsSet("CUTELYST_EVENT_LOOP_EPOLL_ET");
+
     m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (Q_UNLIKELY(-1 == m_epoll_fd)) {
         qErrnoWarning("epoll_create1() failed");
@@ -32,6 +59,15 @@ EventDispatcherEPollPrivate::EventDispatcherEPollPrivate(EventDispatcherEPoll* c
 
 EventDispatcherEPollPrivate::~EventDispatcherEPollPrivate(void)
 {
+    if (m_lag_warn_us) {
+        QMutexLocker locker(&s_lag_mutex);
+        s_lag_instances.erase(std::remove(s_lag_instances.begin(), s_lag_instances.end(), this),
+                              s_lag_instances.end());
+    }
+
+    if (m_wheel_fd != -1) {
+        close(m_wheel_fd);
+    }
     close(m_event_fd);
     close(m_epoll_fd);
 
@@ -102,11 +138,18 @@ bool EventDispatcherEPollPrivate::processEvents(QEventLoop::ProcessEventsFlags f
             timeout = -1;
         }
 
+        // apply the socket registration changes of this pass in one
+        // batch, toggles that cancelled out cost no syscall at all
+        flushSocketCtls();
+
         struct epoll_event events[1024];
         do {
             n_events = epoll_wait(m_epoll_fd, events, 1024, timeout);
         } while (Q_UNLIKELY(-1 == n_events && errno == EINTR));
 
+        const qint64 dispatch_start = (m_lag_warn_us && n_events > 0) ? lag_now_us() : 0;
+        qint64 cb_start = dispatch_start;
+
         for (int i=0; i<n_events; ++i) {
             struct epoll_event& e = events[i];
             int fd                = e.data.fd;
@@ -115,6 +158,11 @@ bool EventDispatcherEPollPrivate::processEvents(QEventLoop::ProcessEventsFlags f
                     wake_up_handler();
                 }
             }
+            else if (fd == m_wheel_fd) {
+                if (Q_LIKELY(e.events & EPOLLIN)) {
+                    wheel_tick();
+                }
+            }
             else {
                 auto it = m_handles.constFind(fd);
                 if (Q_LIKELY(it != m_handles.constEnd())) {
@@ -131,9 +179,38 @@ bool EventDispatcherEPollPrivate::processEvents(QEventLoop::ProcessEventsFlags f
                     default:
                         Q_UNREACHABLE();
                     }
+
+                    // name the callback that blocked the loop while
+                    // its duration is still attributable
+                    if (Q_UNLIKELY(dispatch_start != 0)) {
+                        const qint64 now = lag_now_us();
+                        if (now - cb_start > m_lag_warn_us) {
+                            if (data->type == htSocketNotifier) {
+                                qWarning("Event loop blocked %lld ms dispatching socket notifier on fd %d",
+                                         (now - cb_start) / 1000, fd);
+                            } else {
+                                qWarning("Event loop blocked %lld ms dispatching timer %d of %s",
+                                         (now - cb_start) / 1000, data->ti.timerId,
+                                         data->ti.object ? data->ti.object->metaObject()->className() : "(null)");
+                            }
+                        }
+                        cb_start = now;
+                    }
                 }
             }
         }
+
+        if (Q_UNLIKELY(dispatch_start != 0)) {
+            // one pass of callbacks is the time this core could not
+            // serve anything else; log2 microsecond buckets
+            const quint64 us = quint64(qMax(Q_INT64_C(1), lag_now_us() - dispatch_start));
+            int bucket = 0;
+            while ((Q_UINT64_C(1) << (bucket + 1)) <= us && bucket < LagBuckets - 1) {
+                ++bucket;
+            }
+            m_lag_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+            m_lag_sum_us.fetch_add(us, std::memory_order_relaxed);
+        }
     }
 
     exclude_notifiers && disableSocketNotifiers(false);
@@ -159,6 +236,40 @@ void EventDispatcherEPollPrivate::wake_up_handler(void)
     }
 }
 
+QByteArray EventDispatcherEPollPrivate::lagMetrics(void)
+{
+    QByteArray ret;
+
+    QMutexLocker locker(&s_lag_mutex);
+    if (s_lag_instances.empty()) {
+        return ret;
+    }
+
+    ret.append("# HELP cutelyst_event_loop_dispatch_seconds Time one epoll batch of callbacks blocked the event loop\n"
+               "# TYPE cutelyst_event_loop_dispatch_seconds histogram\n");
+
+    for (size_t core = 0; core < s_lag_instances.size(); ++core) {
+        const EventDispatcherEPollPrivate* d = s_lag_instances[core];
+        const QByteArray label = "{core=\"" + QByteArray::number(quint64(core)) + "\"";
+
+        quint64 count = 0;
+        for (int i = 0; i < LagBuckets; ++i) {
+            count += d->m_lag_histogram[i].load(std::memory_order_relaxed);
+            ret.append("cutelyst_event_loop_dispatch_seconds_bucket" + label
+                       + ",le=\"" + QByteArray::number((Q_UINT64_C(1) << (i + 1)) / 1e6) + "\"} "
+                       + QByteArray::number(count) + '\n');
+        }
+        ret.append("cutelyst_event_loop_dispatch_seconds_bucket" + label + ",le=\"+Inf\"} "
+                   + QByteArray::number(count) + '\n');
+        ret.append("cutelyst_event_loop_dispatch_seconds_sum" + label + "} "
+                   + QByteArray::number(d->m_lag_sum_us.load(std::memory_order_relaxed) / 1e6) + '\n');
+        ret.append("cutelyst_event_loop_dispatch_seconds_count" + label + "} "
+                   + QByteArray::number(count) + '\n');
+    }
+
+    return ret;
+}
+
 void EventDispatcherEPollPrivate::wakeup(void)
 {
     if (m_wakeups.testAndSetAcquire(0, 1))
@@ -7,6 +7,9 @@
 
 #include <QtCore/QAtomicInt>
 
+#include <atomic>
+#include <vector>
+
 enum HandleType {
     htTimer,
     htSocketNotifier
@@ -17,6 +20,11 @@ struct SocketNotifierInfo {
     QSocketNotifier* w;
     QSocketNotifier* x;
     int events;
+    // events currently installed in the kernel, -1 when the fd was
+    // never added; lets flushSocketCtls() skip registrations that
+    // ended up back in their installed state
+    int installed;
+    bool dirty;
 };
 
 struct TimerInfo {
@@ -33,6 +41,13 @@ struct ZeroTimer {
     bool active;
 };
 
+struct WheelTimer {
+    QObject* object;
+    int timerId;
+    int interval;
+    quint64 expiry; // CLOCK_MONOTONIC seconds
+};
+
 struct HandleData {
     HandleType type;
     union {
@@ -62,10 +77,14 @@ public:
     int remainingTime(int timerId) const;
     void wakeup(void);
 
+    static QByteArray lagMetrics(void);
+
     typedef QHash<int, HandleData*> HandleHash;
     typedef QHash<int, HandleData*> TimerHash;
     typedef QHash<QSocketNotifier*, HandleData*> SocketNotifierHash;
     typedef QHash<int, ZeroTimer> ZeroTimerHash;
+    typedef QHash<int, WheelTimer> WheelTimerHash;
+    typedef QHash<quint64, std::vector<int> > WheelBucketHash;
 
 private:
     Q_DISABLE_COPY(EventDispatcherEPollPrivate)
@@ -74,15 +93,39 @@ private:
 
     int m_epoll_fd = -1;
     int m_event_fd = -1;
+    int m_wheel_fd = -1;
     bool m_interrupt = false;
+    bool m_edge_trigger = false;
     QAtomicInt m_wakeups;
     HandleHash m_handles;
     SocketNotifierHash m_notifiers;
+    // socket registration changes queued for the next epoll_wait();
+    // see flushSocketCtls()
+    std::vector<int> m_dirty_fds;
+    std::vector<int> m_pending_deletes;
     TimerHash m_timers;
     ZeroTimerHash m_zero_timers;
+    WheelTimerHash m_wheel_timers;
+    WheelBucketHash m_wheel_buckets;
+    quint64 m_wheel_last = 0;
+
+    // Loop-lag instrumentation, enabled by setting the environment
+    // variable CUTELYST_EVENT_LOOP_LAG_WARN to a threshold in ms.
+    // Buckets are log2 microseconds of one dispatch pass, the time
+    // the loop could not serve other connections; written by the
+    // owning thread, read relaxed by a scraping thread.
+    enum { LagBuckets = 20 };
+    std::atomic<quint64> m_lag_histogram[LagBuckets] = {};
+    std::atomic<quint64> m_lag_sum_us = { 0 };
+    qint64 m_lag_warn_us = 0;
 
     static void socket_notifier_callback(const SocketNotifierInfo& n, int events);
+    void markSocketDirty(int fd, SocketNotifierInfo& sni);
+    void flushSocketCtls(void);
     void timer_callback(const TimerInfo& info);
+    void registerWheelTimer(int timerId, int interval, QObject* object);
+    void wheel_tick(void);
+    void arm_wheel(bool arm);
     void wake_up_handler(void);
 
     bool disableSocketNotifiers(bool disable);
@@ -15,18 +15,17 @@ void EventDispatcherEPollPrivate::registerSocketNotifier(QSocketNotifier* notifi
     QSocketNotifier** n = 0;
     int fd = static_cast<int>(notifier->socket());
 
-    epoll_event e;
-    e.data.fd = fd;
-
     HandleData* data;
     HandleHash::Iterator it = m_handles.find(fd);
 
     if (it == m_handles.end()) {
-        data        = new HandleData;
-        data->type  = htSocketNotifier;
-        data->sni.r = 0;
-        data->sni.w = 0;
-        data->sni.x = 0;
+        data            = new HandleData;
+        data->type      = htSocketNotifier;
+        data->sni.r     = 0;
+        data->sni.w     = 0;
+        data->sni.x     = 0;
+        data->sni.installed = -1;
+        data->sni.dirty = false;
 
         switch (notifier->type()) {
         case QSocketNotifier::Read:      events = EPOLLIN;  n = &data->sni.r; break;
@@ -37,17 +36,10 @@ void EventDispatcherEPollPrivate::registerSocketNotifier(QSocketNotifier* notifi
         }
 
         data->sni.events = events;
-        e.events         = events;
         *n               = notifier;
 
-        int res = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &e);
-        if (Q_UNLIKELY(res != 0)) {
-            qErrnoWarning("%s: epoll_ctl() failed", Q_FUNC_INFO);
-            delete data;
-            return;
-        }
-
         m_handles.insert(fd, data);
+        markSocketDirty(fd, data->sni);
     }
     else {
         data = it.value();
@@ -71,14 +63,8 @@ void EventDispatcherEPollPrivate::registerSocketNotifier(QSocketNotifier* notifi
             Q_ASSERT((data->sni.events & events) == 0);
 
             data->sni.events |= events;
-            e.events          = data->sni.events;
             *n                = notifier;
-
-            int res = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &e);
-            if (Q_UNLIKELY(res != 0)) {
-                qErrnoWarning("%s: epoll_ctl() failed", Q_FUNC_INFO);
-                return;
-            }
+            markSocketDirty(fd, data->sni);
         }
         else {
             Q_UNREACHABLE();
@@ -104,9 +90,6 @@ void EventDispatcherEPollPrivate::unregisterSocketNotifier(QSocketNotifier* noti
         auto hi = m_handles.find(fd);
         Q_ASSERT(hi != m_handles.end());
 
-        struct epoll_event e;
-        e.data.fd = fd;
-
         if (info->sni.r == notifier) {
             info->sni.events &= ~EPOLLIN;
             info->sni.r       = 0;
@@ -123,27 +106,93 @@ void EventDispatcherEPollPrivate::unregisterSocketNotifier(QSocketNotifier* noti
             qFatal("%s: internal error: cannot find socket notifier", Q_FUNC_INFO);
         }
 
-        e.events = info->sni.events;
-
-        int res;
-
         if (info->sni.r || info->sni.w || info->sni.x) {
-            res = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &e);
+            markSocketDirty(fd, info->sni);
         }
         else {
-            res = epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, &e);
-            if (Q_UNLIKELY(res != 0 && EBADF == errno)) {
-                res = 0;
+            if (info->sni.installed != -1) {
+                m_pending_deletes.push_back(fd);
             }
 
             m_handles.erase(hi);
             delete info;
         }
+    }
+}
+
+void EventDispatcherEPollPrivate::markSocketDirty(int fd, SocketNotifierInfo& sni)
+{
+    if (!sni.dirty) {
+        sni.dirty = true;
+        m_dirty_fds.push_back(fd);
+    }
+}
+
+void EventDispatcherEPollPrivate::flushSocketCtls(void)
+{
+    struct epoll_event e;
+
+    // Socket notifier changes are applied in one batch right before
+    // epoll_wait(); Qt toggles the write notifier around every flush
+    // and the disable/enable pair within one loop pass cancels out
+    // here without any epoll_ctl() traffic.
+    for (const int fd : m_pending_deletes) {
+        e.events  = 0;
+        e.data.fd = fd;
+        int res = epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, &e);
+        // closing the descriptor already dropped the registration
+        if (Q_UNLIKELY(res != 0 && ENOENT != errno && EBADF != errno)) {
+            qErrnoWarning("%s: epoll_ctl() failed", Q_FUNC_INFO);
+        }
+    }
+    m_pending_deletes.clear();
+
+    for (const int fd : m_dirty_fds) {
+        auto it = m_handles.constFind(fd);
+        if (it == m_handles.constEnd() || it.value()->type != htSocketNotifier) {
+            // fully unregistered again before the flush
+            continue;
+        }
+
+        SocketNotifierInfo &sni = it.value()->sni;
+        sni.dirty = false;
+
+        int events = sni.events;
+        if (m_edge_trigger) {
+            events |= EPOLLET;
+        }
+        if (events == sni.installed) {
+            continue;
+        }
+
+        e.events  = events;
+        e.data.fd = fd;
+
+        // the descriptor may have been closed and its number reused
+        // since the installed state was recorded, fall back to the
+        // other operation when the kernel disagrees with it
+        int res;
+        if (sni.installed == -1) {
+            res = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &e);
+            if (res != 0 && EEXIST == errno) {
+                res = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &e);
+            }
+        }
+        else {
+            res = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &e);
+            if (res != 0 && ENOENT == errno) {
+                res = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &e);
+            }
+        }
 
         if (Q_UNLIKELY(res != 0)) {
             qErrnoWarning("%s: epoll_ctl() failed", Q_FUNC_INFO);
         }
+        else {
+            sni.installed = events;
+        }
     }
+    m_dirty_fds.clear();
 }
 
 void EventDispatcherEPollPrivate::socket_notifier_callback(const SocketNotifierInfo& n, int events)
@@ -177,12 +226,25 @@ bool EventDispatcherEPollPrivate::disableSocketNotifiers(bool disable)
         HandleData* info          = it.value();
         int fd                    = static_cast<int>(notifier->socket());
 
+        if (info->sni.installed == -1) {
+            // registration still pending, flushSocketCtls() will
+            // install the current state
+            ++it;
+            continue;
+        }
+
         e.events  = disable ? 0 : info->sni.events;
+        if (!disable && m_edge_trigger) {
+            e.events |= EPOLLET;
+        }
         e.data.fd = fd;
         int res = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &e);
         if (Q_UNLIKELY(res != 0)) {
             qErrnoWarning("%s: epoll_ctl() failed", Q_FUNC_INFO);
         }
+        else {
+            info->sni.installed = static_cast<int>(e.events);
+        }
 
         ++it;
     }
@@ -175,12 +175,26 @@ void calculateNextTimeout(TimerInfo* info, const struct timeval& now, struct tim
 
     timersub(&when, &now, &delta);
 }
+
+static quint64 monotonicSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return quint64(ts.tv_sec);
+}
 }
 
 void EventDispatcherEPollPrivate::registerTimer(int timerId, int interval, Qt::TimerType type, QObject* object)
 {
     Q_ASSERT(interval > 0);
 
+    // Second-resolution timers (connection idle timeouts mostly) share
+    // a single timerfd through the timer wheel instead of one fd each.
+    if (Qt::VeryCoarseTimer == type || (Qt::CoarseTimer == type && interval >= 20000)) {
+        registerWheelTimer(timerId, interval, object);
+        return;
+    }
+
     int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
     if (Q_LIKELY(fd != -1)) {
         struct timeval now;
@@ -242,6 +256,103 @@ void EventDispatcherEPollPrivate::registerTimer(int timerId, int interval, Qt::T
     }
 }
 
+void EventDispatcherEPollPrivate::registerWheelTimer(int timerId, int interval, QObject* object)
+{
+    if (Q_UNLIKELY(m_wheel_fd == -1)) {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (Q_UNLIKELY(-1 == fd)) {
+            qErrnoWarning("%s: timerfd_create() failed", Q_FUNC_INFO);
+            return;
+        }
+
+        struct epoll_event event;
+        event.events  = EPOLLIN;
+        event.data.fd = fd;
+
+        if (Q_UNLIKELY(-1 == epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event))) {
+            qErrnoWarning("%s: epoll_ctl() failed", Q_FUNC_INFO);
+            close(fd);
+            return;
+        }
+
+        m_wheel_fd = fd;
+    }
+
+    if (m_wheel_timers.isEmpty()) {
+        m_wheel_last = monotonicSec();
+        arm_wheel(true);
+    }
+
+    WheelTimer data;
+    data.object   = object;
+    data.timerId  = timerId;
+    data.interval = interval;
+
+    quint64 secs = quint64(interval + 999) / 1000;
+    if (!secs) {
+        secs = 1;
+    }
+    data.expiry = monotonicSec() + secs;
+
+    m_wheel_timers.insert(timerId, data);
+    m_wheel_buckets[data.expiry].push_back(timerId);
+}
+
+void EventDispatcherEPollPrivate::arm_wheel(bool arm)
+{
+    struct itimerspec spec;
+    spec.it_interval.tv_sec  = arm ? 1 : 0;
+    spec.it_interval.tv_nsec = 0;
+    spec.it_value            = spec.it_interval;
+
+    if (Q_UNLIKELY(-1 == timerfd_settime(m_wheel_fd, 0, &spec, 0))) {
+        qErrnoWarning("%s: timerfd_settime() failed", Q_FUNC_INFO);
+    }
+}
+
+void EventDispatcherEPollPrivate::wheel_tick(void)
+{
+    uint64_t value;
+    int res;
+    do {
+        res = read(m_wheel_fd, &value, sizeof(value));
+    } while (-1 == res && EINTR == errno);
+
+    const quint64 now = monotonicSec();
+    while (m_wheel_last < now) {
+        ++m_wheel_last;
+
+        auto bucket = m_wheel_buckets.find(m_wheel_last);
+        if (bucket == m_wheel_buckets.end()) {
+            continue;
+        }
+
+        const std::vector<int> expired = bucket.value();
+        m_wheel_buckets.erase(bucket);
+
+        for (int timerId : expired) {
+            auto it = m_wheel_timers.find(timerId);
+            if (it == m_wheel_timers.end() || it.value().expiry != m_wheel_last) {
+                // unregistered or rescheduled, stale bucket entry
+                continue;
+            }
+
+            // reschedule before dispatching, the handler may unregister
+            WheelTimer& data = it.value();
+            quint64 secs = quint64(data.interval + 999) / 1000;
+            if (!secs) {
+                secs = 1;
+            }
+            data.expiry += secs;
+            m_wheel_buckets[data.expiry].push_back(timerId);
+
+            QObject* object = data.object;
+            QTimerEvent event(timerId);
+            QCoreApplication::sendEvent(object, &event);
+        }
+    }
+}
+
 void EventDispatcherEPollPrivate::registerZeroTimer(int timerId, QObject* object)
 {
     ZeroTimer data;
@@ -252,6 +363,17 @@ void EventDispatcherEPollPrivate::registerZeroTimer(int timerId, QObject* object
 
 bool EventDispatcherEPollPrivate::unregisterTimer(int timerId)
 {
+    auto wit = m_wheel_timers.find(timerId);
+    if (wit != m_wheel_timers.end()) {
+        // the bucket entry goes stale and is skipped on tick
+        m_wheel_timers.erase(wit);
+        if (m_wheel_timers.isEmpty()) {
+            m_wheel_buckets.clear();
+            arm_wheel(false);
+        }
+        return true;
+    }
+
     auto it = m_timers.find(timerId);
     if (it != m_timers.end()) {
         HandleData* data = it.value();
@@ -300,6 +422,22 @@ bool EventDispatcherEPollPrivate::unregisterTimers(QObject* object)
         }
     }
 
+    auto wit = m_wheel_timers.begin();
+    while (wit != m_wheel_timers.end()) {
+        if (object == wit.value().object) {
+            result = true;
+            wit    = m_wheel_timers.erase(wit);
+        }
+        else {
+            ++wit;
+        }
+    }
+
+    if (m_wheel_timers.isEmpty() && !m_wheel_buckets.isEmpty()) {
+        m_wheel_buckets.clear();
+        arm_wheel(false);
+    }
+
     auto zit = m_zero_timers.begin();
     while (zit != m_zero_timers.end()) {
         ZeroTimer& data = zit.value();
@@ -331,6 +469,17 @@ QList<QAbstractEventDispatcher::TimerInfo> EventDispatcherEPollPrivate::register
         ++it;
     }
 
+    auto wit = m_wheel_timers.constBegin();
+    while (wit != m_wheel_timers.constEnd()) {
+        const WheelTimer& data = wit.value();
+        if (object == data.object) {
+            QAbstractEventDispatcher::TimerInfo ti(wit.key(), data.interval, Qt::VeryCoarseTimer);
+            res.append(ti);
+        }
+
+        ++wit;
+    }
+
     auto zit = m_zero_timers.constBegin();
     while (zit != m_zero_timers.constEnd()) {
         const ZeroTimer& data = zit.value();
@@ -347,6 +496,13 @@ QList<QAbstractEventDispatcher::TimerInfo> EventDispatcherEPollPrivate::register
 
 int EventDispatcherEPollPrivate::remainingTime(int timerId) const
 {
+    auto wit = m_wheel_timers.constFind(timerId);
+    if (wit != m_wheel_timers.constEnd()) {
+        const quint64 now = monotonicSec();
+        const WheelTimer& data = wit.value();
+        return data.expiry > now ? static_cast<int>((data.expiry - now) * 1000) : 0;
+    }
+
     auto it = m_timers.constFind(timerId);
     if (it != m_timers.constEnd()) {
         HandleData* data = it.value();
@@ -450,5 +606,9 @@ bool EventDispatcherEPollPrivate::disableTimers(bool disable)
         ++it;
     }
 
+    if (m_wheel_fd != -1 && !m_wheel_timers.isEmpty()) {
+        arm_wheel(!disable);
+    }
+
     return true;
 }
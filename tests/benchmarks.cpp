@@ -0,0 +1,120 @@
+#include <QtTest/QTest>
+#include <QtCore/QObject>
+
+#include "headers.h"
+#include "coverageobject.h"
+
+#include <Cutelyst/application.h>
+#include <Cutelyst/controller.h>
+#include <Cutelyst/headers.h>
+
+using namespace Cutelyst;
+
+class Benchmarks : public CoverageObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchHeadersSet();
+    void benchHeadersGet();
+    void benchPathDispatch();
+    void benchPathDispatchManyArgs();
+    void benchChainedDispatch();
+
+    void cleanupTestCase();
+
+private:
+    TestEngine *m_engine;
+
+    TestEngine* getEngine();
+};
+
+void Benchmarks::initTestCase()
+{
+    m_engine = getEngine();
+    QVERIFY(m_engine);
+}
+
+TestEngine* Benchmarks::getEngine()
+{
+    auto app = new TestApplication;
+    auto engine = new TestEngine(app, QVariantMap());
+    if (!engine->init()) {
+        return nullptr;
+    }
+    return engine;
+}
+
+void Benchmarks::cleanupTestCase()
+{
+    delete m_engine;
+}
+
+void Benchmarks::benchHeadersSet()
+{
+    QBENCHMARK {
+        Headers headers;
+        headers.setContentType(QStringLiteral("text/html; charset=utf-8"));
+        headers.setContentLength(1234);
+        headers.setRawHeader(QByteArrayLiteral("HOST"), QByteArrayLiteral("cutelyst.org"));
+        headers.setRawHeader(QByteArrayLiteral("ACCEPT_ENCODING"), QByteArrayLiteral("gzip, deflate"));
+        headers.setHeader(QStringLiteral("x-custom-header"), QStringLiteral("some value"));
+    }
+}
+
+void Benchmarks::benchHeadersGet()
+{
+    Headers headers;
+    headers.setContentType(QStringLiteral("text/html; charset=utf-8"));
+    headers.setContentLength(1234);
+    headers.setRawHeader(QByteArrayLiteral("HOST"), QByteArrayLiteral("cutelyst.org"));
+    headers.setHeader(QStringLiteral("x-custom-header"), QStringLiteral("some value"));
+
+    QBENCHMARK {
+        headers.contentType();
+        headers.contentLength();
+        headers.rawHeader(QByteArrayLiteral("HOST"));
+        headers.header(QStringLiteral("x-custom-header"));
+    }
+}
+
+// Exercises the whole request path, dominated by
+// DispatchTypePath::match(), Context creation and
+// Engine::finalizeHeaders().
+void Benchmarks::benchPathDispatch()
+{
+    QBENCHMARK {
+        m_engine->createRequest(QStringLiteral("GET"),
+                                QStringLiteral("test/controller/hello"),
+                                QByteArray(),
+                                Headers(),
+                                nullptr);
+    }
+}
+
+void Benchmarks::benchPathDispatchManyArgs()
+{
+    QBENCHMARK {
+        m_engine->createRequest(QStringLiteral("GET"),
+                                QStringLiteral("test/controller/many/1/2/3/4/5/6/7/8/9/10/11/12"),
+                                QByteArray(),
+                                Headers(),
+                                nullptr);
+    }
+}
+
+void Benchmarks::benchChainedDispatch()
+{
+    QBENCHMARK {
+        m_engine->createRequest(QStringLiteral("GET"),
+                                QStringLiteral("chain/midle/one/two/end"),
+                                QByteArray(),
+                                Headers(),
+                                nullptr);
+    }
+}
+
+QTEST_MAIN(Benchmarks)
+
+#include "benchmarks.moc"
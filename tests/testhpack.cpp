@@ -0,0 +1,198 @@
+#include <QtTest/QTest>
+#include <QtCore/QObject>
+
+#include "coverageobject.h"
+
+#include "../wsgi/hpack.h"
+
+using namespace CWSGI;
+
+class TestHPack : public CoverageObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testStaticIndexed();
+    void testRfc7541AppendixC3();
+    void testRfc7541AppendixC4();
+    void testLiteralWithoutIndexing();
+    void testDynamicTableSizeUpdate();
+    void testDecodeErrors();
+    void testEncodeStatus();
+    void testEncodeHeaderRoundTrip();
+
+private:
+    static bool decodeHex(HPack &hpack, const QByteArray &hex, HPack::HeaderList &headers) {
+        const QByteArray block = QByteArray::fromHex(hex);
+        const quint8 *it = reinterpret_cast<const quint8 *>(block.constData());
+        return hpack.decode(it, it + block.size(), headers);
+    }
+};
+
+void TestHPack::testStaticIndexed()
+{
+    HPack hpack;
+    HPack::HeaderList headers;
+    QVERIFY(decodeHex(hpack, QByteArrayLiteral("828684"), headers));
+    QCOMPARE(headers.size(), size_t(3));
+    QCOMPARE(headers[0].first, QByteArrayLiteral(":method"));
+    QCOMPARE(headers[0].second, QByteArrayLiteral("GET"));
+    QCOMPARE(headers[1].first, QByteArrayLiteral(":scheme"));
+    QCOMPARE(headers[1].second, QByteArrayLiteral("http"));
+    QCOMPARE(headers[2].first, QByteArrayLiteral(":path"));
+    QCOMPARE(headers[2].second, QByteArrayLiteral("/"));
+}
+
+void TestHPack::testRfc7541AppendixC3()
+{
+    // Three requests on one connection, the dynamic table entries
+    // built by the first blocks must resolve in the later ones
+    HPack hpack;
+
+    HPack::HeaderList headers;
+    QVERIFY(decodeHex(hpack,
+                      QByteArrayLiteral("828684410f7777772e6578616d706c652e636f6d"), headers));
+    QCOMPARE(headers.size(), size_t(4));
+    QCOMPARE(headers[3].first, QByteArrayLiteral(":authority"));
+    QCOMPARE(headers[3].second, QByteArrayLiteral("www.example.com"));
+
+    headers.clear();
+    QVERIFY(decodeHex(hpack, QByteArrayLiteral("828684be58086e6f2d6361636865"), headers));
+    QCOMPARE(headers.size(), size_t(5));
+    // 0xbe is index 62, the :authority entry added by the first block
+    QCOMPARE(headers[3].first, QByteArrayLiteral(":authority"));
+    QCOMPARE(headers[3].second, QByteArrayLiteral("www.example.com"));
+    QCOMPARE(headers[4].first, QByteArrayLiteral("cache-control"));
+    QCOMPARE(headers[4].second, QByteArrayLiteral("no-cache"));
+
+    headers.clear();
+    QVERIFY(decodeHex(hpack,
+                      QByteArrayLiteral("828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565"),
+                      headers));
+    QCOMPARE(headers.size(), size_t(5));
+    QCOMPARE(headers[1].first, QByteArrayLiteral(":scheme"));
+    QCOMPARE(headers[1].second, QByteArrayLiteral("https"));
+    QCOMPARE(headers[2].first, QByteArrayLiteral(":path"));
+    QCOMPARE(headers[2].second, QByteArrayLiteral("/index.html"));
+    QCOMPARE(headers[4].first, QByteArrayLiteral("custom-key"));
+    QCOMPARE(headers[4].second, QByteArrayLiteral("custom-value"));
+}
+
+void TestHPack::testRfc7541AppendixC4()
+{
+    // The same three requests with Huffman coded strings
+    HPack hpack;
+
+    HPack::HeaderList headers;
+    QVERIFY(decodeHex(hpack, QByteArrayLiteral("828684418cf1e3c2e5f23a6ba0ab90f4ff"), headers));
+    QCOMPARE(headers.size(), size_t(4));
+    QCOMPARE(headers[3].first, QByteArrayLiteral(":authority"));
+    QCOMPARE(headers[3].second, QByteArrayLiteral("www.example.com"));
+
+    headers.clear();
+    QVERIFY(decodeHex(hpack, QByteArrayLiteral("828684be5886a8eb10649cbf"), headers));
+    QCOMPARE(headers.size(), size_t(5));
+    QCOMPARE(headers[4].first, QByteArrayLiteral("cache-control"));
+    QCOMPARE(headers[4].second, QByteArrayLiteral("no-cache"));
+
+    headers.clear();
+    QVERIFY(decodeHex(hpack,
+                      QByteArrayLiteral("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"),
+                      headers));
+    QCOMPARE(headers.size(), size_t(5));
+    QCOMPARE(headers[4].first, QByteArrayLiteral("custom-key"));
+    QCOMPARE(headers[4].second, QByteArrayLiteral("custom-value"));
+}
+
+void TestHPack::testLiteralWithoutIndexing()
+{
+    // RFC 7541 Appendix C.2.2, must not grow the dynamic table
+    HPack hpack;
+    HPack::HeaderList headers;
+    QVERIFY(decodeHex(hpack, QByteArrayLiteral("040c2f73616d706c652f70617468"), headers));
+    QCOMPARE(headers.size(), size_t(1));
+    QCOMPARE(headers[0].first, QByteArrayLiteral(":path"));
+    QCOMPARE(headers[0].second, QByteArrayLiteral("/sample/path"));
+
+    // index 62 must still be unresolvable afterwards
+    headers.clear();
+    QVERIFY(!decodeHex(hpack, QByteArrayLiteral("be"), headers));
+}
+
+void TestHPack::testDynamicTableSizeUpdate()
+{
+    HPack hpack;
+    HPack::HeaderList headers;
+    QVERIFY(decodeHex(hpack, QByteArrayLiteral("410f7777772e6578616d706c652e636f6d"), headers));
+    QCOMPARE(headers.size(), size_t(1));
+
+    // shrinking the table to zero evicts the entry above
+    headers.clear();
+    QVERIFY(decodeHex(hpack, QByteArrayLiteral("20"), headers));
+    QVERIFY(headers.empty());
+    QVERIFY(!decodeHex(hpack, QByteArrayLiteral("be"), headers));
+
+    // an update past our SETTINGS_HEADER_TABLE_SIZE is a compression
+    // error
+    QVERIFY(!decodeHex(hpack, QByteArrayLiteral("3fe15f"), headers));
+}
+
+void TestHPack::testDecodeErrors()
+{
+    HPack hpack;
+    HPack::HeaderList headers;
+
+    // index 0 is reserved
+    QVERIFY(!decodeHex(hpack, QByteArrayLiteral("80"), headers));
+    // indexed entry beyond both tables
+    QVERIFY(!decodeHex(hpack, QByteArrayLiteral("fe"), headers));
+    // string length past the end of the block
+    QVERIFY(!decodeHex(hpack, QByteArrayLiteral("040c2f73616d"), headers));
+    // truncated integer continuation
+    QVERIFY(!decodeHex(hpack, QByteArrayLiteral("7fff"), headers));
+    // Huffman string padded with something other than EOS bits
+    QVERIFY(!decodeHex(hpack, QByteArrayLiteral("0481e3c2e500"), headers));
+}
+
+void TestHPack::testEncodeStatus()
+{
+    QByteArray buf;
+    HPack::encodeStatus(buf, 200);
+    QCOMPARE(buf, QByteArray::fromHex(QByteArrayLiteral("88")));
+
+    buf.clear();
+    HPack::encodeStatus(buf, 404);
+    QCOMPARE(buf, QByteArray::fromHex(QByteArrayLiteral("8d")));
+
+    // a status without a static table entry goes out as a literal,
+    // feed it back through a decoder to check the encoding
+    buf.clear();
+    HPack::encodeStatus(buf, 418);
+    HPack hpack;
+    HPack::HeaderList headers;
+    const quint8 *it = reinterpret_cast<const quint8 *>(buf.constData());
+    QVERIFY(hpack.decode(it, it + buf.size(), headers));
+    QCOMPARE(headers.size(), size_t(1));
+    QCOMPARE(headers[0].first, QByteArrayLiteral(":status"));
+    QCOMPARE(headers[0].second, QByteArrayLiteral("418"));
+}
+
+void TestHPack::testEncodeHeaderRoundTrip()
+{
+    QByteArray buf;
+    HPack::encodeHeader(buf, QByteArrayLiteral("content-type"), QByteArrayLiteral("text/html"));
+    HPack::encodeHeader(buf, QByteArrayLiteral("x-long"), QByteArray(300, 'a'));
+
+    HPack hpack;
+    HPack::HeaderList headers;
+    const quint8 *it = reinterpret_cast<const quint8 *>(buf.constData());
+    QVERIFY(hpack.decode(it, it + buf.size(), headers));
+    QCOMPARE(headers.size(), size_t(2));
+    QCOMPARE(headers[0].first, QByteArrayLiteral("content-type"));
+    QCOMPARE(headers[0].second, QByteArrayLiteral("text/html"));
+    QCOMPARE(headers[1].first, QByteArrayLiteral("x-long"));
+    QCOMPARE(headers[1].second, QByteArray(300, 'a'));
+}
+
+QTEST_MAIN(TestHPack)
+
+#include "testhpack.moc"
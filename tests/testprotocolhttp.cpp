@@ -0,0 +1,231 @@
+#include <QtTest/QTest>
+#include <QtCore/QObject>
+
+#include "coverageobject.h"
+
+#include "../wsgi/wsgi.h"
+#include "../wsgi/cwsgiengine.h"
+#include "../wsgi/protocolhttp.h"
+#include "../wsgi/socket.h"
+
+using namespace CWSGI;
+using namespace Cutelyst;
+
+namespace {
+
+/**
+ * Stands in for an accepted connection: request bytes are queued on
+ * feed, everything the server writes lands in out. The parser only
+ * talks to the QIODevice interface, so it cannot tell the difference
+ * from a connected socket.
+ */
+class CaptureSocket : public TcpSocket
+{
+public:
+    explicit CaptureSocket(WSGI *wsgi) : TcpSocket(wsgi) {
+        QIODevice::open(QIODevice::ReadWrite);
+    }
+
+    qint64 bytesAvailable() const override {
+        return feed.size() + QIODevice::bytesAvailable();
+    }
+
+    QByteArray feed;
+    QByteArray out;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override {
+        const qint64 len = qMin(maxlen, static_cast<qint64>(feed.size()));
+        memcpy(data, feed.constData(), static_cast<size_t>(len));
+        feed.remove(0, static_cast<int>(len));
+        return len;
+    }
+
+    qint64 writeData(const char *data, qint64 len) override {
+        out.append(data, static_cast<int>(len));
+        return len;
+    }
+};
+
+}
+
+class TestProtocolHttp : public CoverageObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testSimpleGet();
+    void testQueryString();
+    void testPipelinedKeepAlive();
+    void testBodySplitAcrossReads();
+    void testTooManyHeaderLines();
+    void testBodyLimit();
+    void testTlsClientHello();
+
+    void cleanupTestCase();
+
+private:
+    CaptureSocket *makeSocket(ProtocolHttp *proto = nullptr);
+
+    WSGI *m_wsgi;
+    CWsgiEngine *m_engine;
+    ProtocolHttp *m_proto;
+};
+
+void TestProtocolHttp::initTestCase()
+{
+    m_wsgi = new WSGI;
+    auto app = new TestApplication;
+    m_engine = new CWsgiEngine(app, 0, QVariantMap(), m_wsgi);
+    QVERIFY(m_engine->init());
+    m_engine->postFork(0);
+    m_proto = new ProtocolHttp(m_wsgi);
+}
+
+void TestProtocolHttp::cleanupTestCase()
+{
+    delete m_proto;
+    delete m_engine;
+}
+
+CaptureSocket *TestProtocolHttp::makeSocket(ProtocolHttp *proto)
+{
+    auto sock = new CaptureSocket(m_wsgi);
+    sock->engine = m_engine;
+    sock->proto = proto ? proto : m_proto;
+    sock->resetSocket();
+    sock->serverAddress = QStringLiteral("localhost");
+    sock->remoteAddress = QHostAddress(QHostAddress::LocalHost);
+    sock->remotePort = 12345;
+    return sock;
+}
+
+void TestProtocolHttp::testSimpleGet()
+{
+    CaptureSocket *sock = makeSocket();
+    sock->feed = QByteArrayLiteral("GET /test/controller/hello HTTP/1.1\r\n"
+                                   "Host: localhost\r\n"
+                                   "Connection: close\r\n\r\n");
+    sock->proto->readyRead(sock, sock);
+
+    QVERIFY(sock->out.startsWith(QByteArrayLiteral("HTTP/1.1 200 OK\r\n")));
+    const int split = sock->out.indexOf(QByteArrayLiteral("\r\n\r\n"));
+    QVERIFY(split != -1);
+    const QByteArray head = sock->out.left(split);
+    QVERIFY(head.contains(QByteArrayLiteral("\r\nConnection: close")));
+    QVERIFY(head.contains(QByteArrayLiteral("\r\nContent-Length: 33")));
+    QCOMPARE(sock->out.mid(split + 4), QByteArrayLiteral("path /test/controller/hello args "));
+    delete sock;
+}
+
+void TestProtocolHttp::testQueryString()
+{
+    CaptureSocket *sock = makeSocket();
+    sock->feed = QByteArrayLiteral("GET /uriFor?path=/foo HTTP/1.1\r\n"
+                                   "Host: localhost\r\n"
+                                   "Connection: close\r\n\r\n");
+    sock->proto->readyRead(sock, sock);
+
+    QVERIFY(sock->out.startsWith(QByteArrayLiteral("HTTP/1.1 200 OK\r\n")));
+    const int split = sock->out.indexOf(QByteArrayLiteral("\r\n\r\n"));
+    QVERIFY(split != -1);
+    // uriFor builds the answer from the parsed query and Host header
+    QCOMPARE(sock->out.mid(split + 4), QByteArrayLiteral("http://localhost/foo"));
+    delete sock;
+}
+
+void TestProtocolHttp::testPipelinedKeepAlive()
+{
+    CaptureSocket *sock = makeSocket();
+    sock->feed = QByteArrayLiteral("GET /test/controller/hello HTTP/1.1\r\n"
+                                   "Host: localhost\r\n"
+                                   "Connection: keep-alive\r\n\r\n"
+                                   "GET /global HTTP/1.1\r\n"
+                                   "Host: localhost\r\n"
+                                   "Connection: close\r\n\r\n");
+    sock->proto->readyRead(sock, sock);
+
+    // both answers must be on the wire, in request order
+    QCOMPARE(sock->out.count(QByteArrayLiteral("HTTP/1.1 200 OK\r\n")), 2);
+    const int firstBody = sock->out.indexOf(QByteArrayLiteral("path /test/controller/hello args "));
+    const int secondBody = sock->out.indexOf(QByteArrayLiteral("path /global args "));
+    QVERIFY(firstBody != -1);
+    QVERIFY(secondBody > firstBody);
+    QVERIFY(sock->out.contains(QByteArrayLiteral("\r\nConnection: keep-alive")));
+    QVERIFY(sock->out.contains(QByteArrayLiteral("\r\nConnection: close")));
+    delete sock;
+}
+
+void TestProtocolHttp::testBodySplitAcrossReads()
+{
+    CaptureSocket *sock = makeSocket();
+    sock->feed = QByteArrayLiteral("POST /test/controller/hello HTTP/1.1\r\n"
+                                   "Host: localhost\r\n"
+                                   "Content-Length: 10\r\n"
+                                   "Connection: close\r\n\r\n"
+                                   "01234");
+    sock->proto->readyRead(sock, sock);
+    // half the body is still missing, nothing may be dispatched yet
+    QVERIFY(sock->out.isEmpty());
+    QCOMPARE(sock->connState, Socket::ContentBody);
+
+    sock->feed = QByteArrayLiteral("56789");
+    sock->proto->readyRead(sock, sock);
+    QVERIFY(sock->out.startsWith(QByteArrayLiteral("HTTP/1.1 200 OK\r\n")));
+    delete sock;
+}
+
+void TestProtocolHttp::testTooManyHeaderLines()
+{
+    CaptureSocket *sock = makeSocket();
+    QByteArray req = QByteArrayLiteral("GET / HTTP/1.1\r\nHost: localhost\r\n");
+    for (int i = 0; i < 101; ++i) {
+        req += QByteArrayLiteral("X-Filler-") + QByteArray::number(i) + QByteArrayLiteral(": 1\r\n");
+    }
+    req += QByteArrayLiteral("\r\n");
+    sock->feed = req;
+    sock->proto->readyRead(sock, sock);
+
+    QVERIFY(sock->out.startsWith(QByteArrayLiteral("HTTP/1.1 431 ")));
+    QVERIFY(sock->out.contains(QByteArrayLiteral("\r\nConnection: close")));
+    delete sock;
+}
+
+void TestProtocolHttp::testBodyLimit()
+{
+    // body gates are read once at protocol construction, use a
+    // separately configured instance so the shared one stays clean
+    auto limitWsgi = new WSGI;
+    limitWsgi->setBodyLimit({ QStringLiteral("test=16") });
+    auto proto = new ProtocolHttp(limitWsgi);
+
+    CaptureSocket *sock = makeSocket(proto);
+    sock->feed = QByteArrayLiteral("POST /test/controller/hello HTTP/1.1\r\n"
+                                   "Host: localhost\r\n"
+                                   "Content-Length: 64\r\n"
+                                   "Connection: close\r\n\r\n")
+            + QByteArray(64, 'x');
+    sock->proto->readyRead(sock, sock);
+
+    // refused from the header block alone, before any body buffering
+    QVERIFY(sock->out.startsWith(QByteArrayLiteral("HTTP/1.1 413 ")));
+    delete sock;
+    delete proto;
+}
+
+void TestProtocolHttp::testTlsClientHello()
+{
+    CaptureSocket *sock = makeSocket();
+    // a TLS handshake record on a plain listener must be dropped
+    // without an HTTP answer
+    sock->feed = QByteArray::fromHex(QByteArrayLiteral("160301010100fd"));
+    sock->proto->readyRead(sock, sock);
+    QVERIFY(sock->out.isEmpty());
+    delete sock;
+}
+
+QTEST_MAIN(TestProtocolHttp)
+
+#include "testprotocolhttp.moc"
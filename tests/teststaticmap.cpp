@@ -0,0 +1,211 @@
+#include <QtTest/QTest>
+#include <QtCore/QObject>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QTemporaryDir>
+
+#include "headers.h"
+#include "coverageobject.h"
+
+#include "../wsgi/staticmap.h"
+
+#include <Cutelyst/application.h>
+#include <Cutelyst/headers.h>
+
+using namespace Cutelyst;
+
+class TestStaticMap : public CoverageObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testServeFile();
+    void testNotModified();
+    void testRangeFirstBytes();
+    void testRangeOpenEnded();
+    void testRangeSuffix();
+    void testRangeUnsatisfiable();
+    void testRangeInvalidServesFull();
+    void testIfRangeMismatchServesFull();
+    void testCompressedSidecar();
+    void testMissingFileFallsThrough();
+
+    void cleanupTestCase();
+
+private:
+    QVariantMap doRequest(const QString &path, const Headers &headers = Headers());
+
+    QTemporaryDir m_docRoot;
+    TestEngine *m_engine;
+    // 20 bytes, so the range math below is easy to follow
+    const QByteArray m_asset = QByteArrayLiteral("0123456789abcdefghij");
+    const QByteArray m_sidecar = QByteArrayLiteral("pretend-gzip-payload");
+};
+
+void TestStaticMap::initTestCase()
+{
+    QVERIFY(m_docRoot.isValid());
+
+    QFile asset(m_docRoot.path() + QLatin1String("/hello.txt"));
+    QVERIFY(asset.open(QFile::WriteOnly));
+    QCOMPARE(asset.write(m_asset), qint64(m_asset.size()));
+    asset.close();
+
+    QFile page(m_docRoot.path() + QLatin1String("/page.html"));
+    QVERIFY(page.open(QFile::WriteOnly));
+    QVERIFY(page.write(QByteArrayLiteral("<html></html>")) > 0);
+    page.close();
+
+    // sidecars are served verbatim, the bytes only have to differ
+    // from the plain file to show which one went out
+    QFile sidecar(m_docRoot.path() + QLatin1String("/page.html.gz"));
+    QVERIFY(sidecar.open(QFile::WriteOnly));
+    QCOMPARE(sidecar.write(m_sidecar), qint64(m_sidecar.size()));
+    sidecar.close();
+
+    auto app = new TestApplication;
+    auto staticMap = new CWSGI::StaticMap(app);
+    staticMap->addStaticMap(QStringLiteral("/assets"), m_docRoot.path(), false);
+
+    m_engine = new TestEngine(app, QVariantMap());
+    QVERIFY(m_engine->init());
+}
+
+void TestStaticMap::cleanupTestCase()
+{
+    delete m_engine;
+}
+
+QVariantMap TestStaticMap::doRequest(const QString &path, const Headers &headers)
+{
+    return m_engine->createRequest(QStringLiteral("GET"), path, QByteArray(), headers, nullptr);
+}
+
+void TestStaticMap::testServeFile()
+{
+    const QVariantMap result = doRequest(QStringLiteral("assets/hello.txt"));
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), m_asset);
+
+    const Headers headers = result.value(QStringLiteral("headers")).value<Headers>();
+    QVERIFY(!headers.header(QStringLiteral("ETag")).isEmpty());
+    QCOMPARE(headers.header(QStringLiteral("Accept-Ranges")), QStringLiteral("bytes"));
+    QCOMPARE(headers.header(QStringLiteral("Cache-Control")), QStringLiteral("public"));
+    QCOMPARE(headers.header(QStringLiteral("Content-Length")), QString::number(m_asset.size()));
+    QVERIFY(headers.contentType().startsWith(QLatin1String("text/plain")));
+}
+
+void TestStaticMap::testNotModified()
+{
+    const QVariantMap first = doRequest(QStringLiteral("assets/hello.txt"));
+    const QString etag = first.value(QStringLiteral("headers")).value<Headers>()
+            .header(QStringLiteral("ETag"));
+    QVERIFY(!etag.isEmpty());
+
+    Headers reqHeaders;
+    reqHeaders.setHeader(QStringLiteral("If-None-Match"), etag);
+    const QVariantMap result = doRequest(QStringLiteral("assets/hello.txt"), reqHeaders);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 304);
+    QVERIFY(result.value(QStringLiteral("body")).toByteArray().isEmpty());
+    QCOMPARE(result.value(QStringLiteral("headers")).value<Headers>()
+             .header(QStringLiteral("ETag")), etag);
+}
+
+void TestStaticMap::testRangeFirstBytes()
+{
+    Headers reqHeaders;
+    reqHeaders.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=0-3"));
+    const QVariantMap result = doRequest(QStringLiteral("assets/hello.txt"), reqHeaders);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 206);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("0123"));
+
+    const Headers headers = result.value(QStringLiteral("headers")).value<Headers>();
+    QCOMPARE(headers.header(QStringLiteral("Content-Range")), QStringLiteral("bytes 0-3/20"));
+    QCOMPARE(headers.header(QStringLiteral("Content-Length")), QStringLiteral("4"));
+}
+
+void TestStaticMap::testRangeOpenEnded()
+{
+    Headers reqHeaders;
+    reqHeaders.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=15-"));
+    const QVariantMap result = doRequest(QStringLiteral("assets/hello.txt"), reqHeaders);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 206);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("fghij"));
+    QCOMPARE(result.value(QStringLiteral("headers")).value<Headers>()
+             .header(QStringLiteral("Content-Range")), QStringLiteral("bytes 15-19/20"));
+}
+
+void TestStaticMap::testRangeSuffix()
+{
+    Headers reqHeaders;
+    reqHeaders.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=-5"));
+    const QVariantMap result = doRequest(QStringLiteral("assets/hello.txt"), reqHeaders);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 206);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("fghij"));
+    QCOMPARE(result.value(QStringLiteral("headers")).value<Headers>()
+             .header(QStringLiteral("Content-Range")), QStringLiteral("bytes 15-19/20"));
+}
+
+void TestStaticMap::testRangeUnsatisfiable()
+{
+    Headers reqHeaders;
+    reqHeaders.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=500-"));
+    const QVariantMap result = doRequest(QStringLiteral("assets/hello.txt"), reqHeaders);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 416);
+    QVERIFY(result.value(QStringLiteral("body")).toByteArray().isEmpty());
+    QCOMPARE(result.value(QStringLiteral("headers")).value<Headers>()
+             .header(QStringLiteral("Content-Range")), QStringLiteral("bytes */20"));
+}
+
+void TestStaticMap::testRangeInvalidServesFull()
+{
+    // multi ranges would need a multipart body, those clients get
+    // the whole representation
+    Headers reqHeaders;
+    reqHeaders.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=0-1,3-4"));
+    const QVariantMap result = doRequest(QStringLiteral("assets/hello.txt"), reqHeaders);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), m_asset);
+}
+
+void TestStaticMap::testIfRangeMismatchServesFull()
+{
+    Headers reqHeaders;
+    reqHeaders.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=0-3"));
+    reqHeaders.setHeader(QStringLiteral("If-Range"), QStringLiteral("\"stale-validator\""));
+    const QVariantMap result = doRequest(QStringLiteral("assets/hello.txt"), reqHeaders);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), m_asset);
+}
+
+void TestStaticMap::testCompressedSidecar()
+{
+    Headers reqHeaders;
+    reqHeaders.setHeader(QStringLiteral("Accept-Encoding"), QStringLiteral("gzip, deflate"));
+    const QVariantMap result = doRequest(QStringLiteral("assets/page.html"), reqHeaders);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), m_sidecar);
+
+    const Headers headers = result.value(QStringLiteral("headers")).value<Headers>();
+    QCOMPARE(headers.contentEncoding(), QStringLiteral("gzip"));
+    QCOMPARE(headers.header(QStringLiteral("Vary")), QStringLiteral("Accept-Encoding"));
+    // the media type belongs to the asset, not to the sidecar
+    QVERIFY(headers.contentType().startsWith(QLatin1String("text/html")));
+
+    // without the Accept-Encoding opt-in the plain file goes out
+    const QVariantMap plain = doRequest(QStringLiteral("assets/page.html"));
+    QCOMPARE(plain.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("<html></html>"));
+    QVERIFY(plain.value(QStringLiteral("headers")).value<Headers>().contentEncoding().isEmpty());
+}
+
+void TestStaticMap::testMissingFileFallsThrough()
+{
+    const QVariantMap result = doRequest(QStringLiteral("assets/no-such-file.txt"));
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 404);
+}
+
+QTEST_MAIN(TestStaticMap)
+
+#include "teststaticmap.moc"
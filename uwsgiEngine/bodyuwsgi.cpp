@@ -28,6 +28,16 @@ BodyUWSGI::BodyUWSGI(wsgi_request *request, bool sequential, QObject *parent) :
     open(QIODevice::ReadOnly | QIODevice::Unbuffered);
 }
 
+void BodyUWSGI::setRequest(wsgi_request *request, bool sequential)
+{
+    m_request = request;
+    m_sequential = sequential;
+    // our close() override is a no-op, go through the base class to
+    // reset the device position for the new request
+    QIODevice::close();
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
 bool BodyUWSGI::isSequential() const
 {
     return m_sequential;
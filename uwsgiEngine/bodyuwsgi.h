@@ -30,6 +30,12 @@ class BodyUWSGI : public QIODevice
 public:
     explicit BodyUWSGI(struct wsgi_request *request, bool sequential, QObject *parent = 0);
 
+    /**
+     * Rebinds the device to a new request, resetting the QIODevice
+     * bookkeeping, so one instance can serve request after request.
+     */
+    void setRequest(struct wsgi_request *request, bool sequential);
+
     virtual bool isSequential() const override;
 
     virtual qint64 pos() const override;
@@ -26,6 +26,8 @@
 #include <QtCore/QTimer>
 #include <QtCore/QFile>
 
+#include <utility>
+
 #include <Cutelyst/common.h>
 #include <Cutelyst/application.h>
 #include <Cutelyst/context.h>
@@ -107,6 +109,86 @@ static inline uint16_t notSlash(char *str, uint16_t length) {
     return length;
 }
 
+// uwsgi already normalized the var names (uppercase, '_' for '-'),
+// so the common ones can map straight to interned keys like the
+// cutelyst-wsgi HTTP parser does. Dispatched on the length first
+// so at most a few candidates are compared.
+static inline QByteArray internedVarKey(const char *str, int size)
+{
+    switch (size) {
+    case 4:
+        if (!memcmp(str, "HOST", 4)) return QByteArrayLiteral("HOST");
+        break;
+    case 6:
+        if (!memcmp(str, "ACCEPT", 6)) return QByteArrayLiteral("ACCEPT");
+        if (!memcmp(str, "COOKIE", 6)) return QByteArrayLiteral("COOKIE");
+        if (!memcmp(str, "ORIGIN", 6)) return QByteArrayLiteral("ORIGIN");
+        break;
+    case 7:
+        if (!memcmp(str, "REFERER", 7)) return QByteArrayLiteral("REFERER");
+        if (!memcmp(str, "UPGRADE", 7)) return QByteArrayLiteral("UPGRADE");
+        break;
+    case 10:
+        if (!memcmp(str, "CONNECTION", 10)) return QByteArrayLiteral("CONNECTION");
+        if (!memcmp(str, "USER_AGENT", 10)) return QByteArrayLiteral("USER_AGENT");
+        break;
+    case 13:
+        if (!memcmp(str, "AUTHORIZATION", 13)) return QByteArrayLiteral("AUTHORIZATION");
+        if (!memcmp(str, "CACHE_CONTROL", 13)) return QByteArrayLiteral("CACHE_CONTROL");
+        if (!memcmp(str, "IF_NONE_MATCH", 13)) return QByteArrayLiteral("IF_NONE_MATCH");
+        break;
+    case 15:
+        if (!memcmp(str, "ACCEPT_ENCODING", 15)) return QByteArrayLiteral("ACCEPT_ENCODING");
+        if (!memcmp(str, "ACCEPT_LANGUAGE", 15)) return QByteArrayLiteral("ACCEPT_LANGUAGE");
+        if (!memcmp(str, "X_FORWARDED_FOR", 15)) return QByteArrayLiteral("X_FORWARDED_FOR");
+        break;
+    case 17:
+        if (!memcmp(str, "IF_MODIFIED_SINCE", 17)) return QByteArrayLiteral("IF_MODIFIED_SINCE");
+        if (!memcmp(str, "X_FORWARDED_PROTO", 17)) return QByteArrayLiteral("X_FORWARDED_PROTO");
+        break;
+    default:
+        break;
+    }
+    return QByteArray(str, size);
+}
+
+// The method and protocol come from tiny fixed sets, return shared
+// string data instead of allocating a QString per request
+static inline QString internedMethod(const char *str, int size)
+{
+    switch (size) {
+    case 3:
+        if (!memcmp(str, "GET", 3)) return QStringLiteral("GET");
+        if (!memcmp(str, "PUT", 3)) return QStringLiteral("PUT");
+        break;
+    case 4:
+        if (!memcmp(str, "POST", 4)) return QStringLiteral("POST");
+        if (!memcmp(str, "HEAD", 4)) return QStringLiteral("HEAD");
+        break;
+    case 5:
+        if (!memcmp(str, "PATCH", 5)) return QStringLiteral("PATCH");
+        break;
+    case 6:
+        if (!memcmp(str, "DELETE", 6)) return QStringLiteral("DELETE");
+        break;
+    case 7:
+        if (!memcmp(str, "OPTIONS", 7)) return QStringLiteral("OPTIONS");
+        break;
+    default:
+        break;
+    }
+    return QString::fromLatin1(str, size);
+}
+
+static inline QString internedProtocol(const char *str, int size)
+{
+    if (size == 8) {
+        if (!memcmp(str, "HTTP/1.1", 8)) return QStringLiteral("HTTP/1.1");
+        if (!memcmp(str, "HTTP/1.0", 8)) return QStringLiteral("HTTP/1.0");
+    }
+    return QString::fromLatin1(str, size);
+}
+
 void uWSGI::processRequest(wsgi_request *req)
 {
     // wsgi_req->uri containg the whole URI it /foo/bar?query=null
@@ -120,8 +202,8 @@ void uWSGI::processRequest(wsgi_request *req)
     request.serverAddress = QString::fromLatin1(req->host, req->host_len);
     request.query = QByteArray::fromRawData(req->query_string, req->query_string_len);
 
-    request.method = QString::fromLatin1(req->method, req->method_len);
-    request.protocol = QString::fromLatin1(req->protocol, req->protocol_len);
+    request.method = internedMethod(req->method, req->method_len);
+    request.protocol = internedProtocol(req->protocol, req->protocol_len);
     request.remoteAddress.setAddress(QString::fromLatin1(req->remote_addr, req->remote_addr_len));
     request.remoteUser = QString::fromLatin1(req->remote_user, req->remote_user_len);
     request.isSecure = req->https_len;
@@ -136,8 +218,8 @@ void uWSGI::processRequest(wsgi_request *req)
         struct iovec &value = req->hvec[i];
         if (!uwsgi_startswith(static_cast<char *>(name.iov_base),
                               const_cast<char *>("HTTP_"), 5)) {
-            headers.pushRawHeader(QString::fromLatin1(static_cast<char *>(name.iov_base) + 5, name.iov_len - 5),
-                                  QString::fromLatin1(static_cast<char *>(value.iov_base), value.iov_len));
+            headers.pushRawHeader(internedVarKey(static_cast<char *>(name.iov_base) + 5, name.iov_len - 5),
+                                  QByteArray(static_cast<char *>(value.iov_base), value.iov_len));
         } else if (!request.remotePort &&
                    !uwsgi_strncmp(const_cast<char *>("REMOTE_PORT"), 11,
                                   static_cast<char *>(name.iov_base), name.iov_len)) {
@@ -153,30 +235,39 @@ void uWSGI::processRequest(wsgi_request *req)
         headers.setContentEncoding(QString::fromLatin1(req->encoding, req->encoding_len));
     }
 
+    // the body device is reused across requests: it is only read
+    // while processRequest2() runs, mirroring the delete that used to
+    // sit right behind it
     QIODevice *body = nullptr;
     if (req->post_cl) {
         if (req->post_file) {
             //        qCDebug(CUTELYST_UWSGI) << "Post file available:" << req->post_file;
-            auto upload = new QFile;
-            if (upload->open(req->post_file, QIODevice::ReadOnly)) {
-                body = upload;
-            } else {
-                //            qCDebug(CUTELYST_UWSGI) << "Could not open post file:" << upload->errorString();
-                body = new BodyUWSGI(req, !uwsgi.post_buffering);
-                body->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+            if (!m_postFile) {
+                m_postFile = new QFile(this);
             }
-        } else {
+            if (m_postFile->open(req->post_file, QIODevice::ReadOnly)) {
+                body = m_postFile;
+            }
+        }
+        if (!body) {
             //        qCDebug(CUTELYST_UWSGI) << "Post buffering size:" << uwsgi.post_buffering;
-            body = new BodyUWSGI(req, !uwsgi.post_buffering);
-            body->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+            // already opened unbuffered, reads go straight to uwsgi's buffer
+            if (!m_bodyUWSGI) {
+                m_bodyUWSGI = new BodyUWSGI(req, !uwsgi.post_buffering, this);
+            } else {
+                m_bodyUWSGI->setRequest(req, !uwsgi.post_buffering);
+            }
+            body = m_bodyUWSGI;
         }
         headers.setContentLength(req->post_cl);
     }
     request.body = body;
 
-    delete Engine::processRequest2(request);
+    delete Engine::processRequest2(std::move(request));
 
-    delete body;
+    if (body && body == m_postFile) {
+        m_postFile->close();
+    }
 }
 
 void uWSGI::addUnusedRequest(wsgi_request *wsgi_req)
@@ -191,41 +282,45 @@ uwsgi_socket* uWSGI::watchSocket(struct uwsgi_socket *uwsgi_sock)
             socketNotifier, &QSocketNotifier::setEnabled);
     connect(socketNotifier, &QSocketNotifier::activated,
             [=](int fd) {
-        if (m_unusedReq.empty()) {
-            uwsgi_async_queue_is_full(uwsgi_now());
-            return;
-        }
+        // drain the whole accept backlog in this wakeup; one
+        // event-loop turn per connection amplifies wakeups badly
+        // under load
+        Q_FOREVER {
+            if (m_unusedReq.empty()) {
+                uwsgi_async_queue_is_full(uwsgi_now());
+                return;
+            }
 
-        struct wsgi_request *wsgi_req = m_unusedReq.back();
+            struct wsgi_request *wsgi_req = m_unusedReq.back();
 
-        // fill wsgi_request structure
-        wsgi_req_setup(wsgi_req, wsgi_req->async_id, uwsgi_sock);
+            // fill wsgi_request structure
+            wsgi_req_setup(wsgi_req, wsgi_req->async_id, uwsgi_sock);
 
-        // mark core as used
-        uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].in_request = 1;
+            // mark core as used
+            uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].in_request = 1;
 
-        // accept the connection
-        if (wsgi_req_simple_accept(wsgi_req, fd) != 0) {
-            uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].in_request = 0;
-            m_unusedReq.push_back(wsgi_req);
-            return;
-        }
-        m_unusedReq.pop_back();
+            // accept the connection, failure means the backlog is drained
+            if (wsgi_req_simple_accept(wsgi_req, fd) != 0) {
+                uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].in_request = 0;
+                return;
+            }
+            m_unusedReq.pop_back();
 
-        wsgi_req->start_of_request = uwsgi_micros();
-        wsgi_req->start_of_request_in_sec = wsgi_req->start_of_request/1000000;
+            wsgi_req->start_of_request = uwsgi_micros();
+            wsgi_req->start_of_request_in_sec = wsgi_req->start_of_request/1000000;
 
 #ifdef UWSGI_GO_CHEAP_CODE
-        // enter harakiri mode
-        if (uwsgi.harakiri_options.workers > 0) {
-            set_harakiri(uwsgi.harakiri_options.workers);
-        }
+            // enter harakiri mode
+            if (uwsgi.harakiri_options.workers > 0) {
+                set_harakiri(uwsgi.harakiri_options.workers);
+            }
 #endif // UWSGI_GO_CHEAP_CODE
 
-        readRequestUWSGI(wsgi_req);
-        uwsgi_close_request(wsgi_req);
+            readRequestUWSGI(wsgi_req);
+            uwsgi_close_request(wsgi_req);
 
-        m_unusedReq.push_back(wsgi_req);
+            m_unusedReq.push_back(wsgi_req);
+        }
     });
 
     return uwsgi_sock->next;
@@ -261,6 +356,10 @@ uwsgi_socket *uWSGI::watchSocketAsync(struct uwsgi_socket *uwsgi_sock)
             socketNotifier, &QSocketNotifier::setEnabled);
     connect(socketNotifier, &QSocketNotifier::activated,
             [=](int fd) {
+        // accept everything that is pending in this wakeup; each
+        // accepted request gets its own notifier below and proceeds
+        // on its own
+        Q_FOREVER {
         if (m_unusedReq.empty()) {
             uwsgi_async_queue_is_full(uwsgi_now());
             return;
@@ -274,10 +373,10 @@ uwsgi_socket *uWSGI::watchSocketAsync(struct uwsgi_socket *uwsgi_sock)
         // mark core as used
         uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].in_request = 1;
 
-        // accept the connection (since uWSGI 1.5 all of the sockets are non-blocking)
+        // accept the connection (since uWSGI 1.5 all of the sockets are
+        // non-blocking), failure means the backlog is drained
         if (wsgi_req_simple_accept(wsgi_req, fd) != 0) {
             uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].in_request = 0;
-            m_unusedReq.push_back(wsgi_req);
             return;
         }
         m_unusedReq.pop_back();
@@ -332,7 +431,7 @@ uwsgi_socket *uWSGI::watchSocketAsync(struct uwsgi_socket *uwsgi_sock)
         });
 
         timeoutTimer->start();
-
+        }
     });
 
     return uwsgi_sock->next;
@@ -360,12 +459,13 @@ bool uWSGI::finalizeHeadersWrite(Context *c, quint16 status, const Headers &head
         return false;
     }
 
-    const auto headersData = headers.data();
+    const auto headersData = headers.rawData();
     auto it = headersData.constBegin();
     const auto endIt = headersData.constEnd();
     while (it != endIt) {
-        const QByteArray key = camelCaseHeader(it.key()).toLatin1();
-        const QByteArray value = it.value().toLatin1();
+        QByteArray key = it.key();
+        camelCaseByteArrayHeader(key);
+        const QByteArray value = it.value();
 
         if (uwsgi_response_add_header(wsgi_req,
                                       const_cast<char*>(key.constData()),
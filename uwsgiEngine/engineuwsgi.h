@@ -35,6 +35,9 @@ class Dispatcher;
 class Application;
 }
 
+class BodyUWSGI;
+class QFile;
+
 using namespace Cutelyst;
 class uWSGI : public Engine
 {
@@ -79,6 +82,10 @@ private:
     inline void validateAndExecuteRequest(wsgi_request *wsgi_req, int status);
 
     std::vector<struct wsgi_request *> m_unusedReq;
+    // request body devices reused across requests; the body never
+    // outlives processRequest() so one of each per engine is enough
+    BodyUWSGI *m_bodyUWSGI = nullptr;
+    QFile *m_postFile = nullptr;
     int m_workerId = 0;
 };
 
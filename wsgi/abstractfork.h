@@ -66,6 +66,9 @@ public:
 Q_SIGNALS:
     void forked(int workerId);
     void shutdown();
+    // emitted in the worker when the master passed a SIGHUP on,
+    // asking for the configuration files to be reparsed
+    void reload();
 
 protected:
     void fileChanged(const QString &path);
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "asynclogger.h"
+
+#include <QCoreApplication>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <vector>
+#include <stdio.h>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+using namespace CWSGI;
+
+// Past this many undrained lines the handler drops instead of
+// growing; the drop count is reported when the writer catches up
+#define LOG_QUEUE_MAX 4096
+
+namespace {
+
+struct LogQueue {
+    QMutex mutex;
+    QWaitCondition wake;
+    std::vector<QByteArray> lines;
+    quint64 dropped = 0;
+};
+
+// Leaked on purpose: the handler may fire during static destruction,
+// and a fork abandons the inherited instance for a fresh one
+LogQueue *s_queue = nullptr;
+qint64 s_ownerPid = 0;
+
+class LogWriter : public QThread
+{
+public:
+    LogQueue *queue;
+
+    void run() override
+    {
+        std::vector<QByteArray> batch;
+        Q_FOREVER {
+            quint64 dropped;
+            {
+                QMutexLocker locker(&queue->mutex);
+                while (queue->lines.empty()) {
+                    queue->wake.wait(&queue->mutex);
+                }
+                batch.swap(queue->lines);
+                dropped = queue->dropped;
+                queue->dropped = 0;
+            }
+
+            for (const QByteArray &line : batch) {
+                fwrite(line.constData(), 1, size_t(line.size()), stderr);
+            }
+            if (dropped) {
+                fprintf(stderr, "cutelyst-wsgi: log queue overflow, dropped %llu lines\n",
+                        static_cast<unsigned long long>(dropped));
+            }
+            fflush(stderr);
+            batch.clear();
+        }
+    }
+};
+
+void messageOutput(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    // format in the calling thread, the context pointers do not
+    // outlive this call
+    QByteArray line = qFormatLogMessage(type, context, msg).toLocal8Bit();
+    line.append('\n');
+
+    if (type == QtFatalMsg) {
+        // abort() follows as soon as this handler returns, the line
+        // must reach the console synchronously
+        fwrite(line.constData(), 1, size_t(line.size()), stderr);
+        fflush(stderr);
+        return;
+    }
+
+    LogQueue *queue = s_queue;
+    QMutexLocker locker(&queue->mutex);
+    if (queue->lines.size() >= LOG_QUEUE_MAX) {
+        // never block the event loop on console backpressure
+        ++queue->dropped;
+        return;
+    }
+    queue->lines.push_back(line);
+    queue->wake.wakeOne();
+}
+
+void start()
+{
+    s_ownerPid = QCoreApplication::applicationPid();
+    s_queue = new LogQueue;
+    auto writer = new LogWriter;
+    writer->queue = s_queue;
+    writer->start(QThread::LowestPriority);
+}
+
+}
+
+void AsyncLogger::install()
+{
+    start();
+    qInstallMessageHandler(messageOutput);
+}
+
+void AsyncLogger::postFork()
+{
+    if (!s_queue || s_ownerPid == QCoreApplication::applicationPid()) {
+        // not installed, or no fork actually happened (threaded or
+        // single-process mode), the running writer stays valid
+        return;
+    }
+
+    // The writer thread did not survive into this process and the
+    // inherited mutex may have been held at fork() time; abandon the
+    // old state (leaking its queued lines) and start fresh.
+    start();
+}
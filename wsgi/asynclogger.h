@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef ASYNCLOGGER_H
+#define ASYNCLOGGER_H
+
+namespace CWSGI {
+
+/**
+ * Asynchronous sink for the Qt message handler: callers format the
+ * line and append it to a bounded queue, a dedicated writer thread
+ * drains the queue to stderr. A stalled console or journald can then
+ * no longer block the event loop; when the queue is full lines are
+ * dropped and the drop count is reported once the sink drains.
+ */
+namespace AsyncLogger {
+
+/**
+ * Installs the message handler and starts the writer thread.
+ */
+void install();
+
+/**
+ * Re-arms the sink in a freshly forked worker: threads do not
+ * survive fork(), so the child abandons the inherited state and
+ * starts its own writer.
+ */
+void postFork();
+
+}
+
+}
+
+#endif // ASYNCLOGGER_H
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "bufferalloc.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
+
+using namespace CWSGI;
+
+#define HUGE_PAGE_SIZE quint32(2 * 1024 * 1024)
+
+namespace {
+
+// set once at startup, before the first allocation
+bool s_hugePages = false;
+
+#ifdef Q_OS_LINUX
+inline size_t hugeRound(quint32 size)
+{
+    return (size_t(size) + HUGE_PAGE_SIZE - 1) & ~size_t(HUGE_PAGE_SIZE - 1);
+}
+#endif
+
+}
+
+void BufferAlloc::setHugePages(bool enable)
+{
+    s_hugePages = enable;
+}
+
+char *BufferAlloc::allocate(quint32 size)
+{
+#ifdef Q_OS_LINUX
+    if (s_hugePages && size >= HUGE_PAGE_SIZE) {
+        const size_t length = hugeRound(size);
+
+        // an explicit huge page if the pool has one free
+        void *mem = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            return static_cast<char *>(mem);
+        }
+
+        // no hugetlb reservation, let transparent huge pages back it
+        mem = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            // as out of memory as a throwing new[] would be; bail the
+            // same way so release() can rely on huge sized buffers
+            // always being mappings
+            qFatal("Failed to map %lu bytes for a buffer",
+                   static_cast<unsigned long>(length));
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(mem, length, MADV_HUGEPAGE);
+#endif
+        return static_cast<char *>(mem);
+    }
+#endif
+    return new char[size];
+}
+
+void BufferAlloc::release(char *buffer, quint32 size)
+{
+    if (!buffer) {
+        return;
+    }
+#ifdef Q_OS_LINUX
+    if (s_hugePages && size >= HUGE_PAGE_SIZE) {
+        // huge sized buffers are always mappings, with the same
+        // rounded length allocate() used
+        munmap(buffer, hugeRound(size));
+        return;
+    }
+#endif
+    delete [] buffer;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef BUFFERALLOC_H
+#define BUFFERALLOC_H
+
+#include <QtGlobal>
+
+namespace CWSGI {
+
+/**
+ * Allocator for the server's large flat buffers: socket parse
+ * buffers and the post spool buffer. When huge pages are enabled and
+ * the allocation is at least one huge page (2 MiB), the memory is
+ * mapped with MAP_HUGETLB, falling back to a normal mapping with
+ * MADV_HUGEPAGE and finally to the heap, so memcpy heavy phases stop
+ * churning 4 KiB TLB entries. Smaller allocations always come from
+ * the heap.
+ */
+namespace BufferAlloc {
+
+/**
+ * Enables huge page backing. Must be called before any buffer is
+ * allocated and not changed afterwards, release() relies on the
+ * setting to know how a buffer was obtained.
+ */
+void setHugePages(bool enable);
+
+/**
+ * Returns a buffer of \p size bytes.
+ */
+char *allocate(quint32 size);
+
+/**
+ * Releases a buffer obtained from allocate(); \p size must be the
+ * size it was allocated with.
+ */
+void release(char *buffer, quint32 size);
+
+}
+
+}
+
+#endif // BUFFERALLOC_H
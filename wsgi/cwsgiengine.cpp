@@ -26,40 +26,63 @@
 #include "config.h"
 #include "wsgi.h"
 #include "staticmap.h"
+#include "metricsendpoint.h"
 #include "socket.h"
 
 #include "protocolwebsocket.h"
 #include "protocolhttp.h"
+#include "protocolhttp2.h"
 #include "protocolfastcgi.h"
 
 #ifdef Q_OS_UNIX
 #include "unixfork.h"
 #endif
 
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
 #include <typeinfo>
 
+#ifdef CWSGI_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <Cutelyst/Context>
+#include <Cutelyst/keys_p.h>
 #include <Cutelyst/Response>
 #include <Cutelyst/Request>
 #include <Cutelyst/Application>
 
 #include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
 
 #include <QLoggingCategory>
 
+#include <stdio.h>
+
 Q_LOGGING_CATEGORY(CWSGI_ENGINE, "cwsgi.engine")
 
 using namespace CWSGI;
 using namespace Cutelyst;
 
 QByteArray dateHeader();
+QByteArray sharedDateHeader();
 
 CWsgiEngine::CWsgiEngine(Application *localApp, int workerCore, const QVariantMap &opts, WSGI *wsgi) : Engine(localApp, workerCore, opts)
   , m_wsgi(wsgi)
 {
     defaultHeaders().setServer(QLatin1String("cutelyst/") + QLatin1String(VERSION));
 
-    m_lastDate = dateHeader();
+    m_lastDate = sharedDateHeader();
     m_lastDateTimer.start();
 
     const QStringList staticMap = m_wsgi->staticMap();
@@ -76,10 +99,22 @@ CWsgiEngine::CWsgiEngine(Application *localApp, int workerCore, const QVariantMa
         }
     }
 
-    if (m_wsgi->socketTimeout()) {
+    if (m_wsgi->metrics()) {
+        new MetricsEndpoint(app());
+    }
+
+    if (m_wsgi->socketTimeout() || m_wsgi->websocketHeartbeat()) {
+        // one timer drives both the idle timeout and the websocket
+        // heartbeat, ticking at the shorter of the two windows
+        int interval = m_wsgi->socketTimeout();
+        if (m_wsgi->websocketHeartbeat() && (!interval || m_wsgi->websocketHeartbeat() < interval)) {
+            interval = m_wsgi->websocketHeartbeat();
+        }
         m_socketTimeout = new QTimer(this);
-        m_socketTimeout->setInterval(m_wsgi->socketTimeout() * 1000);
+        m_socketTimeout->setInterval(interval * 1000);
     }
+
+    m_writeCoalesce = m_wsgi->writeCoalesce();
 }
 
 int CWsgiEngine::workerId() const
@@ -138,6 +173,14 @@ void CWsgiEngine::setServers(const std::vector<QObject *> &servers)
     }
 }
 
+Protocol *CWsgiEngine::protocolHttp2()
+{
+    if (!m_protoHttp2) {
+        m_protoHttp2 = new ProtocolHttp2(m_wsgi);
+    }
+    return m_protoHttp2;
+}
+
 void CWsgiEngine::postFork(int workerId)
 {
     m_workerId = workerId;
@@ -152,41 +195,497 @@ void CWsgiEngine::postFork(int workerId)
     UnixFork::setSched(m_wsgi, workerId, workerCore());
 #endif
 
+    if (!m_wsgi->shadow().isEmpty()) {
+        m_shadow = new RequestShadow(m_wsgi->shadow(), m_wsgi->shadowRate(), workerId, workerCore(), this);
+    }
+
     Q_EMIT started();
 }
 
 QByteArray dateHeader()
 {
-    QString ret;
-    ret = QLatin1String("\r\nDate: ") + QLocale::c().toString(QDateTime::currentDateTimeUtc(),
-                                                              QStringLiteral("ddd, dd MMM yyyy hh:mm:ss 'GMT"));
-    return ret.toLatin1();
+    // RFC 7231 IMF-fixdate built by hand, QDateTime::toString() shows
+    // up in profiles at high request rates
+    static const char days[]   = "Sun\0Mon\0Tue\0Wed\0Thu\0Fri\0Sat";
+    static const char months[] = "Jan\0Feb\0Mar\0Apr\0May\0Jun\0Jul\0Aug\0Sep\0Oct\0Nov\0Dec";
+
+    const QDateTime utc = QDateTime::currentDateTimeUtc();
+    const QDate date = utc.date();
+    const QTime time = utc.time();
+
+    char buf[48];
+    const int len = snprintf(buf, sizeof(buf), "\r\nDate: %s, %02d %s %04d %02d:%02d:%02d GMT",
+                             days + 4 * (date.dayOfWeek() % 7),
+                             date.day(),
+                             months + 4 * (date.month() - 1),
+                             date.year(),
+                             time.hour(),
+                             time.minute(),
+                             time.second());
+    return QByteArray(buf, len);
+}
+
+QByteArray sharedDateHeader()
+{
+    // One formatted date per second for the whole process, worker
+    // cores copy it into their local m_lastDate
+    static QMutex mutex;
+    static qint64 lastSecs = 0;
+    static QByteArray lastDate;
+
+    const qint64 secs = QDateTime::currentMSecsSinceEpoch() / 1000;
+
+    QMutexLocker locker(&mutex);
+    if (secs != lastSecs) {
+        lastSecs = secs;
+        lastDate = dateHeader();
+    }
+    return lastDate;
+}
+
+#ifdef CWSGI_HAVE_ZLIB
+static bool contentTypeIsCompressible(const QString &contentType)
+{
+    return contentType.startsWith(QLatin1String("text/")) ||
+            contentType.endsWith(QLatin1String("/json")) ||
+            contentType.endsWith(QLatin1String("+json")) ||
+            contentType.endsWith(QLatin1String("/xml")) ||
+            contentType.endsWith(QLatin1String("+xml")) ||
+            contentType.endsWith(QLatin1String("javascript"));
+}
+
+static QByteArray gzipCompress(const QByteArray &data)
+{
+    QByteArray ret;
+
+    z_stream strm = z_stream();
+    // 16 + 15 selects a gzip wrapper around deflate
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return ret;
+    }
+
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    strm.avail_in = static_cast<uInt>(data.size());
+
+    char buf[16 * 1024];
+    int zRet;
+    do {
+        strm.next_out = reinterpret_cast<Bytef *>(buf);
+        strm.avail_out = sizeof(buf);
+        zRet = deflate(&strm, Z_FINISH);
+        if (zRet != Z_OK && zRet != Z_STREAM_END) {
+            deflateEnd(&strm);
+            return QByteArray();
+        }
+        ret.append(buf, sizeof(buf) - strm.avail_out);
+    } while (zRet != Z_STREAM_END);
+    deflateEnd(&strm);
+
+    return ret;
+}
+
+void CWsgiEngine::compressResponseBody(Context *c, quint16 status)
+{
+    if (!m_wsgi->httpCompression() ||
+            status < Response::OK ||
+            status == Response::NoContent ||
+            status == Response::NotModified) {
+        return;
+    }
+
+    Response *response = c->response();
+    if (response->bodyDevice()) {
+        // File bodies go out with sendfile(), static assets get the
+        // precompressed sidecar lookup in StaticMap instead
+        return;
+    }
+
+    Headers &headers = response->headers();
+    QByteArray &body = response->body();
+    // Compressing tiny or already compressed bodies only burns CPU
+    if (body.size() < 1024 ||
+            !headers.contentEncoding().isEmpty() ||
+            !contentTypeIsCompressible(headers.contentType())) {
+        return;
+    }
+
+    const QString acceptEncoding = c->request()->headers().header(QStringLiteral("ACCEPT_ENCODING"));
+    if (!acceptEncoding.contains(QLatin1String("gzip"), Qt::CaseInsensitive)) {
+        return;
+    }
+
+    const QByteArray compressed = gzipCompress(body);
+    if (compressed.isEmpty() || compressed.size() >= body.size()) {
+        return;
+    }
+
+    body = compressed;
+    headers.setContentEncoding(QStringLiteral("gzip"));
+    headers.setContentLength(compressed.size());
+    headers.pushHeader(Keys::VARY, QStringLiteral("Accept-Encoding"));
+}
+#endif
+
+bool CWsgiEngine::supportsChunkedResponse(Context *c, void *engineData)
+{
+    // Only a raw HTTP/1.1 connection takes our chunked framing,
+    // FastCGI has its own records and the front server does the
+    // client facing encoding
+    auto sock = static_cast<TcpSocket *>(engineData);
+    return sock && sock->proto->type() == Protocol::Http11 &&
+            c->request()->protocol() == QLatin1String("HTTP/1.1");
 }
 
 bool CWsgiEngine::finalizeHeadersWrite(Context *c, quint16 status, const Headers &headers, void *engineData)
 {
     auto sock = static_cast<TcpSocket*>(engineData);
     if (sock) {
+#ifdef CWSGI_HAVE_ZLIB
+        // headers is a reference into the response, changes made here
+        // are visible to sendHeaders() below
+        compressResponseBody(c, status);
+#endif
+
         if (m_lastDateTimer.hasExpired(1000)) {
-            m_lastDate = dateHeader();
+            m_lastDate = sharedDateHeader();
             m_lastDateTimer.restart();
         }
 
+        // Hold the header block back so it leaves in one segment with
+        // the first body bytes, finalizeBody() uncorks. Chunked
+        // responses stream at the pace of the application and must
+        // not sit on the cork timer.
+        if (headers.rawHeader(QByteArrayLiteral("TRANSFER_ENCODING")) != "chunked") {
+            sock->cork();
+        }
+
         return sock->proto->sendHeaders(sock, sock, status, m_lastDate, headers);
     }
     return false;
 }
 
+void CWsgiEngine::finalizeBody(Context *c)
+{
+    auto sock = static_cast<TcpSocket *>(c->engineData());
+#ifdef Q_OS_LINUX
+    Response *response = c->response();
+
+    // When the body is a plain file on disk, as done by StaticMap and
+    // StaticSimple, hand the descriptor straight to the kernel instead
+    // of read()ing it into userspace chunk by chunk. TLS, local sockets
+    // and record based protocols keep using the generic copy loop.
+    //
+    // sendfile() over TLS would need kTLS: the kernel can encrypt if
+    // the negotiated traffic keys are pushed into the socket after the
+    // handshake, but QSslSocket neither exports the key material nor
+    // lets OpenSSL take over the fd, so encrypted bodies have to cross
+    // userspace until the Qt backend grows that hook.
+    auto file = qobject_cast<QFile *>(response->bodyDevice());
+    if (file && file->handle() >= 0 &&
+            response->headers().rawHeader(QByteArrayLiteral("TRANSFER_ENCODING")) != "chunked") {
+        auto ssl = qobject_cast<QSslSocket *>(sock);
+        auto tcp = qobject_cast<QTcpSocket *>(sock);
+        if (tcp && (!ssl || ssl->mode() == QSslSocket::UnencryptedMode) &&
+                sock->proto->type() == Protocol::Http11) {
+            // Make sure the headers Qt has buffered hit the wire before
+            // the kernel starts copying the file.
+            while (tcp->bytesToWrite() > 0) {
+                if (!tcp->flush() && !tcp->waitForBytesWritten(-1)) {
+                    qCWarning(CWSGI_ENGINE) << "Failed to flush headers before sendfile" << tcp->errorString();
+                    sock->uncork();
+                    return;
+                }
+            }
+
+            const int sockFd = static_cast<int>(tcp->socketDescriptor());
+            const int fileFd = file->handle();
+
+            // A QFile wrapped around a pipe (a helper process' stdout,
+            // PDF renderers and the like) cannot go through sendfile(),
+            // but splice() moves its pages into the socket without a
+            // userspace copy. The body ends when the producer closes
+            // its end of the pipe.
+            struct stat st;
+            if (::fstat(fileFd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+                Q_FOREVER {
+                    const ssize_t moved = ::splice(fileFd, nullptr, sockFd, nullptr,
+                                                   64 * 1024, SPLICE_F_MOVE | SPLICE_F_MORE);
+                    if (moved == 0) {
+                        // producer closed its end, body complete
+                        sock->uncork();
+                        return;
+                    }
+
+                    if (moved < 0) {
+                        if (errno == EAGAIN || errno == EINTR) {
+                            // EAGAIN does not say which end blocked:
+                            // an instant poll on the pipe tells the
+                            // sides apart, then sleep on the one that
+                            // is actually in the way
+                            struct pollfd pfd;
+                            pfd.fd = fileFd;
+                            pfd.events = POLLIN;
+                            pfd.revents = 0;
+                            if (::poll(&pfd, 1, 0) == 0) {
+                                // pipe empty, wait for the producer
+                                ::poll(&pfd, 1, -1);
+                            } else {
+                                // data is there, the socket buffer is
+                                // full: the client sets the pace
+                                pfd.fd = sockFd;
+                                pfd.events = POLLOUT;
+                                pfd.revents = 0;
+                                ::poll(&pfd, 1, -1);
+                            }
+                            continue;
+                        }
+
+                        qCWarning(CWSGI_ENGINE, "Failed to write body with splice: %s", strerror(errno));
+                        sock->uncork();
+                        return;
+                    }
+                }
+            }
+
+            off_t offset = static_cast<off_t>(file->pos());
+            qint64 remaining = file->size() - offset;
+            if (response->status() == Response::PartialContent) {
+                // a range response maps to an offset sendfile over the
+                // window the Content-Range header promised
+                const QString contentRange = response->headers().header(Keys::CONTENT_RANGE);
+                if (contentRange.startsWith(QLatin1String("bytes "))) {
+                    const int dash = contentRange.indexOf(QLatin1Char('-'), 6);
+                    const int slash = contentRange.indexOf(QLatin1Char('/'), dash);
+                    if (dash != -1 && slash != -1) {
+                        offset = static_cast<off_t>(contentRange.mid(6, dash - 6).toLongLong());
+                        const qint64 rangeEnd = contentRange.mid(dash + 1, slash - dash - 1).toLongLong();
+                        remaining = rangeEnd - offset + 1;
+                    }
+                }
+            }
+            bool sent = false;
+            while (remaining > 0) {
+                const ssize_t written = ::sendfile(sockFd, fileFd, &offset, static_cast<size_t>(remaining));
+                if (written > 0) {
+                    sent = true;
+                    remaining -= written;
+                } else if (written == 0) {
+                    qCWarning(CWSGI_ENGINE) << "File body truncated while in sendfile" << file->fileName();
+                    sock->uncork();
+                    return;
+                } else if (errno == EAGAIN || errno == EINTR) {
+                    struct pollfd pfd;
+                    pfd.fd = sockFd;
+                    pfd.events = POLLOUT;
+                    pfd.revents = 0;
+                    if (::poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+                        qCWarning(CWSGI_ENGINE, "Failed to write body with sendfile: %s", strerror(errno));
+                        sock->uncork();
+                        return;
+                    }
+                } else if (!sent) {
+                    // sendfile is not possible on this pair of
+                    // descriptors, take the generic copy loop
+                    break;
+                } else {
+                    qCWarning(CWSGI_ENGINE, "Failed to write body with sendfile: %s", strerror(errno));
+                    sock->uncork();
+                    return;
+                }
+            }
+
+            if (remaining == 0) {
+                sock->uncork();
+                return;
+            }
+        }
+    }
+#endif
+
+    Engine::finalizeBody(c);
+    sock->uncork();
+}
+
+// Qt buffers writes internally without bound, so a client reading at
+// modem speed could make a 200 MB response live entirely in RAM. Past
+// the high-water mark the producer is blocked until the buffer drains
+// back to the low-water mark; the kernel socket buffer keeps the wire
+// busy meanwhile.
+#define WRITE_HIGH_WATER_MARK (1024 * 1024)
+#define WRITE_LOW_WATER_MARK (256 * 1024)
+
 qint64 CWsgiEngine::doWrite(Context *c, const char *data, qint64 len, void *engineData)
 {
     auto sock = static_cast<TcpSocket*>(engineData);
     auto io = static_cast<QIODevice*>(engineData);
     //    qDebug() << Q_FUNC_INFO << QByteArray(data,len);
+    if (!sock->coalesceBuffer.isEmpty()) {
+        // frames parked by --write-coalesce must hit the wire before
+        // this write to keep the stream ordered
+        flushSocketCoalesceBuffer(sock);
+    }
     qint64 ret = sock->proto->sendBody(io, sock, data, len);
-    //    conn->waitForBytesWritten(200);
+    if (ret > 0 && io->bytesToWrite() > WRITE_HIGH_WATER_MARK) {
+        while (io->bytesToWrite() > WRITE_LOW_WATER_MARK) {
+            if (!io->waitForBytesWritten(-1)) {
+                return -1;
+            }
+        }
+    }
     return ret;
 }
 
+qint64 CWsgiEngine::doWriteV(Context *c, const QByteArray *chunks, int count, void *engineData)
+{
+#ifdef Q_OS_LINUX
+    auto sock = static_cast<TcpSocket *>(engineData);
+    auto ssl = qobject_cast<QSslSocket *>(sock);
+    auto tcp = qobject_cast<QTcpSocket *>(sock);
+    // FastCGI wraps each write in a record and TLS has to encrypt,
+    // only a plain socket can take the buffers as they are.
+    if (tcp && (!ssl || ssl->mode() == QSslSocket::UnencryptedMode) &&
+            sock->proto->type() == Protocol::Http11 &&
+            count > 0 && count <= 16) {
+        // With --write-coalesce websocket frames are parked on the
+        // socket and flushed once per event loop pass, so a broadcast
+        // storm costs one syscall per socket instead of one per frame.
+        if (m_writeCoalesce && sock->websocketContext) {
+            qint64 total = 0;
+            for (int i = 0; i < count; ++i) {
+                sock->coalesceBuffer.append(chunks[i]);
+                total += chunks[i].size();
+            }
+
+            if (!sock->coalesceQueued) {
+                sock->coalesceQueued = true;
+                m_coalesceQueue.push_back(sock);
+            }
+
+            if (!m_coalesceScheduled) {
+                m_coalesceScheduled = true;
+                QTimer::singleShot(0, this, [this]() {
+                    flushCoalescedWrites();
+                });
+            }
+            return total;
+        }
+
+        while (tcp->bytesToWrite() > 0) {
+            if (!tcp->flush() && !tcp->waitForBytesWritten(-1)) {
+                qCWarning(CWSGI_ENGINE) << "Failed to flush before writev" << tcp->errorString();
+                return -1;
+            }
+        }
+
+        struct iovec vec[16];
+        qint64 total = 0;
+        for (int i = 0; i < count; ++i) {
+            vec[i].iov_base = const_cast<char *>(chunks[i].constData());
+            vec[i].iov_len = static_cast<size_t>(chunks[i].size());
+            total += chunks[i].size();
+        }
+
+        const int sockFd = static_cast<int>(tcp->socketDescriptor());
+        struct iovec *head = vec;
+        int remainingChunks = count;
+        qint64 written = 0;
+        while (written < total) {
+            const ssize_t wrote = ::writev(sockFd, head, remainingChunks);
+            if (wrote >= 0) {
+                written += wrote;
+                // advance past the buffers that went out completely
+                size_t advanced = static_cast<size_t>(wrote);
+                while (remainingChunks && advanced >= head->iov_len) {
+                    advanced -= head->iov_len;
+                    ++head;
+                    --remainingChunks;
+                }
+                if (remainingChunks) {
+                    head->iov_base = static_cast<char *>(head->iov_base) + advanced;
+                    head->iov_len -= advanced;
+                }
+            } else if (errno == EAGAIN || errno == EINTR) {
+                struct pollfd pfd;
+                pfd.fd = sockFd;
+                pfd.events = POLLOUT;
+                pfd.revents = 0;
+                if (::poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+                    qCWarning(CWSGI_ENGINE, "Failed to writev: %s", strerror(errno));
+                    return -1;
+                }
+            } else {
+                qCWarning(CWSGI_ENGINE, "Failed to writev: %s", strerror(errno));
+                return -1;
+            }
+        }
+        return total;
+    }
+#endif
+
+    return Engine::doWriteV(c, chunks, count, engineData);
+}
+
+void CWsgiEngine::flushCoalescedWrites()
+{
+    m_coalesceScheduled = false;
+    // writes issued from here on start a new batch
+    QVector<TcpSocket *> batch;
+    batch.swap(m_coalesceQueue);
+    for (TcpSocket *sock : batch) {
+        sock->coalesceQueued = false;
+        flushSocketCoalesceBuffer(sock);
+    }
+}
+
+void CWsgiEngine::flushSocketCoalesceBuffer(TcpSocket *sock)
+{
+#ifdef Q_OS_LINUX
+    if (sock->coalesceBuffer.isEmpty()) {
+        return;
+    }
+
+    QByteArray buffer;
+    buffer.swap(sock->coalesceBuffer);
+
+    if (sock->state() != QAbstractSocket::ConnectedState) {
+        // the client went away while its frames were parked
+        return;
+    }
+
+    while (sock->bytesToWrite() > 0) {
+        if (!sock->flush() && !sock->waitForBytesWritten(-1)) {
+            qCWarning(CWSGI_ENGINE) << "Failed to flush before coalesced write" << sock->errorString();
+            return;
+        }
+    }
+
+    const int sockFd = static_cast<int>(sock->socketDescriptor());
+    const char *data = buffer.constData();
+    qint64 remaining = buffer.size();
+    while (remaining > 0) {
+        const ssize_t wrote = ::write(sockFd, data, static_cast<size_t>(remaining));
+        if (wrote >= 0) {
+            data += wrote;
+            remaining -= wrote;
+        } else if (errno == EAGAIN || errno == EINTR) {
+            struct pollfd pfd;
+            pfd.fd = sockFd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            if (::poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+                qCWarning(CWSGI_ENGINE, "Failed to write coalesced frames: %s", strerror(errno));
+                return;
+            }
+        } else {
+            qCWarning(CWSGI_ENGINE, "Failed to write coalesced frames: %s", strerror(errno));
+            return;
+        }
+    }
+#else
+    Q_UNUSED(sock)
+#endif
+}
+
 bool CWsgiEngine::webSocketHandshakeDo(Context *c, const QString &key, const QString &origin, const QString &protocol, void *engineData)
 {
     auto sock = static_cast<TcpSocket*>(engineData);
@@ -205,7 +704,7 @@ bool CWsgiEngine::webSocketHandshakeDo(Context *c, const QString &key, const QSt
 
     response->setStatus(Response::SwitchingProtocols);
     headers.setHeader(QStringLiteral("UPGRADE"), QStringLiteral("WebSocket"));
-    headers.setHeader(QStringLiteral("CONNECTION"), QStringLiteral("Upgrade"));
+    headers.setHeader(Keys::CONNECTION, QStringLiteral("Upgrade"));
     const QString localOrigin = origin.isEmpty() ? requestHeaders.header(QStringLiteral("ORIGIN")) : origin;
     if (localOrigin.isEmpty()) {
         headers.setHeader(QStringLiteral("SEC_WEBSOCKET_ORIGIN"), QStringLiteral("*"));
@@ -219,19 +718,72 @@ bool CWsgiEngine::webSocketHandshakeDo(Context *c, const QString &key, const QSt
     }
 
     const QString localKey = key.isEmpty() ? requestHeaders.header(QStringLiteral("SEC_WEBSOCKET_KEY")) : key;
-    const QString wsKey = localKey + QLatin1String("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-    if (wsKey.length() == 36) {
+    if (localKey.isEmpty()) {
         qCWarning(CWSGI_ENGINE) << "Missing websocket key";
         return false;
     }
 
-    const QByteArray wsAccept = QCryptographicHash::hash(wsKey.toLatin1(), QCryptographicHash::Sha1).toBase64();
+    // feed the key and the RFC 6455 GUID separately instead of
+    // concatenating them into a temporary string first
+    QCryptographicHash wsHash(QCryptographicHash::Sha1);
+    wsHash.addData(localKey.toLatin1());
+    wsHash.addData("258EAFA5-E914-47DA-95CA-C5AB0DC85B11", 36);
+    const QByteArray wsAccept = wsHash.result().toBase64();
     headers.setHeader(QStringLiteral("SEC_WEBSOCKET_ACCEPT"), QString::fromLatin1(wsAccept));
 
+#ifdef CWSGI_HAVE_ZLIB
+    const QString extensions = requestHeaders.header(QStringLiteral("SEC_WEBSOCKET_EXTENSIONS"));
+    if (!extensions.isEmpty()) {
+        const QStringList offers = extensions.split(QLatin1Char(','));
+        for (const QString &offer : offers) {
+            const QStringList params = offer.split(QLatin1Char(';'));
+            if (params.first().trimmed().compare(QLatin1String("permessage-deflate"), Qt::CaseInsensitive) != 0) {
+                continue;
+            }
+
+            // Only the RFC 7692 defaults are supported, 15 bits windows
+            // with context takeover on both sides; an offer asking for
+            // anything else keeps the connection uncompressed
+            bool supported = true;
+            for (int i = 1; i < params.size(); ++i) {
+                if (!params.at(i).trimmed().startsWith(QLatin1String("client_max_window_bits"))) {
+                    supported = false;
+                    break;
+                }
+            }
+            if (!supported) {
+                continue;
+            }
+
+            auto inflateStrm = new z_stream();
+            if (inflateInit2(inflateStrm, -15) != Z_OK) {
+                delete inflateStrm;
+                break;
+            }
+            auto deflateStrm = new z_stream();
+            if (deflateInit2(deflateStrm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                inflateEnd(inflateStrm);
+                delete inflateStrm;
+                delete deflateStrm;
+                break;
+            }
+
+            sock->websocket_inflate = inflateStrm;
+            sock->websocket_deflate = deflateStrm;
+            sock->websocket_deflate_enabled = true;
+            headers.setHeader(QStringLiteral("SEC_WEBSOCKET_EXTENSIONS"), QStringLiteral("permessage-deflate"));
+            break;
+        }
+    }
+#endif
+
     sock->headerConnection = Socket::HeaderConnectionUpgrade;
     sock->websocketContext = c;
 
-    return finalizeHeadersWrite(c, Response::SwitchingProtocols, headers, engineData);
+    const bool ret = finalizeHeadersWrite(c, Response::SwitchingProtocols, headers, engineData);
+    // no body follows an upgrade, the frames must not sit on the cork
+    sock->uncork();
+    return ret;
 }
 
 bool CWsgiEngine::webSocketSendTextMessage(Context *c, const QString &message)
@@ -242,9 +794,30 @@ bool CWsgiEngine::webSocketSendTextMessage(Context *c, const QString &message)
     }
 
     const QByteArray rawMessage = message.toUtf8();
-    const QByteArray headers = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodeText, rawMessage.size());
-    doWrite(c, headers.data(), headers.size(), sock);
-    return doWrite(c, rawMessage.data(), rawMessage.size(), sock) == rawMessage.size();
+
+#ifdef CWSGI_HAVE_ZLIB
+    if (sock->websocket_deflate_enabled && rawMessage.size() >= 128) {
+        const QByteArray deflated = ProtocolWebSocket::websocketDeflatePayload(sock, rawMessage);
+        if (!deflated.isEmpty()) {
+            char header[ProtocolWebSocket::WebSocketMaxHeaderSize];
+            // RSV1 set marks the message as compressed
+            const quint32 headerLen = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodeText | 0x40, deflated.size(), header);
+            const QByteArray chunks[2] = {
+                QByteArray::fromRawData(header, headerLen),
+                deflated
+            };
+            return doWriteV(c, chunks, 2, sock) == headerLen + deflated.size();
+        }
+    }
+#endif
+
+    char header[ProtocolWebSocket::WebSocketMaxHeaderSize];
+    const quint32 headerLen = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodeText, rawMessage.size(), header);
+    const QByteArray chunks[2] = {
+        QByteArray::fromRawData(header, headerLen),
+        rawMessage
+    };
+    return doWriteV(c, chunks, 2, sock) == headerLen + rawMessage.size();
 }
 
 bool CWsgiEngine::webSocketSendBinaryMessage(Context *c, const QByteArray &message)
@@ -254,9 +827,72 @@ bool CWsgiEngine::webSocketSendBinaryMessage(Context *c, const QByteArray &messa
         return false;
     }
 
-    const QByteArray headers = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodeBinary, message.size());
-    doWrite(c, headers.data(), headers.size(), sock);
-    return doWrite(c, message.data(), message.size(), sock) == message.size();
+#ifdef CWSGI_HAVE_ZLIB
+    if (sock->websocket_deflate_enabled && message.size() >= 128) {
+        const QByteArray deflated = ProtocolWebSocket::websocketDeflatePayload(sock, message);
+        if (!deflated.isEmpty()) {
+            char header[ProtocolWebSocket::WebSocketMaxHeaderSize];
+            const quint32 headerLen = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodeBinary | 0x40, deflated.size(), header);
+            const QByteArray chunks[2] = {
+                QByteArray::fromRawData(header, headerLen),
+                deflated
+            };
+            return doWriteV(c, chunks, 2, sock) == headerLen + deflated.size();
+        }
+    }
+#endif
+
+    char header[ProtocolWebSocket::WebSocketMaxHeaderSize];
+    const quint32 headerLen = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodeBinary, message.size(), header);
+    const QByteArray chunks[2] = {
+        QByteArray::fromRawData(header, headerLen),
+        message
+    };
+    return doWriteV(c, chunks, 2, sock) == headerLen + message.size();
+}
+
+bool CWsgiEngine::webSocketBroadcastTextMessage(const QVector<Cutelyst::Context *> &contexts, const QString &message)
+{
+    const QByteArray rawMessage = message.toUtf8();
+    char header[ProtocolWebSocket::WebSocketMaxHeaderSize];
+    const quint32 headerLen = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodeText, rawMessage.size(), header);
+    const QByteArray chunks[2] = {
+        QByteArray::fromRawData(header, headerLen),
+        rawMessage
+    };
+
+    // The frame is encoded a single time and shared by all sockets
+    bool ret = true;
+    for (Cutelyst::Context *c : contexts) {
+        auto sock = static_cast<TcpSocket*>(c->engineData());
+        if (sock->headerConnection != Socket::HeaderConnectionUpgrade) {
+            ret = false;
+            continue;
+        }
+        ret = (doWriteV(c, chunks, 2, sock) == headerLen + rawMessage.size()) && ret;
+    }
+    return ret;
+}
+
+bool CWsgiEngine::webSocketBroadcastBinaryMessage(const QVector<Cutelyst::Context *> &contexts, const QByteArray &message)
+{
+    char header[ProtocolWebSocket::WebSocketMaxHeaderSize];
+    const quint32 headerLen = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodeBinary, message.size(), header);
+    const QByteArray chunks[2] = {
+        QByteArray::fromRawData(header, headerLen),
+        message
+    };
+
+    bool ret = true;
+    for (Cutelyst::Context *c : contexts) {
+        auto sock = static_cast<TcpSocket*>(c->engineData());
+        if (sock->headerConnection != Socket::HeaderConnectionUpgrade) {
+            ret = false;
+            continue;
+        }
+        ret = (doWriteV(c, chunks, 2, sock) == headerLen + message.size()) && ret;
+    }
+    return ret;
 }
 
 bool CWsgiEngine::webSocketSendPing(Context *c, const QByteArray &payload)
@@ -267,9 +903,13 @@ bool CWsgiEngine::webSocketSendPing(Context *c, const QByteArray &payload)
     }
 
     const QByteArray rawMessage = payload.left(125);
-    const QByteArray headers = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodePing, rawMessage.size());
-    doWrite(c, headers.data(), headers.size(), sock);
-    return doWrite(c, rawMessage.data(), rawMessage.size(), sock) == rawMessage.size();
+    char header[ProtocolWebSocket::WebSocketMaxHeaderSize];
+    const quint32 headerLen = ProtocolWebSocket::createWebsocketHeader(Socket::OpCodePing, rawMessage.size(), header);
+    const QByteArray chunks[2] = {
+        QByteArray::fromRawData(header, headerLen),
+        rawMessage
+    };
+    return doWriteV(c, chunks, 2, sock) == headerLen + rawMessage.size();
 }
 
 bool CWsgiEngine::webSocketClose(Context *c, quint16 code, const QString &reason)
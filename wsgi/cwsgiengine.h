@@ -23,15 +23,22 @@
 #include <QElapsedTimer>
 #include <QTimer>
 
+#include <utility>
+
 #include <Cutelyst/Engine>
 
+#include "requestshadow.h"
+
 class QTcpServer;
 
 namespace CWSGI {
 
 class TcpServer;
+class TcpSocket;
+class Protocol;
 class ProtocolFastCGI;
 class ProtocolHttp;
+class ProtocolHttp2;
 class WSGI;
 class CWsgiEngine : public Cutelyst::Engine
 {
@@ -42,11 +49,21 @@ public:
     virtual int workerId() const override;
 
     inline Cutelyst::Context *processSocket(Cutelyst::EngineRequest *sock) {
-        return processRequest2(*sock);
+        if (m_shadow) {
+            m_shadow->maybeRecord(*sock);
+        }
+        // every protocol refills the request-scoped fields before the
+        // next request on this socket, so their payload can be moved
+        // into the Request instead of shared and detached later
+        return processRequest2(std::move(*sock));
     }
 
     void setServers(const std::vector<QObject *> &servers);
 
+    // the shared HTTP/2 protocol of this worker core, created on the
+    // first connection that negotiates h2
+    Protocol *protocolHttp2();
+
     void postFork(int workerId);
 
     int m_workerId = 0;
@@ -59,16 +76,26 @@ Q_SIGNALS:
     void shutdownCompleted(CWsgiEngine *engine);
 
 protected:
+    virtual bool supportsChunkedResponse(Cutelyst::Context *c, void *engineData) override;
+
     virtual bool finalizeHeadersWrite(Cutelyst::Context *c, quint16 status,  const Cutelyst::Headers &headers, void *engineData) override;
 
+    virtual void finalizeBody(Cutelyst::Context *c) override;
+
     virtual qint64 doWrite(Cutelyst::Context *c, const char *data, qint64 len, void *engineData) override;
 
+    virtual qint64 doWriteV(Cutelyst::Context *c, const QByteArray *chunks, int count, void *engineData) override;
+
     virtual bool webSocketHandshakeDo(Cutelyst::Context *c, const QString &key, const QString &origin, const QString &protocol, void *engineData) override;
 
     virtual bool webSocketSendTextMessage(Cutelyst::Context *c, const QString &message) override;
 
     virtual bool webSocketSendBinaryMessage(Cutelyst::Context *c, const QByteArray &message) override;
 
+    virtual bool webSocketBroadcastTextMessage(const QVector<Cutelyst::Context *> &contexts, const QString &message) override;
+
+    virtual bool webSocketBroadcastBinaryMessage(const QVector<Cutelyst::Context *> &contexts, const QByteArray &message) override;
+
     virtual bool webSocketSendPing(Cutelyst::Context *c, const QByteArray &payload) override;
 
     virtual bool webSocketClose(Cutelyst::Context *c, quint16 code, const QString &reason) override;
@@ -92,6 +119,15 @@ protected:
     }
 
 private:
+#ifdef CWSGI_HAVE_ZLIB
+    void compressResponseBody(Cutelyst::Context *c, quint16 status);
+#endif
+
+    // drains the sockets queued by the --write-coalesce batching,
+    // one syscall per socket for everything written this pass
+    void flushCoalescedWrites();
+    void flushSocketCoalesceBuffer(TcpSocket *sock);
+
     friend class ProtocolHttp;
     friend class ProtocolFastCGI;
     friend class LocalServer;
@@ -101,11 +137,16 @@ private:
     QByteArray m_lastDate;
     QElapsedTimer m_lastDateTimer;
     QTimer *m_socketTimeout = nullptr;
+    RequestShadow *m_shadow = nullptr;
     WSGI *m_wsgi;
     ProtocolHttp *m_protoHttp = nullptr;
+    ProtocolHttp2 *m_protoHttp2 = nullptr;
     ProtocolFastCGI *m_protoFcgi = nullptr;
+    QVector<TcpSocket *> m_coalesceQueue;
     int m_runningServers = 0;
     int m_serversTimeout = 0;
+    bool m_writeCoalesce = false;
+    bool m_coalesceScheduled = false;
 };
 
 }
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "hpack.h"
+
+using namespace CWSGI;
+
+// RFC 7541 Appendix B Huffman codes, indexed by symbol; entry 256 is
+// the EOS symbol, which must never appear in decoded data
+static const quint32 huffmanCodes[257] = {
+    0x1ff8u, 0x7fffd8u, 0xfffffe2u, 0xfffffe3u, 0xfffffe4u, 0xfffffe5u,
+    0xfffffe6u, 0xfffffe7u, 0xfffffe8u, 0xffffeau, 0x3ffffffcu, 0xfffffe9u,
+    0xfffffeau, 0x3ffffffdu, 0xfffffebu, 0xfffffecu, 0xfffffedu, 0xfffffeeu,
+    0xfffffefu, 0xffffff0u, 0xffffff1u, 0xffffff2u, 0x3ffffffeu, 0xffffff3u,
+    0xffffff4u, 0xffffff5u, 0xffffff6u, 0xffffff7u, 0xffffff8u, 0xffffff9u,
+    0xffffffau, 0xffffffbu, 0x14u, 0x3f8u, 0x3f9u, 0xffau,
+    0x1ff9u, 0x15u, 0xf8u, 0x7fau, 0x3fau, 0x3fbu,
+    0xf9u, 0x7fbu, 0xfau, 0x16u, 0x17u, 0x18u,
+    0x0u, 0x1u, 0x2u, 0x19u, 0x1au, 0x1bu,
+    0x1cu, 0x1du, 0x1eu, 0x1fu, 0x5cu, 0xfbu,
+    0x7ffcu, 0x20u, 0xffbu, 0x3fcu, 0x1ffau, 0x21u,
+    0x5du, 0x5eu, 0x5fu, 0x60u, 0x61u, 0x62u,
+    0x63u, 0x64u, 0x65u, 0x66u, 0x67u, 0x68u,
+    0x69u, 0x6au, 0x6bu, 0x6cu, 0x6du, 0x6eu,
+    0x6fu, 0x70u, 0x71u, 0x72u, 0xfcu, 0x73u,
+    0xfdu, 0x1ffbu, 0x7fff0u, 0x1ffcu, 0x3ffcu, 0x22u,
+    0x7ffdu, 0x3u, 0x23u, 0x4u, 0x24u, 0x5u,
+    0x25u, 0x26u, 0x27u, 0x6u, 0x74u, 0x75u,
+    0x28u, 0x29u, 0x2au, 0x7u, 0x2bu, 0x76u,
+    0x2cu, 0x8u, 0x9u, 0x2du, 0x77u, 0x78u,
+    0x79u, 0x7au, 0x7bu, 0x7ffeu, 0x7fcu, 0x3ffdu,
+    0x1ffdu, 0xffffffcu, 0xfffe6u, 0x3fffd2u, 0xfffe7u, 0xfffe8u,
+    0x3fffd3u, 0x3fffd4u, 0x3fffd5u, 0x7fffd9u, 0x3fffd6u, 0x7fffdau,
+    0x7fffdbu, 0x7fffdcu, 0x7fffddu, 0x7fffdeu, 0xffffebu, 0x7fffdfu,
+    0xffffecu, 0xffffedu, 0x3fffd7u, 0x7fffe0u, 0xffffeeu, 0x7fffe1u,
+    0x7fffe2u, 0x7fffe3u, 0x7fffe4u, 0x1fffdcu, 0x3fffd8u, 0x7fffe5u,
+    0x3fffd9u, 0x7fffe6u, 0x7fffe7u, 0xffffefu, 0x3fffdau, 0x1fffddu,
+    0xfffe9u, 0x3fffdbu, 0x3fffdcu, 0x7fffe8u, 0x7fffe9u, 0x1fffdeu,
+    0x7fffeau, 0x3fffddu, 0x3fffdeu, 0xfffff0u, 0x1fffdfu, 0x3fffdfu,
+    0x7fffebu, 0x7fffecu, 0x1fffe0u, 0x1fffe1u, 0x3fffe0u, 0x1fffe2u,
+    0x7fffedu, 0x3fffe1u, 0x7fffeeu, 0x7fffefu, 0xfffeau, 0x3fffe2u,
+    0x3fffe3u, 0x3fffe4u, 0x7ffff0u, 0x3fffe5u, 0x3fffe6u, 0x7ffff1u,
+    0x3ffffe0u, 0x3ffffe1u, 0xfffebu, 0x7fff1u, 0x3fffe7u, 0x7ffff2u,
+    0x3fffe8u, 0x1ffffecu, 0x3ffffe2u, 0x3ffffe3u, 0x3ffffe4u, 0x7ffffdeu,
+    0x7ffffdfu, 0x3ffffe5u, 0xfffff1u, 0x1ffffedu, 0x7fff2u, 0x1fffe3u,
+    0x3ffffe6u, 0x7ffffe0u, 0x7ffffe1u, 0x3ffffe7u, 0x7ffffe2u, 0xfffff2u,
+    0x1fffe4u, 0x1fffe5u, 0x3ffffe8u, 0x3ffffe9u, 0xffffffdu, 0x7ffffe3u,
+    0x7ffffe4u, 0x7ffffe5u, 0xfffecu, 0xfffff3u, 0xfffedu, 0x1fffe6u,
+    0x3fffe9u, 0x1fffe7u, 0x1fffe8u, 0x7ffff3u, 0x3fffeau, 0x3fffebu,
+    0x1ffffeeu, 0x1ffffefu, 0xfffff4u, 0xfffff5u, 0x3ffffeau, 0x7ffff4u,
+    0x3ffffebu, 0x7ffffe6u, 0x3ffffecu, 0x3ffffedu, 0x7ffffe7u, 0x7ffffe8u,
+    0x7ffffe9u, 0x7ffffeau, 0x7ffffebu, 0xffffffeu, 0x7ffffecu, 0x7ffffedu,
+    0x7ffffeeu, 0x7ffffefu, 0x7fffff0u, 0x3ffffeeu, 0x3fffffffu
+};
+
+static const quint8 huffmanCodeLengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+     6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+     5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+    13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+     7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+    15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+     6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30
+};
+
+// RFC 7541 Appendix A, indices 1 to 61 on the wire
+static const struct { const char *name; const char *value; } staticTable[61] = {
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" },
+};
+
+/**
+ * Binary decode tree over the Huffman codes, built once on first
+ * use; 257 leaves make at most 513 nodes. A leaf stores the symbol,
+ * inner nodes the child indices.
+ */
+struct HuffmanNode {
+    qint16 child[2] = { -1, -1 };
+    qint16 symbol = -1;
+};
+
+static std::vector<HuffmanNode> buildHuffmanTree()
+{
+    std::vector<HuffmanNode> tree;
+    tree.reserve(513);
+    tree.emplace_back();
+    for (int symbol = 0; symbol < 257; ++symbol) {
+        const quint32 huffCode = huffmanCodes[symbol];
+        const quint8 length = huffmanCodeLengths[symbol];
+        qint16 node = 0;
+        for (int bit = length - 1; bit >= 0; --bit) {
+            const int branch = (huffCode >> bit) & 1;
+            if (tree[node].child[branch] == -1) {
+                tree[node].child[branch] = static_cast<qint16>(tree.size());
+                tree.emplace_back();
+            }
+            node = tree[node].child[branch];
+        }
+        tree[node].symbol = static_cast<qint16>(symbol);
+    }
+    return tree;
+}
+
+static bool huffmanDecode(const quint8 *it, const quint8 *end, QByteArray &out)
+{
+    static const std::vector<HuffmanNode> tree = buildHuffmanTree();
+
+    out.reserve(static_cast<int>((end - it) * 8 / 5));
+    qint16 node = 0;
+    int bitsOnPath = 0;
+    bool pathAllOnes = true;
+    while (it < end) {
+        const quint8 byte = *it++;
+        for (int bit = 7; bit >= 0; --bit) {
+            const int branch = (byte >> bit) & 1;
+            node = tree[node].child[branch];
+            if (node == -1) {
+                return false;
+            }
+            ++bitsOnPath;
+            pathAllOnes = pathAllOnes && branch;
+            if (tree[node].symbol != -1) {
+                if (tree[node].symbol == 256) {
+                    // EOS in the data is a coding error
+                    return false;
+                }
+                out.append(static_cast<char>(tree[node].symbol));
+                node = 0;
+                bitsOnPath = 0;
+                pathAllOnes = true;
+            }
+        }
+    }
+
+    // the final bits must be the most significant bits of EOS,
+    // shorter than one byte
+    return bitsOnPath < 8 && pathAllOnes;
+}
+
+static bool decodeInteger(const quint8 *&it, const quint8 *end, quint8 prefixBits, quint32 &value)
+{
+    const quint32 mask = (1u << prefixBits) - 1;
+    if (it >= end) {
+        return false;
+    }
+
+    value = *it++ & mask;
+    if (value < mask) {
+        return true;
+    }
+
+    quint32 shift = 0;
+    quint8 byte;
+    do {
+        if (it >= end || shift > 28) {
+            return false;
+        }
+        byte = *it++;
+        value += static_cast<quint32>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return true;
+}
+
+static bool decodeString(const quint8 *&it, const quint8 *end, QByteArray &out)
+{
+    if (it >= end) {
+        return false;
+    }
+    const bool huffman = *it & 0x80;
+    quint32 length;
+    if (!decodeInteger(it, end, 7, length) || length > static_cast<quint32>(end - it)) {
+        return false;
+    }
+
+    if (huffman) {
+        if (!huffmanDecode(it, it + length, out)) {
+            return false;
+        }
+    } else {
+        out = QByteArray(reinterpret_cast<const char *>(it), static_cast<int>(length));
+    }
+    it += length;
+    return true;
+}
+
+void HPack::setMaxTableSize(quint32 size)
+{
+    m_settingsMaxDynamicSize = size;
+    if (m_maxDynamicSize > size) {
+        m_maxDynamicSize = size;
+        evictEntries();
+    }
+}
+
+void HPack::pushEntry(const QByteArray &name, const QByteArray &value)
+{
+    // RFC 7541 section 4.1, each entry costs 32 bytes of overhead
+    const quint32 entrySize = static_cast<quint32>(name.size() + value.size()) + 32;
+    if (entrySize > m_maxDynamicSize) {
+        // too large to store, clears the whole table
+        m_dynamic.clear();
+        m_dynamicSize = 0;
+        return;
+    }
+
+    m_dynamic.push_front({ name, value });
+    m_dynamicSize += entrySize;
+    evictEntries();
+}
+
+void HPack::evictEntries()
+{
+    while (m_dynamicSize > m_maxDynamicSize) {
+        const Entry &last = m_dynamic.back();
+        m_dynamicSize -= static_cast<quint32>(last.name.size() + last.value.size()) + 32;
+        m_dynamic.pop_back();
+    }
+}
+
+bool HPack::decode(const quint8 *it, const quint8 *end, HeaderList &headers)
+{
+    while (it < end) {
+        const quint8 byte = *it;
+        QByteArray name;
+        QByteArray value;
+
+        if (byte & 0x80) {
+            // indexed header field
+            quint32 index;
+            if (!decodeInteger(it, end, 7, index) || index == 0) {
+                return false;
+            }
+            if (index <= 61) {
+                name = QByteArray(staticTable[index - 1].name);
+                value = QByteArray(staticTable[index - 1].value);
+            } else if (index - 62 < m_dynamic.size()) {
+                const Entry &entry = m_dynamic[index - 62];
+                name = entry.name;
+                value = entry.value;
+            } else {
+                return false;
+            }
+        } else if ((byte & 0xe0) == 0x20) {
+            // dynamic table size update
+            quint32 size;
+            if (!decodeInteger(it, end, 5, size) || size > m_settingsMaxDynamicSize) {
+                return false;
+            }
+            m_maxDynamicSize = size;
+            evictEntries();
+            continue;
+        } else {
+            // literal header field, with incremental indexing (01),
+            // never indexed (0001) or without indexing (0000)
+            const bool addToIndex = (byte & 0xc0) == 0x40;
+            const quint8 prefixBits = addToIndex ? 6 : 4;
+            quint32 index;
+            if (!decodeInteger(it, end, prefixBits, index)) {
+                return false;
+            }
+            if (index == 0) {
+                if (!decodeString(it, end, name)) {
+                    return false;
+                }
+            } else if (index <= 61) {
+                name = QByteArray(staticTable[index - 1].name);
+            } else if (index - 62 < m_dynamic.size()) {
+                name = m_dynamic[index - 62].name;
+            } else {
+                return false;
+            }
+            if (!decodeString(it, end, value)) {
+                return false;
+            }
+            if (addToIndex) {
+                pushEntry(name, value);
+            }
+        }
+
+        headers.push_back({ name, value });
+    }
+    return true;
+}
+
+static void encodeInteger(QByteArray &buf, quint8 firstByte, quint8 prefixBits, quint32 value)
+{
+    const quint32 mask = (1u << prefixBits) - 1;
+    if (value < mask) {
+        buf.append(static_cast<char>(firstByte | value));
+        return;
+    }
+
+    buf.append(static_cast<char>(firstByte | mask));
+    value -= mask;
+    while (value >= 0x80) {
+        buf.append(static_cast<char>(0x80 | (value & 0x7f)));
+        value >>= 7;
+    }
+    buf.append(static_cast<char>(value));
+}
+
+static void encodeString(QByteArray &buf, const QByteArray &string)
+{
+    // always raw, Huffman would only save a few bytes on an
+    // encrypted connection at the cost of an encoder table
+    encodeInteger(buf, 0x00, 7, static_cast<quint32>(string.size()));
+    buf.append(string);
+}
+
+void HPack::encodeStatus(QByteArray &buf, quint16 status)
+{
+    quint8 index = 0;
+    switch (status) {
+    case 200: index = 8; break;
+    case 204: index = 9; break;
+    case 206: index = 10; break;
+    case 304: index = 11; break;
+    case 400: index = 12; break;
+    case 404: index = 13; break;
+    case 500: index = 14; break;
+    default: break;
+    }
+
+    if (index) {
+        buf.append(static_cast<char>(0x80 | index));
+    } else {
+        // literal without indexing, the :status name by static index 8
+        encodeInteger(buf, 0x00, 4, 8);
+        encodeString(buf, QByteArray::number(status));
+    }
+}
+
+void HPack::encodeHeader(QByteArray &buf, const QByteArray &name, const QByteArray &value)
+{
+    // literal without indexing with a literal name, names must
+    // already be lower case
+    buf.append(static_cast<char>(0x00));
+    encodeString(buf, name);
+    encodeString(buf, value);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef HPACK_H
+#define HPACK_H
+
+#include <QByteArray>
+
+#include <deque>
+#include <vector>
+#include <utility>
+
+namespace CWSGI {
+
+/**
+ * RFC 7541 HPACK codec for one HTTP/2 connection. The decoder keeps
+ * the dynamic table the client builds across header blocks, so one
+ * instance must live as long as the connection. Responses are encoded
+ * without indexing, which keeps the encoder stateless and the peer's
+ * decoder table empty.
+ */
+class HPack
+{
+public:
+    typedef std::vector<std::pair<QByteArray, QByteArray> > HeaderList;
+
+    /**
+     * Decodes a complete header block into name/value pairs in wire
+     * order, pseudo headers included. Returns false on a compression
+     * error, which is fatal for the connection.
+     */
+    bool decode(const quint8 *it, const quint8 *end, HeaderList &headers);
+
+    /**
+     * Upper bound for dynamic table size updates, our
+     * SETTINGS_HEADER_TABLE_SIZE.
+     */
+    void setMaxTableSize(quint32 size);
+
+    static void encodeStatus(QByteArray &buf, quint16 status);
+    static void encodeHeader(QByteArray &buf, const QByteArray &name, const QByteArray &value);
+
+private:
+    struct Entry {
+        QByteArray name;
+        QByteArray value;
+    };
+
+    void pushEntry(const QByteArray &name, const QByteArray &value);
+    void evictEntries();
+
+    // newest entry at the front, index 62 on the wire
+    std::deque<Entry> m_dynamic;
+    quint32 m_dynamicSize = 0;
+    quint32 m_maxDynamicSize = 4096;
+    quint32 m_settingsMaxDynamicSize = 4096;
+};
+
+}
+
+#endif // HPACK_H
@@ -25,6 +25,7 @@
 
 #include <QSocketNotifier>
 #include <QDateTime>
+#include <QTimer>
 
 #ifdef Q_OS_UNIX
 //#include <sys/types.h>
@@ -34,6 +35,15 @@
 #include <fcntl.h>
 
 static inline int cutelyst_safe_accept(int s, struct sockaddr *addr, uint *addrlen, int flags = 0);
+
+#ifdef SO_PEERCRED
+// same layout as struct ucred, which glibc only exposes with _GNU_SOURCE
+struct PeerCred {
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
+};
+#endif
 #endif
 
 using namespace CWSGI;
@@ -103,12 +113,17 @@ void LocalServer::incomingConnection(quintptr handle)
     } else {
         sock = new LocalSocket(m_wsgi, this);
         sock->engine = m_engine;
+        // constant for every connection of this server, no need to
+        // reassign them on each accept like the TCP path must
+        sock->proto = m_protocol;
+        sock->serverAddress = QStringLiteral("localhost");
 
-        connect(sock, &QIODevice::readyRead, [sock] () {
-            sock->timeout = false;
+        connect(sock, &QIODevice::readyRead, [this, sock] () {
+            m_activityList.touch(sock, QDateTime::currentMSecsSinceEpoch());
             sock->proto->readyRead(sock, sock);
         });
         connect(sock, &LocalSocket::finished, [this] (LocalSocket *obj) {
+            m_activityList.remove(obj);
             m_socks.push_back(obj);
             if (--m_processing == 0) {
                 m_engine->stopSocketTimeout();
@@ -119,8 +134,22 @@ void LocalServer::incomingConnection(quintptr handle)
     if (Q_LIKELY(sock->setSocketDescriptor(handle))) {
         sock->resetSocket();
 
-        sock->proto = m_protocol;
-        sock->serverAddress = QStringLiteral("localhost");
+#ifdef SO_PEERCRED
+        // The kernel hands over the peer's credentials for free at
+        // accept time, so sidecar clients on the same host are
+        // authenticated without any handshake. The uid travels as
+        // Request::remoteUser(), like REMOTE_USER from a front server.
+        PeerCred cred;
+        socklen_t credLen = sizeof(cred);
+        if (::getsockopt(int(handle), SOL_SOCKET, SO_PEERCRED, &cred, &credLen) == 0) {
+            sock->remoteUser = QString::number(cred.uid);
+        } else {
+            sock->remoteUser.clear();
+        }
+#endif
+
+        m_activityList.touch(sock, QDateTime::currentMSecsSinceEpoch());
+
         if (++m_processing) {
             m_engine->startSocketTimeout();
         }
@@ -145,36 +174,79 @@ void LocalServer::shutdown()
 
     if (m_processing == 0) {
         m_engine->serverShutdown();
-    } else {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<LocalSocket*>(child);
-            if (socket) {
-                socket->headerConnection = Socket::HeaderConnectionClose;
-                connect(socket, &LocalSocket::finished, [this] () {
-                    if (!m_processing) {
-                        m_engine->serverShutdown();
-                    }
-                });
+        return;
+    }
+
+    const auto childrenL = children();
+    for (auto child : childrenL) {
+        auto socket = qobject_cast<LocalSocket*>(child);
+        if (socket) {
+            socket->headerConnection = Socket::HeaderConnectionClose;
+            connect(socket, &LocalSocket::finished, this, [this] () {
+                if (!m_processing) {
+                    m_engine->serverShutdown();
+                }
+            });
+            if (!socket->processing) {
+                // idle keep-alive connection, close it now instead of
+                // waiting for its next request or the socket timeout
+                m_activityList.remove(socket);
+                socket->connectionClose();
             }
         }
     }
+
+    if (m_processing) {
+        // in-flight requests get a deadline, past it the remaining
+        // connections are dropped so a worker restart cannot hang
+        // behind one slow client
+        QTimer::singleShot(m_wsgi->gracefulTimeout() * 1000, this, [this] () {
+            const auto childrenL = children();
+            for (auto child : childrenL) {
+                auto socket = qobject_cast<LocalSocket*>(child);
+                if (socket && socket->processing) {
+                    m_activityList.remove(socket);
+                    socket->processing = false;
+                    socket->abort();
+                }
+            }
+        });
+    }
 }
 
 void LocalServer::timeoutConnections()
 {
-    if (m_processing) {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<LocalSocket*>(child);
-            if (socket && !socket->processing && socket->state() == QLocalSocket::ConnectedState) {
-                if (socket->timeout) {
-                    socket->connectionClose();
+    // Walk from the oldest socket and stop at the first one still
+    // inside every window, the list is ordered by last activity
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 timeoutMs = m_wsgi->socketTimeout() * 1000;
+    const qint64 heartbeatMs = qint64(m_wsgi->websocketHeartbeat()) * 1000;
+    const qint64 expireBefore = timeoutMs ? now - timeoutMs : Q_INT64_C(-1);
+    const qint64 pingBefore = heartbeatMs ? now - heartbeatMs : Q_INT64_C(-1);
+
+    // unmasked unfragmented PING with no payload, see
+    // TcpServer::timeoutConnections()
+    static const char pingFrame[] = { char(0x89), 0x00 };
+
+    Socket *sock = m_activityList.oldest();
+    while (sock && sock->lastActivity <= qMax(expireBefore, pingBefore)) {
+        Socket *next = sock->activityNext;
+        if (sock->websocketContext) {
+            if (pingBefore != -1 && sock->lastActivity <= pingBefore) {
+                if (sock->websocket_pong_pending) {
+                    m_activityList.remove(sock);
+                    sock->connectionClose();
                 } else {
-                    socket->timeout = true;
+                    sock->websocket_pong_pending = true;
+                    m_activityList.touch(sock, now);
+                    static_cast<LocalSocket *>(sock)->write(pingFrame, sizeof(pingFrame));
                 }
             }
+        } else if (!sock->processing && expireBefore != -1 && sock->lastActivity <= expireBefore) {
+            m_activityList.remove(sock);
+            sock->connectionClose();
         }
+        sock = next;
     }
 }
 
@@ -203,15 +275,27 @@ QSocketNotifier *LocalServer::socketDescriptorNotifier() const
 }
 
 #ifdef Q_OS_UNIX
+// Drains at most this many connections per notifier wakeup, so a
+// connection storm cannot starve the sockets that are already talking
+#define LOCAL_ACCEPT_BURST 64
+
 void LocalServer::socketNotifierActivated()
 {
     if (-1 == m_socket)
         return;
 
-    ::sockaddr_un addr;
-    uint length = sizeof(sockaddr_un);
-    int connectedSocket = cutelyst_safe_accept(m_socket, (sockaddr *)&addr, &length);
-    if (-1 != connectedSocket) {
+    // Accept until the queue is empty instead of taking one
+    // connection per event-loop turn; under a storm the turnaround
+    // through the loop is what caps the accept rate. The listen fd
+    // is non-blocking, an empty queue returns -1 right away.
+    int burst = LOCAL_ACCEPT_BURST;
+    while (burst--) {
+        ::sockaddr_un addr;
+        uint length = sizeof(sockaddr_un);
+        int connectedSocket = cutelyst_safe_accept(m_socket, (sockaddr *)&addr, &length);
+        if (-1 == connectedSocket) {
+            break;
+        }
         incomingConnection(connectedSocket);
     }
 }
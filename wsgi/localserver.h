@@ -21,6 +21,8 @@
 
 #include <QLocalServer>
 
+#include "socket.h"
+
 class QSocketNotifier;
 namespace CWSGI {
 
@@ -61,6 +63,7 @@ private:
     WSGI *m_wsgi;
 
     std::vector<LocalSocket *> m_socks;
+    SocketActivityList m_activityList;
     Protocol *m_protocol = nullptr;
     qintptr m_socket = -1;
     int m_processing = 0;
@@ -23,6 +23,7 @@
 #include <QTranslator>
 
 #include "wsgi.h"
+#include "asynclogger.h"
 #include "config.h"
 
 int main(int argc, char *argv[])
@@ -36,6 +37,9 @@ int main(int argc, char *argv[])
 
     QCoreApplication app(argc, argv);
 
+    // console or journald backpressure must never block the workers
+    CWSGI::AsyncLogger::install();
+
     wsgi.parseCommandLine(app.arguments());
 
     qputenv("QT_LOGGING_CONF", "/home/daniel/cutelyst.ini");
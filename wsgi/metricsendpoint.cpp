@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "metricsendpoint.h"
+
+#include <Cutelyst/Application>
+#include <Cutelyst/Response>
+#include <Cutelyst/Request>
+#include <Cutelyst/stats.h>
+
+#ifdef Q_OS_LINUX
+#include "../EventLoopEPoll/eventdispatcher_epoll.h"
+#endif
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+#include <atomic>
+
+using namespace CWSGI;
+using namespace Cutelyst;
+
+// Shared by every worker core of this process, a scrape on any
+// core sees the whole process
+static std::atomic<quint64> s_requests = { 0 };
+
+#ifdef Q_OS_UNIX
+// Resident size and fault counters of this worker process; major
+// faults climbing between scrapes means the heap is being paged out
+// and revived, which the lock-memory option exists to prevent
+static QByteArray memoryMetrics()
+{
+    QByteArray ret;
+
+#ifdef Q_OS_LINUX
+    long long sizePages, rssPages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (fscanf(statm, "%lld %lld", &sizePages, &rssPages) != 2) {
+            rssPages = 0;
+        }
+        fclose(statm);
+    }
+
+    if (rssPages) {
+        static const long pageSize = sysconf(_SC_PAGESIZE);
+        ret.append("# HELP cutelyst_worker_resident_bytes Resident set size of this worker process\n"
+                   "# TYPE cutelyst_worker_resident_bytes gauge\n"
+                   "cutelyst_worker_resident_bytes ");
+        ret.append(QByteArray::number(qint64(rssPages) * pageSize));
+        ret.append('\n');
+    }
+#endif
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        ret.append("# HELP cutelyst_worker_major_page_faults_total Page faults that required I/O\n"
+                   "# TYPE cutelyst_worker_major_page_faults_total counter\n"
+                   "cutelyst_worker_major_page_faults_total ");
+        ret.append(QByteArray::number(qint64(usage.ru_majflt)));
+        ret.append("\n"
+                   "# HELP cutelyst_worker_minor_page_faults_total Page faults served without I/O\n"
+                   "# TYPE cutelyst_worker_minor_page_faults_total counter\n"
+                   "cutelyst_worker_minor_page_faults_total ");
+        ret.append(QByteArray::number(qint64(usage.ru_minflt)));
+        ret.append('\n');
+    }
+
+    return ret;
+}
+#endif
+
+MetricsEndpoint::MetricsEndpoint(Cutelyst::Application *parent) : Plugin(parent)
+{
+
+}
+
+bool MetricsEndpoint::setup(Cutelyst::Application *app)
+{
+    connect(app, &Cutelyst::Application::beforePrepareAction,
+            this, &MetricsEndpoint::beforePrepareAction);
+    return true;
+}
+
+void MetricsEndpoint::beforePrepareAction(Cutelyst::Context *c, bool *skipMethod)
+{
+    if (*skipMethod) {
+        return;
+    }
+
+    const quint64 requests = s_requests.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    Request *req = c->request();
+    if (req->method() != QLatin1String("GET")) {
+        return;
+    }
+
+    if (req->path() == QLatin1String("metrics/top")) {
+        // the human-readable answer to "which action is eating the
+        // box": actions sorted by total CPU time, with call counts
+        // and per-request allocation churn when compiled in
+        Response *res = c->response();
+        res->setStatus(Response::OK);
+        res->stripDefaultHeaders();
+        res->setContentType(QStringLiteral("text/plain"));
+        res->setBody(Stats::topActionsReport());
+
+        *skipMethod = true;
+        return;
+    }
+
+    if (req->path() != QLatin1String("metrics")) {
+        return;
+    }
+
+    QByteArray body;
+    body.append("# HELP cutelyst_requests_total Requests seen by this worker process\n"
+                "# TYPE cutelyst_requests_total counter\n"
+                "cutelyst_requests_total ");
+    body.append(QByteArray::number(requests));
+    body.append('\n');
+    body.append(Stats::prometheusMetrics());
+#ifdef Q_OS_LINUX
+    // only populated when the epoll loop runs with lag tracking on
+    body.append(EventDispatcherEPoll::lagMetrics());
+#endif
+#ifdef Q_OS_UNIX
+    body.append(memoryMetrics());
+#endif
+
+    Response *res = c->response();
+    res->setStatus(Response::OK);
+    // scrape replies have no use for the decorative default headers
+    res->stripDefaultHeaders();
+    res->setContentType(QStringLiteral("text/plain; version=0.0.4"));
+    res->setBody(body);
+
+    *skipMethod = true;
+}
+
+#include "moc_metricsendpoint.cpp"
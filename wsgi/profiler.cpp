@@ -0,0 +1,404 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "profiler.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QTimer>
+#include <QFile>
+#include <QDir>
+#include <QStandardPaths>
+#include <QHash>
+#include <QVector>
+#include <QLoggingCategory>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <sys/time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+
+Q_LOGGING_CATEGORY(CWSGI_PROFILER, "cwsgi.profiler")
+
+using namespace CWSGI;
+
+// 97 Hz keeps the overhead in the noise and avoids sampling in
+// lockstep with the second resolution timers the server runs
+#define PROFILER_INTERVAL_USEC 10309
+#define PROFILER_MAX_DEPTH 40
+#define PROFILER_MAX_SAMPLES 65536
+#define PROFILER_MAX_SECONDS 300
+
+struct ProfilerSample {
+    int depth;
+    void *pcs[PROFILER_MAX_DEPTH];
+};
+
+static ProfilerSample *profilerSamples = nullptr;
+static std::atomic<int> profilerSampleCount;
+static std::atomic<bool> profilerCollecting;
+
+static void profilerSignalHandler(int signum)
+{
+    Q_UNUSED(signum)
+    if (!profilerCollecting.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    // only async-signal-safe work here: backtrace() walks the stack
+    // without allocating (the unwinder library is preloaded by
+    // start()), the slot is claimed with a single atomic increment
+    void *pcs[PROFILER_MAX_DEPTH + 2];
+    int depth = backtrace(pcs, PROFILER_MAX_DEPTH + 2);
+
+    // drop this handler and the kernel signal trampoline, keeping
+    // the frame that was interrupted on top
+    int skip = qMin(depth, 2);
+    depth -= skip;
+    if (depth <= 0) {
+        return;
+    }
+
+    const int ix = profilerSampleCount.fetch_add(1, std::memory_order_relaxed);
+    if (ix >= PROFILER_MAX_SAMPLES) {
+        return;
+    }
+
+    ProfilerSample *sample = profilerSamples + ix;
+    sample->depth = depth;
+    memcpy(sample->pcs, pcs + skip, size_t(depth) * sizeof(void *));
+}
+
+/**
+ * Both output files land at predictable names, so a local user could
+ * leave a symlink there to redirect the write: drop any stale file
+ * and demand exclusive creation of a fresh one, never following
+ * whatever was planted.
+ */
+static int profilerOpenExclusive(const QByteArray &path)
+{
+    ::unlink(path.constData());
+    return ::open(path.constData(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+}
+
+struct ProfilerAnonRegion {
+    quintptr start;
+    quintptr end;
+    QByteArray name;
+};
+
+#ifdef Q_OS_LINUX
+/**
+ * Runtime generated code - the pcre JIT behind QRegularExpression,
+ * template engines - lives in anonymous executable mappings no
+ * symbol table covers. Name each such region and write them in the
+ * perf-map format (/tmp/perf-<pid>.map), so perf and flamegraph
+ * tooling attach the same labels our collapsed stacks use.
+ */
+static QVector<ProfilerAnonRegion> profilerMapAnonRegions()
+{
+    QVector<ProfilerAnonRegion> regions;
+
+    QFile maps(QStringLiteral("/proc/self/maps"));
+    if (!maps.open(QFile::ReadOnly | QFile::Text)) {
+        return regions;
+    }
+
+    char buf[1024];
+    qint64 len;
+    while ((len = maps.readLine(buf, sizeof(buf))) > 0) {
+        // start-end perms offset dev inode [path]
+        char *end;
+        quintptr regionStart = quintptr(strtoull(buf, &end, 16));
+        if (*end != '-') {
+            continue;
+        }
+        quintptr regionEnd = quintptr(strtoull(end + 1, &end, 16));
+
+        const char *perms = end + 1;
+        if (perms[2] != 'x') {
+            continue;
+        }
+
+        // a path column marks a file backed mapping, covered by dladdr
+        const char *path = strchr(perms, '/');
+        if (path && path < buf + len) {
+            continue;
+        }
+
+        ProfilerAnonRegion region;
+        region.start = regionStart;
+        region.end = regionEnd;
+        region.name = "anon_exec_0x" + QByteArray::number(qulonglong(regionStart), 16);
+        regions.push_back(region);
+    }
+
+    if (!regions.isEmpty()) {
+        // this exact path in the shared temp dir is fixed by the
+        // perf-map convention, so it cannot move to a private
+        // directory; the exclusive open keeps it from being abused
+        const QByteArray path = QByteArrayLiteral("/tmp/perf-")
+                + QByteArray::number(::getpid()) + QByteArrayLiteral(".map");
+        const int fd = profilerOpenExclusive(path);
+        if (fd != -1) {
+            QFile perfMap;
+            if (perfMap.open(fd, QFile::WriteOnly | QFile::Text, QFileDevice::AutoCloseHandle)) {
+                for (const ProfilerAnonRegion &region : regions) {
+                    perfMap.write(QByteArray::number(qulonglong(region.start), 16) + ' '
+                                  + QByteArray::number(qulonglong(region.end - region.start), 16) + ' '
+                                  + region.name + '\n');
+                }
+            } else {
+                ::close(fd);
+            }
+        }
+    }
+
+    return regions;
+}
+#endif
+
+static QByteArray profilerSymbolize(void *pc, const QVector<ProfilerAnonRegion> &anonRegions)
+{
+    Dl_info info;
+    if (dladdr(pc, &info)) {
+        if (info.dli_sname) {
+            int status = -1;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            if (status == 0 && demangled) {
+                QByteArray ret(demangled);
+                free(demangled);
+                return ret;
+            }
+            if (demangled) {
+                free(demangled);
+            }
+            return QByteArray(info.dli_sname);
+        }
+
+        if (info.dli_fname) {
+            // a stripped module, name it by its offset so the admin
+            // can still resolve it with addr2line
+            const char *base = strrchr(info.dli_fname, '/');
+            return QByteArray(base ? base + 1 : info.dli_fname) + "+0x"
+                    + QByteArray::number(qulonglong(quintptr(pc) - quintptr(info.dli_fbase)), 16);
+        }
+    }
+
+    for (const ProfilerAnonRegion &region : anonRegions) {
+        if (quintptr(pc) >= region.start && quintptr(pc) < region.end) {
+            return region.name;
+        }
+    }
+
+    return QByteArrayLiteral("[unknown]");
+}
+
+Profiler::Profiler(QObject *parent) : QObject(parent)
+{
+}
+
+Profiler::~Profiler()
+{
+    if (profilerCollecting.load(std::memory_order_acquire)) {
+        stop();
+    }
+}
+
+bool Profiler::listen(const QString &path)
+{
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+
+    QLocalServer::removeServer(path);
+    if (!m_server->listen(path)) {
+        qCCritical(CWSGI_PROFILER) << "Failed to listen on profiler socket"
+                                   << path << m_server->errorString();
+        return false;
+    }
+
+    connect(m_server, &QLocalServer::newConnection, this, [this] {
+        while (QLocalSocket *client = m_server->nextPendingConnection()) {
+            connect(client, &QLocalSocket::disconnected, client, &QLocalSocket::deleteLater);
+            connect(client, &QLocalSocket::readyRead, this, [this, client] {
+                if (client->canReadLine()) {
+                    processCommand(client, client->readLine().trimmed());
+                }
+            });
+        }
+    });
+
+    qCInfo(CWSGI_PROFILER) << "Profiler command socket listening on" << path;
+    return true;
+}
+
+void Profiler::processCommand(QLocalSocket *client, const QByteArray &line)
+{
+    const QList<QByteArray> parts = line.split(' ');
+    if (parts.size() == 2 && parts.first() == "profile") {
+        bool ok;
+        const int seconds = parts.last().toInt(&ok);
+        if (!ok || seconds < 1 || seconds > PROFILER_MAX_SECONDS) {
+            client->write("ERROR seconds must be between 1 and " QT_STRINGIFY(PROFILER_MAX_SECONDS) "\n");
+            return;
+        }
+
+        QString output;
+        QString error;
+        if (start(seconds, &output, &error)) {
+            client->write("OK profiling for " + QByteArray::number(seconds)
+                          + "s into " + output.toLocal8Bit() + '\n');
+        } else {
+            client->write("ERROR " + error.toLocal8Bit() + '\n');
+        }
+        return;
+    }
+
+    client->write("ERROR usage: profile <seconds>\n");
+}
+
+bool Profiler::start(int seconds, QString *output, QString *error)
+{
+    if (profilerCollecting.load(std::memory_order_acquire)) {
+        *error = QStringLiteral("a profile is already running");
+        return false;
+    }
+
+    // a per-user directory, not the shared temp dir where another
+    // local user controls sibling names
+    QString dir = QString::fromLocal8Bit(qgetenv("XDG_RUNTIME_DIR"));
+    if (dir.isEmpty()) {
+        dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        QDir().mkpath(dir);
+    }
+    m_output = dir + QStringLiteral("/cutelyst-profile-%1-%2.folded")
+            .arg(QCoreApplication::applicationPid())
+            .arg(QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMddhhmmss")));
+    *output = m_output;
+
+    if (!profilerSamples) {
+        profilerSamples = new ProfilerSample[PROFILER_MAX_SAMPLES];
+    }
+    profilerSampleCount.store(0, std::memory_order_relaxed);
+
+    // the first backtrace() call loads the unwinder library, do it
+    // now so the signal handler never allocates
+    void *warm[4];
+    backtrace(warm, 4);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = profilerSignalHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, nullptr)) {
+        *error = QStringLiteral("could not install the SIGPROF handler");
+        return false;
+    }
+
+    profilerCollecting.store(true, std::memory_order_release);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = PROFILER_INTERVAL_USEC;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr)) {
+        profilerCollecting.store(false, std::memory_order_release);
+        *error = QStringLiteral("could not arm the profiling timer");
+        return false;
+    }
+
+    qCInfo(CWSGI_PROFILER) << "Sampling worker threads for" << seconds << "seconds";
+    QTimer::singleShot(seconds * 1000, this, &Profiler::stop);
+    return true;
+}
+
+void Profiler::stop()
+{
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    profilerCollecting.store(false, std::memory_order_release);
+
+    // a tick in flight claims an index past this read, so every
+    // sample below count is fully written
+    const int count = qMin(profilerSampleCount.load(std::memory_order_acquire),
+                           int(PROFILER_MAX_SAMPLES));
+
+    QVector<ProfilerAnonRegion> anonRegions;
+#ifdef Q_OS_LINUX
+    anonRegions = profilerMapAnonRegions();
+#endif
+
+    QHash<void *, QByteArray> symbolCache;
+    QHash<QByteArray, int> folded;
+    for (int i = 0; i < count; ++i) {
+        const ProfilerSample *sample = profilerSamples + i;
+
+        // collapsed stacks read root first, backtrace() returns
+        // them leaf first
+        QByteArray stack;
+        for (int frame = sample->depth - 1; frame >= 0; --frame) {
+            void *pc = sample->pcs[frame];
+            auto it = symbolCache.constFind(pc);
+            if (it == symbolCache.constEnd()) {
+                it = symbolCache.insert(pc, profilerSymbolize(pc, anonRegions));
+            }
+            if (!stack.isEmpty()) {
+                stack.append(';');
+            }
+            stack.append(it.value());
+        }
+        ++folded[stack];
+    }
+
+    delete [] profilerSamples;
+    profilerSamples = nullptr;
+
+    const int fd = profilerOpenExclusive(QFile::encodeName(m_output));
+    if (fd == -1) {
+        qCCritical(CWSGI_PROFILER) << "Failed to write profile" << m_output
+                                   << QString::fromLocal8Bit(strerror(errno));
+        return;
+    }
+
+    QFile file;
+    if (!file.open(fd, QFile::WriteOnly | QFile::Text, QFileDevice::AutoCloseHandle)) {
+        ::close(fd);
+        qCCritical(CWSGI_PROFILER) << "Failed to write profile" << m_output << file.errorString();
+        return;
+    }
+
+    auto it = folded.constBegin();
+    while (it != folded.constEnd()) {
+        file.write(it.key() + ' ' + QByteArray::number(it.value()) + '\n');
+        ++it;
+    }
+
+    qCInfo(CWSGI_PROFILER) << "Wrote" << count << "samples to" << m_output;
+}
+
+#include "moc_profiler.cpp"
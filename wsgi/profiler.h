@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef CWSGI_PROFILER_H
+#define CWSGI_PROFILER_H
+
+#include <QObject>
+
+class QLocalServer;
+class QLocalSocket;
+
+namespace CWSGI {
+
+/**
+ * In-process sampling profiler with a unix socket command channel.
+ *
+ * The socket is created with user-only access, so triggering a
+ * profile needs the credentials the server runs under. The only
+ * command is "profile <seconds>\n": it arms an ITIMER_PROF timer
+ * whose SIGPROF ticks capture the backtrace of whichever thread
+ * was burning CPU, which samples the worker threads in proportion
+ * to the time they actually use. When the timer runs out the
+ * samples are symbolized and written as collapsed stacks, the
+ * format flamegraph.pl consumes directly.
+ */
+class Profiler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Profiler(QObject *parent = nullptr);
+    ~Profiler();
+
+    bool listen(const QString &path);
+
+private:
+    void processCommand(QLocalSocket *client, const QByteArray &line);
+    bool start(int seconds, QString *output, QString *error);
+    void stop();
+
+    QLocalServer *m_server = nullptr;
+    QString m_output;
+};
+
+}
+
+#endif // CWSGI_PROFILER_H
@@ -19,6 +19,7 @@
 #include "protocol.h"
 
 #include "wsgi.h"
+#include "bufferalloc.h"
 
 using namespace CWSGI;
 
@@ -28,12 +29,33 @@ Protocol::Protocol(WSGI *wsgi)
     m_postBuffering = wsgi->postBuffering();
     m_webSocketBufferSize = wsgi->bufferSize();
     m_postBufferSize = qMax(static_cast<qint64>(32), wsgi->postBufferingBufsize());
-    m_postBuffer = new char[wsgi->postBufferingBufsize()];
+    m_maxRequestAge = static_cast<qint64>(wsgi->maxRequestAge()) * 1000000;
+    m_headerTimeout = static_cast<qint64>(wsgi->socketTimeout()) * 1000000;
 }
 
 Protocol::~Protocol()
 {
-    delete [] m_postBuffer;
+}
+
+char *Protocol::postBuffer() const
+{
+    // One scratch buffer per worker thread serves the HTTP, FastCGI
+    // and websocket parsers alike: the event loop runs one readyRead
+    // to completion at a time and the buffer never carries data
+    // across calls. Protocol prototypes living on the main thread
+    // never parse, with the lazy allocation they never pay for it.
+    static thread_local char *buffer = nullptr;
+    static thread_local qint64 bufferSize = 0;
+
+    if (Q_UNLIKELY(bufferSize < m_postBufferSize)) {
+        if (buffer) {
+            BufferAlloc::release(buffer, static_cast<quint32>(bufferSize));
+        }
+        // sized with the same floor the reads use
+        buffer = BufferAlloc::allocate(static_cast<quint32>(m_postBufferSize));
+        bufferSize = m_postBufferSize;
+    }
+    return buffer;
 }
 
 Protocol::Type Protocol::type() const
@@ -33,6 +33,7 @@ public:
     enum Type {
         Unknown,
         Http11,
+        Http2,
         FastCGI1
     };
 
@@ -45,11 +46,21 @@ public:
     virtual bool sendHeaders(QIODevice *io, Socket *sock, quint16 status, const QByteArray &dateHeader, const Cutelyst::Headers &headers) = 0;
     virtual qint64 sendBody(QIODevice *io, Socket *sock, const char *data, qint64 len);
 
+    /**
+     * Read scratch buffer of m_postBufferSize bytes, never holding
+     * data across calls. It is shared by every protocol instance of
+     * the current thread and only allocated once a parser needs it,
+     * so idle listener types cost nothing per worker.
+     */
+    char *postBuffer() const;
+
     qint64 m_postBufferSize;
     qint64 m_bufferSize;
     qint64 m_webSocketBufferSize;
     qint64 m_postBuffering;
-    char *m_postBuffer;
+    // deadline in microseconds, to match Engine::time(); 0 is off
+    qint64 m_maxRequestAge;
+    qint64 m_headerTimeout;
 };
 
 }
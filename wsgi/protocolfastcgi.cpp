@@ -28,6 +28,13 @@
 #include <QTemporaryFile>
 #include <QBuffer>
 
+#ifdef Q_OS_LINUX
+#include <sys/uio.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
 Q_LOGGING_CATEGORY(CWSGI_FCGI, "cwsgi.fcgi")
 
 /*
@@ -186,14 +193,13 @@ quint16 ProtocolFastCGI::addHeader(Socket *wsgi_req, const char *key, quint16 ke
     }
 
     if (keylen > 5 && memcmp(key, "HTTP_", 5) == 0) {
-        const QString value = QString::fromLatin1(val, vallen);
+        const QByteArray value(val, vallen);
         if (!wsgi_req->headerHost && memcmp(key + 5, "HOST", 4) == 0) {
-            wsgi_req->serverAddress = value;
+            wsgi_req->serverAddress = QString::fromLatin1(val, vallen);
             wsgi_req->headerHost = true;
-            wsgi_req->headers.pushRawHeader(QStringLiteral("HOST"), value);
+            wsgi_req->headers.pushRawHeader(QByteArrayLiteral("HOST"), value);
         } else {
-            const QString keyStr = QString::fromLatin1(key + 5, keylen - 5);
-            wsgi_req->headers.pushRawHeader(keyStr, value);
+            wsgi_req->headers.pushRawHeader(QByteArray(key + 5, keylen - 5), value);
         }
     } else if (memcmp(key, "REQUEST_METHOD", 14) == 0) {
         wsgi_req->method = QString::fromLatin1(val, vallen);
@@ -280,7 +286,53 @@ int ProtocolFastCGI::parseHeaders(Socket *wsgi_req, const char *buf, size_t len)
     return 0;
 }
 
-int ProtocolFastCGI::processPacket(Socket *sock) const
+// Replies to a FCGI_GET_VALUES management record; we only answer
+// FCGI_MPXS_CONNS as requests are processed one at a time per connection
+static void wsgi_proto_fastcgi_get_values_result(QIODevice *io, const char *buf, quint16 len)
+{
+    QByteArray content;
+    quint16 j = 0;
+    while (j + 1 < len) {
+        quint8 keylen = static_cast<quint8>(buf[j]);
+        quint8 vallen = static_cast<quint8>(buf[j + 1]);
+        if (keylen > 127 || vallen != 0 || j + 2 + keylen > len) {
+            // Only the standard short names are expected here
+            break;
+        }
+
+        const char *key = buf + j + 2;
+        if (keylen == sizeof(FCGI_MPXS_CONNS) - 1 && memcmp(key, FCGI_MPXS_CONNS, keylen) == 0) {
+            content.append(static_cast<char>(keylen)).append(static_cast<char>(1))
+                    .append(key, keylen).append('0');
+        }
+        j += 2 + keylen;
+    }
+
+    struct fcgi_record fr;
+    fr.version = FCGI_VERSION_1;
+    fr.type = FCGI_GET_VALUES_RESULT;
+    fr.req1 = 0;
+    fr.req0 = 0;
+    fr.cl1 = static_cast<quint8>((content.size() >> 8) & 0xff);
+    fr.cl0 = static_cast<quint8>(content.size() & 0xff);
+    fr.pad = 0;
+    fr.reserved = 0;
+    io->write(reinterpret_cast<const char *>(&fr), sizeof(struct fcgi_record));
+    io->write(content);
+}
+
+// Writes a bare FCGI_END_REQUEST record, used to refuse requests
+// that can not be served (FCGI_CANT_MPX_CONN, FCGI_OVERLOADED)
+static void wsgi_proto_fastcgi_end_request(QIODevice *io, quint16 requestId, quint8 protocolStatus)
+{
+    char end_request[] = "\1\3\0\1\0\x08\0\0\0\0\0\0\0\0\0\0";
+    end_request[2] = static_cast<char>((requestId >> 8) & 0xff);
+    end_request[3] = static_cast<char>(requestId & 0xff);
+    end_request[12] = static_cast<char>(protocolStatus);
+    io->write(end_request, 16);
+}
+
+int ProtocolFastCGI::processPacket(Socket *sock, QIODevice *io) const
 {
     Q_FOREVER {
         if (sock->buf_size >= sizeof(struct fcgi_record)) {
@@ -289,12 +341,13 @@ int ProtocolFastCGI::processPacket(Socket *sock) const
             quint16 fcgi_len = wsgi_be16(reinterpret_cast<const char *>(&fr->cl1));
             quint32 fcgi_all_len = sizeof(struct fcgi_record) + fcgi_len + fr->pad;
             quint8 fcgi_type = fr->type;
-            quint8 *sid = reinterpret_cast<quint8 *>(& sock->stream_id);
+            quint16 fcgi_id = 0;
+            quint8 *sid = reinterpret_cast<quint8 *>(&fcgi_id);
             sid[0] = fr->req0;
             sid[1] = fr->req1;
 
             // if STDIN, end of the loop
-            if (fcgi_type == FCGI_STDIN) {
+            if (fcgi_type == FCGI_STDIN && fcgi_id == sock->stream_id) {
                 if (fcgi_len == 0) {
                     memmove(sock->buffer, sock->buffer + fcgi_all_len, sock->buf_size - fcgi_all_len);
                     sock->buf_size -= fcgi_all_len;
@@ -319,16 +372,25 @@ int ProtocolFastCGI::processPacket(Socket *sock) const
                 sock->buf_size -= fcgi_all_len;
             } else if (sock->buf_size >= fcgi_all_len) {
                 // PARAMS ? (ignore other types)
-                if (fcgi_type == FCGI_PARAMS) {
+                if (fcgi_type == FCGI_PARAMS && fcgi_id == sock->stream_id) {
                     if (parseHeaders(sock, sock->buffer + sizeof(struct fcgi_record), fcgi_len)) {
                         return WSGI_ERROR;
                     }
                 } else if (fcgi_type == FCGI_BEGIN_REQUEST) {
-                    auto brb = reinterpret_cast<struct fcgi_begin_request_body *>(sock->buffer + sizeof(struct fcgi_begin_request_body));
-                    sock->headerConnection = (brb->flags & FCGI_KEEP_CONN) ? Socket::HeaderConnectionKeep : Socket::HeaderConnectionClose;
-                    sock->contentLength = -1;
-                    sock->headers = Cutelyst::Headers();
-                    sock->connState = Socket::MethodLine;
+                    if (sock->stream_id) {
+                        // A request is already in flight on this connection and we
+                        // advertise FCGI_MPXS_CONNS=0, refuse the multiplexed one
+                        wsgi_proto_fastcgi_end_request(io, fcgi_id, FCGI_CANT_MPX_CONN);
+                    } else {
+                        auto brb = reinterpret_cast<struct fcgi_begin_request_body *>(sock->buffer + sizeof(struct fcgi_begin_request_body));
+                        sock->stream_id = fcgi_id;
+                        sock->headerConnection = (brb->flags & FCGI_KEEP_CONN) ? Socket::HeaderConnectionKeep : Socket::HeaderConnectionClose;
+                        sock->contentLength = -1;
+                        sock->headers = Cutelyst::Headers();
+                        sock->connState = Socket::MethodLine;
+                    }
+                } else if (fcgi_type == FCGI_GET_VALUES) {
+                    wsgi_proto_fastcgi_get_values_result(io, sock->buffer + sizeof(struct fcgi_record), fcgi_len);
                 }
 
                 memmove(sock->buffer, sock->buffer + fcgi_all_len, sock->buf_size - fcgi_all_len);
@@ -350,21 +412,27 @@ bool ProtocolFastCGI::writeBody(Socket *sock, char *buf, qint64 len) const
     }
 
     if (m_postBuffering && sock->contentLength > m_postBuffering) {
-        auto temp = new QTemporaryFile;
-        if (!temp->open()) {
-            qCWarning(CWSGI_FCGI) << "Failed to open temporary file to store post" << temp->errorString();
-            return false;
+        auto temp = qobject_cast<QTemporaryFile *>(sock->bodySpare);
+        if (temp) {
+            // recycled spill file, already truncated
+            sock->bodySpare = nullptr;
+        } else {
+            temp = new QTemporaryFile;
+            if (!temp->open()) {
+                qCWarning(CWSGI_FCGI) << "Failed to open temporary file to store post" << temp->errorString();
+                return false;
+            }
         }
         sock->body = temp;
-    } else if (m_postBuffering && sock->contentLength <= m_postBuffering) {
-        auto buffer = new QBuffer;
-        buffer->open(QIODevice::ReadWrite);
-        buffer->buffer().reserve(sock->contentLength);
-        sock->body = buffer;
     } else {
-        // Unbuffered
-        auto buffer = new QBuffer;
-        buffer->open(QIODevice::ReadWrite);
+        // Buffered in memory or unbuffered
+        auto buffer = qobject_cast<QBuffer *>(sock->bodySpare);
+        if (buffer) {
+            sock->bodySpare = nullptr;
+        } else {
+            buffer = new QBuffer;
+            buffer->open(QIODevice::ReadWrite);
+        }
         buffer->buffer().reserve(sock->contentLength);
         sock->body = buffer;
     }
@@ -372,8 +440,119 @@ bool ProtocolFastCGI::writeBody(Socket *sock, char *buf, qint64 len) const
     return sock->body->write(buf, len) == len;
 }
 
+#ifdef Q_OS_LINUX
+// enough headers for 1 MiB of payload per writev() round
+#define FCGI_WRITEV_RECORDS 16
+
+// Scatter-gather record encoding: each 64 KiB record is an 8-byte
+// header filled in on the stack plus an iovec view of the caller's
+// payload, so body bytes go to the kernel without ever being copied
+// into record frames or the device's write buffer.
+static int fastcgi_writev(int fd, Socket *wsgi_req, const char *buf, int len)
+{
+    static const char padBytes[FCGI_ALIGNMENT] = { 0 };
+
+    quint8 *sid = reinterpret_cast<quint8 *>(&wsgi_req->stream_id);
+
+    int write_pos = 0;
+    while (write_pos < len) {
+        struct fcgi_record headers[FCGI_WRITEV_RECORDS];
+        struct iovec vec[FCGI_WRITEV_RECORDS * 3];
+        int vecCount = 0;
+        qint64 total = 0;
+
+        int record = 0;
+        while (record < FCGI_WRITEV_RECORDS && write_pos < len) {
+            const quint16 fcgi_len = static_cast<quint16>(qMin(len - write_pos, 0xffff));
+            const quint16 padded_len = FCGI_ALIGN(fcgi_len);
+            const quint8 padding = static_cast<quint8>(padded_len - fcgi_len);
+
+            struct fcgi_record *fr = &headers[record];
+            fr->version = FCGI_VERSION_1;
+            fr->type = FCGI_STDOUT;
+            fr->req1 = sid[1];
+            fr->req0 = sid[0];
+            fr->cl0 = static_cast<quint8>(fcgi_len & 0xff);
+            fr->cl1 = static_cast<quint8>((fcgi_len >> 8) & 0xff);
+            fr->pad = padding;
+            fr->reserved = 0;
+
+            vec[vecCount].iov_base = fr;
+            vec[vecCount].iov_len = sizeof(struct fcgi_record);
+            ++vecCount;
+            vec[vecCount].iov_base = const_cast<char *>(buf + write_pos);
+            vec[vecCount].iov_len = fcgi_len;
+            ++vecCount;
+            if (padding) {
+                vec[vecCount].iov_base = const_cast<char *>(padBytes);
+                vec[vecCount].iov_len = padding;
+                ++vecCount;
+            }
+
+            total += sizeof(struct fcgi_record) + fcgi_len + padding;
+            write_pos += fcgi_len;
+            ++record;
+        }
+
+        struct iovec *head = vec;
+        int remainingChunks = vecCount;
+        qint64 written = 0;
+        while (written < total) {
+            const ssize_t wrote = ::writev(fd, head, remainingChunks);
+            if (wrote >= 0) {
+                written += wrote;
+                // advance past the buffers that went out completely
+                size_t advanced = static_cast<size_t>(wrote);
+                while (remainingChunks && advanced >= head->iov_len) {
+                    advanced -= head->iov_len;
+                    ++head;
+                    --remainingChunks;
+                }
+                if (remainingChunks) {
+                    head->iov_base = static_cast<char *>(head->iov_base) + advanced;
+                    head->iov_len -= advanced;
+                }
+            } else if (errno == EAGAIN || errno == EINTR) {
+                struct pollfd pfd;
+                pfd.fd = fd;
+                pfd.events = POLLOUT;
+                pfd.revents = 0;
+                if (::poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+                    qCWarning(CWSGI_FCGI, "Failed to writev: %s", strerror(errno));
+                    return -1;
+                }
+            } else {
+                qCWarning(CWSGI_FCGI, "Failed to writev: %s", strerror(errno));
+                return -1;
+            }
+        }
+    }
+
+    return WSGI_OK;
+}
+#endif // Q_OS_LINUX
+
 int ProtocolFastCGI::wsgi_proto_fastcgi_write(QIODevice *io, Socket *wsgi_req, const char *buf, int len)
 {
+#ifdef Q_OS_LINUX
+    // TLS has to encrypt, and a non-empty device buffer would reorder
+    // bytes around a raw write; everything else takes the writev path
+    if (len > 0 && io->bytesToWrite() == 0) {
+        auto ssl = qobject_cast<QSslSocket *>(io);
+        if (!ssl || ssl->mode() == QSslSocket::UnencryptedMode) {
+            qintptr fd = -1;
+            if (auto tcp = qobject_cast<QAbstractSocket *>(io)) {
+                fd = tcp->socketDescriptor();
+            } else if (auto local = qobject_cast<QLocalSocket *>(io)) {
+                fd = local->socketDescriptor();
+            }
+            if (fd != -1) {
+                return fastcgi_writev(static_cast<int>(fd), wsgi_req, buf, len);
+            }
+        }
+    }
+#endif
+
     // reset for next write
     int write_pos = 0;
     quint32 proto_parser_status = 0;
@@ -448,9 +627,10 @@ qint64 ProtocolFastCGI::readBody(Socket *sock, QIODevice *io, qint64 bytesAvaila
     int len;
     QIODevice *body = sock->body;
     quint32 &pad = sock->buf_size;
+    char *scratch = postBuffer();
     while (bytesAvailable && sock->pktsize + pad) {
         // We need to read and ignore ending PAD data
-        len = io->read(m_postBuffer, qMin(m_postBufferSize, static_cast<qint64>(sock->pktsize + pad)));
+        len = io->read(scratch, qMin(m_postBufferSize, static_cast<qint64>(sock->pktsize + pad)));
         if (len == -1) {
             sock->connectionClose();
             return -1;
@@ -466,7 +646,7 @@ qint64 ProtocolFastCGI::readBody(Socket *sock, QIODevice *io, qint64 bytesAvaila
             sock->pktsize -= len;
         }
 
-        body->write(m_postBuffer, len);
+        body->write(scratch, len);
     }
 
     if ( sock->pktsize + pad == 0) {
@@ -478,6 +658,11 @@ qint64 ProtocolFastCGI::readBody(Socket *sock, QIODevice *io, qint64 bytesAvaila
 
 void ProtocolFastCGI::readyRead(Socket *sock, QIODevice *io) const
 {
+    // FastCGI rewrites the request vars into the packet buffer in
+    // place, so it needs the whole configured buffer up front; these
+    // connections come from the local reverse proxy and are few
+    while (sock->buf_capacity < m_bufferSize && sock->growBuffer(static_cast<quint32>(m_bufferSize))) { }
+
     // Post buffering
     qint64 bytesAvailable = io->bytesAvailable();
     if (sock->connState == Socket::ContentBody) {
@@ -503,7 +688,7 @@ void ProtocolFastCGI::readyRead(Socket *sock, QIODevice *io) const
                 continue;
             }
 
-            int ret = processPacket(sock);
+            int ret = processPacket(sock, io);
             if (ret == WSGI_AGAIN) {
                 continue;
             } else if (ret == WSGI_OK) {
@@ -548,21 +733,20 @@ bool ProtocolFastCGI::sendHeaders(QIODevice *io, Socket *sock, quint16 status, c
     headerBuffer.resize(0);
     headerBuffer.append(QByteArrayLiteral("Status: ") + QByteArray::number(status));
 
-    const auto headersData = headers.data();
+    const auto headersData = headers.rawData();
 
     bool hasDate = false;
     auto it = headersData.constBegin();
     const auto endIt = headersData.constEnd();
     while (it != endIt) {
-        const QString key = it.key();
-        const QString value = it.value();
-        if (!hasDate && key == QLatin1String("DATE")) {
+        QByteArray key = it.key();
+        const QByteArray value = it.value();
+        if (!hasDate && key == "DATE") {
             hasDate = true;
         }
 
-        QString line(QLatin1String("\r\n") + CWsgiEngine::camelCaseHeader(key) + QLatin1String(": ") + value);
-        const QByteArray data = line.toLatin1();
-        headerBuffer.append(data);
+        CWsgiEngine::camelCaseByteArrayHeader(key);
+        headerBuffer.append("\r\n", 2).append(key).append(": ", 2).append(value);
 
         ++it;
     }
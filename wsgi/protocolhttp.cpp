@@ -22,29 +22,100 @@
 #include "wsgi.h"
 
 #include <Cutelyst/Headers>
+#include <Cutelyst/keys_p.h>
 #include <Cutelyst/Context>
 
 #include <QVariant>
 #include <QIODevice>
 #include <QEventLoop>
-#include <QCoreApplication>
 #include <QTemporaryFile>
 #include <QBuffer>
 #include <QTimer>
 #include <QLoggingCategory>
 
+#include <vector>
+#include <algorithm>
+
+#ifdef CWSGI_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 using namespace CWSGI;
 
 Q_LOGGING_CATEGORY(CWSGI_HTTP, "cwsgi.http")
 
+// A legitimate request head rarely has more than a few dozen header
+// lines, the buffer-size already bounds the bytes but not the count
+#define HTTP_MAX_HEADER_LINES 100
+
+// Event-loop passes a batch-endpoint dispatch may be deferred before
+// it runs regardless, the starvation bound of the scheduling
+#define HTTP_BATCH_MAX_DEFERS 4
+
 ProtocolHttp::ProtocolHttp(WSGI *wsgi) : Protocol(wsgi)
   , m_websocketProto(new ProtocolWebSocket(wsgi))
 {
+    if (!wsgi->httpsRedirect().isEmpty()) {
+        m_httpsRedirectPrefix = "HTTP/1.1 301 Moved Permanently\r\nLocation: "
+                + wsgi->httpsRedirect().toLatin1();
+    }
 
+    // parseMethod() strips the leading slashes off the path, the
+    // mountpoints must match that form; longest prefix wins
+    const auto bodyLimits = wsgi->bodyLimit();
+    for (const QString &line : bodyLimits) {
+        const int sep = line.indexOf(QLatin1Char('='));
+        bool ok = sep != -1;
+        const qint64 bytes = ok ? line.midRef(sep + 1).toLongLong(&ok) : -1;
+        if (!ok || bytes < 0) {
+            qCWarning(CWSGI_HTTP) << "Invalid body-limit, expected mountpoint=bytes:" << line;
+            continue;
+        }
+        QString mount = line.left(sep);
+        while (mount.startsWith(QLatin1Char('/'))) {
+            mount.remove(0, 1);
+        }
+        m_bodyLimits.push_back({ mount, bytes });
+    }
+    std::sort(m_bodyLimits.begin(), m_bodyLimits.end(), [] (const std::pair<QString, qint64> &a, const std::pair<QString, qint64> &b) {
+        return a.first.size() > b.first.size();
+    });
+
+    const auto bodyContentTypes = wsgi->bodyContentType();
+    for (const QString &line : bodyContentTypes) {
+        const int sep = line.indexOf(QLatin1Char('='));
+        if (sep == -1) {
+            qCWarning(CWSGI_HTTP) << "Invalid body-content-type, expected mountpoint=types:" << line;
+            continue;
+        }
+        QString mount = line.left(sep);
+        while (mount.startsWith(QLatin1Char('/'))) {
+            mount.remove(0, 1);
+        }
+        m_bodyContentTypes.push_back({ mount, line.mid(sep + 1).split(QLatin1Char(','), QString::SkipEmptyParts) });
+    }
+    std::sort(m_bodyContentTypes.begin(), m_bodyContentTypes.end(), [] (const std::pair<QString, QStringList> &a, const std::pair<QString, QStringList> &b) {
+        return a.first.size() > b.first.size();
+    });
+
+    const auto batchEndpoints = wsgi->batchEndpoint();
+    for (const QString &line : batchEndpoints) {
+        QString mount = line;
+        while (mount.startsWith(QLatin1Char('/'))) {
+            mount.remove(0, 1);
+        }
+        m_batchEndpoints.push_back(mount);
+    }
 }
 
 ProtocolHttp::~ProtocolHttp()
 {
+#ifdef CWSGI_HAVE_ZLIB
+    for (z_stream *strm : m_inflatePool) {
+        inflateEnd(strm);
+        delete strm;
+    }
+#endif
 }
 
 Protocol::Type ProtocolHttp::type() const
@@ -75,178 +146,532 @@ inline int CrLfIndexIn(const char *str, int len, int from)
 
 void ProtocolHttp::readyRead(Socket *sock, QIODevice *io) const
 {
-    // Post buffering
-    if (sock->connState == Socket::ContentBody) {
-        qint64 bytesAvailable = io->bytesAvailable();
-        int len;
-        qint64 remaining;
-
-        QIODevice *body = sock->body;
-        do {
-            remaining = sock->contentLength - body->size();
-            len = io->read(m_postBuffer, qMin(m_postBufferSize, remaining));
-            if (len == -1) {
-                sock->connectionClose();
+    // Drain everything the socket has buffered in one pass, so a
+    // batch of pipelined requests is parsed and answered with a
+    // single event-loop wakeup. The responses are queued in order
+    // on the device write buffer.
+    do {
+        // Post buffering
+        if (sock->connState == Socket::ContentBody) {
+            QIODevice *body = sock->body;
+            // with an encoded body the Content-Length counts wire
+            // bytes while the body device holds the inflated entity
+            qint64 remaining = sock->contentLength
+                    - (sock->bodyInflate ? sock->bodyReceived : body->size());
+            char *scratch = postBuffer();
+            while (remaining > 0 && io->bytesAvailable() > 0) {
+                const int len = io->read(scratch, qMin(m_postBufferSize, remaining));
+                if (len == -1) {
+                    sock->connectionClose();
+                    return;
+                }
+//                qCDebug(CWSGI_HTTP) << "WRITE body" << sock->contentLength << remaining << len;
+                if (sock->bodyInflate) {
+                    if (!inflateBody(sock, scratch, len)) {
+                        qCWarning(CWSGI_HTTP) << "Failed to inflate request body";
+                        sock->connectionClose();
+                        return;
+                    }
+                    sock->bodyReceived += len;
+                } else {
+                    body->write(scratch, len);
+                }
+                remaining -= len;
+            }
+
+            if (remaining > 0) {
+                // need to wait for more data
                 return;
             }
-            bytesAvailable -= len;
-//            qCDebug(CWSGI_HTTP) << "WRITE body" << sock->contentLength << remaining << len << (remaining == len) << sock->bytesAvailable();
-            body->write(m_postBuffer, len);
-        } while (bytesAvailable);
 
-        if (remaining == len) {
-            processRequest(sock);
+            if (!processRequest(sock, io)) {
+                return;
+            }
+
+            // a pipelined request might follow the body
+            continue;
         }
 
-        return;
-    }
+        if (sock->buf_size == sock->buf_capacity && !sock->growBuffer(static_cast<quint32>(m_bufferSize))) {
+            // the request head exceeds the configured buffer-size,
+            // the check below already answered 431
+            return;
+        }
 
-    int len = io->read(sock->buffer + sock->buf_size, m_bufferSize - sock->buf_size);
-    if (len == -1) {
-        qCWarning(CWSGI_HTTP) << "Failed to read from socket" << io->errorString();
-        return;
-    }
-    sock->buf_size += len;
+        const int len = io->read(sock->buffer + sock->buf_size, sock->buf_capacity - sock->buf_size);
+        if (len <= 0) {
+            if (len == -1) {
+                qCWarning(CWSGI_HTTP) << "Failed to read from socket" << io->errorString();
+            }
+            return;
+        }
+        sock->buf_size += len;
+
+        // A TLS ClientHello sent to a plain listener can never become
+        // a request, close it before the parser chews on the binary
+        // record. 0x16 (handshake) never starts an HTTP method.
+        if (sock->connState == Socket::MethodLine && sock->last == 0 &&
+                !sock->isSecure && sock->buffer[0] == 0x16) {
+            sock->connectionClose();
+            return;
+        }
 
-    while (sock->last < sock->buf_size) {
-//        qCDebug(CWSGI_HTTP) << Q_FUNC_INFO << QByteArray(sock->buf, sock->buf_size);
-        int ix = CrLfIndexIn(sock->buffer, sock->buf_size, sock->last);
-        if (ix != -1) {
-            int len = ix - sock->beginLine;
-            char *ptr = sock->buffer + sock->beginLine;
-            sock->beginLine = ix + 2;
-            sock->last = sock->beginLine;
+        // Slow-header defense: a client trickling its request head a
+        // byte at a time refreshes the idle timeout with every byte,
+        // so the total time a request head may take is bounded too.
+        // The check rides on the client's own traffic, no timer.
+        if (sock->connState != Socket::ContentBody && sock->startOfRequest &&
+                sock->engine->time() > sock->startOfRequest + static_cast<quint64>(m_headerTimeout)) {
+            io->write("HTTP/1.1 408 Request Timeout\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            sock->connectionClose();
+            return;
+        }
 
-            if (sock->connState == Socket::MethodLine) {
-                if (!sock->startOfRequest) {
-                    sock->startOfRequest = sock->engine->time();
-                }
-                parseMethod(ptr, ptr + len, sock);
-                sock->connState = Socket::HeaderLine;
-                sock->contentLength = -1;
-                sock->headers = Cutelyst::Headers();
-//                qCDebug(CWSGI_HTTP) << "--------" << sock->method << sock->path << sock->query << sock->protocol;
-
-            } else if (sock->connState == Socket::HeaderLine) {
-                if (len) {
-                    parseHeader(ptr, ptr + len, sock);
-                } else {
-                    if (sock->contentLength != -1) {
-                        sock->connState = Socket::ContentBody;
-                        if (m_postBuffering && sock->contentLength > m_postBuffering) {
-                            auto temp = new QTemporaryFile;
-                            if (!temp->open()) {
-                                qCWarning(CWSGI_HTTP) << "Failed to open temporary file to store post" << temp->errorString();
-                                io->close(); // On error close immediately
+        while (sock->last < sock->buf_size) {
+//            qCDebug(CWSGI_HTTP) << Q_FUNC_INFO << QByteArray(sock->buf, sock->buf_size);
+            int ix = CrLfIndexIn(sock->buffer, sock->buf_size, sock->last);
+            if (ix != -1) {
+                int len = ix - sock->beginLine;
+                char *ptr = sock->buffer + sock->beginLine;
+                sock->beginLine = ix + 2;
+                sock->last = sock->beginLine;
+
+                if (sock->connState == Socket::MethodLine) {
+                    if (!sock->startOfRequest) {
+                        sock->startOfRequest = sock->engine->time();
+                    }
+                    if (!m_httpsRedirectPrefix.isEmpty() && !sock->isSecure) {
+                        sendHttpsRedirect(ptr, ptr + len, sock, io);
+                        return;
+                    }
+                    parseMethod(ptr, ptr + len, sock);
+                    sock->connState = Socket::HeaderLine;
+                    sock->contentLength = -1;
+                    sock->headerLines = 0;
+                    sock->headers = Cutelyst::Headers();
+//                    qCDebug(CWSGI_HTTP) << "--------" << sock->method << sock->path << sock->query << sock->protocol;
+
+                } else if (sock->connState == Socket::HeaderLine) {
+                    if (len) {
+                        if (++sock->headerLines > HTTP_MAX_HEADER_LINES) {
+                            io->write("HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                            sock->connectionClose();
+                            return;
+                        }
+                        parseHeader(ptr, ptr + len, sock);
+                    } else {
+                        if (sock->contentLength != -1) {
+                            if ((!m_bodyLimits.empty() || !m_bodyContentTypes.empty())
+                                    && !checkBodyLimits(sock, io)) {
                                 return;
                             }
-                            sock->body = temp;
-                        } else if (m_postBuffering && sock->contentLength <= m_postBuffering) {
-                            auto buffer = new QBuffer;
-                            buffer->open(QIODevice::ReadWrite);
-                            buffer->buffer().reserve(sock->contentLength);
-                            sock->body = buffer;
-                        } else {
-                            // Unbuffered
-                            auto buffer = new QBuffer;
-                            buffer->open(QIODevice::ReadWrite);
-                            buffer->buffer().reserve(sock->contentLength);
-                            sock->body = buffer;
-                        }
 
-                        ptr += 2;
-                        len = qMin(sock->contentLength, static_cast<qint64>(sock->buf_size - sock->last));
-//                        qCDebug(CWSGI_HTTP) << "WRITE" << sock->contentLength << len;
-                        if (len) {
-                            sock->body->write(ptr, len);
+                            sock->connState = Socket::ContentBody;
+
+                            // Content encoded bodies inflate past their
+                            // Content-Length, so size the device for what
+                            // this path produced on earlier requests
+                            // instead of growing into the real entity.
+                            qint64 expectedSize = sock->contentLength;
+                            if (!m_bodySizeHints.isEmpty() &&
+                                    sock->headers.contains(QStringLiteral("CONTENT_ENCODING"))) {
+                                expectedSize = qMax(expectedSize, m_bodySizeHints.value(sock->path));
+                            }
+
+                            if (m_postBuffering && expectedSize > m_postBuffering) {
+                                auto temp = qobject_cast<QTemporaryFile *>(sock->bodySpare);
+                                if (temp) {
+                                    // recycled spill file, already truncated
+                                    sock->bodySpare = nullptr;
+                                } else {
+                                    temp = new QTemporaryFile;
+                                    if (!temp->open()) {
+                                        qCWarning(CWSGI_HTTP) << "Failed to open temporary file to store post" << temp->errorString();
+                                        io->close(); // On error close immediately
+                                        return;
+                                    }
+                                }
+                                sock->body = temp;
+                            } else {
+                                // Buffered in memory or unbuffered
+                                auto buffer = qobject_cast<QBuffer *>(sock->bodySpare);
+                                if (buffer) {
+                                    sock->bodySpare = nullptr;
+                                } else {
+                                    buffer = new QBuffer;
+                                    buffer->open(QIODevice::ReadWrite);
+                                }
+                                buffer->buffer().reserve(expectedSize);
+                                sock->body = buffer;
+                            }
+
+                            setupBodyInflate(sock);
+
+                            ptr += 2;
+                            len = qMin(sock->contentLength, static_cast<qint64>(sock->buf_size - sock->last));
+//                            qCDebug(CWSGI_HTTP) << "WRITE" << sock->contentLength << len;
+                            if (len) {
+                                if (sock->bodyInflate) {
+                                    if (!inflateBody(sock, ptr, len)) {
+                                        qCWarning(CWSGI_HTTP) << "Failed to inflate request body";
+                                        sock->connectionClose();
+                                        return;
+                                    }
+                                    sock->bodyReceived += len;
+                                } else {
+                                    sock->body->write(ptr, len);
+                                }
+                            }
+                            sock->last += len;
+
+                            if (sock->contentLength > len) {
+//                                qCDebug(CWSGI_HTTP) << "WRITE more..." << sock->contentLength << len;
+                                // need to wait for more data
+                                break;
+                            }
                         }
-                        sock->last += len;
 
-                        if (sock->contentLength > len) {
-//                            qCDebug(CWSGI_HTTP) << "WRITE more..." << sock->contentLength << len;
-                            // need to wait for more data
+                        if (!processRequest(sock, io)) {
                             return;
                         }
                     }
-
-                    if (!processRequest(sock)) {
-                        break;
-                    }
                 }
+            } else {
+                if (!sock->startOfRequest) {
+                    sock->startOfRequest = sock->engine->time();
+                }
+                sock->last = sock->buf_size;
             }
-        } else {
-            if (!sock->startOfRequest) {
-                sock->startOfRequest = sock->engine->time();
-            }
-            sock->last = sock->buf_size;
         }
+
+        if (sock->connState != Socket::ContentBody && sock->buf_size == sock->buf_capacity
+                && sock->buf_capacity >= m_bufferSize) {
+            // a single header line filled the whole parse buffer
+            io->write("HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            sock->connectionClose();
+            return;
+        }
+    } while (io->bytesAvailable() > 0);
+}
+
+void ProtocolHttp::setupBodyInflate(Socket *sock) const
+{
+#ifdef CWSGI_HAVE_ZLIB
+    const QString encoding = sock->headers.header(Cutelyst::Keys::CONTENT_ENCODING);
+    int windowBits;
+    if (encoding.compare(QLatin1String("gzip"), Qt::CaseInsensitive) == 0) {
+        // 16 + 15 selects a gzip wrapper around deflate
+        windowBits = 16 + 15;
+    } else if (encoding.compare(QLatin1String("deflate"), Qt::CaseInsensitive) == 0) {
+        windowBits = 15;
+    } else {
+        return;
     }
 
-    if (sock->buf_size == m_bufferSize) {
-        // 414 Request-URI Too Long
+    z_stream *strm;
+    if (!m_inflatePool.empty()) {
+        strm = m_inflatePool.back();
+        m_inflatePool.pop_back();
+        if (inflateReset2(strm, windowBits) != Z_OK) {
+            inflateEnd(strm);
+            delete strm;
+            return;
+        }
+    } else {
+        strm = new z_stream();
+        if (inflateInit2(strm, windowBits) != Z_OK) {
+            delete strm;
+            return;
+        }
     }
+
+    sock->bodyInflate = strm;
+    sock->bodyReceived = 0;
+#else
+    Q_UNUSED(sock)
+#endif
 }
 
-bool ProtocolHttp::sendHeaders(QIODevice *io, Socket *sock, quint16 status, const QByteArray &dateHeader, const Cutelyst::Headers &headers)
+bool ProtocolHttp::inflateBody(Socket *sock, const char *data, qint64 len) const
 {
-    int msgLen;
-    const char *msg = CWsgiEngine::httpStatusMessage(status, &msgLen);
-    io->write(msg, msgLen);
+#ifdef CWSGI_HAVE_ZLIB
+    z_stream *strm = sock->bodyInflate;
+    // a 100:1 cap stops decompression bombs while leaving room for
+    // the ratios highly repetitive telemetry payloads reach
+    const qint64 limit = qMax(sock->contentLength * 100, qint64(16 * 1024 * 1024));
+
+    char out[16 * 1024];
+    strm->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    strm->avail_in = static_cast<uInt>(len);
+    do {
+        strm->next_out = reinterpret_cast<Bytef *>(out);
+        strm->avail_out = sizeof(out);
+
+        const int zRet = inflate(strm, Z_NO_FLUSH);
+        if (zRet != Z_OK && zRet != Z_STREAM_END && zRet != Z_BUF_ERROR) {
+            return false;
+        }
 
-    const auto headersData = headers.data();
-    Socket::HeaderConnection fallbackConnection = sock->headerConnection;
-    sock->headerConnection = Socket::HeaderConnectionNotSet;
+        const qint64 have = static_cast<qint64>(sizeof(out)) - strm->avail_out;
+        if (have) {
+            if (sock->body->size() + have > limit) {
+                return false;
+            }
+            sock->body->write(out, have);
+        }
+
+        if (zRet == Z_STREAM_END) {
+            break;
+        }
+    } while (strm->avail_out == 0);
+
+    return true;
+#else
+    Q_UNUSED(sock)
+    Q_UNUSED(data)
+    Q_UNUSED(len)
+    return false;
+#endif
+}
 
+void ProtocolHttp::finishBodyInflate(Socket *sock) const
+{
+#ifdef CWSGI_HAVE_ZLIB
+    if (m_inflatePool.size() < 4) {
+        m_inflatePool.push_back(sock->bodyInflate);
+    } else {
+        inflateEnd(sock->bodyInflate);
+        delete sock->bodyInflate;
+    }
+    sock->bodyInflate = nullptr;
+#else
+    Q_UNUSED(sock)
+#endif
+}
+
+namespace {
+// Serialized block for one (status, header shape) combination,
+// Content-Length and Date are appended per response.
+struct HeaderTemplate {
+    quint64 sig = 0;
+    std::vector<std::pair<QByteArray, QByteArray> > shape;
+    QByteArray block;
+    Socket::HeaderConnection connection = Socket::HeaderConnectionNotSet;
+};
+}
+
+bool ProtocolHttp::sendHeaders(QIODevice *io, Socket *sock, quint16 status, const QByteArray &dateHeader, const Cutelyst::Headers &headers)
+{
+    // Serialize the whole header block into one buffer so the
+    // device gets a single write instead of one per header.
+    static thread_local QByteArray headerBuffer = ([]() -> QByteArray {
+                                                       QByteArray ret;
+                                                       ret.reserve(1024);
+                                                       return ret;
+                                                   }());
+
+    // Most applications emit a handful of identical header shapes
+    // differing only in Content-Length and Date, cache the serialized
+    // block for those and only append the two variable fields.
+    static thread_local HeaderTemplate templates[8];
+
+    const auto headersData = headers.rawData();
+    const Socket::HeaderConnection fallbackConnection = sock->headerConnection;
+
+    QByteArray contentLength;
+    bool hasContentLength = false;
+    QByteArray date;
     bool hasDate = false;
+
+    quint64 sig = (quint64(status) * 4 + fallbackConnection) * Q_UINT64_C(1099511628211);
     auto it = headersData.constBegin();
     const auto endIt = headersData.constEnd();
     while (it != endIt) {
-        const QString key = it.key();
-        const QString value = it.value();
-        if (sock->headerConnection == Socket::HeaderConnectionNotSet && key == QLatin1String("CONNECTION")) {
-            if (value.compare(QLatin1String("close"), Qt::CaseInsensitive) == 0) {
-                sock->headerConnection = Socket::HeaderConnectionClose;
-            } else if (value.compare(QLatin1String("upgrade"), Qt::CaseInsensitive) == 0) {
-                sock->headerConnection = Socket::HeaderConnectionUpgrade;
-            } else {
-                sock->headerConnection = Socket::HeaderConnectionKeep;
-            }
-        } else if (!hasDate && key == QLatin1String("DATE")) {
+        const QByteArray &key = it.key();
+        if (key == "CONTENT_LENGTH") {
+            contentLength = it.value();
+            hasContentLength = true;
+        } else if (key == "DATE") {
+            date = it.value();
             hasDate = true;
+        } else {
+            sig = (sig ^ qHash(key)) * Q_UINT64_C(1099511628211);
+            sig = (sig ^ qHash(it.value())) * Q_UINT64_C(1099511628211);
         }
-
-        QString ret(QLatin1String("\r\n") + CWsgiEngine::camelCaseHeader(key) + QLatin1String(": ") + value);
-        io->write(ret.toLatin1());
-
         ++it;
     }
 
-    if (sock->headerConnection == Socket::HeaderConnectionNotSet) {
-        if (fallbackConnection == Socket::HeaderConnectionKeep) {
-            sock->headerConnection = Socket::HeaderConnectionKeep;
-            io->write("\r\nConnection: keep-alive", 24);
-        } else {
-            sock->headerConnection = Socket::HeaderConnectionClose;
-            io->write("\r\nConnection: close", 19);
+    HeaderTemplate &tmpl = templates[sig & 7];
+    bool hit = tmpl.sig == sig && !tmpl.block.isEmpty();
+    if (hit) {
+        // verify, a signature collision must not serve wrong headers
+        size_t i = 0;
+        it = headersData.constBegin();
+        while (it != endIt) {
+            const QByteArray &key = it.key();
+            if (key != "CONTENT_LENGTH" && key != "DATE") {
+                if (i >= tmpl.shape.size()
+                        || tmpl.shape[i].first != key
+                        || tmpl.shape[i].second != it.value()) {
+                    hit = false;
+                    break;
+                }
+                ++i;
+            }
+            ++it;
+        }
+        hit = hit && i == tmpl.shape.size();
+    }
+
+    if (!hit) {
+        int msgLen;
+        const char *msg = CWsgiEngine::httpStatusMessage(status, &msgLen);
+
+        QByteArray block;
+        block.reserve(256);
+        block.append(msg, msgLen);
+
+        tmpl.sig = sig;
+        tmpl.shape.clear();
+
+        Socket::HeaderConnection connection = Socket::HeaderConnectionNotSet;
+        it = headersData.constBegin();
+        while (it != endIt) {
+            QByteArray key = it.key();
+            const QByteArray value = it.value();
+            if (key == "CONTENT_LENGTH" || key == "DATE") {
+                ++it;
+                continue;
+            }
+
+            if (connection == Socket::HeaderConnectionNotSet && key == "CONNECTION") {
+                if (qstricmp(value.constData(), "close") == 0) {
+                    connection = Socket::HeaderConnectionClose;
+                } else if (qstricmp(value.constData(), "upgrade") == 0) {
+                    connection = Socket::HeaderConnectionUpgrade;
+                } else {
+                    connection = Socket::HeaderConnectionKeep;
+                }
+            }
+
+            tmpl.shape.push_back({ key, value });
+
+            CWsgiEngine::camelCaseByteArrayHeader(key);
+            block.append("\r\n", 2).append(key).append(": ", 2).append(value);
+
+            ++it;
+        }
+
+        if (connection == Socket::HeaderConnectionNotSet) {
+            if (fallbackConnection == Socket::HeaderConnectionKeep) {
+                connection = Socket::HeaderConnectionKeep;
+                block.append("\r\nConnection: keep-alive", 24);
+            } else {
+                connection = Socket::HeaderConnectionClose;
+                block.append("\r\nConnection: close", 19);
+            }
         }
+
+        tmpl.block = block;
+        tmpl.connection = connection;
     }
 
-    if (!hasDate) {
-        io->write(dateHeader);
+    sock->headerConnection = tmpl.connection;
+
+    headerBuffer.resize(0);
+    headerBuffer.append(tmpl.block);
+    if (hasContentLength) {
+        headerBuffer.append("\r\nContent-Length: ", 18).append(contentLength);
     }
+    if (hasDate) {
+        headerBuffer.append("\r\nDate: ", 8).append(date);
+    } else {
+        headerBuffer.append(dateHeader);
+    }
+    headerBuffer.append("\r\n\r\n", 4);
+
+    return io->write(headerBuffer) == headerBuffer.size();
+}
 
-    return io->write("\r\n\r\n", 4) == 4;
+void ProtocolHttp::recordBodySizeHint(Socket *sock) const
+{
+    const qint64 size = sock->body->size();
+    auto it = m_bodySizeHints.find(sock->path);
+    if (it == m_bodySizeHints.end()) {
+        // a table keyed by client supplied paths must stay bounded,
+        // forget everything rather than track an abusive client
+        if (m_bodySizeHints.size() >= 1024) {
+            m_bodySizeHints.clear();
+        }
+        m_bodySizeHints.insert(sock->path, size);
+    } else if (size > it.value()) {
+        it.value() = size;
+    } else {
+        // decay toward the smaller uploads so one outlier does not
+        // pin an oversized reservation on the path forever
+        it.value() -= (it.value() - size) / 8;
+    }
 }
 
-bool ProtocolHttp::processRequest(Socket *sock) const
+bool ProtocolHttp::processRequest(Socket *sock, QIODevice *io) const
 {
 //    qCDebug(CWSGI_HTTP) << "processRequest" << sock->contentLength;
+    if (!m_batchEndpoints.empty() && sock->dispatchDefers < HTTP_BATCH_MAX_DEFERS
+            && sock->last >= sock->buf_size && io->bytesAvailable() == 0) {
+        for (const QString &prefix : m_batchEndpoints) {
+            if (sock->path.startsWith(prefix)) {
+                // Two-class scheduling: park this dispatch for one
+                // pass of the event loop so interactive requests
+                // already readable on the worker's other connections
+                // run ahead of it; HTTP_BATCH_MAX_DEFERS bounds how
+                // long a batch request can be held back. Deferring
+                // only while nothing else is buffered keeps pipelined
+                // requests on this connection from being parked too.
+                ++sock->dispatchDefers;
+                sock->processing = true;
+                const quint32 generation = sock->dispatchGeneration;
+                QTimer::singleShot(0, io, [this, sock, io, generation] () {
+                    if (sock->dispatchGeneration != generation) {
+                        // recycled for another connection meanwhile
+                        return;
+                    }
+                    sock->processing = false;
+                    processRequest(sock, io);
+                });
+                return false;
+            }
+        }
+    }
+
+    if (sock->bodyInflate) {
+        finishBodyInflate(sock);
+        // the application sees the decompressed entity
+        sock->headers.setContentLength(sock->body->size());
+        sock->headers.removeHeader(Cutelyst::Keys::CONTENT_ENCODING);
+        recordBodySizeHint(sock);
+    }
+
+    if (m_maxRequestAge && sock->startOfRequest &&
+            sock->engine->time() > sock->startOfRequest + static_cast<quint64>(m_maxRequestAge)) {
+        // the client has been waiting since before the deadline,
+        // dispatching now would be dead work answered into the void
+        io->write("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        sock->connectionClose();
+        return false;
+    }
+
     sock->processing = true;
     if (sock->body) {
         sock->body->seek(0);
     }
 
     Cutelyst::Context *c = sock->engine->processSocket(sock);
+    if (!c) {
+        // An action called Context::detachAsync(), the response is
+        // finalized when it attaches back; keep the socket in the
+        // processing state so no pipelined data is parsed meanwhile
+        return false;
+    }
     sock->processing = false;
 
     if (sock->headerConnection == Socket::HeaderConnectionUpgrade) {
@@ -272,8 +697,6 @@ bool ProtocolHttp::processRequest(Socket *sock) const
         memmove(sock->buffer, sock->buffer + sock->last, remaining);
         sock->resetSocket();
         sock->buf_size = remaining;
-
-        QCoreApplication::processEvents();
     } else {
         sock->resetSocket();
     }
@@ -281,66 +704,263 @@ bool ProtocolHttp::processRequest(Socket *sock) const
     return true;
 }
 
+bool ProtocolHttp::checkBodyLimits(Socket *sock, QIODevice *io) const
+{
+    // The multi-megabyte garbage body an application would only read
+    // to reject is cheapest to refuse here, while all that exists of
+    // the request is its header block.
+    for (const auto &limit : m_bodyLimits) {
+        if (sock->path.startsWith(limit.first)) {
+            if (sock->contentLength > limit.second) {
+                io->write("HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                sock->connectionClose();
+                return false;
+            }
+            break;
+        }
+    }
+
+    for (const auto &allowed : m_bodyContentTypes) {
+        if (sock->path.startsWith(allowed.first)) {
+            const QString contentType = sock->headers.header(Cutelyst::Keys::CONTENT_TYPE);
+            bool matched = false;
+            for (const QString &type : allowed.second) {
+                if (contentType.startsWith(type, Qt::CaseInsensitive)) {
+                    matched = true;
+                    break;
+                }
+            }
+            if (!matched) {
+                io->write("HTTP/1.1 415 Unsupported Media Type\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                sock->connectionClose();
+                return false;
+            }
+            break;
+        }
+    }
+
+    return true;
+}
+
+void ProtocolHttp::sendHttpsRedirect(const char *ptr, const char *end, Socket *sock, QIODevice *io) const
+{
+    // The whole response is the precomputed status and Location base
+    // plus the request target copied from between the two spaces of
+    // the request line; nothing else of the request is parsed.
+    const char *target = static_cast<const char *>(memchr(ptr, ' ', end - ptr));
+    const char *targetEnd = nullptr;
+    if (target) {
+        while (target < end && *target == ' ') {
+            ++target;
+        }
+        targetEnd = static_cast<const char *>(memchr(target, ' ', end - target));
+        if (!targetEnd) {
+            targetEnd = end;
+        }
+    }
+
+    static thread_local QByteArray response;
+    response.resize(0);
+    response.reserve(m_httpsRedirectPrefix.size() + 64);
+    response.append(m_httpsRedirectPrefix);
+    if (target && target < targetEnd && *target == '/') {
+        response.append(target, targetEnd - target);
+    } else {
+        // absolute-form or malformed targets land on the root
+        response.append('/');
+    }
+    response.append("\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", 42);
+
+    io->write(response);
+    sock->connectionClose();
+}
+
+// The method and protocol tokens of real traffic come from a fixed
+// handful of values, so hand out shared copies of literal strings:
+// assigning one is free (literals carry an immortal reference count)
+// where QString::fromLatin1 allocates. In a heap profile these two
+// are among the most allocated strings after the header values.
+// Unknown tokens still materialize normally.
+static QString internedToken(const char *ptr, int len)
+{
+    switch (len) {
+    case 3:
+        if (!memcmp(ptr, "GET", 3)) return Cutelyst::Keys::GET;
+        if (!memcmp(ptr, "PUT", 3)) return QStringLiteral("PUT");
+        break;
+    case 4:
+        if (!memcmp(ptr, "POST", 4)) return Cutelyst::Keys::POST;
+        if (!memcmp(ptr, "HEAD", 4)) return Cutelyst::Keys::HEAD;
+        break;
+    case 5:
+        if (!memcmp(ptr, "PATCH", 5)) return QStringLiteral("PATCH");
+        if (!memcmp(ptr, "TRACE", 5)) return QStringLiteral("TRACE");
+        break;
+    case 6:
+        if (!memcmp(ptr, "DELETE", 6)) return QStringLiteral("DELETE");
+        break;
+    case 7:
+        if (!memcmp(ptr, "OPTIONS", 7)) return QStringLiteral("OPTIONS");
+        if (!memcmp(ptr, "CONNECT", 7)) return QStringLiteral("CONNECT");
+        break;
+    case 8:
+        if (!memcmp(ptr, "HTTP/1.1", 8)) return QStringLiteral("HTTP/1.1");
+        if (!memcmp(ptr, "HTTP/1.0", 8)) return QStringLiteral("HTTP/1.0");
+        break;
+    }
+    return QString::fromLatin1(ptr, len);
+}
+
 void ProtocolHttp::parseMethod(const char *ptr, const char *end, Socket *sock) const
 {
-    const char *word_boundary = ptr;
-    while (*word_boundary != ' ' && word_boundary < end) {
-        ++word_boundary;
+    // Like CrLfIndexIn we let the vectorized libc memchr scan for the
+    // word delimiters instead of walking the line per character.
+    const char *word_boundary = static_cast<const char *>(memchr(ptr, ' ', end - ptr));
+    if (!word_boundary) {
+        word_boundary = end;
     }
-    sock->method = QString::fromLatin1(ptr, word_boundary - ptr);
+    sock->method = internedToken(ptr, word_boundary - ptr);
 
     // skip spaces
-    while (*word_boundary == ' ' && word_boundary < end) {
-        ++word_boundary;
-    }
     ptr = word_boundary;
+    while (ptr < end && *ptr == ' ') {
+        ++ptr;
+    }
 
     // skip leading slashes
-    while (*ptr == '/' && ptr <= end) {
+    while (ptr < end && *ptr == '/') {
         ++ptr;
     }
 
     // find path end
-    while (*word_boundary != ' ' && *word_boundary != '?' && word_boundary < end) {
-        ++word_boundary;
+    word_boundary = static_cast<const char *>(memchr(ptr, ' ', end - ptr));
+    if (!word_boundary) {
+        word_boundary = end;
     }
-    sock->path = QString::fromLatin1(ptr, word_boundary - ptr);
+    const char *query = static_cast<const char *>(memchr(ptr, '?', word_boundary - ptr));
+    const char *path_end = query ? query : word_boundary;
+    sock->path = QString::fromLatin1(ptr, path_end - ptr);
 
-    if (*word_boundary == '?') {
-        ptr = word_boundary + 1;
-        while (*word_boundary != ' ' && word_boundary < end) {
-            ++word_boundary;
-        }
-        sock->query = QByteArray(ptr, word_boundary - ptr);
+    if (query) {
+        sock->query = QByteArray(query + 1, word_boundary - query - 1);
     } else {
         sock->query = QByteArray();
     }
 
     // skip spaces
-    while (*word_boundary == ' ' && word_boundary < end) {
-        ++word_boundary;
-    }
     ptr = word_boundary;
+    while (ptr < end && *ptr == ' ') {
+        ++ptr;
+    }
 
-    while (*word_boundary != ' ' && word_boundary < end) {
-        ++word_boundary;
+    word_boundary = static_cast<const char *>(memchr(ptr, ' ', end - ptr));
+    if (!word_boundary) {
+        word_boundary = end;
     }
-    sock->protocol = QString::fromLatin1(ptr, word_boundary - ptr);
+    sock->protocol = internedToken(ptr, word_boundary - ptr);
 }
 
 
-inline QString normalizeHeaderKey(const char *str, int size)
+inline bool headerKeyMatches(const char *str, const char *normalized, int size)
 {
+    for (int i = 0; i < size; ++i) {
+        char c = str[i];
+        if (c == '-') {
+            c = '_';
+        } else if (c >= 'a' && c <= 'z') {
+            c -= ('a' - 'A');
+        }
+        if (c != normalized[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Maps the most common header names straight to interned
+// normalized keys, so that filling the Headers hash does not
+// allocate a new key per header. Dispatched on the name length
+// first so at most a few candidates are compared.
+inline QByteArray knownHeaderKey(const char *str, int size)
+{
+    switch (size) {
+    case 3:
+        if (headerKeyMatches(str, "DNT", 3)) return QByteArrayLiteral("DNT");
+        break;
+    case 4:
+        if (headerKeyMatches(str, "HOST", 4)) return QByteArrayLiteral("HOST");
+        if (headerKeyMatches(str, "DATE", 4)) return QByteArrayLiteral("DATE");
+        break;
+    case 5:
+        if (headerKeyMatches(str, "RANGE", 5)) return QByteArrayLiteral("RANGE");
+        break;
+    case 6:
+        if (headerKeyMatches(str, "ACCEPT", 6)) return QByteArrayLiteral("ACCEPT");
+        if (headerKeyMatches(str, "COOKIE", 6)) return QByteArrayLiteral("COOKIE");
+        if (headerKeyMatches(str, "ORIGIN", 6)) return QByteArrayLiteral("ORIGIN");
+        if (headerKeyMatches(str, "PRAGMA", 6)) return QByteArrayLiteral("PRAGMA");
+        if (headerKeyMatches(str, "EXPECT", 6)) return QByteArrayLiteral("EXPECT");
+        break;
+    case 7:
+        if (headerKeyMatches(str, "REFERER", 7)) return QByteArrayLiteral("REFERER");
+        if (headerKeyMatches(str, "UPGRADE", 7)) return QByteArrayLiteral("UPGRADE");
+        break;
+    case 10:
+        if (headerKeyMatches(str, "CONNECTION", 10)) return QByteArrayLiteral("CONNECTION");
+        if (headerKeyMatches(str, "USER_AGENT", 10)) return QByteArrayLiteral("USER_AGENT");
+        break;
+    case 12:
+        if (headerKeyMatches(str, "CONTENT_TYPE", 12)) return QByteArrayLiteral("CONTENT_TYPE");
+        break;
+    case 13:
+        if (headerKeyMatches(str, "AUTHORIZATION", 13)) return QByteArrayLiteral("AUTHORIZATION");
+        if (headerKeyMatches(str, "CACHE_CONTROL", 13)) return QByteArrayLiteral("CACHE_CONTROL");
+        if (headerKeyMatches(str, "IF_NONE_MATCH", 13)) return QByteArrayLiteral("IF_NONE_MATCH");
+        break;
+    case 14:
+        if (headerKeyMatches(str, "CONTENT_LENGTH", 14)) return QByteArrayLiteral("CONTENT_LENGTH");
+        if (headerKeyMatches(str, "ACCEPT_CHARSET", 14)) return QByteArrayLiteral("ACCEPT_CHARSET");
+        break;
+    case 15:
+        if (headerKeyMatches(str, "ACCEPT_ENCODING", 15)) return QByteArrayLiteral("ACCEPT_ENCODING");
+        if (headerKeyMatches(str, "ACCEPT_LANGUAGE", 15)) return QByteArrayLiteral("ACCEPT_LANGUAGE");
+        if (headerKeyMatches(str, "X_FORWARDED_FOR", 15)) return QByteArrayLiteral("X_FORWARDED_FOR");
+        break;
+    case 16:
+        if (headerKeyMatches(str, "X_REQUESTED_WITH", 16)) return QByteArrayLiteral("X_REQUESTED_WITH");
+        break;
+    case 17:
+        if (headerKeyMatches(str, "IF_MODIFIED_SINCE", 17)) return QByteArrayLiteral("IF_MODIFIED_SINCE");
+        if (headerKeyMatches(str, "SEC_WEBSOCKET_KEY", 17)) return QByteArrayLiteral("SEC_WEBSOCKET_KEY");
+        if (headerKeyMatches(str, "X_FORWARDED_PROTO", 17)) return QByteArrayLiteral("X_FORWARDED_PROTO");
+        break;
+    case 21:
+        if (headerKeyMatches(str, "SEC_WEBSOCKET_VERSION", 21)) return QByteArrayLiteral("SEC_WEBSOCKET_VERSION");
+        break;
+    case 22:
+        if (headerKeyMatches(str, "SEC_WEBSOCKET_PROTOCOL", 22)) return QByteArrayLiteral("SEC_WEBSOCKET_PROTOCOL");
+        break;
+    default:
+        break;
+    }
+    return QByteArray();
+}
+
+inline QByteArray normalizeHeaderKey(const char *str, int size)
+{
+    QByteArray key = knownHeaderKey(str, size);
+    if (!key.isNull()) {
+        return key;
+    }
+
     int i = 0;
-    QString key = QString::fromLatin1(str, size);
+    key = QByteArray(str, size);
     while (i < key.size()) {
-        QCharRef c = key[i];
-        if (c.isLetter()) {
-            if (c.isLower()) {
-                c = c.toUpper();
-            }
-        } else if (c == QLatin1Char('-')) {
-            c = QLatin1Char('_');
+        char c = key.at(i);
+        if (c >= 'a' && c <= 'z') {
+            key[i] = c - ('a' - 'A');
+        } else if (c == '-') {
+            key[i] = '_';
         }
         ++i;
     }
@@ -349,31 +969,31 @@ inline QString normalizeHeaderKey(const char *str, int size)
 
 void ProtocolHttp::parseHeader(const char *ptr, const char *end, Socket *sock) const
 {
-    const char *word_boundary = ptr;
-    while (*word_boundary != ':' && word_boundary < end) {
-        ++word_boundary;
+    const char *word_boundary = static_cast<const char *>(memchr(ptr, ':', end - ptr));
+    if (!word_boundary) {
+        word_boundary = end;
     }
-    const QString key = normalizeHeaderKey(ptr, word_boundary - ptr);
+    const QByteArray key = normalizeHeaderKey(ptr, word_boundary - ptr);
 
-    while ((*word_boundary == ':' || *word_boundary == ' ') && word_boundary < end) {
+    while (word_boundary < end && (*word_boundary == ':' || *word_boundary == ' ')) {
         ++word_boundary;
     }
-    const QString value = QString::fromLatin1(word_boundary, end - word_boundary);
+    const QByteArray value(word_boundary, end - word_boundary);
 
-    if (sock->headerConnection == Socket::HeaderConnectionNotSet && key == QLatin1String("CONNECTION")) {
-        if (value.compare(QLatin1String("close"), Qt::CaseInsensitive) == 0) {
+    if (sock->headerConnection == Socket::HeaderConnectionNotSet && key == "CONNECTION") {
+        if (qstricmp(value.constData(), "close") == 0) {
             sock->headerConnection = Socket::HeaderConnectionClose;
         } else {
             sock->headerConnection = Socket::HeaderConnectionKeep;
         }
-    } else if (sock->contentLength < 0 && key == QLatin1String("CONTENT_LENGTH")) {
+    } else if (sock->contentLength < 0 && key == "CONTENT_LENGTH") {
         bool ok;
         qint64 cl = value.toLongLong(&ok);
         if (ok && cl >= 0) {
             sock->contentLength = cl;
         }
-    } else if (!sock->headerHost && key == QLatin1String("HOST")) {
-        sock->serverAddress = value;
+    } else if (!sock->headerHost && key == "HOST") {
+        sock->serverAddress = QString::fromLatin1(value);
         sock->headerHost = true;
     }
     sock->headers.pushRawHeader(key, value);
@@ -20,9 +20,14 @@
 #define PROTOCOLHTTP_H
 
 #include <QObject>
+#include <QHash>
 
 #include "protocol.h"
 
+#include <vector>
+
+struct z_stream_s;
+
 namespace CWSGI {
 
 class WSGI;
@@ -40,11 +45,34 @@ public:
     virtual bool sendHeaders(QIODevice *io, CWSGI::Socket *sock, quint16 status, const QByteArray &dateHeader, const Cutelyst::Headers &headers) override;
 
 private:
-    inline bool processRequest(Socket *sock) const;
+    inline bool processRequest(Socket *sock, QIODevice *io) const;
+    bool checkBodyLimits(Socket *sock, QIODevice *io) const;
+    void sendHttpsRedirect(const char *ptr, const char *end, Socket *sock, QIODevice *io) const;
     inline void parseMethod(const char *ptr, const char *end, Socket *sock) const;
     inline void parseHeader(const char *ptr, const char *end, Socket *sock) const;
 
+    void setupBodyInflate(Socket *sock) const;
+    bool inflateBody(Socket *sock, const char *data, qint64 len) const;
+    void finishBodyInflate(Socket *sock) const;
+    void recordBodySizeHint(Socket *sock) const;
+
     ProtocolWebSocket *m_websocketProto;
+    // precomputed "301 ... Location: <base>" head when this listener
+    // only redirects to HTTPS, see WSGI::httpsRedirect()
+    QByteArray m_httpsRedirectPrefix;
+    // per path-prefix body gates checked before the body is buffered,
+    // longest prefix first; see WSGI::bodyLimit()
+    std::vector<std::pair<QString, qint64> > m_bodyLimits;
+    std::vector<std::pair<QString, QStringList> > m_bodyContentTypes;
+    // path prefixes whose dispatch yields to the worker's ready
+    // interactive traffic first; see WSGI::batchEndpoint()
+    std::vector<QString> m_batchEndpoints;
+    // idle inflate streams recycled across requests on this worker
+    mutable std::vector<struct z_stream_s *> m_inflatePool;
+    // learned decompressed body size per request path: for content
+    // encoded uploads Content-Length only counts compressed bytes,
+    // the hint sizes the body device for the real entity
+    mutable QHash<QString, qint64> m_bodySizeHints;
 };
 
 }
@@ -0,0 +1,722 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "protocolhttp2.h"
+#include "socket.h"
+#include "wsgi.h"
+
+#include <Cutelyst/Context>
+
+#include <QIODevice>
+#include <QBuffer>
+#include <QLoggingCategory>
+
+#include <utility>
+
+using namespace CWSGI;
+
+Q_LOGGING_CATEGORY(CWSGI_HTTP2, "cwsgi.http2")
+
+enum FrameType {
+    FrameData         = 0x0,
+    FrameHeaders      = 0x1,
+    FramePriority     = 0x2,
+    FrameRstStream    = 0x3,
+    FrameSettings     = 0x4,
+    FramePushPromise  = 0x5,
+    FramePing         = 0x6,
+    FrameGoaway       = 0x7,
+    FrameWindowUpdate = 0x8,
+    FrameContinuation = 0x9
+};
+
+enum FrameFlag {
+    FlagAck        = 0x1, // SETTINGS and PING
+    FlagEndStream  = 0x1, // DATA and HEADERS
+    FlagEndHeaders = 0x4,
+    FlagPadded     = 0x8,
+    FlagPriority   = 0x20
+};
+
+enum ErrorCode {
+    ErrorNone            = 0x0,
+    ErrorProtocol        = 0x1,
+    ErrorInternal        = 0x2,
+    ErrorFlowControl     = 0x3,
+    ErrorStreamClosed    = 0x5,
+    ErrorFrameSize       = 0x6,
+    ErrorCompression     = 0x9,
+    ErrorEnhanceYourCalm = 0xb
+};
+
+// SETTINGS_MAX_FRAME_SIZE stays at the protocol default, a larger
+// value only grows the parse buffer without helping throughput
+static const quint32 maxFrameSize = 16384;
+
+Http2Connection::~Http2Connection()
+{
+    auto it = streams.constBegin();
+    while (it != streams.constEnd()) {
+        delete it.value()->body;
+        delete it.value();
+        ++it;
+    }
+}
+
+ProtocolHttp2::ProtocolHttp2(WSGI *wsgi) : Protocol(wsgi)
+{
+    // a full frame plus its 9 byte header must fit in the buffer
+    m_h2BufferSize = qMax(m_bufferSize, static_cast<qint64>(maxFrameSize + 9));
+}
+
+ProtocolHttp2::~ProtocolHttp2()
+{
+}
+
+Protocol::Type ProtocolHttp2::type() const
+{
+    return Http2;
+}
+
+static inline bool writeFrame(QIODevice *io, quint8 type, quint8 flags, quint32 streamId, const char *data, quint32 len)
+{
+    quint8 frameHeader[9];
+    frameHeader[0] = quint8(len >> 16);
+    frameHeader[1] = quint8(len >> 8);
+    frameHeader[2] = quint8(len);
+    frameHeader[3] = type;
+    frameHeader[4] = flags;
+    frameHeader[5] = quint8(streamId >> 24) & 0x7f;
+    frameHeader[6] = quint8(streamId >> 16);
+    frameHeader[7] = quint8(streamId >> 8);
+    frameHeader[8] = quint8(streamId);
+
+    if (io->write(reinterpret_cast<const char *>(frameHeader), 9) != 9) {
+        return false;
+    }
+    return !len || io->write(data, len) == len;
+}
+
+static inline void writeWindowUpdate(QIODevice *io, quint32 streamId, quint32 increment)
+{
+    quint8 payload[4];
+    payload[0] = quint8(increment >> 24) & 0x7f;
+    payload[1] = quint8(increment >> 16);
+    payload[2] = quint8(increment >> 8);
+    payload[3] = quint8(increment);
+    writeFrame(io, FrameWindowUpdate, 0, streamId, reinterpret_cast<const char *>(payload), 4);
+}
+
+bool ProtocolHttp2::connectionError(Socket *sock, QIODevice *io, quint32 errorCode) const
+{
+    quint8 payload[8];
+    const quint32 lastStreamId = sock->h2 ? sock->h2->lastStreamId : 0;
+    payload[0] = quint8(lastStreamId >> 24) & 0x7f;
+    payload[1] = quint8(lastStreamId >> 16);
+    payload[2] = quint8(lastStreamId >> 8);
+    payload[3] = quint8(lastStreamId);
+    payload[4] = quint8(errorCode >> 24);
+    payload[5] = quint8(errorCode >> 16);
+    payload[6] = quint8(errorCode >> 8);
+    payload[7] = quint8(errorCode);
+    writeFrame(io, FrameGoaway, 0, 0, reinterpret_cast<const char *>(payload), 8);
+    sock->connectionClose();
+    return false;
+}
+
+void ProtocolHttp2::readyRead(Socket *sock, QIODevice *io) const
+{
+    auto h2 = sock->h2;
+    if (!h2) {
+        h2 = sock->h2 = new Http2Connection;
+        // an empty SETTINGS frame opens our side, the defaults apply
+        writeFrame(io, FrameSettings, 0, 0, nullptr, 0);
+    }
+
+    do {
+        if (sock->buf_size == sock->buf_capacity &&
+                !sock->growBuffer(static_cast<quint32>(m_h2BufferSize))) {
+            // can not happen for frames within the announced limit,
+            // the oversized ones error out below before filling up
+            connectionError(sock, io, ErrorFrameSize);
+            return;
+        }
+
+        const int len = io->read(sock->buffer + sock->buf_size, sock->buf_capacity - sock->buf_size);
+        if (len <= 0) {
+            if (len == -1) {
+                qCWarning(CWSGI_HTTP2) << "Failed to read from socket" << io->errorString();
+            }
+            return;
+        }
+        sock->buf_size += len;
+
+        quint32 pos = 0;
+
+        if (!h2->prefaceSeen) {
+            if (sock->buf_size < 24) {
+                continue;
+            }
+            if (memcmp(sock->buffer, "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24) != 0) {
+                connectionError(sock, io, ErrorProtocol);
+                return;
+            }
+            h2->prefaceSeen = true;
+            pos = 24;
+        }
+
+        while (sock->buf_size - pos >= 9) {
+            const quint8 *p = reinterpret_cast<const quint8 *>(sock->buffer) + pos;
+            const quint32 frameLen = (quint32(p[0]) << 16) | (quint32(p[1]) << 8) | p[2];
+            const quint8 frameType = p[3];
+            const quint8 flags = p[4];
+            const quint32 streamId = (quint32(p[5] & 0x7f) << 24) | (quint32(p[6]) << 16) |
+                    (quint32(p[7]) << 8) | p[8];
+
+            if (frameLen > maxFrameSize) {
+                connectionError(sock, io, ErrorFrameSize);
+                return;
+            }
+            if (sock->buf_size - pos - 9 < frameLen) {
+                break;
+            }
+
+            if (!processFrame(sock, io, frameType, flags, streamId, p + 9, frameLen)) {
+                return;
+            }
+            pos += 9 + frameLen;
+        }
+
+        if (pos) {
+            if (pos < sock->buf_size) {
+                memmove(sock->buffer, sock->buffer + pos, sock->buf_size - pos);
+            }
+            sock->buf_size -= pos;
+        }
+    } while (io->bytesAvailable());
+}
+
+bool ProtocolHttp2::processFrame(Socket *sock, QIODevice *io, quint8 frameType, quint8 flags, quint32 streamId, const quint8 *payload, quint32 length) const
+{
+    auto h2 = sock->h2;
+    switch (frameType) {
+    case FrameData:
+        return processData(sock, io, flags, streamId, payload, length);
+    case FrameHeaders:
+        return processHeaders(sock, io, flags, streamId, payload, length);
+    case FrameContinuation:
+    {
+        if (streamId == 0 || streamId != h2->continuationStreamId) {
+            return connectionError(sock, io, ErrorProtocol);
+        }
+        h2->headerFragments.append(reinterpret_cast<const char *>(payload), length);
+        if (flags & FlagEndHeaders) {
+            h2->continuationStreamId = 0;
+            return headerBlockDone(sock, io, h2->streams.value(streamId), h2->continuationEndStream);
+        }
+        return true;
+    }
+    case FrameSettings:
+        if (streamId != 0) {
+            return connectionError(sock, io, ErrorProtocol);
+        }
+        return processSettings(sock, io, flags, payload, length);
+    case FrameWindowUpdate:
+    {
+        if (length != 4) {
+            return connectionError(sock, io, ErrorFrameSize);
+        }
+        const quint32 increment = (quint32(payload[0] & 0x7f) << 24) | (quint32(payload[1]) << 16) |
+                (quint32(payload[2]) << 8) | payload[3];
+        if (increment == 0) {
+            return connectionError(sock, io, ErrorProtocol);
+        }
+        if (streamId == 0) {
+            h2->sendWindow += increment;
+            const auto streams = h2->streams.values();
+            for (H2Stream *stream : streams) {
+                flushStream(io, h2, stream);
+            }
+        } else {
+            H2Stream *stream = h2->streams.value(streamId);
+            if (stream) {
+                stream->sendWindow += qint32(increment);
+                flushStream(io, h2, stream);
+            }
+        }
+        return true;
+    }
+    case FramePing:
+        if (length != 8) {
+            return connectionError(sock, io, ErrorFrameSize);
+        }
+        if (!(flags & FlagAck)) {
+            writeFrame(io, FramePing, FlagAck, 0, reinterpret_cast<const char *>(payload), 8);
+        }
+        return true;
+    case FrameRstStream:
+    {
+        if (length != 4 || streamId == 0) {
+            return connectionError(sock, io, ErrorFrameSize);
+        }
+        H2Stream *stream = h2->streams.take(streamId);
+        if (stream) {
+            delete stream->body;
+            delete stream;
+        }
+        if (h2->continuationStreamId == streamId) {
+            h2->continuationStreamId = 0;
+            h2->headerFragments.clear();
+        }
+        return true;
+    }
+    case FramePriority:
+        if (length != 5) {
+            return connectionError(sock, io, ErrorFrameSize);
+        }
+        return true;
+    case FrameGoaway:
+        h2->goneAway = true;
+        return true;
+    case FramePushPromise:
+        // clients must not push
+        return connectionError(sock, io, ErrorProtocol);
+    default:
+        // unknown frame types are ignored by design
+        return true;
+    }
+}
+
+bool ProtocolHttp2::processSettings(Socket *sock, QIODevice *io, quint8 flags, const quint8 *payload, quint32 length) const
+{
+    auto h2 = sock->h2;
+    if (flags & FlagAck) {
+        return length == 0 || connectionError(sock, io, ErrorFrameSize);
+    }
+    if (length % 6) {
+        return connectionError(sock, io, ErrorFrameSize);
+    }
+
+    for (quint32 i = 0; i < length; i += 6) {
+        const quint16 identifier = quint16(payload[i] << 8) | payload[i + 1];
+        const quint32 value = (quint32(payload[i + 2]) << 24) | (quint32(payload[i + 3]) << 16) |
+                (quint32(payload[i + 4]) << 8) | payload[i + 5];
+        switch (identifier) {
+        case 0x4: // SETTINGS_INITIAL_WINDOW_SIZE
+        {
+            if (value > 0x7fffffff) {
+                return connectionError(sock, io, ErrorFlowControl);
+            }
+            const qint64 delta = qint64(value) - h2->peerInitialWindowSize;
+            h2->peerInitialWindowSize = qint32(value);
+            const auto streams = h2->streams.values();
+            for (H2Stream *stream : streams) {
+                stream->sendWindow += delta;
+                flushStream(io, h2, stream);
+            }
+            break;
+        }
+        case 0x5: // SETTINGS_MAX_FRAME_SIZE
+            if (value < 16384 || value > 16777215) {
+                return connectionError(sock, io, ErrorProtocol);
+            }
+            h2->peerMaxFrameSize = value;
+            break;
+        default:
+            // header table size only matters for an indexing encoder,
+            // push is never used and concurrency is not limited here
+            break;
+        }
+    }
+
+    writeFrame(io, FrameSettings, FlagAck, 0, nullptr, 0);
+    return true;
+}
+
+bool ProtocolHttp2::processHeaders(Socket *sock, QIODevice *io, quint8 flags, quint32 streamId, const quint8 *payload, quint32 length) const
+{
+    auto h2 = sock->h2;
+    if (streamId == 0 || !(streamId & 1) || h2->continuationStreamId) {
+        return connectionError(sock, io, ErrorProtocol);
+    }
+
+    const quint8 *it = payload;
+    const quint8 *end = payload + length;
+    quint8 padLength = 0;
+    if (flags & FlagPadded) {
+        if (it >= end) {
+            return connectionError(sock, io, ErrorProtocol);
+        }
+        padLength = *it++;
+    }
+    if (flags & FlagPriority) {
+        if (end - it < 5) {
+            return connectionError(sock, io, ErrorFrameSize);
+        }
+        it += 5;
+    }
+    if (padLength > end - it) {
+        return connectionError(sock, io, ErrorProtocol);
+    }
+    end -= padLength;
+
+    H2Stream *stream = h2->streams.value(streamId);
+    if (!stream && !h2->goneAway && streamId > h2->lastStreamId) {
+        stream = new H2Stream;
+        stream->id = streamId;
+        stream->sendWindow = h2->peerInitialWindowSize;
+        stream->startOfRequest = sock->engine->time();
+        h2->streams.insert(streamId, stream);
+        h2->lastStreamId = streamId;
+    }
+
+    h2->headerFragments = QByteArray(reinterpret_cast<const char *>(it), end - it);
+    if (flags & FlagEndHeaders) {
+        return headerBlockDone(sock, io, stream, flags & FlagEndStream);
+    }
+
+    h2->continuationStreamId = streamId;
+    h2->continuationEndStream = flags & FlagEndStream;
+    return true;
+}
+
+static inline QByteArray normalizedHeaderKey(const QByteArray &name)
+{
+    QByteArray key = name;
+    for (int i = 0; i < key.size(); ++i) {
+        const char c = key.at(i);
+        if (c >= 'a' && c <= 'z') {
+            key[i] = c - ('a' - 'A');
+        } else if (c == '-') {
+            key[i] = '_';
+        }
+    }
+    return key;
+}
+
+bool ProtocolHttp2::headerBlockDone(Socket *sock, QIODevice *io, H2Stream *stream, bool endStream) const
+{
+    auto h2 = sock->h2;
+    const QByteArray block = h2->headerFragments;
+    h2->headerFragments.clear();
+
+    HPack::HeaderList list;
+    const quint8 *it = reinterpret_cast<const quint8 *>(block.constData());
+    if (!h2->hpack.decode(it, it + block.size(), list)) {
+        return connectionError(sock, io, ErrorCompression);
+    }
+
+    if (!stream) {
+        // a reset or finished stream, the block still had to feed
+        // the connection wide HPACK table above
+        return true;
+    }
+
+    if (!stream->headersDone) {
+        QByteArray cookies;
+        for (const auto &header : list) {
+            const QByteArray &name = header.first;
+            const QByteArray &value = header.second;
+            if (name.startsWith(':')) {
+                if (name == ":method") {
+                    stream->method = QString::fromLatin1(value);
+                } else if (name == ":path") {
+                    const int query = value.indexOf('?');
+                    int path = 0;
+                    while (path < value.size() && value.at(path) == '/') {
+                        ++path;
+                    }
+                    if (query != -1) {
+                        stream->path = QString::fromLatin1(value.constData() + path, query - path);
+                        stream->query = value.mid(query + 1);
+                    } else {
+                        stream->path = QString::fromLatin1(value.constData() + path, value.size() - path);
+                    }
+                } else if (name == ":authority") {
+                    stream->authority = QString::fromLatin1(value);
+                } else if (name == ":scheme") {
+                    stream->scheme = QString::fromLatin1(value);
+                }
+                continue;
+            }
+
+            if (name == "cookie") {
+                // RFC 7540 section 8.1.2.5, cookies may arrive split
+                // into several fields and are joined back
+                if (!cookies.isEmpty()) {
+                    cookies.append("; ", 2);
+                }
+                cookies.append(value);
+                continue;
+            }
+
+            const QByteArray key = normalizedHeaderKey(name);
+            if (stream->contentLength < 0 && key == "CONTENT_LENGTH") {
+                bool ok;
+                const qint64 cl = value.toLongLong(&ok);
+                if (ok && cl >= 0) {
+                    stream->contentLength = cl;
+                }
+            }
+            stream->headers.pushRawHeader(key, value);
+        }
+
+        if (!cookies.isEmpty()) {
+            stream->headers.pushRawHeader(QByteArrayLiteral("COOKIE"), cookies);
+        }
+        if (!stream->authority.isEmpty()) {
+            stream->headers.pushRawHeader(QByteArrayLiteral("HOST"), stream->authority.toLatin1());
+        }
+        stream->headersDone = true;
+
+        if (stream->method.isEmpty() || stream->path.isNull()) {
+            return connectionError(sock, io, ErrorProtocol);
+        }
+    }
+    // trailers only feed the HPACK table, nothing maps them into the
+    // request once the handler may already have run
+
+    if (endStream) {
+        dispatchStream(sock, io, stream);
+    }
+    return true;
+}
+
+bool ProtocolHttp2::processData(Socket *sock, QIODevice *io, quint8 flags, quint32 streamId, const quint8 *payload, quint32 length) const
+{
+    auto h2 = sock->h2;
+    if (streamId == 0) {
+        return connectionError(sock, io, ErrorProtocol);
+    }
+
+    // the whole payload counts against flow control, padding included
+    if (length) {
+        writeWindowUpdate(io, 0, length);
+    }
+
+    H2Stream *stream = h2->streams.value(streamId);
+    if (!stream || !stream->headersDone) {
+        // a closed or never opened stream, the bytes are accounted
+        // for above and otherwise dropped
+        return true;
+    }
+
+    const quint8 *it = payload;
+    const quint8 *end = payload + length;
+    quint8 padLength = 0;
+    if (flags & FlagPadded) {
+        if (it >= end) {
+            return connectionError(sock, io, ErrorProtocol);
+        }
+        padLength = *it++;
+    }
+    if (padLength > end - it) {
+        return connectionError(sock, io, ErrorProtocol);
+    }
+    end -= padLength;
+
+    if (it < end) {
+        if (!stream->body) {
+            auto buffer = new QBuffer;
+            buffer->open(QIODevice::ReadWrite);
+            if (stream->contentLength > 0) {
+                buffer->buffer().reserve(static_cast<int>(stream->contentLength));
+            }
+            stream->body = buffer;
+        }
+        stream->body->write(reinterpret_cast<const char *>(it), end - it);
+    }
+
+    if (flags & FlagEndStream) {
+        dispatchStream(sock, io, stream);
+    } else if (length) {
+        writeWindowUpdate(io, streamId, length);
+    }
+    return true;
+}
+
+void ProtocolHttp2::dispatchStream(Socket *sock, QIODevice *io, H2Stream *stream) const
+{
+    auto h2 = sock->h2;
+
+    sock->stream_id = stream->id;
+    // the stream is done with its request payload once dispatched
+    sock->method = std::move(stream->method);
+    sock->path = std::move(stream->path);
+    sock->query = std::move(stream->query);
+    sock->protocol = QStringLiteral("HTTP/2");
+    sock->headers = std::move(stream->headers);
+    sock->contentLength = stream->contentLength;
+    sock->startOfRequest = stream->startOfRequest;
+    if (!stream->authority.isEmpty()) {
+        sock->serverAddress = stream->authority;
+    }
+    if (stream->body) {
+        stream->body->seek(0);
+    }
+    sock->body = stream->body;
+
+    sock->processing = true;
+    Cutelyst::Context *c = sock->engine->processSocket(sock);
+    sock->processing = false;
+    sock->body = nullptr;
+    if (!c) {
+        // Context::detachAsync() holds the response back, the stream
+        // is finalized whenever it attaches again
+        return;
+    }
+    delete c;
+
+    if (!stream->responseEnded) {
+        if (stream->sendBuffer.isEmpty()) {
+            writeFrame(io, FrameData, FlagEndStream, stream->id, nullptr, 0);
+            stream->responseEnded = true;
+        } else {
+            stream->endAfterDrain = true;
+        }
+    }
+
+    delete stream->body;
+    stream->body = nullptr;
+
+    if (stream->responseEnded) {
+        h2->streams.remove(stream->id);
+        delete stream;
+    }
+}
+
+bool ProtocolHttp2::sendHeaders(QIODevice *io, Socket *sock, quint16 status, const QByteArray &dateHeader, const Cutelyst::Headers &headers)
+{
+    auto h2 = sock->h2;
+    if (!h2) {
+        return false;
+    }
+    H2Stream *stream = h2->streams.value(static_cast<quint32>(sock->stream_id));
+    if (!stream) {
+        return false;
+    }
+
+    QByteArray block;
+    block.reserve(256);
+    HPack::encodeStatus(block, status);
+    // the shared date arrives formatted for HTTP/1.1 as "\r\nDate: value"
+    HPack::encodeHeader(block, QByteArrayLiteral("date"), dateHeader.mid(8));
+
+    const auto headersData = headers.rawData();
+    auto it = headersData.constBegin();
+    const auto endIt = headersData.constEnd();
+    while (it != endIt) {
+        const QByteArray &key = it.key();
+        // connection oriented headers have no meaning on a stream
+        if (key == "DATE" || key == "CONNECTION" || key == "KEEP_ALIVE" ||
+                key == "TRANSFER_ENCODING" || key == "UPGRADE") {
+            ++it;
+            continue;
+        }
+
+        QByteArray name = key;
+        for (int i = 0; i < name.size(); ++i) {
+            const char c = name.at(i);
+            if (c >= 'A' && c <= 'Z') {
+                name[i] = c + ('a' - 'A');
+            } else if (c == '_') {
+                name[i] = '-';
+            }
+        }
+        HPack::encodeHeader(block, name, it.value());
+        ++it;
+    }
+
+    // header blocks beyond the peer's frame size continue in
+    // CONTINUATION frames, flow control does not apply to them
+    quint32 offset = 0;
+    const quint32 blockSize = static_cast<quint32>(block.size());
+    do {
+        const quint32 chunk = qMin(blockSize - offset, h2->peerMaxFrameSize);
+        const bool last = offset + chunk == blockSize;
+        const quint8 type = offset ? FrameContinuation : FrameHeaders;
+        if (!writeFrame(io, type, last ? FlagEndHeaders : 0, stream->id, block.constData() + offset, chunk)) {
+            return false;
+        }
+        offset += chunk;
+    } while (offset < blockSize);
+
+    return true;
+}
+
+qint64 ProtocolHttp2::sendBody(QIODevice *io, Socket *sock, const char *data, qint64 len)
+{
+    auto h2 = sock->h2;
+    if (!h2) {
+        return -1;
+    }
+    H2Stream *stream = h2->streams.value(static_cast<quint32>(sock->stream_id));
+    if (!stream || stream->responseEnded) {
+        return -1;
+    }
+
+    if (!stream->sendBuffer.isEmpty()) {
+        // already waiting on the peer's window, keep the order
+        stream->sendBuffer.append(data, static_cast<int>(len));
+        return len;
+    }
+
+    qint64 offset = 0;
+    while (offset < len) {
+        const qint64 window = qMin(h2->sendWindow, static_cast<qint64>(stream->sendWindow));
+        const qint64 chunk = qMin(qMin(len - offset, static_cast<qint64>(h2->peerMaxFrameSize)), window);
+        if (chunk <= 0) {
+            // the peer's flow control window is exhausted, the rest
+            // drains on WINDOW_UPDATE
+            stream->sendBuffer.append(data + offset, static_cast<int>(len - offset));
+            return len;
+        }
+        if (!writeFrame(io, FrameData, 0, stream->id, data + offset, static_cast<quint32>(chunk))) {
+            return -1;
+        }
+        h2->sendWindow -= chunk;
+        stream->sendWindow -= qint32(chunk);
+        offset += chunk;
+    }
+    return len;
+}
+
+void ProtocolHttp2::flushStream(QIODevice *io, Http2Connection *h2, H2Stream *stream) const
+{
+    while (!stream->sendBuffer.isEmpty()) {
+        const qint64 window = qMin(h2->sendWindow, static_cast<qint64>(stream->sendWindow));
+        const qint64 chunk = qMin(qMin(static_cast<qint64>(stream->sendBuffer.size()),
+                                       static_cast<qint64>(h2->peerMaxFrameSize)), window);
+        if (chunk <= 0) {
+            return;
+        }
+        if (!writeFrame(io, FrameData, 0, stream->id, stream->sendBuffer.constData(), static_cast<quint32>(chunk))) {
+            return;
+        }
+        h2->sendWindow -= chunk;
+        stream->sendWindow -= qint32(chunk);
+        stream->sendBuffer.remove(0, static_cast<int>(chunk));
+    }
+
+    if (stream->endAfterDrain && !stream->responseEnded) {
+        writeFrame(io, FrameData, FlagEndStream, stream->id, nullptr, 0);
+        stream->responseEnded = true;
+        h2->streams.remove(stream->id);
+        delete stream;
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef PROTOCOLHTTP2_H
+#define PROTOCOLHTTP2_H
+
+#include <QObject>
+
+#include "protocol.h"
+#include "hpack.h"
+
+#include <Cutelyst/Headers>
+
+class QBuffer;
+
+namespace CWSGI {
+
+class WSGI;
+class Socket;
+
+/**
+ * One client initiated stream. Requests are dispatched one at a
+ * time when their last frame arrives, multiplexing removes the
+ * head-of-line wait on the request side of the connection.
+ */
+struct H2Stream {
+    QString method;
+    QString path;
+    QString scheme;
+    QString authority;
+    QByteArray query;
+    Cutelyst::Headers headers;
+    // response bytes the peer's flow control window could not take
+    // yet, drained on WINDOW_UPDATE
+    QByteArray sendBuffer;
+    QBuffer *body = nullptr;
+    qint64 contentLength = -1;
+    quint64 startOfRequest = 0;
+    qint32 sendWindow = 65535;
+    quint32 id = 0;
+    bool headersDone = false;
+    bool responseEnded = false;
+    bool endAfterDrain = false;
+};
+
+/**
+ * Connection state of one HTTP/2 socket, owned by the Socket and
+ * freed when the connection goes away.
+ */
+class Http2Connection
+{
+public:
+    ~Http2Connection();
+
+    HPack hpack;
+    QHash<quint32, H2Stream *> streams;
+    QByteArray headerFragments;
+    quint32 continuationStreamId = 0;
+    quint32 lastStreamId = 0;
+    quint32 peerMaxFrameSize = 16384;
+    qint32 peerInitialWindowSize = 65535;
+    qint64 sendWindow = 65535;
+    bool prefaceSeen = false;
+    bool goneAway = false;
+    bool continuationEndStream = false;
+};
+
+class ProtocolHttp2 : public Protocol
+{
+public:
+    ProtocolHttp2(WSGI *wsgi);
+    ~ProtocolHttp2();
+
+    virtual Type type() const override;
+
+    virtual void readyRead(Socket *sock, QIODevice *io) const override;
+    virtual bool sendHeaders(QIODevice *io, Socket *sock, quint16 status, const QByteArray &dateHeader, const Cutelyst::Headers &headers) override;
+    virtual qint64 sendBody(QIODevice *io, Socket *sock, const char *data, qint64 len) override;
+
+private:
+    // returns false when the connection was terminated
+    inline bool processFrame(Socket *sock, QIODevice *io, quint8 frameType, quint8 flags, quint32 streamId, const quint8 *payload, quint32 length) const;
+    inline bool processHeaders(Socket *sock, QIODevice *io, quint8 flags, quint32 streamId, const quint8 *payload, quint32 length) const;
+    inline bool processData(Socket *sock, QIODevice *io, quint8 flags, quint32 streamId, const quint8 *payload, quint32 length) const;
+    inline bool processSettings(Socket *sock, QIODevice *io, quint8 flags, const quint8 *payload, quint32 length) const;
+    inline bool headerBlockDone(Socket *sock, QIODevice *io, H2Stream *stream, bool endStream) const;
+    inline void dispatchStream(Socket *sock, QIODevice *io, H2Stream *stream) const;
+    inline void flushStream(QIODevice *io, Http2Connection *h2, H2Stream *stream) const;
+    bool connectionError(Socket *sock, QIODevice *io, quint32 errorCode) const;
+
+    qint64 m_h2BufferSize;
+};
+
+}
+
+#endif // PROTOCOLHTTP2_H
@@ -29,10 +29,29 @@
 
 #include <QTextCodec>
 
+#ifdef CWSGI_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 using namespace CWSGI;
 
 Q_LOGGING_CATEGORY(CWSGI_WS, "cwsgi.websocket")
 
+// Tiny frames at high rates make the per-frame allocation cost more
+// than the unmasking itself, so the per-socket assembly buffers keep
+// their capacity between frames. Past the retention bound the buffer
+// is released, so one large message does not pin its peak forever.
+static const int WebSocketScratchRetain = 64 * 1024;
+
+static inline void ws_release_scratch(QByteArray &buf)
+{
+    if (buf.capacity() > WebSocketScratchRetain) {
+        buf = QByteArray();
+    } else {
+        buf.resize(0);
+    }
+}
+
 ProtocolWebSocket::ProtocolWebSocket(CWSGI::WSGI *wsgi) : Protocol(wsgi)
   , m_codec(QTextCodec::codecForName(QByteArrayLiteral("UTF-8")))
 {
@@ -45,34 +64,35 @@ ProtocolWebSocket::~ProtocolWebSocket()
 
 QByteArray ProtocolWebSocket::createWebsocketHeader(quint8 opcode, quint64 len)
 {
-    QByteArray ret;
-    ret.append(0x80 + opcode);
+    char buf[WebSocketMaxHeaderSize];
+    return QByteArray(buf, createWebsocketHeader(opcode, len, buf));
+}
+
+quint32 ProtocolWebSocket::createWebsocketHeader(quint8 opcode, quint64 len, char *buf)
+{
+    quint8 *ptr = reinterpret_cast<quint8 *>(buf);
+    ptr[0] = 0x80 + opcode;
 
     if (len < 126) {
-        ret.append(static_cast<quint8>(len));
+        ptr[1] = (quint8) len;
+        return 2;
     } else if (len <= static_cast<quint16>(0xffff)) {
-        ret.append(126);
-
-        quint8 buf[2];
-        buf[1] = (quint8) (len & 0xff);
-        buf[0] = (quint8) ((len >> 8) & 0xff);
-        ret.append(reinterpret_cast<char*>(buf), 2);
+        ptr[1] = 126;
+        ptr[2] = (quint8) ((len >> 8) & 0xff);
+        ptr[3] = (quint8) (len & 0xff);
+        return 4;
     } else {
-        ret.append(127);
-
-        quint8 buf[8];
-        buf[7] = (quint8) (len & 0xff);
-        buf[6] = (quint8) ((len >> 8) & 0xff);
-        buf[5] = (quint8) ((len >> 16) & 0xff);
-        buf[4] = (quint8) ((len >> 24) & 0xff);
-        buf[3] = (quint8) ((len >> 32) & 0xff);
-        buf[2] = (quint8) ((len >> 40) & 0xff);
-        buf[1] = (quint8) ((len >> 48) & 0xff);
-        buf[0] = (quint8) ((len >> 56) & 0xff);
-        ret.append(reinterpret_cast<char*>(buf), 8);
+        ptr[1] = 127;
+        ptr[2] = (quint8) ((len >> 56) & 0xff);
+        ptr[3] = (quint8) ((len >> 48) & 0xff);
+        ptr[4] = (quint8) ((len >> 40) & 0xff);
+        ptr[5] = (quint8) ((len >> 32) & 0xff);
+        ptr[6] = (quint8) ((len >> 24) & 0xff);
+        ptr[7] = (quint8) ((len >> 16) & 0xff);
+        ptr[8] = (quint8) ((len >> 8) & 0xff);
+        ptr[9] = (quint8) (len & 0xff);
+        return WebSocketMaxHeaderSize;
     }
-
-    return ret;
 }
 
 QByteArray ProtocolWebSocket::createWebsocketCloseReply(const QString &msg, quint16 closeCode)
@@ -121,6 +141,11 @@ quint64 ws_be64(const char *buf) {
 void ProtocolWebSocket::readyRead(Socket *sock, QIODevice *io) const
 {
     qint64 bytesAvailable = io->bytesAvailable();
+    char *scratch = postBuffer();
+
+    // any traffic proves the peer alive, the engine heartbeat only
+    // closes connections that stay silent after being pinged
+    sock->websocket_pong_pending = false;
 
     Q_FOREVER {
         if (!bytesAvailable || !sock->websocket_need || (bytesAvailable < sock->websocket_need && sock->websocket_phase != Socket::WebSocketPhasePayload)) {
@@ -129,7 +154,7 @@ void ProtocolWebSocket::readyRead(Socket *sock, QIODevice *io) const
         }
 
         quint32 maxlen = qMin(sock->websocket_need, static_cast<quint32>(m_postBufferSize));
-        qint64 len = io->read(m_postBuffer, maxlen);
+        qint64 len = io->read(scratch, maxlen);
         if (len == -1) {
             qCWarning(CWSGI_WS) << "Failed to read from socket" << io->errorString();
             sock->connectionClose();
@@ -139,20 +164,20 @@ void ProtocolWebSocket::readyRead(Socket *sock, QIODevice *io) const
 
         switch(sock->websocket_phase) {
         case Socket::WebSocketPhaseHeaders:
-            if (!websocket_parse_header(sock, m_postBuffer, io)) {
+            if (!websocket_parse_header(sock, scratch, io)) {
                 return;
             }
             break;
         case Socket::WebSocketPhaseSize:
-            if (!websocket_parse_size(sock, m_postBuffer, m_websockets_max_size)) {
+            if (!websocket_parse_size(sock, scratch, m_websockets_max_size)) {
                 return;
             }
             break;
         case Socket::WebSocketPhaseMask:
-            websocket_parse_mask(sock, m_postBuffer, io);
+            websocket_parse_mask(sock, scratch, io);
             break;
         case Socket::WebSocketPhasePayload:
-            if (!websocket_parse_payload(sock, m_postBuffer, len, io)) {
+            if (!websocket_parse_payload(sock, scratch, len, io)) {
                 return;
             }
             break;
@@ -175,6 +200,37 @@ bool ProtocolWebSocket::send_text(Cutelyst::Context *c, Socket *sock, bool singl
 {
     Cutelyst::Request *request = c->request();
 
+#ifdef CWSGI_HAVE_ZLIB
+    if (sock->websocket_message_deflated) {
+        // Compressed messages can only be delivered once the whole
+        // deflate block arrived, so no per-frame signal is emitted
+        sock->websocket_message.append(sock->websocket_payload);
+        if (!(sock->websocket_finn_opcode & 0x80)) {
+            return true;
+        }
+
+        QByteArray inflated;
+        if (!websocket_inflate_message(sock, inflated)) {
+            sock->connectionClose();
+            return false;
+        }
+
+        QTextCodec::ConverterState state;
+        const QString msg = m_codec->toUnicode(inflated.data(), inflated.size(), &state);
+        if (state.invalidChars || state.remainingChars) {
+            sock->connectionClose();
+            return false;
+        }
+
+        request->webSocketTextFrame(msg, true, sock->websocketContext);
+        request->webSocketTextMessage(msg, sock->websocketContext);
+        sock->websocket_continue_opcode = 0;
+        ws_release_scratch(sock->websocket_message);
+        ws_release_scratch(sock->websocket_payload);
+        return true;
+    }
+#endif
+
     const int msg_size = sock->websocket_message.size();
     sock->websocket_message.append(sock->websocket_payload);
 
@@ -212,8 +268,8 @@ bool ProtocolWebSocket::send_text(Cutelyst::Context *c, Socket *sock, bool singl
             request->webSocketTextMessage(msg,
                                           sock->websocketContext);
         }
-        sock->websocket_message = QByteArray();
-        sock->websocket_payload = QByteArray();
+        ws_release_scratch(sock->websocket_message);
+        ws_release_scratch(sock->websocket_payload);
     }
 
     return true;
@@ -223,6 +279,28 @@ void ProtocolWebSocket::send_binary(Cutelyst::Context *c, Socket *sock, bool sin
 {
     Cutelyst::Request *request = c->request();
 
+#ifdef CWSGI_HAVE_ZLIB
+    if (sock->websocket_message_deflated) {
+        sock->websocket_message.append(sock->websocket_payload);
+        if (!(sock->websocket_finn_opcode & 0x80)) {
+            return;
+        }
+
+        QByteArray inflated;
+        if (!websocket_inflate_message(sock, inflated)) {
+            sock->connectionClose();
+            return;
+        }
+
+        request->webSocketBinaryFrame(inflated, true, sock->websocketContext);
+        request->webSocketBinaryMessage(inflated, sock->websocketContext);
+        sock->websocket_continue_opcode = 0;
+        ws_release_scratch(sock->websocket_message);
+        ws_release_scratch(sock->websocket_payload);
+        return;
+    }
+#endif
+
     sock->websocket_message.append(sock->websocket_payload);
 
     const QByteArray frame = sock->websocket_payload;
@@ -239,11 +317,71 @@ void ProtocolWebSocket::send_binary(Cutelyst::Context *c, Socket *sock, bool sin
             request->webSocketBinaryMessage(sock->websocket_message,
                                             sock->websocketContext);
         }
-        sock->websocket_message = QByteArray();
-        sock->websocket_payload = QByteArray();
+        ws_release_scratch(sock->websocket_message);
+        ws_release_scratch(sock->websocket_payload);
     }
 }
 
+#ifdef CWSGI_HAVE_ZLIB
+QByteArray ProtocolWebSocket::websocketDeflatePayload(Socket *sock, const QByteArray &payload)
+{
+    QByteArray ret;
+    z_stream *strm = sock->websocket_deflate;
+    strm->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(payload.constData()));
+    strm->avail_in = payload.size();
+
+    char buf[16 * 1024];
+    do {
+        strm->next_out = reinterpret_cast<Bytef *>(buf);
+        strm->avail_out = sizeof(buf);
+        int res = deflate(strm, Z_SYNC_FLUSH);
+        if (res != Z_OK && res != Z_BUF_ERROR) {
+            qCWarning(CWSGI_WS) << "Failed to deflate websocket message" << res;
+            return QByteArray();
+        }
+        ret.append(buf, sizeof(buf) - strm->avail_out);
+    } while (strm->avail_out == 0);
+
+    // Z_SYNC_FLUSH ends the data with an empty uncompressed block,
+    // RFC 7692 requires its 00 00 ff ff tail to be stripped
+    if (ret.size() < 4) {
+        return QByteArray();
+    }
+    ret.chop(4);
+
+    return ret;
+}
+
+bool ProtocolWebSocket::websocket_inflate_message(Socket *sock, QByteArray &inflated) const
+{
+    z_stream *strm = sock->websocket_inflate;
+    QByteArray in = sock->websocket_message;
+    in.append("\x00\x00\xff\xff", 4);
+    strm->next_in = reinterpret_cast<Bytef *>(in.data());
+    strm->avail_in = in.size();
+
+    char buf[16 * 1024];
+    do {
+        strm->next_out = reinterpret_cast<Bytef *>(buf);
+        strm->avail_out = sizeof(buf);
+        int res = inflate(strm, Z_SYNC_FLUSH);
+        if (res != Z_OK && res != Z_BUF_ERROR) {
+            qCWarning(CWSGI_WS) << "Failed to inflate websocket message" << res;
+            return false;
+        }
+        inflated.append(buf, sizeof(buf) - strm->avail_out);
+
+        if (inflated.size() > static_cast<int>(m_websockets_max_size)) {
+            qCWarning(CWSGI_WS) << "Inflated payload size too big" << inflated.size()
+                                << "max allowed" << m_websockets_max_size;
+            return false;
+        }
+    } while (strm->avail_out == 0);
+
+    return strm->avail_in == 0;
+}
+#endif // CWSGI_HAVE_ZLIB
+
 void ProtocolWebSocket::send_pong(QIODevice *io, const QByteArray data) const
 {
     io->write(ProtocolWebSocket::createWebsocketHeader(Socket::OpCodePong, data.size()));
@@ -310,10 +448,19 @@ bool ProtocolWebSocket::websocket_parse_header(Socket *sock, const char *buf, QI
 
     quint8 opcode = byte1 & 0xf;
 
+    quint8 rsv = byte1 & 0x70;
+#ifdef CWSGI_HAVE_ZLIB
+    if (sock->websocket_deflate_enabled && (rsv & 0x40)
+            && (opcode == Socket::OpCodeText || opcode == Socket::OpCodeBinary)) {
+        // RSV1 marks the start of a permessage-deflate compressed message
+        rsv &= ~0x40;
+    }
+#endif
+
     bool websocket_has_mask = byte2 >> 7;
     if (!websocket_has_mask ||
             ((opcode == Socket::OpCodePing || opcode == Socket::OpCodeClose) && sock->websocket_payload_size > 125) ||
-            (byte1 & 0x70) ||
+            rsv ||
             ((opcode >= Socket::OpCodeReserved3 && opcode <= Socket::OpCodeReserved7) ||
              (opcode >= Socket::OpCodeReservedB && opcode <= Socket::OpCodeReservedF)) ||
             (!(byte1 & 0x80) && opcode != Socket::OpCodeText && opcode != Socket::OpCodeBinary && opcode != Socket::OpCodeContinue) ||
@@ -332,9 +479,12 @@ bool ProtocolWebSocket::websocket_parse_header(Socket *sock, const char *buf, QI
         return false;
     }
 
+    CUTELYST_PROBE2(ws_frame_received, opcode, sock->websocket_payload_size);
+
     if (opcode == Socket::OpCodeText || opcode == Socket::OpCodeBinary) {
-        sock->websocket_message = QByteArray();
+        ws_release_scratch(sock->websocket_message);
         sock->websocket_start_of_frame = 0;
+        sock->websocket_message_deflated = sock->websocket_deflate_enabled && (byte1 & 0x40);
         if (!(byte1 & 0x80)) {
             // FINN byte not set, store opcode for continue
             sock->websocket_continue_opcode = opcode;
@@ -389,11 +539,18 @@ void ProtocolWebSocket::websocket_parse_mask(Socket *sock, char *buf, QIODevice
     sock->websocket_phase = Socket::WebSocketPhasePayload;
     sock->websocket_need = sock->websocket_payload_size;
 
-    sock->websocket_payload = QByteArray();
+    // reuse the payload scratch from the previous frame; growth in
+    // powers of two keeps a stream of slightly growing frames from
+    // reallocating on every one
+    sock->websocket_payload.resize(0);
     if (sock->websocket_payload_size == 0) {
         websocket_parse_payload(sock, buf, 0, io);
-    } else {
-        sock->websocket_payload.reserve(sock->websocket_payload_size);
+    } else if (sock->websocket_payload.capacity() < int(sock->websocket_payload_size)) {
+        int cap = 256;
+        while (cap < int(sock->websocket_payload_size)) {
+            cap *= 2;
+        }
+        sock->websocket_payload.reserve(cap);
     }
 }
 
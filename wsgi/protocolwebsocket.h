@@ -32,9 +32,21 @@ public:
     ProtocolWebSocket(WSGI *wsgi);
     ~ProtocolWebSocket();
 
+    // Biggest frame header: 2 bytes + 8 bytes of extended payload length
+    enum { WebSocketMaxHeaderSize = 10 };
+
     static QByteArray createWebsocketHeader(quint8 opcode, quint64 len);
+    // Writes the frame header into buf, which must have room for
+    // WebSocketMaxHeaderSize bytes, and returns the header size
+    static quint32 createWebsocketHeader(quint8 opcode, quint64 len, char *buf);
     static QByteArray createWebsocketCloseReply(const QString &msg, quint16 closeCode);
 
+#ifdef CWSGI_HAVE_ZLIB
+    // Compresses a message payload with the connection's deflate stream,
+    // the RFC 7692 00 00 ff ff tail already stripped; empty on error
+    static QByteArray websocketDeflatePayload(Socket *sock, const QByteArray &payload);
+#endif
+
     virtual void readyRead(Socket *sock, QIODevice *io) const override;
     virtual bool sendHeaders(QIODevice *io, Socket *sock, quint16 status, const QByteArray &dateHeader, const Cutelyst::Headers &headers) override;
 
@@ -47,6 +59,9 @@ private:
     bool websocket_parse_size(Socket *sock, const char *buf, int websockets_max_message_size) const;
     void websocket_parse_mask(Socket *sock, char *buf, QIODevice *io) const;
     bool websocket_parse_payload(Socket *sock, char *buf, uint len, QIODevice *io) const;
+#ifdef CWSGI_HAVE_ZLIB
+    bool websocket_inflate_message(Socket *sock, QByteArray &inflated) const;
+#endif
 
     QTextCodec *m_codec;
     quint32 m_websockets_max_size;
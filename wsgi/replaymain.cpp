@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "requestshadow.h"
+#include "config.h"
+
+#include <Cutelyst/Application>
+#include <Cutelyst/Context>
+#include <Cutelyst/Engine>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QPluginLoader>
+#include <QBuffer>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QThread>
+
+#include <iostream>
+
+using namespace Cutelyst;
+
+namespace {
+
+/**
+ * Engine that runs captured requests through the application and
+ * discards the response bytes, the tool measures the application,
+ * not a client connection.
+ */
+class ReplayEngine : public Engine
+{
+public:
+    ReplayEngine(Application *app, const QVariantMap &opts) : Engine(app, 0, opts) { }
+
+    virtual int workerId() const override { return 0; }
+
+    virtual bool init() override {
+        return initApplication() && postForkApplication();
+    }
+
+    void replay(const EngineRequest &req) {
+        delete processRequest2(req);
+    }
+
+    QMap<quint16, int> statuses;
+    qint64 bytesWritten = 0;
+
+protected:
+    virtual bool finalizeHeadersWrite(Context *c, quint16 status, const Headers &headers, void *engineData) override {
+        Q_UNUSED(c)
+        Q_UNUSED(headers)
+        Q_UNUSED(engineData)
+        ++statuses[status];
+        return true;
+    }
+
+    virtual qint64 doWrite(Context *c, const char *data, qint64 len, void *engineData) override {
+        Q_UNUSED(c)
+        Q_UNUSED(data)
+        Q_UNUSED(engineData)
+        bytesWritten += len;
+        return len;
+    }
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("cutelyst-wsgi-replay"));
+    QCoreApplication::setApplicationVersion(QStringLiteral(VERSION));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QCoreApplication::translate("main", "Replays a cutelyst-wsgi --shadow capture through an application at a controlled rate"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption applicationOpt({ QStringLiteral("application"), QStringLiteral("a") },
+                                      QCoreApplication::translate("main", "application to load"),
+                                      QCoreApplication::translate("main", "file"));
+    parser.addOption(applicationOpt);
+
+    QCommandLineOption captureOpt({ QStringLiteral("capture"), QStringLiteral("c") },
+                                  QCoreApplication::translate("main", "capture file written by --shadow"),
+                                  QCoreApplication::translate("main", "file"));
+    parser.addOption(captureOpt);
+
+    QCommandLineOption rateOpt(QStringLiteral("rate"),
+                               QCoreApplication::translate("main", "requests per second, 0 replays unpaced"),
+                               QCoreApplication::translate("main", "requests"),
+                               QStringLiteral("100"));
+    parser.addOption(rateOpt);
+
+    QCommandLineOption countOpt(QStringLiteral("count"),
+                                QCoreApplication::translate("main", "stop after this many requests, 0 replays the whole capture"),
+                                QCoreApplication::translate("main", "requests"),
+                                QStringLiteral("0"));
+    parser.addOption(countOpt);
+
+    parser.process(app);
+
+    if (!parser.isSet(applicationOpt) || !parser.isSet(captureOpt)) {
+        parser.showHelp(1);
+    }
+
+    bool ok;
+    const int rate = parser.value(rateOpt).toInt(&ok);
+    if (!ok || rate < 0) {
+        parser.showHelp(1);
+    }
+
+    const int count = parser.value(countOpt).toInt(&ok);
+    if (!ok || count < 0) {
+        parser.showHelp(1);
+    }
+
+    QPluginLoader loader(parser.value(applicationOpt));
+    if (!loader.load()) {
+        std::cerr << "Could not load application: " << loader.errorString().toLatin1().constData() << std::endl;
+        return 1;
+    }
+
+    auto localApp = qobject_cast<Application *>(loader.instance());
+    if (!localApp) {
+        std::cerr << "Could not cast Cutelyst::Application from instance: " << loader.errorString().toLatin1().constData() << std::endl;
+        return 1;
+    }
+
+    QFile capture(parser.value(captureOpt));
+    if (!capture.open(QIODevice::ReadOnly)) {
+        std::cerr << "Could not open capture: " << capture.errorString().toLatin1().constData() << std::endl;
+        return 1;
+    }
+
+    QDataStream in(&capture);
+    if (!CWSGI::RequestShadow::readFileHeader(in)) {
+        std::cerr << "Not a cutelyst-wsgi shadow capture: " << capture.fileName().toLatin1().constData() << std::endl;
+        return 1;
+    }
+
+    ReplayEngine engine(localApp, QVariantMap());
+    if (!engine.init()) {
+        std::cerr << "Failed to init application" << std::endl;
+        return 1;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+
+    int done = 0;
+    EngineRequest req;
+    QByteArray body;
+    while ((count == 0 || done < count) &&
+           CWSGI::RequestShadow::readRecord(in, &req, &body)) {
+        if (rate) {
+            // pace against the wall clock, a slow request makes the
+            // following ones catch up instead of stretching the run
+            const qint64 ahead = (qint64(done) * 1000) / rate - clock.elapsed();
+            if (ahead > 0) {
+                QThread::msleep(ahead);
+            }
+        }
+
+        QBuffer bodyDevice(&body);
+        bodyDevice.open(QIODevice::ReadOnly);
+        req.body = &bodyDevice;
+        req.startOfRequest = quint64(QDateTime::currentMSecsSinceEpoch());
+
+        engine.replay(req);
+        ++done;
+
+        // let deleteLater and timers run between requests as they
+        // would between real ones
+        QCoreApplication::processEvents();
+    }
+
+    const qint64 elapsed = qMax(clock.elapsed(), Q_INT64_C(1));
+    std::cout << "Replayed " << done << " requests in " << elapsed << " ms ("
+              << (qint64(done) * 1000) / elapsed << " req/s), wrote "
+              << engine.bytesWritten << " body bytes" << std::endl;
+    auto it = engine.statuses.constBegin();
+    while (it != engine.statuses.constEnd()) {
+        std::cout << "  status " << it.key() << ": " << it.value() << std::endl;
+        ++it;
+    }
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "requestshadow.h"
+
+#include <Cutelyst/Engine>
+
+#include <QDataStream>
+#include <QFile>
+#include <QTimer>
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(CWSGI_SHADOW, "cwsgi.shadow")
+
+using namespace CWSGI;
+
+#define SHADOW_MAGIC quint32(0x43534844) // "CSHD"
+#define SHADOW_VERSION quint16(1)
+
+// bodies above this size are truncated in the capture, the point is
+// replaying parse and dispatch cost, not archiving uploads
+#define SHADOW_BODY_LIMIT (256 * 1024)
+
+// flushing above this size instead of waiting for the timer keeps
+// the pending buffer bounded under load
+#define SHADOW_FLUSH_BYTES (512 * 1024)
+
+RequestShadow::RequestShadow(const QString &path, int rate, int workerId, int workerCore, QObject *parent)
+    : QObject(parent)
+    , m_rate(qMax(rate, 1))
+{
+    // one capture file per worker core, concurrent writers would
+    // interleave records
+    m_file = new QFile(path + QLatin1Char('.') + QString::number(workerId)
+                       + QLatin1Char('.') + QString::number(workerCore), this);
+    if (!m_file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCWarning(CWSGI_SHADOW) << "Failed to open shadow capture file" << m_file->fileName() << m_file->errorString();
+        delete m_file;
+        m_file = nullptr;
+        m_flushTimer = nullptr;
+        return;
+    }
+
+    if (m_file->size() == 0) {
+        QDataStream out(&m_pending, QIODevice::WriteOnly);
+        writeFileHeader(out);
+    }
+
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setInterval(1000);
+    connect(m_flushTimer, &QTimer::timeout, this, &RequestShadow::flush);
+    m_flushTimer->start();
+
+    qCInfo(CWSGI_SHADOW) << "Shadowing 1 in" << m_rate << "requests to" << m_file->fileName();
+}
+
+RequestShadow::~RequestShadow()
+{
+    flush();
+}
+
+void RequestShadow::writeFileHeader(QDataStream &out)
+{
+    out.setVersion(QDataStream::Qt_5_6);
+    out << SHADOW_MAGIC << SHADOW_VERSION;
+}
+
+bool RequestShadow::readFileHeader(QDataStream &in)
+{
+    in.setVersion(QDataStream::Qt_5_6);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    return in.status() == QDataStream::Ok &&
+            magic == SHADOW_MAGIC && version == SHADOW_VERSION;
+}
+
+void RequestShadow::record(const Cutelyst::EngineRequest &req)
+{
+    if (!m_file) {
+        return;
+    }
+
+    QByteArray body;
+    if (req.body && !req.body->isSequential()) {
+        // the application has not read the body yet, peek it and put
+        // the device back where it was
+        const qint64 pos = req.body->pos();
+        req.body->seek(0);
+        body = req.body->read(SHADOW_BODY_LIMIT);
+        req.body->seek(pos);
+    }
+
+    QDataStream out(&m_pending, QIODevice::WriteOnly | QIODevice::Append);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << req.method
+        << req.path
+        << req.query
+        << req.protocol
+        << req.serverAddress
+        << req.remoteAddress.toString()
+        << req.remotePort
+        << req.isSecure
+        << req.remoteUser
+        << req.headers.data()
+        << quint64(req.startOfRequest)
+        << body;
+
+    if (m_pending.size() >= SHADOW_FLUSH_BYTES) {
+        flush();
+    }
+}
+
+bool RequestShadow::readRecord(QDataStream &in, Cutelyst::EngineRequest *req, QByteArray *body)
+{
+    if (in.atEnd()) {
+        return false;
+    }
+
+    QString remoteAddress;
+    QHash<QString, QString> headers;
+    quint64 startOfRequest = 0;
+    in >> req->method
+       >> req->path
+       >> req->query
+       >> req->protocol
+       >> req->serverAddress
+       >> remoteAddress
+       >> req->remotePort
+       >> req->isSecure
+       >> req->remoteUser
+       >> headers
+       >> startOfRequest
+       >> *body;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    req->remoteAddress = QHostAddress(remoteAddress);
+    req->headers = Cutelyst::Headers();
+    auto it = headers.constBegin();
+    while (it != headers.constEnd()) {
+        req->headers.setHeader(it.key(), it.value());
+        ++it;
+    }
+    req->startOfRequest = startOfRequest;
+    req->body = nullptr;
+    req->requestPtr = nullptr;
+    return true;
+}
+
+void RequestShadow::flush()
+{
+    if (!m_file || m_pending.isEmpty()) {
+        return;
+    }
+
+    if (m_file->write(m_pending) != m_pending.size()) {
+        qCWarning(CWSGI_SHADOW) << "Failed to write shadow capture file" << m_file->fileName() << m_file->errorString();
+    }
+    m_file->flush();
+    m_pending.clear();
+}
+
+#include "moc_requestshadow.cpp"
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef REQUESTSHADOW_H
+#define REQUESTSHADOW_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+
+#include <Cutelyst/cutelyst_global.h>
+
+class QDataStream;
+class QFile;
+class QTimer;
+
+namespace Cutelyst {
+struct EngineRequest;
+}
+
+namespace CWSGI {
+
+/**
+ * Duplicates a 1-in-N sample of parsed requests into a per-worker
+ * capture file in a compact binary format. Records are serialized
+ * into a memory buffer on the request path and appended to disk from
+ * a timer, so the capture never adds a write syscall to a request.
+ * The cutelyst-wsgi-replay tool feeds captures back through the
+ * application at a controlled rate.
+ */
+class CUTELYST_WSGI_EXPORT RequestShadow : public QObject
+{
+    Q_OBJECT
+public:
+    RequestShadow(const QString &path, int rate, int workerId, int workerCore, QObject *parent = nullptr);
+    virtual ~RequestShadow();
+
+    inline void maybeRecord(const Cutelyst::EngineRequest &req) {
+        if (++m_seen >= m_rate) {
+            m_seen = 0;
+            record(req);
+        }
+    }
+
+    /**
+     * Writes the capture file magic and version to \p out.
+     */
+    static void writeFileHeader(QDataStream &out);
+
+    /**
+     * Reads and validates the capture file magic and version from \p in.
+     */
+    static bool readFileHeader(QDataStream &in);
+
+    /**
+     * Reads one record from \p in into \p req, leaving the captured
+     * body bytes in \p body; req->body and req->requestPtr are set
+     * to null. Returns false at end of stream or on a short record.
+     */
+    static bool readRecord(QDataStream &in, Cutelyst::EngineRequest *req, QByteArray *body);
+
+private:
+    void record(const Cutelyst::EngineRequest &req);
+    void flush();
+
+    QByteArray m_pending;
+    QFile *m_file;
+    QTimer *m_flushTimer;
+    int m_rate;
+    int m_seen = 0;
+};
+
+}
+
+#endif // REQUESTSHADOW_H
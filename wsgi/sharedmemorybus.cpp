@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "sharedmemorybus.h"
+
+#include <Cutelyst/WebSocketRegistry>
+
+#include <QSocketNotifier>
+#include <QLoggingCategory>
+
+#include <atomic>
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+Q_LOGGING_CATEGORY(CWSGI_BUS, "cwsgi.bus")
+
+using namespace CWSGI;
+
+#define BUS_SLOTS 1024
+#define BUS_SLOT_DATA (8 * 1024)
+#define BUS_MAX_WORKERS 256
+
+namespace {
+
+struct Slot {
+    // 2 * ticket + 1 while the writer that claimed the ticket is
+    // copying, 2 * ticket + 2 once the message is complete; readers
+    // validate the value again after copying out
+    std::atomic<quint64> sequence;
+    quint32 topicLen;
+    quint32 payloadLen;
+    quint8 binary;
+    char data[BUS_SLOT_DATA];
+};
+
+struct Ring {
+    std::atomic<quint64> head; // next ticket to claim
+    int workers;
+    int doorbells[BUS_MAX_WORKERS]; // eventfds, same numbers in every process
+    Slot slots[BUS_SLOTS];
+};
+
+// The mapping is created MAP_SHARED before fork(), every worker sees
+// the same ring; cursor and worker id are per process.
+Ring *s_ring = nullptr;
+int s_workerId = -1;
+quint64 s_cursor = 0;
+
+void publishToRing(const QString &topic, const QByteArray &payload, bool binary)
+{
+    const QByteArray topicUtf8 = topic.toUtf8();
+    if (topicUtf8.size() + payload.size() > BUS_SLOT_DATA) {
+        qCWarning(CWSGI_BUS) << "Message on topic" << topic
+                             << "exceeds the bus slot size, siblings will not see it";
+        return;
+    }
+
+    const quint64 ticket = s_ring->head.fetch_add(1, std::memory_order_acq_rel);
+    Slot &slot = s_ring->slots[ticket % BUS_SLOTS];
+
+    slot.sequence.store(ticket * 2 + 1, std::memory_order_release);
+    slot.topicLen = quint32(topicUtf8.size());
+    slot.payloadLen = quint32(payload.size());
+    slot.binary = binary ? 1 : 0;
+    memcpy(slot.data, topicUtf8.constData(), size_t(topicUtf8.size()));
+    memcpy(slot.data + topicUtf8.size(), payload.constData(), size_t(payload.size()));
+    slot.sequence.store(ticket * 2 + 2, std::memory_order_release);
+
+    for (int i = 0; i < s_ring->workers; ++i) {
+        if (i != s_workerId) {
+            eventfd_write(s_ring->doorbells[i], 1);
+        }
+    }
+}
+
+void drainRing()
+{
+    const quint64 head = s_ring->head.load(std::memory_order_acquire);
+    while (s_cursor < head) {
+        Slot &slot = s_ring->slots[s_cursor % BUS_SLOTS];
+        const quint64 complete = s_cursor * 2 + 2;
+
+        const quint64 seq = slot.sequence.load(std::memory_order_acquire);
+        if (seq < complete) {
+            // the writer holding this ticket is not done, its
+            // doorbell will bring us back once it is
+            break;
+        }
+
+        bool valid = false;
+        QByteArray topicUtf8;
+        QByteArray payload;
+        quint8 binary = 0;
+        if (seq == complete) {
+            const quint32 topicLen = slot.topicLen;
+            const quint32 payloadLen = slot.payloadLen;
+            binary = slot.binary;
+            if (topicLen + payloadLen <= BUS_SLOT_DATA) {
+                topicUtf8 = QByteArray(slot.data, int(topicLen));
+                payload = QByteArray(slot.data + topicLen, int(payloadLen));
+                // the copy only counts if no writer reclaimed the
+                // slot while it was taken
+                valid = slot.sequence.load(std::memory_order_acquire) == complete;
+            }
+        }
+
+        if (!valid) {
+            // lapped by the writers; skip ahead to the oldest ticket
+            // whose slot can still be intact
+            const quint64 oldest = head > BUS_SLOTS ? head - BUS_SLOTS : 0;
+            const quint64 skipTo = qMax(oldest, s_cursor + 1);
+            qCWarning(CWSGI_BUS) << "Worker" << s_workerId << "fell behind the bus, lost"
+                                 << (skipTo - s_cursor) << "messages";
+            s_cursor = skipTo;
+            continue;
+        }
+
+        ++s_cursor;
+
+        const QString topic = QString::fromUtf8(topicUtf8);
+        if (binary) {
+            Cutelyst::WebSocketRegistry::publishLocalBinaryMessage(topic, payload);
+        } else {
+            Cutelyst::WebSocketRegistry::publishLocalTextMessage(topic, QString::fromUtf8(payload));
+        }
+    }
+}
+
+}
+
+bool SharedMemoryBus::create(int processes)
+{
+    if (processes < 2) {
+        // a single worker has no sibling to talk to
+        return true;
+    }
+
+    if (processes > BUS_MAX_WORKERS) {
+        qCWarning(CWSGI_BUS) << "Not creating the bus," << processes
+                             << "workers exceed the" << BUS_MAX_WORKERS << "doorbell slots";
+        return false;
+    }
+
+    void *mem = mmap(nullptr, sizeof(Ring), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        qCWarning(CWSGI_BUS) << "Failed to map the shared ring";
+        return false;
+    }
+
+    // anonymous mappings come zeroed, which is the empty ring state
+    s_ring = static_cast<Ring *>(mem);
+    s_ring->workers = processes;
+
+    for (int i = 0; i < processes; ++i) {
+        s_ring->doorbells[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (s_ring->doorbells[i] == -1) {
+            qCWarning(CWSGI_BUS) << "Failed to create the worker doorbells";
+            while (i-- > 0) {
+                close(s_ring->doorbells[i]);
+            }
+            munmap(s_ring, sizeof(Ring));
+            s_ring = nullptr;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SharedMemoryBus::attach(int workerId)
+{
+    if (!s_ring || workerId < 0 || workerId >= s_ring->workers) {
+        return;
+    }
+
+    s_workerId = workerId;
+    s_cursor = s_ring->head.load(std::memory_order_acquire);
+
+    Cutelyst::WebSocketRegistry::setPublishForwarder(publishToRing);
+
+    // lives for the whole worker process
+    auto notifier = new QSocketNotifier(s_ring->doorbells[workerId], QSocketNotifier::Read);
+    QObject::connect(notifier, &QSocketNotifier::activated, [] (int fd) {
+        eventfd_t count;
+        eventfd_read(fd, &count);
+        drainRing();
+    });
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public License
+ * along with this library; see the file COPYING.LIB. If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef SHAREDMEMORYBUS_H
+#define SHAREDMEMORYBUS_H
+
+namespace CWSGI {
+
+/**
+ * In-host publish/subscribe bus between forked worker processes.
+ *
+ * A shared anonymous mapping created before fork() holds a broadcast
+ * ring of fixed size slots; publishing a websocket message claims a
+ * slot with an atomic ticket, copies topic and payload in and rings
+ * an eventfd doorbell per sibling worker. Each worker watches its own
+ * doorbell with a socket notifier and replays received messages into
+ * the local WebSocketRegistry, so cross-worker fanout stays inside
+ * the host instead of detouring through an external broker.
+ *
+ * Readers never block writers and writers never block readers; a
+ * worker that falls a full ring behind loses the overwritten
+ * messages, which is logged.
+ */
+namespace SharedMemoryBus {
+
+/**
+ * Creates the shared ring and one doorbell per worker. Must run in
+ * the master before the workers are forked so all of them inherit
+ * the mapping and the eventfds. Returns false when the kernel
+ * resources could not be set up.
+ */
+bool create(int processes);
+
+/**
+ * Hooks this worker process up to the bus: installs the registry
+ * forwarder and starts watching the worker's doorbell on the calling
+ * thread. Does nothing if create() was not called.
+ */
+void attach(int workerId);
+
+}
+
+}
+
+#endif // SHAREDMEMORYBUS_H
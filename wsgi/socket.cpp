@@ -19,12 +19,23 @@
 #include "socket.h"
 
 #include "wsgi.h"
+#include "protocolhttp2.h"
 
 #include <Cutelyst/Context>
 
 #include <QCoreApplication>
 #include <QDebug>
 
+#ifdef CWSGI_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
 using namespace CWSGI;
 
 TcpSocket::TcpSocket(WSGI *wsgi, QObject *parent) : QTcpSocket(parent), Socket(wsgi)
@@ -43,12 +54,107 @@ void TcpSocket::connectionClose()
 Socket::Socket(WSGI *wsgi)
 {
     body = nullptr;
-    buffer = new char[wsgi->bufferSize()];
+    // Sockets start on the smallest size class, the protocols grow
+    // the buffer on demand up to the configured buffer-size; with
+    // tens of thousands of mostly idle connections the difference is
+    // gigabytes of untouched RSS
+    buf_capacity = qMin(static_cast<quint32>(wsgi->bufferSize()), quint32(4096));
+    buffer = BufferAlloc::allocate(buf_capacity);
 }
 
 Socket::~Socket()
 {
-    delete [] buffer;
+    websocketExtensionsCleanup();
+    http2Cleanup();
+    bodyInflateCleanup();
+    delete bodySpare;
+    BufferAlloc::release(buffer, buf_capacity);
+}
+
+void Socket::cork()
+{
+#ifdef Q_OS_LINUX
+    if (corked) {
+        return;
+    }
+
+    // Socket is a mixin, only the TCP backed subclasses have a
+    // descriptor the option can be set on
+    auto tcp = dynamic_cast<QTcpSocket *>(this);
+    if (!tcp) {
+        return;
+    }
+    const int fd = static_cast<int>(tcp->socketDescriptor());
+    if (fd < 0) {
+        return;
+    }
+
+    int state = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_CORK, &state, sizeof(state)) == 0) {
+        corked = true;
+    }
+#endif
+}
+
+void Socket::uncork()
+{
+#ifdef Q_OS_LINUX
+    if (!corked) {
+        return;
+    }
+    corked = false;
+
+    auto tcp = dynamic_cast<QTcpSocket *>(this);
+    if (!tcp) {
+        return;
+    }
+    const int fd = static_cast<int>(tcp->socketDescriptor());
+    if (fd < 0) {
+        return;
+    }
+
+    // Push what Qt still buffers into the kernel first, so removing
+    // the cork releases the whole tail instead of leaving bytes
+    // behind for the 200ms cork timer
+    tcp->flush();
+    int state = 0;
+    setsockopt(fd, IPPROTO_TCP, TCP_CORK, &state, sizeof(state));
+#endif
+}
+
+void Socket::http2Cleanup()
+{
+    delete h2;
+    h2 = nullptr;
+}
+
+void Socket::bodyInflateCleanup()
+{
+#ifdef CWSGI_HAVE_ZLIB
+    if (bodyInflate) {
+        inflateEnd(bodyInflate);
+        delete bodyInflate;
+        bodyInflate = nullptr;
+    }
+#endif
+}
+
+void Socket::websocketExtensionsCleanup()
+{
+#ifdef CWSGI_HAVE_ZLIB
+    if (websocket_inflate) {
+        inflateEnd(websocket_inflate);
+        delete websocket_inflate;
+        websocket_inflate = nullptr;
+    }
+    if (websocket_deflate) {
+        deflateEnd(websocket_deflate);
+        delete websocket_deflate;
+        websocket_deflate = nullptr;
+    }
+#endif
+    websocket_deflate_enabled = false;
+    websocket_message_deflated = false;
 }
 
 void TcpSocket::socketDisconnected()
@@ -61,6 +167,9 @@ void TcpSocket::socketDisconnected()
         delete websocketContext;
         websocketContext = nullptr;
     }
+    websocketExtensionsCleanup();
+    http2Cleanup();
+    bodyInflateCleanup();
 
     if (!processing) {
         Q_EMIT finished(this);
@@ -91,6 +200,9 @@ void LocalSocket::socketDisconnected()
         delete websocketContext;
         websocketContext = nullptr;
     }
+    websocketExtensionsCleanup();
+    http2Cleanup();
+    bodyInflateCleanup();
 
     if (!processing) {
         Q_EMIT finished(this);
@@ -120,6 +232,9 @@ void SslSocket::socketDisconnected()
         delete websocketContext;
         websocketContext = nullptr;
     }
+    websocketExtensionsCleanup();
+    http2Cleanup();
+    bodyInflateCleanup();
 
     if (!processing) {
         Q_EMIT finished(this);
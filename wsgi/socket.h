@@ -23,17 +23,25 @@
 #include <QSslSocket>
 #include <QLocalSocket>
 #include <QHostAddress>
+#include <QBuffer>
+#include <QTemporaryFile>
+
+#include <cstring>
 #include <Cutelyst/Headers>
 #include <Cutelyst/Engine>
 
 #include "cwsgiengine.h"
+#include "bufferalloc.h"
 
 class QIODevice;
 
+struct z_stream_s;
+
 namespace CWSGI {
 
 class WSGI;
 class Protocol;
+class Http2Connection;
 class Socket : public Cutelyst::EngineRequest
 {
     Q_GADGET
@@ -96,15 +104,89 @@ public:
         headerConnection = HeaderConnectionNotSet;
         pktsize = 0;
         processing = false;
+        dispatchDefers = 0;
+        ++dispatchGeneration;
         headerHost = false;
-        timeout = false;
-        delete body;
-        body = nullptr;
+        websocket_pong_pending = false;
+        corked = false;
+        headerLines = 0;
+        coalesceBuffer.clear();
+        if (body) {
+            // Keep the device for the next request on this connection
+            // instead of churning allocations and temp file inodes,
+            // the protocols claim it again when a body arrives
+            if (bodySpare) {
+                delete body;
+            } else if (auto buffer = qobject_cast<QBuffer *>(body)) {
+                if (buffer->buffer().capacity() <= 1024 * 1024) {
+                    buffer->buffer().resize(0);
+                    buffer->seek(0);
+                    bodySpare = buffer;
+                } else {
+                    delete body;
+                }
+            } else if (auto temp = qobject_cast<QTemporaryFile *>(body)) {
+                if (temp->resize(0)) {
+                    temp->seek(0);
+                    bodySpare = temp;
+                } else {
+                    delete body;
+                }
+            } else {
+                delete body;
+            }
+            body = nullptr;
+        }
+    }
+
+    // Grows the parse buffer to the next size class, doubling up to
+    // maxSize; returns false when it is already there
+    inline bool growBuffer(quint32 maxSize) {
+        if (buf_capacity >= maxSize) {
+            return false;
+        }
+
+        const quint32 newCapacity = qMin(qMax(buf_capacity * 2, quint32(4096)), maxSize);
+        char *newBuffer = BufferAlloc::allocate(newCapacity);
+        if (buf_size) {
+            memcpy(newBuffer, buffer, buf_size);
+        }
+        BufferAlloc::release(buffer, buf_capacity);
+        buffer = newBuffer;
+        buf_capacity = newCapacity;
+        return true;
     }
 
     virtual void connectionClose() = 0;
 
+    // Holds partial TCP segments in the kernel so the header block
+    // and the first body bytes leave as one full segment, uncork()
+    // flushes and releases at response end. No-ops away from Linux
+    // or on local sockets.
+    void cork();
+    void uncork();
+
+    // Frees the permessage-deflate streams, called when the
+    // connection goes away as sockets are pooled and reused
+    void websocketExtensionsCleanup();
+
+    // Frees the HTTP/2 connection state, same lifecycle
+    void http2Cleanup();
+
+    // Frees the request body inflate stream on abnormal teardown,
+    // completed requests hand it back to the protocol's pool instead
+    void bodyInflateCleanup();
+
     qint64 contentLength;
+    // body device recycled by resetSocket(), waiting to be claimed
+    // for the next request body
+    QIODevice *bodySpare = nullptr;
+    // streaming request body inflate state, set up by ProtocolHttp
+    // when the request declares a gzip or deflate Content-Encoding
+    struct z_stream_s *bodyInflate = nullptr;
+    qint64 bodyReceived = 0;
+    // HTTP/2 connection state, set by ProtocolHttp2 on first read
+    Http2Connection *h2 = nullptr;
     CWsgiEngine *engine;
     Cutelyst::Context *websocketContext = nullptr;
     Protocol *proto;
@@ -112,16 +194,46 @@ public:
     ParserState connState = MethodLine;
     quint64 stream_id = 0;// FGCI
     quint32 buf_size = 0;
+    quint32 buf_capacity = 0;
     quint32 last = 0;
     int beginLine = 0;
     HeaderConnection headerConnection = HeaderConnectionNotSet;
     quint16 pktsize = 0;// FGCI
     bool headerHost = false;
     bool processing = false;
-    bool timeout = false;
+    bool corked = false;
+
+    // bumped by resetSocket(), lets a parked batch-endpoint dispatch
+    // notice that its socket was recycled meanwhile
+    quint32 dispatchGeneration = 0;
+    // event-loop passes the dispatch of the current request has been
+    // deferred, bounded by the protocol
+    quint8 dispatchDefers = 0;
+
+    // Intrusive links for SocketActivityList, owned by the server
+    Socket *activityPrev = nullptr;
+    Socket *activityNext = nullptr;
+    qint64 lastActivity = 0;
+    // header lines seen for the request being parsed, bounded by the
+    // protocol to keep an abusive client from feeding headers forever
+    quint32 headerLines = 0;
+    bool inActivityList = false;
+
+    // outgoing websocket frames parked for the once-per-event-loop-pass
+    // coalesced flush, see CWsgiEngine::flushCoalescedWrites()
+    QByteArray coalesceBuffer;
+    bool coalesceQueued = false;
 
     QByteArray websocket_message;
     QByteArray websocket_payload;
+    // RFC 7692 permessage-deflate state, null when not negotiated
+    struct z_stream_s *websocket_inflate = nullptr;
+    struct z_stream_s *websocket_deflate = nullptr;
+    bool websocket_deflate_enabled = false;
+    bool websocket_message_deflated = false;
+    // set when the engine heartbeat pinged this connection, cleared
+    // by any incoming frame; still set one interval later means dead
+    bool websocket_pong_pending = false;
     quint32 websocket_need;
     int websocket_start_of_frame = 0;
     int websocket_phase = 0;
@@ -131,6 +243,65 @@ public:
     quint8 websocket_finn_opcode;
 };
 
+/**
+ * Doubly linked list of sockets ordered by last activity, the
+ * oldest socket is at the head. Touching a socket on every read
+ * splices it to the tail in O(1), so the timeout tick only has
+ * to walk the head until it finds a recent socket instead of
+ * scanning every child of the server.
+ */
+class SocketActivityList
+{
+public:
+    inline void touch(Socket *sock, qint64 now) {
+        sock->lastActivity = now;
+        if (sock->inActivityList) {
+            if (!sock->activityNext) {
+                return; // already the newest
+            }
+            unlink(sock);
+        }
+
+        sock->inActivityList = true;
+        sock->activityNext = nullptr;
+        sock->activityPrev = m_newest;
+        if (m_newest) {
+            m_newest->activityNext = sock;
+        } else {
+            m_oldest = sock;
+        }
+        m_newest = sock;
+    }
+
+    inline void remove(Socket *sock) {
+        if (sock->inActivityList) {
+            unlink(sock);
+            sock->inActivityList = false;
+        }
+    }
+
+    inline Socket *oldest() const { return m_oldest; }
+
+private:
+    inline void unlink(Socket *sock) {
+        if (sock->activityPrev) {
+            sock->activityPrev->activityNext = sock->activityNext;
+        } else {
+            m_oldest = sock->activityNext;
+        }
+        if (sock->activityNext) {
+            sock->activityNext->activityPrev = sock->activityPrev;
+        } else {
+            m_newest = sock->activityPrev;
+        }
+        sock->activityPrev = nullptr;
+        sock->activityNext = nullptr;
+    }
+
+    Socket *m_oldest = nullptr;
+    Socket *m_newest = nullptr;
+};
+
 class TcpSocket : public QTcpSocket, public Socket
 {
     Q_OBJECT
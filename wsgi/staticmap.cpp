@@ -21,10 +21,13 @@
 #include "socket.h"
 
 #include <QDir>
+#include <QDirIterator>
 #include <QFile>
+#include <QFileInfo>
 #include <QLoggingCategory>
 
 #include <Cutelyst/Application>
+#include <Cutelyst/keys_p.h>
 #include <Cutelyst/Response>
 #include <Cutelyst/Request>
 
@@ -42,6 +45,8 @@ bool StaticMap::setup(Cutelyst::Application *app)
 {
     connect(app, &Cutelyst::Application::beforePrepareAction,
             this, &StaticMap::beforePrepareAction);
+    connect(app, &Cutelyst::Application::postForked,
+            this, &StaticMap::preloadAssets);
     return true;
 }
 
@@ -95,40 +100,240 @@ bool StaticMap::tryToServeFile(Cutelyst::Context *c, const MountPoint &mp, const
     return serveFile(c, absFilePath);
 }
 
+// Assets up to this size are kept decoded in memory, anything
+// bigger is streamed from an open file as before
+#define ASSET_CACHE_MAX_ENTRY (1024 * 1024)
+
+struct ByteRange {
+    qint64 start = 0;
+    qint64 end = -1;
+    bool valid = false;
+    bool unsatisfiable = false;
+};
+
+// Parses a single range Range header against the entity size.
+// Multi range answers would need a multipart/byteranges body, those
+// clients get the whole representation instead.
+static ByteRange parseRangeHeader(const QString &range, qint64 size)
+{
+    ByteRange ret;
+    if (!range.startsWith(QLatin1String("bytes=")) || range.contains(QLatin1Char(','))) {
+        return ret;
+    }
+
+    const int dash = range.indexOf(QLatin1Char('-'), 6);
+    if (dash == -1) {
+        return ret;
+    }
+
+    const QString startStr = range.mid(6, dash - 6).trimmed();
+    const QString endStr = range.mid(dash + 1).trimmed();
+    if (startStr.isEmpty()) {
+        // suffix form, the last N bytes
+        if (endStr.isEmpty()) {
+            return ret;
+        }
+        const qint64 suffix = endStr.toLongLong();
+        if (suffix <= 0) {
+            ret.unsatisfiable = true;
+            return ret;
+        }
+        ret.start = qMax(qint64(0), size - suffix);
+        ret.end = size - 1;
+    } else {
+        bool ok;
+        ret.start = startStr.toLongLong(&ok);
+        if (!ok || ret.start >= size) {
+            ret.unsatisfiable = ret.start >= size;
+            return ret;
+        }
+        ret.end = endStr.isEmpty() ? size - 1 : qMin(endStr.toLongLong(), size - 1);
+        if (ret.end < ret.start) {
+            return ret;
+        }
+    }
+
+    ret.valid = true;
+    return ret;
+}
+
 bool StaticMap::serveFile(Cutelyst::Context *c, const QString &filename)
 {
     auto res = c->response();
-    const QDateTime currentDateTime = QFileInfo(filename).lastModified();
-    if (currentDateTime == c->request()->headers().ifModifiedSinceDateTime()) {
+    const QFileInfo fileInfo(filename);
+    const QDateTime currentDateTime = fileInfo.lastModified();
+    // Weak validator built from what the stat already gave us, no
+    // need to hash the file contents
+    const QString etag = QLatin1Char('"')
+            + QString::number(currentDateTime.toMSecsSinceEpoch(), 16)
+            + QLatin1Char('-') + QString::number(fileInfo.size(), 16)
+            + QLatin1Char('"');
+
+    const Headers reqHeaders = c->request()->headers();
+    if (reqHeaders.header(QStringLiteral("IF_NONE_MATCH")) == etag
+            || currentDateTime == reqHeaders.ifModifiedSinceDateTime()) {
         res->setStatus(Response::NotModified);
+        res->headers().setHeader(Keys::ETAG, etag);
         return true;
     }
 
-    auto file = new QFile(filename);
-    if (file->open(QFile::ReadOnly)) {
-        qCDebug(CUTELYST_SM) << "Serving" << filename;
-        Headers &headers = res->headers();
+    // Sidecar files compressed once at deploy time, checked in order
+    // of how well they usually compress
+    static const struct {
+        const char *suffix;
+        const char *encoding;
+    } sidecars[] = {
+        { ".br", "br" },
+        { ".gz", "gzip" },
+    };
 
-        // set our open file
-        res->setBody(file);
+    QString servePath = filename;
+    QString contentEncoding;
+    const QString acceptEncoding = reqHeaders.header(QStringLiteral("ACCEPT_ENCODING"));
+    if (!acceptEncoding.isEmpty()) {
+        for (const auto &sidecar : sidecars) {
+            if (!acceptEncoding.contains(QLatin1String(sidecar.encoding), Qt::CaseInsensitive)) {
+                continue;
+            }
 
-        // use the extension to match to be faster
-        QMimeType mimeType = m_db.mimeTypeForFile(filename, QMimeDatabase::MatchExtension);
-        if (mimeType.isValid()) {
-            headers.setContentType(mimeType.name());
+            const QString candidate = filename + QLatin1String(sidecar.suffix);
+            if (m_cache.contains(candidate) || QFile::exists(candidate)) {
+                servePath = candidate;
+                contentEncoding = QLatin1String(sidecar.encoding);
+                break;
+            }
         }
-        headers.setContentLength(file->size());
+    }
 
-        headers.setLastModified(currentDateTime);
-        // Tell Firefox & friends its OK to cache, even over SSL
-        headers.setHeader(QStringLiteral("cache_control"), QStringLiteral("public"));
+    qint64 contentLength = -1;
 
-        return true;
+    CachedAsset *cached = m_cache.object(servePath);
+    if (cached) {
+        const QDateTime serveModified = servePath == filename
+                ? currentDateTime : QFileInfo(servePath).lastModified();
+        if (cached->lastModified == serveModified) {
+            qCDebug(CUTELYST_SM) << "Serving cached" << servePath;
+            res->setBody(cached->data);
+            contentLength = cached->data.size();
+        }
     }
 
-    qCWarning(CUTELYST_SM) << "Could not serve" << filename << file->errorString();
-    delete file;
-    return false;
+    if (contentLength < 0) {
+        auto file = new QFile(servePath);
+        if (!file->open(QFile::ReadOnly) && servePath != filename) {
+            // the sidecar we probed for went away meanwhile
+            delete file;
+            servePath = filename;
+            contentEncoding.clear();
+            file = new QFile(servePath);
+            file->open(QFile::ReadOnly);
+        }
+        if (!file->isOpen()) {
+            qCWarning(CUTELYST_SM) << "Could not serve" << filename << file->errorString();
+            delete file;
+            return false;
+        }
+
+        qCDebug(CUTELYST_SM) << "Serving" << servePath;
+        contentLength = file->size();
+        if (contentLength <= ASSET_CACHE_MAX_ENTRY) {
+            // keep hot small assets in memory, QCache evicts the
+            // least recently served ones when the budget is spent
+            const QByteArray data = file->readAll();
+            const QDateTime serveModified = servePath == filename
+                    ? currentDateTime : QFileInfo(servePath).lastModified();
+            delete file;
+            res->setBody(data);
+            m_cache.insert(servePath, new CachedAsset{ data, serveModified }, data.size());
+        } else {
+            // set our open file
+            res->setBody(file);
+        }
+    }
+
+    Headers &headers = res->headers();
+
+    // use the extension to match to be faster, always from the original
+    // name so a .gz sidecar keeps the media type of the asset itself
+    QMimeType mimeType = m_db.mimeTypeForFile(filename, QMimeDatabase::MatchExtension);
+    if (mimeType.isValid()) {
+        headers.setContentType(mimeType.name());
+    }
+
+    headers.setHeader(Keys::ACCEPT_RANGES, QStringLiteral("bytes"));
+
+    const QString rangeHeader = reqHeaders.header(Keys::RANGE);
+    if (!rangeHeader.isEmpty()) {
+        // If-Range with a validator other than our ETag means the
+        // client's copy may be stale, answer with the whole entity
+        const QString ifRange = reqHeaders.header(Keys::IF_RANGE);
+        if (ifRange.isEmpty() || ifRange == etag) {
+            const ByteRange range = parseRangeHeader(rangeHeader, contentLength);
+            if (range.unsatisfiable) {
+                res->setStatus(Response::RequestedRangeNotSatisfiable);
+                res->setBody(QByteArray());
+                headers.setHeader(Keys::CONTENT_RANGE,
+                                  QLatin1String("bytes */") + QString::number(contentLength));
+                headers.setContentLength(0);
+                headers.setHeader(Keys::ETAG, etag);
+                return true;
+            }
+
+            if (range.valid) {
+                res->setStatus(Response::PartialContent);
+                headers.setHeader(Keys::CONTENT_RANGE,
+                                  QLatin1String("bytes ") + QString::number(range.start)
+                                  + QLatin1Char('-') + QString::number(range.end)
+                                  + QLatin1Char('/') + QString::number(contentLength));
+                contentLength = range.end - range.start + 1;
+                if (!res->bodyDevice()) {
+                    res->setBody(res->body().mid(range.start, contentLength));
+                }
+                // file bodies are windowed by the engine, which maps
+                // the range to an offset sendfile
+            }
+        }
+    }
+
+    headers.setContentLength(contentLength);
+    if (!contentEncoding.isEmpty()) {
+        headers.setContentEncoding(contentEncoding);
+        headers.setHeader(Keys::VARY, QStringLiteral("Accept-Encoding"));
+    }
+
+    headers.setHeader(Keys::ETAG, etag);
+    headers.setLastModified(currentDateTime);
+    // Tell Firefox & friends its OK to cache, even over SSL
+    headers.setHeader(QStringLiteral("cache_control"), QStringLiteral("public"));
+
+    return true;
+}
+
+void StaticMap::preloadAssets()
+{
+    // Warm the asset cache before the first request hits the worker,
+    // stopping once the memory budget is spent
+    for (const MountPoint &mp : m_staticMaps) {
+        QDirIterator it(mp.path, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString path = it.next();
+            const QFileInfo info = it.fileInfo();
+            if (info.size() > ASSET_CACHE_MAX_ENTRY || m_cache.contains(path)) {
+                continue;
+            }
+            if (m_cache.totalCost() + info.size() > m_cache.maxCost()) {
+                qCInfo(CUTELYST_SM) << "asset cache budget spent, preload stopped at" << path;
+                return;
+            }
+
+            QFile file(path);
+            if (file.open(QFile::ReadOnly)) {
+                const QByteArray data = file.readAll();
+                m_cache.insert(path, new CachedAsset{ data, info.lastModified() }, data.size());
+            }
+        }
+    }
+    qCInfo(CUTELYST_SM) << "preloaded" << m_cache.count() << "assets," << m_cache.totalCost() << "bytes";
 }
 
 #include "moc_staticmap.cpp"
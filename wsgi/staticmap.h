@@ -21,6 +21,8 @@
 
 #include <QString>
 #include <QMimeDatabase>
+#include <QCache>
+#include <QDateTime>
 #include <vector>
 
 #include <Cutelyst/Plugin>
@@ -34,6 +36,11 @@ struct MountPoint {
     bool append;
 };
 
+struct CachedAsset {
+    QByteArray data;
+    QDateTime lastModified;
+};
+
 class Socket;
 class StaticMap : public Cutelyst::Plugin
 {
@@ -52,8 +59,12 @@ private:
 
     bool serveFile(Cutelyst::Context *c, const QString &filename);
 
+    void preloadAssets();
+
     QMimeDatabase m_db;
     std::vector<MountPoint> m_staticMaps;
+    // Bounded per worker memory for small assets, cost is bytes
+    QCache<QString, CachedAsset> m_cache{64 * 1024 * 1024};
 };
 
 }
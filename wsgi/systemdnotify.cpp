@@ -29,6 +29,8 @@
 #include <fcntl.h>
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QDebug>
 
 /* The first passed file descriptor is fd 3 */
@@ -43,6 +45,14 @@ class systemdNotifyPrivate
 public:
     struct msghdr *notification_object = nullptr;
     int notification_fd = 0;
+
+    // watchdog state, see systemdNotify::startWatchdog()
+    WSGI *wsgi = nullptr;
+    QElapsedTimer ticker;
+    qint64 watchdogIntervalMs = 0;
+    qint64 lastTick = 0;
+    qint64 lastStatus = 0;
+    qint64 maxLag = 0;
 };
 
 }
@@ -134,6 +144,77 @@ void systemdNotify::ready()
     }
 }
 
+void systemdNotify::startWatchdog(WSGI *wsgi, qint64 usec)
+{
+    Q_D(systemdNotify);
+
+    if (usec <= 0 || !d->notification_fd) {
+        return;
+    }
+
+    d->wsgi = wsgi;
+    d->watchdogIntervalMs = usec / 1000;
+    d->ticker.start();
+
+    // a quarter of the budget, so a lagging loop is noticed after one
+    // missed tick instead of only on the final deadline
+    const int tickMs = qMax(1, static_cast<int>(d->watchdogIntervalMs / 4));
+
+    auto timer = new QTimer(this);
+    timer->setInterval(tickMs);
+    connect(timer, &QTimer::timeout, this, [this, tickMs] () {
+        watchdogTick(tickMs);
+    });
+    timer->start();
+}
+
+void systemdNotify::watchdogTick(int tickMs)
+{
+    Q_D(systemdNotify);
+
+    // the skew of our own timer is exactly the time the event loop
+    // spent unable to run timers, no extra instrumentation needed
+    const qint64 now = d->ticker.elapsed();
+    const qint64 lag = qMax(Q_INT64_C(0), now - d->lastTick - tickMs);
+    d->lastTick = now;
+    d->maxLag = qMax(d->maxLag, lag);
+
+    // Acknowledge the watchdog only while the loop proves responsive;
+    // a loop lagging past half the budget is as good as stuck and is
+    // left for systemd to restart, which makes the watchdog timeout a
+    // latency bound instead of only a liveness check. A fully stuck
+    // loop never reaches this code and times out on its own.
+    if (lag < d->watchdogIntervalMs / 2) {
+        sendRaw(QByteArrayLiteral("WATCHDOG=1\n"));
+    } else {
+        qWarning("Event loop lagged %lld ms, withholding watchdog keep-alive", lag);
+    }
+
+    if (now - d->lastStatus >= 1000) {
+        d->lastStatus = now;
+        notify(QByteArray::number(d->wsgi->currentConnections())
+               + " connections, event loop lag " + QByteArray::number(lag)
+               + " ms (max " + QByteArray::number(d->maxLag) + " ms)");
+    }
+}
+
+void systemdNotify::sendRaw(const QByteArray &data)
+{
+    Q_D(systemdNotify);
+
+    struct msghdr *msghdr = d->notification_object;
+    struct iovec *iovec = msghdr->msg_iov;
+
+    iovec[0].iov_base = const_cast<char *>(data.constData());
+    iovec[0].iov_len = data.size();
+
+    msghdr->msg_iovlen = 1;
+
+    if (sendmsg(d->notification_fd, msghdr, 0) < 0) {
+        qWarning("sendmsg()");
+    }
+}
+
 void systemdNotify::install_systemd_notifier(WSGI *wsgi)
 {
     if (!qEnvironmentVariableIsSet("NOTIFY_SOCKET")) {
@@ -144,6 +225,21 @@ void systemdNotify::install_systemd_notifier(WSGI *wsgi)
     qDebug() << "systemd notify detected" << notifySocket;
     auto notify = new systemdNotify(notifySocket.constData(), wsgi);
     connect(wsgi, &WSGI::ready, notify, &systemdNotify::ready);
+
+    // WATCHDOG_PID distinguishes the supervised process from forked
+    // children that inherited the environment
+    const QByteArray watchdogPid = qgetenv("WATCHDOG_PID");
+    if (!watchdogPid.isEmpty() &&
+            watchdogPid.toLongLong() != QCoreApplication::applicationPid()) {
+        return;
+    }
+
+    bool ok;
+    const qint64 watchdogUsec = qgetenv("WATCHDOG_USEC").toLongLong(&ok);
+    if (ok && watchdogUsec > 0) {
+        qDebug("systemd watchdog enabled, %lld usec budget", watchdogUsec);
+        notify->startWatchdog(wsgi, watchdogUsec);
+    }
 }
 
 int fd_cloexec(int fd, bool cloexec) {
@@ -37,11 +37,25 @@ public:
     void notify(const QByteArray &data);
     void ready();
 
+    /**
+     * Starts acknowledging the service watchdog, usec is the budget
+     * from WATCHDOG_USEC. The keep-alive rides on an event-loop
+     * timer whose skew is measured on every tick, so besides a dead
+     * loop a loop lagging past half the budget also stops being
+     * acknowledged and gets the process restarted within the budget
+     * instead of limping along. The tick also publishes the current
+     * connection load and observed lag as the service STATUS.
+     */
+    void startWatchdog(WSGI *wsgi, qint64 usec);
+
     static void install_systemd_notifier(WSGI *wsgi);
 
     static std::vector<int> listenFds(bool unsetEnvironment = true);
 
 private:
+    void watchdogTick(int tickMs);
+    void sendRaw(const QByteArray &data);
+
     systemdNotifyPrivate *d_ptr;
 };
 
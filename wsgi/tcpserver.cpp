@@ -23,6 +23,13 @@
 
 #include <Cutelyst/Engine>
 #include <QDateTime>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <QSocketNotifier>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 using namespace CWSGI;
 
@@ -45,10 +52,24 @@ TcpServer::TcpServer(const QString &serverAddress, Protocol *protocol, WSGI *wsg
     if (m_wsgi->socketRcvbuf() != -1) {
         m_socketOptions.push_back({ QAbstractSocket::ReceiveBufferSizeSocketOption, m_wsgi->socketRcvbuf() });
     }
+    m_maxConnections = m_wsgi->maxConnections();
+    m_websocketHeartbeatMs = qint64(m_wsgi->websocketHeartbeat()) * 1000;
 }
 
 void TcpServer::incomingConnection(qintptr handle)
 {
+    if (m_maxConnections && m_processing >= m_maxConnections) {
+        // Shed load at the door: a canned 503 is far cheaper than
+        // queueing a request we would only answer after the client
+        // has given up on it
+        QTcpSocket sock;
+        sock.setSocketDescriptor(handle);
+        sock.write("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        sock.flush();
+        sock.close();
+        return;
+    }
+
     TcpSocket *sock;
     if (!m_socks.empty()) {
         sock = m_socks.back();
@@ -57,19 +78,28 @@ void TcpServer::incomingConnection(qintptr handle)
         sock = new TcpSocket(m_wsgi, this);
         sock->engine = m_engine;
 
-        connect(sock, &QIODevice::readyRead, [sock] () {
-            sock->timeout = false;
+        connect(sock, &QIODevice::readyRead, [this, sock] () {
+            m_activityList.touch(sock, QDateTime::currentMSecsSinceEpoch());
             sock->proto->readyRead(sock, sock);
         });
         connect(sock, &TcpSocket::finished, [this] (TcpSocket *obj) {
+            m_activityList.remove(obj);
             m_socks.push_back(obj);
             --m_processing;
+            --m_load;
         });
     }
 
     if (Q_LIKELY(sock->setSocketDescriptor(handle))) {
         sock->resetSocket();
 
+        // Near the connection budget stop offering keep-alive so fds
+        // come back after one response; parseHeader only fills the
+        // field when it is still unset, so the client cannot override
+        if (m_maxConnections && m_processing * 10 >= m_maxConnections * 9) {
+            sock->headerConnection = Socket::HeaderConnectionClose;
+        }
+
         sock->proto = m_protocol;
         sock->serverAddress = m_serverAddress;
         sock->remoteAddress = sock->peerAddress();
@@ -79,6 +109,9 @@ void TcpServer::incomingConnection(qintptr handle)
             sock->setSocketOption(opt.first, opt.second);
         }
 
+        m_activityList.touch(sock, QDateTime::currentMSecsSinceEpoch());
+
+        ++m_load;
         if (++m_processing) {
             m_engine->startSocketTimeout();
         }
@@ -87,45 +120,166 @@ void TcpServer::incomingConnection(qintptr handle)
     }
 }
 
+#ifdef Q_OS_LINUX
+void TcpServer::initBalancerRing()
+{
+    m_ringEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_ringEventFd == -1) {
+        // fall back to the queued createConnection signal
+        return;
+    }
+
+    m_ringNotifier = new QSocketNotifier(m_ringEventFd, QSocketNotifier::Read, this);
+    connect(m_ringNotifier, &QSocketNotifier::activated, this, [this] () {
+        ringActivated();
+    });
+}
+
+bool TcpServer::queueConnection(qintptr handle)
+{
+    // Called from the balancer thread, pairs with ringActivated()
+    // running on the worker thread.
+    if (m_ringEventFd == -1) {
+        return false;
+    }
+
+    const quint32 tail = m_ringTail.load(std::memory_order_relaxed);
+    if (tail - m_ringHead.load(std::memory_order_acquire) >= ConnectionRingSize) {
+        // ring full, let the balancer use the queued signal
+        return false;
+    }
+
+    m_connectionRing[tail % ConnectionRingSize] = handle;
+    m_ringTail.store(tail + 1, std::memory_order_release);
+
+    eventfd_write(m_ringEventFd, 1);
+    return true;
+}
+
+void TcpServer::ringActivated()
+{
+    eventfd_t value;
+    eventfd_read(m_ringEventFd, &value);
+
+    quint32 head = m_ringHead.load(std::memory_order_relaxed);
+    while (head != m_ringTail.load(std::memory_order_acquire)) {
+        const qintptr handle = m_connectionRing[head % ConnectionRingSize];
+        m_ringHead.store(++head, std::memory_order_release);
+        incomingConnection(handle);
+    }
+}
+#endif // Q_OS_LINUX
+
 void TcpServer::shutdown()
 {
     pauseAccepting();
 
     if (m_processing == 0) {
         m_engine->serverShutdown();
-    } else {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<TcpSocket*>(child);
-            if (socket) {
-                socket->headerConnection = Socket::HeaderConnectionClose;
-                connect(socket, &TcpSocket::finished, [this] () {
-                    if (!m_processing) {
-                        m_engine->serverShutdown();
-                    }
-                });
+        return;
+    }
+
+    const auto childrenL = children();
+    for (auto child : childrenL) {
+        auto socket = qobject_cast<TcpSocket*>(child);
+        if (socket) {
+            socket->headerConnection = Socket::HeaderConnectionClose;
+            connect(socket, &TcpSocket::finished, this, [this] () {
+                if (!m_processing) {
+                    m_engine->serverShutdown();
+                }
+            });
+            if (!socket->processing) {
+                // idle keep-alive connection, close it now instead of
+                // waiting for its next request or the socket timeout
+                m_activityList.remove(socket);
+                socket->connectionClose();
             }
         }
     }
+
+    if (m_processing) {
+        // in-flight requests get a deadline, past it the remaining
+        // connections are dropped so a worker restart cannot hang
+        // behind one slow client
+        QTimer::singleShot(m_wsgi->gracefulTimeout() * 1000, this, [this] () {
+            const auto childrenL = children();
+            for (auto child : childrenL) {
+                auto socket = qobject_cast<TcpSocket*>(child);
+                if (socket && socket->processing) {
+                    m_activityList.remove(socket);
+                    socket->processing = false;
+                    socket->abort();
+                }
+            }
+        });
+    }
 }
 
 void TcpServer::timeoutConnections()
 {
-    if (m_processing) {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<TcpSocket*>(child);
-            if (socket && !socket->processing && socket->state() == QAbstractSocket::ConnectedState) {
-                if (socket->timeout) {
-                    socket->connectionClose();
+    qint64 timeoutMs = m_wsgi->socketTimeout() * 1000;
+    if (m_maxConnections && timeoutMs) {
+        // Shrink the idle window as the connection budget fills up:
+        // half the grace at three quarters full, a quarter at nine
+        // tenths, so idle keep-alive sockets give their fds back
+        // before new connections have to be shed at the door
+        if (m_processing * 10 >= m_maxConnections * 9) {
+            timeoutMs /= 4;
+        } else if (m_processing * 4 >= m_maxConnections * 3) {
+            timeoutMs /= 2;
+        }
+    }
+
+    // Walk from the oldest socket and stop at the first one still
+    // inside every window, the list is ordered by last activity
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 expireBefore = timeoutMs ? now - timeoutMs : Q_INT64_C(-1);
+    const qint64 pingBefore = m_websocketHeartbeatMs ? now - m_websocketHeartbeatMs : Q_INT64_C(-1);
+
+    // unmasked unfragmented PING with no payload, every heartbeat
+    // on every connection writes these same two bytes
+    static const char pingFrame[] = { char(0x89), 0x00 };
+
+    Socket *sock = m_activityList.oldest();
+    while (sock && sock->lastActivity <= qMax(expireBefore, pingBefore)) {
+        Socket *next = sock->activityNext;
+        if (sock->websocketContext) {
+            // Engine-managed heartbeat: silent for one interval gets
+            // a ping, still silent one interval later is dead. The
+            // pong (or any frame) clears the flag in the protocol.
+            if (pingBefore != -1 && sock->lastActivity <= pingBefore) {
+                if (sock->websocket_pong_pending) {
+                    m_activityList.remove(sock);
+                    sock->connectionClose();
                 } else {
-                    socket->timeout = true;
+                    sock->websocket_pong_pending = true;
+                    // pings count as activity, park the socket at the
+                    // list tail until the answer window has passed
+                    m_activityList.touch(sock, now);
+                    static_cast<TcpSocket *>(sock)->write(pingFrame, sizeof(pingFrame));
                 }
             }
+        } else if (!sock->processing && expireBefore != -1 && sock->lastActivity <= expireBefore) {
+            m_activityList.remove(sock);
+            sock->connectionClose();
         }
+        sock = next;
     }
 }
 
+int TcpServer::load() const
+{
+    int ret = m_load.load(std::memory_order_relaxed);
+#ifdef Q_OS_LINUX
+    // connections queued on the balancer ring but not yet accepted
+    // by the worker count as load too
+    ret += int(m_ringTail.load(std::memory_order_relaxed)
+               - m_ringHead.load(std::memory_order_relaxed));
+#endif
+    return ret;
+}
+
 Protocol *TcpServer::protocol() const
 {
     return m_protocol;
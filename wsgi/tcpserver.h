@@ -21,6 +21,12 @@
 
 #include <QTcpServer>
 
+#include "socket.h"
+
+#include <atomic>
+
+class QSocketNotifier;
+
 namespace CWSGI {
 
 class WSGI;
@@ -42,20 +48,43 @@ public:
     Protocol *protocol() const;
     void setProtocol(Protocol *protocol);
 
+    int load() const;
+
+#ifdef Q_OS_LINUX
+    bool queueConnection(qintptr handle);
+#endif
+
 Q_SIGNALS:
     void createConnection(qintptr handle);
 
 protected:
     friend class TcpServerBalancer;
 
+#ifdef Q_OS_LINUX
+    void initBalancerRing();
+    void ringActivated();
+
+    enum { ConnectionRingSize = 1024 }; // must be a power of two
+    qintptr m_connectionRing[ConnectionRingSize];
+    std::atomic<quint32> m_ringHead { 0 }; // consumed on the worker thread
+    std::atomic<quint32> m_ringTail { 0 }; // produced on the balancer thread
+    QSocketNotifier *m_ringNotifier = nullptr;
+    int m_ringEventFd = -1;
+#endif
+
     QString m_serverAddress;
     CWsgiEngine *m_engine;
     WSGI *m_wsgi;
 
     std::vector<std::pair<QAbstractSocket::SocketOption, QVariant> > m_socketOptions;
     std::vector<TcpSocket *> m_socks;
+    SocketActivityList m_activityList;
     Protocol *m_protocol;
+    // read by the balancer thread when picking the least loaded core
+    std::atomic<int> m_load { 0 };
     int m_processing = 0;
+    int m_maxConnections = 0;
+    qint64 m_websocketHeartbeatMs = 0;
 };
 
 }
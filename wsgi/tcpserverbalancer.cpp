@@ -23,7 +23,11 @@
 #include "tcpserver.h"
 #include "tcpsslserver.h"
 
+#include <Cutelyst/probes_p.h>
+
 #include <QFile>
+#include <QFileSystemWatcher>
+#include <QTimer>
 #include <QLoggingCategory>
 
 #include <QSslKey>
@@ -31,6 +35,8 @@
 #include <iostream>
 
 #ifdef Q_OS_LINUX
+#include "unixfork.h"
+
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -81,35 +87,14 @@ bool TcpServerBalancer::listen(const QString &line, Protocol *protocol, bool sec
     }
 
     if (secure) {
-        const QString certPath = afterColon.section(QLatin1Char(','), 1, 1);
-        auto certFile = new QFile(certPath);
-        if (!certFile->open(QFile::ReadOnly)) {
-            std::cerr << "Failed to open SSL certificate" << qPrintable(certPath)
-                      << qPrintable(certFile->errorString()) << std::endl;
-            exit(1);
-        }
-        QSslCertificate cert(certFile);
-        if (cert.isNull()) {
-            std::cerr << "Failed to parse SSL certificate" << std::endl;
-            exit(1);
-        }
+        m_sslCertPath = afterColon.section(QLatin1Char(','), 1, 1);
+        m_sslKeyPath = afterColon.section(QLatin1Char(','), 2, 2);
 
-        const QString keyPath = afterColon.section(QLatin1Char(','), 2, 2);
-        auto keyFile = new QFile(keyPath);
-        if (!keyFile->open(QFile::ReadOnly)) {
-            std::cerr << "Failed to open SSL private key" << qPrintable(keyPath)
-                      << qPrintable(keyFile->errorString()) << std::endl;
-            exit(1);
-        }
-        QSslKey key(keyFile, QSsl::Rsa);
-        if (key.isNull()) {
-            std::cerr << "Failed to parse SSL private key" << std::endl;
+        auto conf = new QSslConfiguration;
+        if (!loadSslConfiguration(conf)) {
             exit(1);
         }
-
-        m_sslConfiguration = new QSslConfiguration;
-        m_sslConfiguration->setLocalCertificate(cert);
-        m_sslConfiguration->setPrivateKey(key);
+        m_sslConfiguration = conf;
     }
 
     m_address = address;
@@ -126,12 +111,16 @@ bool TcpServerBalancer::listen(const QString &line, Protocol *protocol, bool sec
             setSocketDescriptor(socket);
             pauseAccepting();
         } else {
-            std::cerr << "Failed to listen on TCP: " << qPrintable(line)
-                      << " : " << qPrintable(errorString()) << std::endl;
-            exit(1);
+            // Kernels without SO_REUSEPORT support (< 3.9), fall
+            // back to accepting on a single shared socket
+            qCWarning(CWSGI_BALANCER) << "Failed to listen with SO_REUSEPORT, falling back to a shared listen socket";
+            m_wsgi->setReusePort(false);
+            reusePort = false;
         }
 #endif
-    } else {
+    }
+
+    if (!reusePort) {
         bool ret = QTcpServer::listen(address, port);
         if (ret) {
             pauseAccepting();
@@ -365,14 +354,152 @@ int listenReuse(const QHostAddress &address, quint16 port, bool startListening)
 }
 #endif // Q_OS_LINUX
 
+bool TcpServerBalancer::loadSslConfiguration(QSslConfiguration *conf) const
+{
+    QFile certFile(m_sslCertPath);
+    if (!certFile.open(QFile::ReadOnly)) {
+        qCCritical(CWSGI_BALANCER) << "Failed to open SSL certificate" << m_sslCertPath
+                                   << certFile.errorString();
+        return false;
+    }
+    QSslCertificate cert(&certFile);
+    if (cert.isNull()) {
+        qCCritical(CWSGI_BALANCER) << "Failed to parse SSL certificate" << m_sslCertPath;
+        return false;
+    }
+
+    QFile keyFile(m_sslKeyPath);
+    if (!keyFile.open(QFile::ReadOnly)) {
+        qCCritical(CWSGI_BALANCER) << "Failed to open SSL private key" << m_sslKeyPath
+                                   << keyFile.errorString();
+        return false;
+    }
+    QSslKey key(&keyFile, QSsl::Rsa);
+    if (key.isNull()) {
+        qCCritical(CWSGI_BALANCER) << "Failed to parse SSL private key" << m_sslKeyPath;
+        return false;
+    }
+
+    conf->setLocalCertificate(cert);
+    conf->setPrivateKey(key);
+    // Qt disables session resumption by default; turn the server
+    // session cache and session tickets back on so returning
+    // clients skip the asymmetric part of the handshake. Every
+    // per core server copies this configuration, which keeps the
+    // backend context - ticket key and cache included - shared
+    // within the process.
+    conf->setSslOption(QSsl::SslOptionDisableSessionSharing, false);
+    conf->setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    conf->setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+
+    if (m_wsgi->http2()) {
+        // offered through ALPN, TcpSslServer switches the socket
+        // protocol when the client picks h2
+        conf->setAllowedNextProtocols({ QByteArrayLiteral("h2"),
+                                        QByteArrayLiteral("http/1.1") });
+    }
+
+    return true;
+}
+
+void TcpServerBalancer::startSslCertWatcher()
+{
+    if (!m_sslConfiguration || m_sslWatcher) {
+        return;
+    }
+
+    // the new configuration crosses into the worker core threads
+    // through the queued sslConfigurationChanged() signal
+    qRegisterMetaType<QSslConfiguration>();
+
+    // certificate and key land one after the other on rotation,
+    // let the files settle before parsing so the new certificate
+    // is never paired with the old key
+    m_sslReloadTimer = new QTimer(this);
+    m_sslReloadTimer->setSingleShot(true);
+    m_sslReloadTimer->setInterval(1000);
+    connect(m_sslReloadTimer, &QTimer::timeout, this, &TcpServerBalancer::reloadSslConfiguration);
+
+    m_sslWatcher = new QFileSystemWatcher(this);
+    m_sslWatcher->addPath(m_sslCertPath);
+    m_sslWatcher->addPath(m_sslKeyPath);
+    connect(m_sslWatcher, &QFileSystemWatcher::fileChanged, this, [this] () {
+        m_sslReloadTimer->start();
+    });
+}
+
+void TcpServerBalancer::reloadSslConfiguration()
+{
+    // rotations usually rename a fresh file over the watched path,
+    // which drops it from the watcher; watch the new inode again
+    const QStringList watched = m_sslWatcher->files();
+    if (!watched.contains(m_sslCertPath)) {
+        m_sslWatcher->addPath(m_sslCertPath);
+    }
+    if (!watched.contains(m_sslKeyPath)) {
+        m_sslWatcher->addPath(m_sslKeyPath);
+    }
+
+    QSslConfiguration conf;
+    if (!loadSslConfiguration(&conf)) {
+        qCWarning(CWSGI_BALANCER) << "Keeping the previous SSL certificate for" << m_serverName;
+        return;
+    }
+
+    if (conf.localCertificate() == m_sslConfiguration->localCertificate()
+            && conf.privateKey() == m_sslConfiguration->privateKey()) {
+        // touched but unchanged
+        return;
+    }
+
+    *m_sslConfiguration = conf;
+    Q_EMIT sslConfigurationChanged(conf);
+    qCInfo(CWSGI_BALANCER) << "Reloaded SSL certificate for" << m_serverName
+                           << "expiring" << conf.localCertificate().expiryDate().toString(Qt::ISODate);
+}
+
 void TcpServerBalancer::setBalancer(bool enable)
 {
     m_balancer = enable;
 }
 
+int TcpServerBalancer::load() const
+{
+    int ret = 0;
+    for (TcpServer *server : m_servers) {
+        ret += server->load();
+    }
+    return ret;
+}
+
 void TcpServerBalancer::incomingConnection(qintptr handle)
 {
-    TcpServer *serverIdle = m_servers.at(m_currentServer++ % m_servers.size());
+    CUTELYST_PROBE1(balancer_incoming_connection, handle);
+
+    // Join the shortest queue instead of blind round-robin: a core
+    // stuck on a slow handler keeps its backlog while idler neighbors
+    // pick up new connections. The round-robin cursor only rotates the
+    // starting point so equally idle cores still share the load.
+    const int size = int(m_servers.size());
+    const int first = m_currentServer++ % size;
+    TcpServer *serverIdle = m_servers.at(first);
+    int best = serverIdle->load();
+    for (int i = 1; i < size && best; ++i) {
+        TcpServer *server = m_servers.at((first + i) % size);
+        const int load = server->load();
+        if (load < best) {
+            serverIdle = server;
+            best = load;
+        }
+    }
+
+#ifdef Q_OS_LINUX
+    // Fast path: push the fd on the worker ring and wake it with
+    // an eventfd write, skipping the queued signal emission.
+    if (serverIdle->queueConnection(handle)) {
+        return;
+    }
+#endif
 
     serverIdle->createConnection(handle);
 }
@@ -383,6 +510,11 @@ TcpServer *TcpServerBalancer::createServer(CWsgiEngine *engine)
     if (m_sslConfiguration) {
         auto sslServer = new TcpSslServer(m_serverName, m_protocol, m_wsgi, engine);
         sslServer->setSslConfiguration(*m_sslConfiguration);
+        // rotated certificates reach the server on its own thread,
+        // new handshakes use them while established connections
+        // keep the context they started with
+        connect(this, &TcpServerBalancer::sslConfigurationChanged,
+                sslServer, &TcpSslServer::setSslConfiguration);
         server = sslServer;
     } else {
         server = new TcpServer(m_serverName, m_protocol, m_wsgi, engine);
@@ -390,6 +522,9 @@ TcpServer *TcpServerBalancer::createServer(CWsgiEngine *engine)
     connect(engine, &CWsgiEngine::shutdown, server, &TcpServer::shutdown);
 
     if (m_balancer) {
+#ifdef Q_OS_LINUX
+        server->initBalancerRing();
+#endif
         connect(engine, &CWsgiEngine::started, this, [=] () {
             m_servers.push_back(server);
             resumeAccepting();
@@ -404,6 +539,16 @@ TcpServer *TcpServerBalancer::createServer(CWsgiEngine *engine)
                 if (!server->setSocketDescriptor(socket)) {
                     qFatal("Failed to set server socket descriptor, reuse-port");
                 }
+#ifdef SO_INCOMING_CPU
+                // When the worker is pinned, steer flows whose RSS
+                // queue lands on its CPU to this listener, keeping
+                // softirq and worker on the same core
+                const int cpu = UnixFork::affinityBaseCpu(m_wsgi, engine->workerId(), engine->workerCore());
+                if (cpu >= 0
+                        && ::setsockopt(socket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu))) {
+                    qCWarning(CWSGI_BALANCER) << "Failed to set SO_INCOMING_CPU" << cpu;
+                }
+#endif
             }, Qt::DirectConnection);
             return server;
         }
@@ -22,7 +22,10 @@
 #include <QTcpServer>
 #include <QtGlobal>
 
-class QSslConfiguration;
+#include <QSslConfiguration>
+
+class QFileSystemWatcher;
+class QTimer;
 
 namespace CWSGI {
 
@@ -39,6 +42,10 @@ public:
 
     bool listen(const QString &address, Protocol *protocol, bool secure);
 
+    // connections on all worker cores of this listener, accepted or
+    // still queued on a balancer ring
+    int load() const;
+
     void setBalancer(bool enable);
     QString serverName() const { return m_serverName; }
 
@@ -46,14 +53,30 @@ public:
 
     TcpServer *createServer(CWsgiEngine *engine);
 
+    // Starts watching the certificate and key files of a secure
+    // listener so rotated certificates are picked up without a
+    // restart. Called after fork, every worker process watches its
+    // own copy of the configuration.
+    void startSslCertWatcher();
+
+Q_SIGNALS:
+    void sslConfigurationChanged(const QSslConfiguration &conf);
+
 private:
+    bool loadSslConfiguration(QSslConfiguration *conf) const;
+    void reloadSslConfiguration();
+
     QHostAddress m_address;
     quint16 m_port;
     QString m_serverName;
+    QString m_sslCertPath;
+    QString m_sslKeyPath;
     std::vector<TcpServer *> m_servers;
     WSGI *m_wsgi;
     Protocol *m_protocol;
     QSslConfiguration *m_sslConfiguration = nullptr;
+    QFileSystemWatcher *m_sslWatcher = nullptr;
+    QTimer *m_sslReloadTimer = nullptr;
     int m_currentServer = 0;
     bool m_balancer = false;
 };
@@ -23,6 +23,8 @@
 #include "wsgi.h"
 
 #include <QSslError>
+#include <QDateTime>
+#include <QTimer>
 
 using namespace CWSGI;
 
@@ -33,18 +35,40 @@ TcpSslServer::TcpSslServer(const QString &serverAddress, CWSGI::Protocol *protoc
 
 void TcpSslServer::incomingConnection(qintptr handle)
 {
+    if (m_maxConnections && m_processing >= m_maxConnections) {
+        // before the handshake there is no channel to say 503 on,
+        // refusing outright is still kinder than a late answer
+        QTcpSocket sock;
+        sock.setSocketDescriptor(handle);
+        sock.abort();
+        return;
+    }
+
     auto sock = new SslSocket(m_wsgi, this);
     sock->setSslConfiguration(m_sslConfiguration);
     sock->engine = m_engine;
 
-    connect(sock, &QIODevice::readyRead, [sock] () {
-        sock->timeout = false;
+    if (m_wsgi->http2()) {
+        connect(sock, &QSslSocket::encrypted, [this, sock] () {
+            // the protocol is per connection once ALPN is in play
+            if (sock->sslConfiguration().nextNegotiatedProtocol() == "h2") {
+                sock->proto = m_engine->protocolHttp2();
+            }
+        });
+    }
+
+    connect(sock, &QIODevice::readyRead, [this, sock] () {
+        m_activityList.touch(sock, QDateTime::currentMSecsSinceEpoch());
         sock->proto->readyRead(sock, sock);
     });
-    connect(sock, &SslSocket::finished, [this] () {
+    connect(sock, &SslSocket::finished, [this] (SslSocket *obj) {
+        m_activityList.remove(obj);
         --m_processing;
     });
-    connect(sock, &SslSocket::disconnected, sock, &SslSocket::deleteLater);
+    connect(sock, &SslSocket::disconnected, [this, sock] () {
+        m_activityList.remove(sock);
+        sock->deleteLater();
+    });
 
     if (Q_LIKELY(sock->setSocketDescriptor(handle))) {
         sock->resetSocket();
@@ -58,6 +82,8 @@ void TcpSslServer::incomingConnection(qintptr handle)
             sock->setSocketOption(opt.first, opt.second);
         }
 
+        m_activityList.touch(sock, QDateTime::currentMSecsSinceEpoch());
+
         if (++m_processing) {
             m_engine->startSocketTimeout();
         }
@@ -74,36 +100,43 @@ void TcpSslServer::shutdown()
 
     if (m_processing == 0) {
         m_engine->serverShutdown();
-    } else {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<TcpSocket*>(child);
-            if (socket) {
-                socket->headerConnection = Socket::HeaderConnectionClose;
-                connect(socket, &TcpSocket::finished, [this] () {
-                    if (!m_processing) {
-                        m_engine->serverShutdown();
-                    }
-                });
+        return;
+    }
+
+    const auto childrenL = children();
+    for (auto child : childrenL) {
+        auto socket = qobject_cast<SslSocket*>(child);
+        if (socket) {
+            socket->headerConnection = Socket::HeaderConnectionClose;
+            connect(socket, &SslSocket::finished, this, [this] () {
+                if (!m_processing) {
+                    m_engine->serverShutdown();
+                }
+            });
+            if (!socket->processing) {
+                // idle keep-alive connection, close it now instead of
+                // waiting for its next request or the socket timeout
+                m_activityList.remove(socket);
+                socket->connectionClose();
             }
         }
     }
-}
 
-void TcpSslServer::timeoutConnections()
-{
     if (m_processing) {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<SslSocket*>(child);
-            if (socket && !socket->processing && socket->state() == QAbstractSocket::ConnectedState) {
-                if (socket->timeout) {
-                    socket->connectionClose();
-                } else {
-                    socket->timeout = true;
+        // in-flight requests get a deadline, past it the remaining
+        // connections are dropped so a worker restart cannot hang
+        // behind one slow client
+        QTimer::singleShot(m_wsgi->gracefulTimeout() * 1000, this, [this] () {
+            const auto childrenL = children();
+            for (auto child : childrenL) {
+                auto socket = qobject_cast<SslSocket*>(child);
+                if (socket && socket->processing) {
+                    m_activityList.remove(socket);
+                    socket->processing = false;
+                    socket->abort();
                 }
             }
-        }
+        });
     }
 }
 
@@ -38,7 +38,6 @@ public:
     virtual void incomingConnection(qintptr handle) override;
 
     virtual void shutdown() override;
-    virtual void timeoutConnections() override;
 
     void setSslConfiguration(const QSslConfiguration &conf);
 
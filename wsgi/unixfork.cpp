@@ -31,14 +31,23 @@
 #include <grp.h>
 
 #include <sys/socket.h>
+#include <sys/mman.h>
 #include <signal.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#ifndef MPOL_LOCAL
+#define MPOL_LOCAL 4
+#endif
+#endif
+
 #include <iostream>
 
 #include <QCoreApplication>
 #include <QSocketNotifier>
 #include <QTimer>
+#include <QDateTime>
 #include <QMutex>
 #include <QThread>
 #include <QFile>
@@ -52,6 +61,18 @@ Q_LOGGING_CATEGORY(WSGI_UNIX, "wsgi.unix")
 
 static int signalsFd[2];
 
+// Shared anonymous mapping created before fork(), one int per worker
+// slot holding that worker's current connection count. Each slot has a
+// single writer and the master only reads, so plain stores suffice; a
+// torn read at worst skews one sizing decision by a tick.
+static int *s_workerLoad = nullptr;
+static int s_workerLoadCount = 0;
+
+// Average in-flight connections per worker above which another worker
+// is forked, below half of it for this long one is retired
+#define CHEAPER_OVERLOAD 10
+#define CHEAPER_IDLE_MS 10000
+
 UnixFork::UnixFork(int process, int threads, QObject *parent) : AbstractFork(parent)
   , m_threads(threads)
   , m_processes(process)
@@ -96,16 +117,28 @@ int UnixFork::exec(bool lazy, bool master)
 
 void UnixFork::restart()
 {
-    auto it = m_childs.begin();
-    while (it != m_childs.end()) {
-        it.value().restart = 1; // Mark as requiring restart
-        terminateChild(it.key());
-        ++it;
-    }
+    // Rolling restart: replace one worker at a time so the rest keep
+    // serving, each replacement is forked from the warmed master
+    // image instead of paying a full application setup
+    m_restartQueue = m_childs.keys().toVector();
+    terminateNextForRestart();
 
     setupCheckChildTimer();
 }
 
+void UnixFork::terminateNextForRestart()
+{
+    while (!m_restartQueue.isEmpty()) {
+        const qint64 pid = m_restartQueue.takeFirst();
+        auto it = m_childs.find(pid);
+        if (it != m_childs.end()) {
+            it.value().restart = 1; // Mark as requiring restart
+            terminateChild(pid);
+            return;
+        }
+    }
+}
+
 int UnixFork::internalExec()
 {
     int ret;
@@ -139,8 +172,31 @@ bool UnixFork::createProcess(bool respawn)
             }
             m_recreateWorker.erase(it);
         }
+
+        // the replacement is up, move the rolling restart along
+        terminateNextForRestart();
     } else {
-        for (int i = 0; i < m_processes; ++i) {
+        int initial = m_processes;
+        if (m_cheaper > 0 && m_cheaper < m_processes) {
+            if (!s_workerLoad) {
+                void *mem = ::mmap(nullptr, sizeof(int) * size_t(m_processes),
+                                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+                if (mem != MAP_FAILED) {
+                    s_workerLoad = static_cast<int *>(mem);
+                    s_workerLoadCount = m_processes;
+                } else {
+                    qCWarning(WSGI_UNIX) << "Failed to map the worker load segment, disabling cheaper mode";
+                    m_cheaper = 0;
+                }
+            }
+
+            if (s_workerLoad) {
+                initial = m_cheaper;
+                setupCheaperTimer();
+            }
+        }
+
+        for (int i = 0; i < initial; ++i) {
             Worker worker;
             worker.id = i + 1;
             worker.null = false;
@@ -151,6 +207,99 @@ bool UnixFork::createProcess(bool respawn)
     return !m_childs.empty();
 }
 
+void UnixFork::setCheaper(int minProcesses)
+{
+    m_cheaper = minProcesses;
+}
+
+void UnixFork::reportWorkerLoad(int worker, int connections)
+{
+    if (s_workerLoad && worker >= 0 && worker < s_workerLoadCount) {
+        s_workerLoad[worker] = connections;
+    }
+}
+
+void UnixFork::setupCheaperTimer()
+{
+    if (!m_cheaperTimer) {
+        m_cheaperTimer = new QTimer(this);
+        m_cheaperTimer->start(1000);
+        connect(m_cheaperTimer, &QTimer::timeout, this, &UnixFork::checkWorkerLoad);
+    }
+}
+
+int UnixFork::firstFreeWorkerId() const
+{
+    int id = 1;
+    bool used;
+    do {
+        used = false;
+        for (const Worker &worker : m_childs) {
+            if (worker.id == id) {
+                used = true;
+                ++id;
+                break;
+            }
+        }
+    } while (used);
+
+    return id;
+}
+
+void UnixFork::checkWorkerLoad()
+{
+    if (m_child || m_terminating || !s_workerLoad || m_childs.isEmpty()) {
+        return;
+    }
+
+    int busy = 0;
+    for (const Worker &worker : m_childs) {
+        busy += s_workerLoad[worker.id - 1];
+    }
+
+    const int workers = m_childs.size();
+    if (busy >= workers * CHEAPER_OVERLOAD && workers < m_processes) {
+        m_underloadedSince = 0;
+
+        // forked from the warmed master image, the worker starts
+        // serving without paying a full application setup
+        Worker worker;
+        worker.id = firstFreeWorkerId();
+        worker.null = false;
+        std::cout << "cheaper: fleet is loaded (" << busy << " connections on "
+                  << workers << " workers), spawning worker " << worker.id << std::endl;
+        createChild(worker, true);
+    } else if (workers > m_cheaper && busy < (workers - 1) * CHEAPER_OVERLOAD / 2) {
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        if (!m_underloadedSince) {
+            m_underloadedSince = now;
+        } else if (now - m_underloadedSince >= CHEAPER_IDLE_MS) {
+            m_underloadedSince = 0;
+
+            // retire the youngest worker, marking it so SIGCHLD does
+            // not respawn it; SIGQUIT drains in-flight requests first
+            qint64 retirePid = 0;
+            int retireId = 0;
+            auto it = m_childs.begin();
+            while (it != m_childs.end()) {
+                if (it.value().id > retireId) {
+                    retireId = it.value().id;
+                    retirePid = it.key();
+                }
+                ++it;
+            }
+
+            if (retirePid) {
+                std::cout << "cheaper: fleet is quiet, CHEAPING worker " << retireId << std::endl;
+                m_childs[retirePid].null = true;
+                terminateChild(retirePid);
+            }
+        }
+    } else {
+        m_underloadedSince = 0;
+    }
+}
+
 void UnixFork::killChild()
 {
     const auto childs = m_childs.keys();
@@ -244,6 +393,7 @@ void UnixFork::postFork(int workerId)
 {
     // Child must not have parent timers
     delete m_checkChildRestart;
+    delete m_cheaperTimer;
 
     Q_EMIT forked(workerId - 1);
 }
@@ -416,9 +566,18 @@ int UnixFork::idealThreadCount()
 
 void UnixFork::handleSigHup()
 {
-    // do Qt stuff
-//    qDebug() << Q_FUNC_INFO << QCoreApplication::applicationPid();
-//    m_proc->kill();
+    if (m_child || m_childs.isEmpty()) {
+        Q_EMIT reload();
+    } else {
+        // master: pass the reload on, every worker process reparses
+        // its own copy of the configuration
+        std::cout << "SIGHUP received, reloading workers configuration..." << std::endl;
+        auto it = m_childs.constBegin();
+        while (it != m_childs.constEnd()) {
+            ::kill(pid_t(it.key()), SIGHUP);
+            ++it;
+        }
+    }
 }
 
 void UnixFork::handleSigTerm()
@@ -434,6 +593,7 @@ void UnixFork::handleSigInt()
     // do Qt stuff
 //    qDebug() << Q_FUNC_INFO << QCoreApplication::applicationPid();
     m_terminating = true;
+    m_restartQueue.clear(); // abort any rolling restart in flight
     if (m_child || (m_childs.isEmpty())) {
         Q_EMIT shutdown();
     } else {
@@ -465,6 +625,11 @@ void UnixFork::handleSigChld()
         if (it != m_childs.end()) {
             worker = it.value();
             m_childs.erase(it);
+
+            // the slot is free to be reused by a future worker
+            if (s_workerLoad && worker.id > 0 && worker.id <= s_workerLoadCount) {
+                s_workerLoad[worker.id - 1] = 0;
+            }
         }
 
         int exitStatus = WEXITSTATUS(status);
@@ -502,6 +667,27 @@ void UnixFork::handleSigChld()
     }
 }
 
+int UnixFork::affinityBaseCpu(CWSGI::WSGI *wsgi, int workerId, int workerCore)
+{
+    const int cpu_affinity = wsgi->cpuAffinity();
+    if (!cpu_affinity) {
+        return -1;
+    }
+
+    int base_cpu;
+    if (wsgi->threads().toInt() > 0) {
+        base_cpu = workerCore * cpu_affinity;
+    } else {
+        base_cpu = workerId * cpu_affinity;
+    }
+
+    const int coreCount = idealThreadCount();
+    if (base_cpu >= coreCount) {
+        base_cpu = base_cpu % coreCount;
+    }
+    return base_cpu;
+}
+
 void UnixFork::setSched(CWSGI::WSGI *wsgi, int workerId, int workerCore)
 {
     char buf[4096];
@@ -510,16 +696,7 @@ void UnixFork::setSched(CWSGI::WSGI *wsgi, int workerId, int workerCore)
     int cpu_affinity = wsgi->cpuAffinity();
     if (cpu_affinity) {
         int coreCount = idealThreadCount();
-        int base_cpu;
-        if (wsgi->threads().toInt() > 0) {
-            base_cpu = workerCore * cpu_affinity;
-        } else {
-            base_cpu = workerId * cpu_affinity;
-        }
-
-        if (base_cpu >= coreCount) {
-            base_cpu = base_cpu % coreCount;
-        }
+        int base_cpu = affinityBaseCpu(wsgi, workerId, workerCore);
         ret = snprintf(buf, 4096, "mapping worker %d core %d to CPUs:", workerId + 1, workerCore + 1);
         if (ret < 25 || ret >= 4096) {
             qCCritical(WSGI_UNIX) << "unable to initialize cpu affinity !!!";
@@ -556,6 +733,17 @@ void UnixFork::setSched(CWSGI::WSGI *wsgi, int workerId, int workerCore)
             qFatal("cpuset_setaffinity");
         }
 #endif
+
+#if defined(__linux__)
+        // With the CPUs pinned the local node no longer changes, so
+        // prefer it for future heap pages instead of leaving them on
+        // whichever node the scheduler first placed this worker. Raw
+        // syscall to avoid a libnuma dependency; kernels without
+        // MPOL_LOCAL (< 3.8) reject it with EINVAL, which is fine.
+        if (syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) && errno != EINVAL) {
+            qCWarning(WSGI_UNIX) << "failed to set local NUMA memory policy";
+        }
+#endif
         qCDebug(WSGI_UNIX) << buf;
     }
 }
@@ -607,6 +795,14 @@ int UnixFork::setupUnixSignalHandlers()
     if (sigaction(SIGCHLD, &action, 0) > 0)
         return SIGCHLD;
 
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = UnixFork::signalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags |= SA_RESTART;
+
+    if (sigaction(SIGHUP, &action, 0) > 0)
+        return SIGHUP;
+
     return 0;
 }
 
@@ -636,6 +832,9 @@ void UnixFork::setupSocketPair(bool closeSignalsFD)
         case SIGQUIT:
             handleSigInt();
             break;
+        case SIGHUP:
+            handleSigHup();
+            break;
         default:
             break;
         }
@@ -50,6 +50,19 @@ public:
 
     virtual void restart() override;
 
+    /**
+     * Enables elastic scaling: only \p minProcesses workers are
+     * started, the master forks more up to the process count when
+     * the fleet is loaded and drains them again when it is not.
+     */
+    void setCheaper(int minProcesses);
+
+    /**
+     * Called on a timer inside each worker to publish its current
+     * connection count into the segment shared with the master.
+     */
+    static void reportWorkerLoad(int worker, int connections);
+
     int internalExec();
 
     bool createProcess(bool respawn);
@@ -75,6 +88,7 @@ public:
     void handleSigChld();
 
     static void setSched(CWSGI::WSGI *wsgi, int workerId, int workerCore);
+    static int affinityBaseCpu(CWSGI::WSGI *wsgi, int workerId, int workerCore);
 
 private:
     int setupUnixSignalHandlers();
@@ -82,14 +96,22 @@ private:
     bool createChild(const Worker &worker, bool respawn);
     static void signalHandler(int signal);
     void setupCheckChildTimer();
+    void setupCheaperTimer();
+    void checkWorkerLoad();
+    int firstFreeWorkerId() const;
     void postFork(int workerId);
+    void terminateNextForRestart();
 
     QHash<qint64, Worker> m_childs;
     QVector<Worker> m_recreateWorker;
+    QVector<qint64> m_restartQueue;
     QSocketNotifier *m_signalNotifier = nullptr;
     QTimer *m_checkChildRestart = nullptr;
+    QTimer *m_cheaperTimer = nullptr;
+    qint64 m_underloadedSince = 0;
     int m_threads;
     int m_processes;
+    int m_cheaper = 0; // minimum worker count, 0 keeps the count fixed
     bool m_child = false;
     bool m_terminating = false;
 };
@@ -26,9 +26,16 @@
 #include "tcpserverbalancer.h"
 #include "tcpsslserver.h"
 #include "localserver.h"
+#include "asynclogger.h"
+#include "bufferalloc.h"
 
 #ifdef Q_OS_UNIX
 #include "unixfork.h"
+#include "profiler.h"
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <string.h>
 #else
 #include "windowsfork.h"
 #endif
@@ -36,6 +43,13 @@
 #ifdef Q_OS_LINUX
 #include "../EventLoopEPoll/eventdispatcher_epoll.h"
 #include "systemdnotify.h"
+#include "sharedmemorybus.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
 #endif
 
 #include <QCoreApplication>
@@ -83,6 +97,20 @@ WSGI::~WSGI()
     std::cout << "Cutelyst-WSGI terminated" << std::endl;
 }
 
+int WSGI::currentConnections() const
+{
+    Q_D(const WSGI);
+
+    int ret = 0;
+    for (QObject *server : d->servers) {
+        auto balancer = qobject_cast<TcpServerBalancer *>(server);
+        if (balancer) {
+            ret += balancer->load();
+        }
+    }
+    return ret;
+}
+
 void WSGI::parseCommandLine(const QStringList &arguments)
 {
     Q_D(WSGI);
@@ -131,6 +159,15 @@ void WSGI::parseCommandLine(const QStringList &arguments)
                                  QCoreApplication::translate("main", "spawn the specified number of processes"),
                                  QCoreApplication::translate("main", "processes"));
     parser.addOption(processes);
+
+    QCommandLineOption cheaperOpt(QStringLiteral("cheaper"),
+                                  QCoreApplication::translate("main", "keep only this many workers alive when idle, forking up to --processes under load"),
+                                  QCoreApplication::translate("main", "processes"));
+    parser.addOption(cheaperOpt);
+
+    QCommandLineOption lockMemoryOpt(QStringLiteral("lock-memory"),
+                                     QCoreApplication::translate("main", "lock worker memory resident after setup, needs CAP_IPC_LOCK"));
+    parser.addOption(lockMemoryOpt);
 #endif
 
     QCommandLineOption master({ QStringLiteral("master"), QStringLiteral("M") },
@@ -177,11 +214,46 @@ void WSGI::parseCommandLine(const QStringList &arguments)
                                      QCoreApplication::translate("main", "seconds"));
     parser.addOption(socketTimeout);
 
+    QCommandLineOption gracefulTimeoutOpt(QStringLiteral("graceful-timeout"),
+                                          QCoreApplication::translate("main", "seconds a shutting down worker waits for in-flight requests before dropping them"),
+                                          QCoreApplication::translate("main", "seconds"));
+    parser.addOption(gracefulTimeoutOpt);
+
+    QCommandLineOption maxConnectionsOpt(QStringLiteral("max-connections"),
+                                         QCoreApplication::translate("main", "answer new connections beyond this many per worker core with 503 instead of queueing them"),
+                                         QCoreApplication::translate("main", "connections"));
+    parser.addOption(maxConnectionsOpt);
+
+    QCommandLineOption maxRequestAgeOpt(QStringLiteral("max-request-age"),
+                                        QCoreApplication::translate("main", "shed requests that waited longer than this many seconds before dispatch"),
+                                        QCoreApplication::translate("main", "seconds"));
+    parser.addOption(maxRequestAgeOpt);
+
+    QCommandLineOption httpsRedirectOpt(QStringLiteral("https-redirect"),
+                                        QCoreApplication::translate("main", "redirect all plain HTTP requests permanently to this base URL"),
+                                        QCoreApplication::translate("main", "url"));
+    parser.addOption(httpsRedirectOpt);
+
     QCommandLineOption staticMapOpt(QStringLiteral("static-map"),
                                     QCoreApplication::translate("main", "map mountpoint to static directory (or file)"),
                                     QCoreApplication::translate("main", "mountpoint=path"));
     parser.addOption(staticMapOpt);
 
+    QCommandLineOption bodyLimitOpt(QStringLiteral("body-limit"),
+                                    QCoreApplication::translate("main", "reject bodies larger than this many bytes under the mountpoint with 413 before buffering them"),
+                                    QCoreApplication::translate("main", "mountpoint=bytes"));
+    parser.addOption(bodyLimitOpt);
+
+    QCommandLineOption bodyContentTypeOpt(QStringLiteral("body-content-type"),
+                                          QCoreApplication::translate("main", "reject bodies of other media types under the mountpoint with 415 before buffering them"),
+                                          QCoreApplication::translate("main", "mountpoint=types"));
+    parser.addOption(bodyContentTypeOpt);
+
+    QCommandLineOption batchEndpointOpt(QStringLiteral("batch-endpoint"),
+                                        QCoreApplication::translate("main", "dispatch requests under the mountpoint after other ready traffic, bounded so they cannot starve"),
+                                        QCoreApplication::translate("main", "mountpoint"));
+    parser.addOption(batchEndpointOpt);
+
     QCommandLineOption staticMap2Opt(QStringLiteral("static-map2"),
                                      QCoreApplication::translate("main", "like static-map but completely appending the requested resource to the docroot"),
                                      QCoreApplication::translate("main", "mountpoint=path"));
@@ -196,10 +268,28 @@ void WSGI::parseCommandLine(const QStringList &arguments)
                                       QCoreApplication::translate("main", "file"));
     parser.addOption(touchReloadOpt);
 
+    QCommandLineOption shadowOpt(QStringLiteral("shadow"),
+                                 QCoreApplication::translate("main", "duplicate a sample of parsed requests into per-worker capture files for cutelyst-wsgi-replay"),
+                                 QCoreApplication::translate("main", "path"));
+    parser.addOption(shadowOpt);
+
+    QCommandLineOption shadowRateOpt(QStringLiteral("shadow-rate"),
+                                     QCoreApplication::translate("main", "capture 1 in this many requests (default 100)"),
+                                     QCoreApplication::translate("main", "requests"));
+    parser.addOption(shadowRateOpt);
+
     QCommandLineOption tcpNoDelay(QStringLiteral("tcp-nodelay"),
                                   QCoreApplication::translate("main", "enable TCP NODELAY on each request"));
     parser.addOption(tcpNoDelay);
 
+    QCommandLineOption hugeBuffersOption(QStringLiteral("huge-buffers"),
+                                         QCoreApplication::translate("main", "back large buffers with huge pages"));
+    parser.addOption(hugeBuffersOption);
+
+    QCommandLineOption writeCoalesceOption(QStringLiteral("write-coalesce"),
+                                           QCoreApplication::translate("main", "coalesce small websocket writes into one syscall per socket"));
+    parser.addOption(writeCoalesceOption);
+
     QCommandLineOption soKeepAlive(QStringLiteral("so-keepalive"),
                                    QCoreApplication::translate("main", "enable TCP KEEPALIVEs"));
     parser.addOption(soKeepAlive);
@@ -219,6 +309,11 @@ void WSGI::parseCommandLine(const QStringList &arguments)
                                  QCoreApplication::translate("main", "Kbytes"));
     parser.addOption(wsMaxSize);
 
+    QCommandLineOption wsHeartbeat(QStringLiteral("websocket-heartbeat"),
+                                   QCoreApplication::translate("main", "ping idle websocket connections at this interval in seconds and close the ones that stop answering"),
+                                   QCoreApplication::translate("main", "seconds"));
+    parser.addOption(wsHeartbeat);
+
     QCommandLineOption pidfileOpt(QStringLiteral("pidfile"),
                                   QCoreApplication::translate("main", "create pidfile (before privileges drop)"),
                                   QCoreApplication::translate("main", "file"));
@@ -263,14 +358,35 @@ void WSGI::parseCommandLine(const QStringList &arguments)
                                          QCoreApplication::translate("main", "set CPU affinity with the number of CPUs available for each worker core"),
                                          QCoreApplication::translate("main", "core count"));
     parser.addOption(cpuAffinityOption);
+
+    QCommandLineOption profilerSocketOpt(QStringLiteral("profiler-socket"),
+                                         QCoreApplication::translate("main", "accept profiling commands on this unix socket, writing collapsed-stack profiles"),
+                                         QCoreApplication::translate("main", "path"));
+    parser.addOption(profilerSocketOpt);
 #endif // Q_OS_UNIX
 
 #ifdef Q_OS_LINUX
     QCommandLineOption reusePortOption(QStringLiteral("reuse-port"),
-                                       QCoreApplication::translate("main", "enable SO_REUSEPORT flag on socket (Linux 3.9+)"));
+                                       QCoreApplication::translate("main", "enable SO_REUSEPORT flag on socket (Linux 3.9+, default)"));
     parser.addOption(reusePortOption);
+
+    QCommandLineOption noReusePortOption(QStringLiteral("no-reuse-port"),
+                                         QCoreApplication::translate("main", "accept on a single shared socket instead of per worker SO_REUSEPORT sockets"));
+    parser.addOption(noReusePortOption);
 #endif
 
+    QCommandLineOption httpCompressionOpt(QStringLiteral("http-compression"),
+                                          QCoreApplication::translate("main", "gzip compress eligible response bodies when the client accepts it"));
+    parser.addOption(httpCompressionOpt);
+
+    QCommandLineOption metricsOpt(QStringLiteral("metrics"),
+                                  QCoreApplication::translate("main", "serve request counters and latency quantiles on GET /metrics (Prometheus text format)"));
+    parser.addOption(metricsOpt);
+
+    QCommandLineOption http2Opt(QStringLiteral("http2"),
+                                QCoreApplication::translate("main", "offer HTTP/2 on HTTPS sockets through ALPN"));
+    parser.addOption(http2Opt);
+
     QCommandLineOption threadBalancerOpt(QStringLiteral("experimental-thread-balancer"),
                                          QCoreApplication::translate("main", "balances new connections to threads using round-robin"));
     parser.addOption(threadBalancerOpt);
@@ -317,6 +433,37 @@ void WSGI::parseCommandLine(const QStringList &arguments)
         }
     }
 
+    if (parser.isSet(gracefulTimeoutOpt)) {
+        bool ok;
+        auto size = parser.value(gracefulTimeoutOpt).toInt(&ok);
+        setGracefulTimeout(size);
+        if (!ok || size < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(maxConnectionsOpt)) {
+        bool ok;
+        auto size = parser.value(maxConnectionsOpt).toInt(&ok);
+        setMaxConnections(size);
+        if (!ok || size < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(maxRequestAgeOpt)) {
+        bool ok;
+        auto size = parser.value(maxRequestAgeOpt).toInt(&ok);
+        setMaxRequestAge(size);
+        if (!ok || size < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(httpsRedirectOpt)) {
+        setHttpsRedirect(parser.value(httpsRedirectOpt));
+    }
+
     if (parser.isSet(pidfileOpt)) {
         setPidfile(parser.value(pidfileOpt));
     }
@@ -334,6 +481,19 @@ void WSGI::parseCommandLine(const QStringList &arguments)
         setProcesses(parser.value(processes));
     }
 
+    if (parser.isSet(cheaperOpt)) {
+        bool ok;
+        int cheaper = parser.value(cheaperOpt).toInt(&ok);
+        setCheaper(cheaper);
+        if (!ok || cheaper < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(lockMemoryOpt)) {
+        setLockMemory(true);
+    }
+
     if (parser.isSet(uidOption)) {
         setUid(parser.value(uidOption));
     }
@@ -362,14 +522,34 @@ void WSGI::parseCommandLine(const QStringList &arguments)
             parser.showHelp(1);
         }
     }
+
+    if (parser.isSet(profilerSocketOpt)) {
+        setProfilerSocket(parser.value(profilerSocketOpt));
+    }
 #endif // Q_OS_UNIX
 
 #ifdef Q_OS_LINUX
     if (parser.isSet(reusePortOption)) {
         setReusePort(true);
     }
+
+    if (parser.isSet(noReusePortOption)) {
+        setReusePort(false);
+    }
 #endif
 
+    if (parser.isSet(httpCompressionOpt)) {
+        setHttpCompression(true);
+    }
+
+    if (parser.isSet(metricsOpt)) {
+        setMetrics(true);
+    }
+
+    if (parser.isSet(http2Opt)) {
+        setHttp2(true);
+    }
+
     if (parser.isSet(lazyOption)) {
         setLazy(true);
     }
@@ -417,6 +597,14 @@ void WSGI::parseCommandLine(const QStringList &arguments)
         setTcpNodelay(true);
     }
 
+    if (parser.isSet(hugeBuffersOption)) {
+        setHugeBuffers(true);
+    }
+
+    if (parser.isSet(writeCoalesceOption)) {
+        setWriteCoalesce(true);
+    }
+
     if (parser.isSet(soKeepAlive)) {
         setSoKeepalive(true);
     }
@@ -448,6 +636,15 @@ void WSGI::parseCommandLine(const QStringList &arguments)
         }
     }
 
+    if (parser.isSet(wsHeartbeat)) {
+        bool ok;
+        auto seconds = parser.value(wsHeartbeat).toInt(&ok);
+        setWebsocketHeartbeat(seconds);
+        if (!ok || seconds < 0) {
+            parser.showHelp(1);
+        }
+    }
+
     setHttpSocket(httpSocket() + parser.values(httpSocketOpt));
 
     setHttpsSocket(httpsSocket() + parser.values(httpsSocketOpt));
@@ -458,8 +655,27 @@ void WSGI::parseCommandLine(const QStringList &arguments)
 
     setStaticMap2(staticMap2() + parser.values(staticMap2Opt));
 
+    setBodyLimit(bodyLimit() + parser.values(bodyLimitOpt));
+
+    setBodyContentType(bodyContentType() + parser.values(bodyContentTypeOpt));
+
+    setBatchEndpoint(batchEndpoint() + parser.values(batchEndpointOpt));
+
     setTouchReload(touchReload() + parser.values(touchReloadOpt));
 
+    if (parser.isSet(shadowOpt)) {
+        setShadow(parser.value(shadowOpt));
+    }
+
+    if (parser.isSet(shadowRateOpt)) {
+        bool ok;
+        auto rate = parser.value(shadowRateOpt).toInt(&ok);
+        setShadowRate(rate);
+        if (!ok || rate < 1) {
+            parser.showHelp(1);
+        }
+    }
+
     d->threadBalancer = parser.isSet(threadBalancerOpt);
 }
 
@@ -485,7 +701,11 @@ int WSGI::exec(Cutelyst::Application *app)
     if (d->processes == 0 && d->master) {
         d->processes = 1;
     }
-    d->genericFork = new UnixFork(d->processes, qMax(d->threads, 1), this);
+    auto unixFork = new UnixFork(d->processes, qMax(d->threads, 1), this);
+    if (d->cheaper > 0) {
+        unixFork->setCheaper(qMin(d->cheaper, d->processes));
+    }
+    d->genericFork = unixFork;
 #else
     if (d->processes == -1) {
         d->processes = 1;
@@ -498,6 +718,7 @@ int WSGI::exec(Cutelyst::Application *app)
 
     connect(d->genericFork, &AbstractFork::forked, d, &WSGIPrivate::postFork, Qt::DirectConnection);
     connect(d->genericFork, &AbstractFork::shutdown, d, &WSGIPrivate::shutdown, Qt::DirectConnection);
+    connect(d->genericFork, &AbstractFork::reload, d, &WSGIPrivate::reloadConfig);
 
     if (d->master && d->lazy) {
         if (d->autoReload && !d->application.isEmpty()) {
@@ -515,6 +736,10 @@ int WSGI::exec(Cutelyst::Application *app)
     systemdNotify::install_systemd_notifier(this);
 #endif
 
+    // before the first Protocol or Socket allocates a buffer, the
+    // setting must not change once buffers exist
+    BufferAlloc::setHugePages(d->hugeBuffers);
+
     // TCP needs root privileges
     d->listenTcpSockets();
 
@@ -559,6 +784,12 @@ int WSGI::exec(Cutelyst::Application *app)
         d->setupApplication();
     }
 
+#ifdef Q_OS_LINUX
+    // created before fork() so every worker inherits the mapping and
+    // the doorbells
+    SharedMemoryBus::create(d->processes);
+#endif
+
     ret = d->genericFork->exec(d->lazy, d->master);
 
     return ret;
@@ -726,6 +957,43 @@ bool WSGIPrivate::listenLocal(const QString &line, Protocol *protocol)
                   << " fd " << QByteArray::number(server->socket()).constData()
                   << std::endl;
         servers.push_back(server);
+#ifdef Q_OS_LINUX
+    } else if (line.startsWith(QLatin1Char('@'))) {
+        // Abstract namespace socket: no filesystem node, so there is
+        // no stale socket file to remove, no mode or ownership to fix
+        // up, and the name vanishes with the last listener. The fd is
+        // created by hand as QLocalServer cannot bind these by name.
+        auto server = new LocalServer(q, this);
+        server->setProtocol(protocol);
+
+        const QByteArray name = line.midRef(1).toUtf8();
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        bool ok = fd != -1 && name.size() + 1 < int(sizeof(sockaddr_un().sun_path));
+        if (ok) {
+            sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            // sun_path[0] stays 0, marking the abstract namespace
+            memcpy(addr.sun_path + 1, name.constData(), name.size());
+            const socklen_t len = offsetof(sockaddr_un, sun_path) + 1 + name.size();
+            ok = ::bind(fd, reinterpret_cast<sockaddr *>(&addr), len) == 0
+                    && ::listen(fd, 100) == 0
+                    && server->listen(fd);
+        }
+        server->pauseAccepting();
+
+        if (!ok || !server->socket()) {
+            std::cout << "Failed to listen on abstract LOCAL: " << qPrintable(line)
+                      << " : " << qPrintable(server->errorString()) << std::endl;
+            exit(1);
+        }
+
+        std::cout << "WSGI socket " << QByteArray::number(static_cast<int>(servers.size())).constData()
+                  << " bound to abstract LOCAL address " << qPrintable(line)
+                  << " fd " << QByteArray::number(server->socket()).constData()
+                  << std::endl;
+        servers.push_back(server);
+#endif
     }
 
     return ret;
@@ -781,6 +1049,30 @@ QString WSGI::processes() const
     }
     return QString::number(d->processes);
 }
+
+void WSGI::setCheaper(int cheaper)
+{
+    Q_D(WSGI);
+    d->cheaper = cheaper;
+}
+
+int WSGI::cheaper() const
+{
+    Q_D(const WSGI);
+    return d->cheaper;
+}
+
+void WSGI::setLockMemory(bool enable)
+{
+    Q_D(WSGI);
+    d->lockMemory = enable;
+}
+
+bool WSGI::lockMemory() const
+{
+    Q_D(const WSGI);
+    return d->lockMemory;
+}
 #endif
 
 void WSGI::setChdir(const QString &chdir)
@@ -855,6 +1147,57 @@ int WSGI::socketTimeout() const
     return d->socketTimeout;
 }
 
+void WSGI::setGracefulTimeout(int timeout)
+{
+    Q_D(WSGI);
+    d->gracefulTimeout = timeout;
+}
+
+int WSGI::gracefulTimeout() const
+{
+    Q_D(const WSGI);
+    return d->gracefulTimeout;
+}
+
+void WSGI::setMaxConnections(int connections)
+{
+    Q_D(WSGI);
+    d->maxConnections = connections;
+}
+
+int WSGI::maxConnections() const
+{
+    Q_D(const WSGI);
+    return d->maxConnections;
+}
+
+void WSGI::setMaxRequestAge(int seconds)
+{
+    Q_D(WSGI);
+    d->maxRequestAge = seconds;
+}
+
+int WSGI::maxRequestAge() const
+{
+    Q_D(const WSGI);
+    return d->maxRequestAge;
+}
+
+void WSGI::setHttpsRedirect(const QString &base)
+{
+    Q_D(WSGI);
+    d->httpsRedirect = base;
+    while (d->httpsRedirect.endsWith(QLatin1Char('/'))) {
+        d->httpsRedirect.chop(1);
+    }
+}
+
+QString WSGI::httpsRedirect() const
+{
+    Q_D(const WSGI);
+    return d->httpsRedirect;
+}
+
 void WSGI::setChdir2(const QString &chdir2)
 {
     Q_D(WSGI);
@@ -915,6 +1258,42 @@ QStringList WSGI::staticMap2() const
     return d->staticMaps2;
 }
 
+void WSGI::setBodyLimit(const QStringList &bodyLimit)
+{
+    Q_D(WSGI);
+    d->bodyLimits = bodyLimit;
+}
+
+QStringList WSGI::bodyLimit() const
+{
+    Q_D(const WSGI);
+    return d->bodyLimits;
+}
+
+void WSGI::setBodyContentType(const QStringList &bodyContentType)
+{
+    Q_D(WSGI);
+    d->bodyContentTypes = bodyContentType;
+}
+
+QStringList WSGI::bodyContentType() const
+{
+    Q_D(const WSGI);
+    return d->bodyContentTypes;
+}
+
+void WSGI::setBatchEndpoint(const QStringList &batchEndpoint)
+{
+    Q_D(WSGI);
+    d->batchEndpoints = batchEndpoint;
+}
+
+QStringList WSGI::batchEndpoint() const
+{
+    Q_D(const WSGI);
+    return d->batchEndpoints;
+}
+
 void WSGI::setMaster(bool enable)
 {
     Q_D(WSGI);
@@ -955,6 +1334,30 @@ QStringList WSGI::touchReload() const
     return d->touchReload;
 }
 
+void WSGI::setShadow(const QString &path)
+{
+    Q_D(WSGI);
+    d->shadow = path;
+}
+
+QString WSGI::shadow() const
+{
+    Q_D(const WSGI);
+    return d->shadow;
+}
+
+void WSGI::setShadowRate(int rate)
+{
+    Q_D(WSGI);
+    d->shadowRate = rate;
+}
+
+int WSGI::shadowRate() const
+{
+    Q_D(const WSGI);
+    return d->shadowRate;
+}
+
 void WSGI::setBufferSize(qint64 size)
 {
     Q_D(WSGI);
@@ -1011,6 +1414,30 @@ bool WSGI::tcpNodelay() const
     return d->tcpNodelay;
 }
 
+void WSGI::setHugeBuffers(bool enable)
+{
+    Q_D(WSGI);
+    d->hugeBuffers = enable;
+}
+
+bool WSGI::hugeBuffers() const
+{
+    Q_D(const WSGI);
+    return d->hugeBuffers;
+}
+
+void WSGI::setWriteCoalesce(bool enable)
+{
+    Q_D(WSGI);
+    d->writeCoalesce = enable;
+}
+
+bool WSGI::writeCoalesce() const
+{
+    Q_D(const WSGI);
+    return d->writeCoalesce;
+}
+
 void WSGI::setSoKeepalive(bool enable)
 {
     Q_D(WSGI);
@@ -1059,6 +1486,18 @@ int WSGI::websocketMaxSize() const
     return d->websocketMaxSize / 1024;
 }
 
+void WSGI::setWebsocketHeartbeat(int seconds)
+{
+    Q_D(WSGI);
+    d->websocketHeartbeat = seconds;
+}
+
+int WSGI::websocketHeartbeat() const
+{
+    Q_D(const WSGI);
+    return d->websocketHeartbeat;
+}
+
 void WSGI::setPidfile(const QString &file)
 {
     Q_D(WSGI);
@@ -1155,6 +1594,18 @@ int WSGI::cpuAffinity() const
     Q_D(const WSGI);
     return d->cpuAffinity;
 }
+
+void WSGI::setProfilerSocket(const QString &path)
+{
+    Q_D(WSGI);
+    d->profilerSocket = path;
+}
+
+QString WSGI::profilerSocket() const
+{
+    Q_D(const WSGI);
+    return d->profilerSocket;
+}
 #endif
 
 #ifdef Q_OS_LINUX
@@ -1171,6 +1622,42 @@ bool WSGI::reusePort() const
 }
 #endif
 
+void WSGI::setHttpCompression(bool enable)
+{
+    Q_D(WSGI);
+    d->httpCompression = enable;
+}
+
+bool WSGI::httpCompression() const
+{
+    Q_D(const WSGI);
+    return d->httpCompression;
+}
+
+void WSGI::setMetrics(bool enable)
+{
+    Q_D(WSGI);
+    d->metrics = enable;
+}
+
+bool WSGI::metrics() const
+{
+    Q_D(const WSGI);
+    return d->metrics;
+}
+
+void WSGI::setHttp2(bool enable)
+{
+    Q_D(WSGI);
+    d->http2 = enable;
+}
+
+bool WSGI::http2() const
+{
+    Q_D(const WSGI);
+    return d->http2;
+}
+
 void WSGI::setLazy(bool enable)
 {
     Q_D(WSGI);
@@ -1262,12 +1749,74 @@ void WSGIPrivate::workerStarted()
     }
 }
 
+#ifdef Q_OS_LINUX
+static void logWorkerMemorySharing(int workerId)
+{
+    // Sum the kernel's per mapping accounting so the copy-on-write
+    // sharing of state loaded before the fork (see WSGI::setLazy)
+    // can be verified: pages still shared with the master show up
+    // as Shared_*, pages a worker has written to as Private_Dirty.
+    QFile smaps(QStringLiteral("/proc/self/smaps"));
+    if (!smaps.open(QFile::ReadOnly | QFile::Text)) {
+        return;
+    }
+
+    qint64 sharedKb = 0;
+    qint64 privateKb = 0;
+    char buf[1024];
+    qint64 len;
+    while ((len = smaps.readLine(buf, sizeof(buf))) > 0) {
+        if (!strncmp(buf, "Shared_Clean:", 13) || !strncmp(buf, "Shared_Dirty:", 13)) {
+            sharedKb += strtoll(buf + 13, nullptr, 10);
+        } else if (!strncmp(buf, "Private_Clean:", 14) || !strncmp(buf, "Private_Dirty:", 14)) {
+            privateKb += strtoll(buf + 14, nullptr, 10);
+        }
+    }
+
+    qCDebug(CUTELYST_WSGI) << "Worker" << workerId << "resident memory: shared"
+                           << sharedKb << "kB, private" << privateKb << "kB";
+}
+#endif
+
 void WSGIPrivate::postFork(int workerId)
 {
+    AsyncLogger::postFork();
+
+#ifdef Q_OS_LINUX
+    SharedMemoryBus::attach(workerId);
+#endif
+
     if (lazy) {
         setupApplication();
     }
 
+#ifdef Q_OS_LINUX
+    if (CUTELYST_WSGI().isDebugEnabled()) {
+        logWorkerMemorySharing(workerId);
+    }
+#endif
+
+#ifdef Q_OS_UNIX
+    if (lockMemory) {
+        // with the application set up every page the dispatcher and
+        // the caches need is mapped, pin them so memory pressure
+        // cannot page them out under the request path
+        if (::mlockall(MCL_CURRENT)) {
+            qCWarning(CUTELYST_WSGI) << "Failed to lock worker memory:" << strerror(errno);
+        }
+    }
+#endif
+
+    // the watchers have to start after the fork, every worker
+    // process reloads rotated certificates into its own copy of
+    // the listener configuration
+    for (QObject *server : servers) {
+        auto balancer = qobject_cast<TcpServerBalancer *>(server);
+        if (balancer) {
+            balancer->startSslCertWatcher();
+        }
+    }
+
     if (engines.size() > 1) {
         qCDebug(CUTELYST_WSGI) << "Starting threads";
     }
@@ -1285,6 +1834,29 @@ void WSGIPrivate::postFork(int workerId)
         }
     }
 
+#ifdef Q_OS_UNIX
+    if (!profilerSocket.isEmpty()) {
+        QString path = profilerSocket;
+        if (processes > 1) {
+            // every worker process profiles itself, each gets its
+            // own command socket
+            path += QLatin1Char('.') + QString::number(workerId);
+        }
+        auto profiler = new Profiler(this);
+        profiler->listen(path);
+    }
+
+    if (cheaper > 0) {
+        // publish this worker's load so the master can size the fleet
+        auto loadTimer = new QTimer(this);
+        connect(loadTimer, &QTimer::timeout, this, [this, workerId] {
+            Q_Q(WSGI);
+            UnixFork::reportWorkerLoad(workerId, q->currentConnections());
+        });
+        loadTimer->start(1000);
+    }
+#endif
+
     Q_EMIT postForked(workerId);
 
     QTimer::singleShot(1000, this, [=]() {
@@ -1324,6 +1896,9 @@ CWsgiEngine *WSGIPrivate::createEngine(Application *app, int core)
     connect(engine, &CWsgiEngine::started, this, &WSGIPrivate::workerStarted, Qt::QueuedConnection);
 
     engine->setConfig(config);
+    // a reloaded configuration is swapped on the engine's own event
+    // loop, between the requests it is processing
+    connect(this, &WSGIPrivate::configReloaded, engine, &CWsgiEngine::setConfig, Qt::QueuedConnection);
     engine->setServers(servers);
     if (!engine->init()) {
         qCCritical(CUTELYST_WSGI) << "Failed to init engine for core:" << core;
@@ -1384,7 +1959,7 @@ void WSGIPrivate::loadConfig(const QString &file, bool json)
     config = loadedConfig;
 }
 
-void WSGIPrivate::applyConfig(const QVariantMap &config)
+void WSGIPrivate::applyConfig(const QVariantMap &config, bool reload)
 {
     Q_Q(WSGI);
 
@@ -1401,16 +1976,18 @@ void WSGIPrivate::applyConfig(const QVariantMap &config)
 
         const QVariant value = it.value();
         const QMetaProperty prop = q->metaObject()->property(ix);
-        if (prop.type() == value.type()) {
-            if (prop.type() == QVariant::StringList) {
+        if (prop.type() == QVariant::StringList) {
+            // list options accumulate (sockets, static maps); they
+            // are structural boot options, reapplying them on a
+            // reload would only grow duplicates
+            if (!reload) {
                 const QStringList currentValues = prop.read(q).toStringList();
-                prop.write(q, currentValues + value.toStringList());
-            } else {
-                prop.write(q, value);
+                if (value.type() == QVariant::StringList) {
+                    prop.write(q, currentValues + value.toStringList());
+                } else {
+                    prop.write(q, currentValues + QStringList{ value.toString() });
+                }
             }
-        } else if (prop.type() == QVariant::StringList) {
-            const QStringList currentValues = prop.read(q).toStringList();
-            prop.write(q, currentValues + QStringList{ value.toString() });
         } else {
             prop.write(q, value);
         }
@@ -1419,4 +1996,36 @@ void WSGIPrivate::applyConfig(const QVariantMap &config)
     }
 }
 
+void WSGIPrivate::reloadConfig()
+{
+    if (ini.isEmpty() && json.isEmpty()) {
+        qCInfo(CUTELYST_WSGI) << "SIGHUP received but there are no configuration files to reload";
+        return;
+    }
+
+    std::cout << "Reloading configuration..." << std::endl;
+
+    // reparse from scratch; loadConfig() merges with entries already
+    // present taking precedence, so stale values must go first
+    opt.clear();
+    config.clear();
+    const QStringList iniFiles = ini;
+    for (const QString &file : iniFiles) {
+        loadConfig(file, false);
+    }
+    const QStringList jsonFiles = json;
+    for (const QString &file : jsonFiles) {
+        loadConfig(file, true);
+    }
+
+    // options the server reads at runtime - timeouts, request age,
+    // heartbeats - take effect right away; structural ones (sockets,
+    // worker counts, buffer sizes baked into the protocols at boot)
+    // keep their values until a real restart
+    applyConfig(opt, true);
+
+    // swap the application-facing sections on every worker core
+    Q_EMIT configReloaded(config);
+}
+
 #include "moc_wsgi_p.cpp"
@@ -64,6 +64,13 @@ public:
      */
     int exec(Cutelyst::Application *app = nullptr);
 
+    /**
+     * Returns the number of connections currently accepted or queued
+     * on the listeners of this process, summed over all cores. Cheap
+     * enough to poll, the counters are kept by the servers anyway.
+     */
+    int currentConnections() const;
+
     /**
      * Defines application file path to be loaded, an alternative is to provide
      * the Cutelyst::Application pointer to exec()
@@ -89,6 +96,33 @@ public:
     Q_PROPERTY(QString processes READ processes WRITE setProcesses)
     void setProcesses(const QString &process);
     QString processes() const;
+
+    /**
+     * Defines the minimum number of worker processes kept alive,
+     * enabling elastic scaling between this and the processes count.
+     * The master starts this many workers and watches per-worker load
+     * through a shared segment; when the fleet is saturated it forks
+     * additional workers from its warmed image, and after a sustained
+     * quiet period it drains the extra ones again. Defaults to 0,
+     * meaning a fixed process count.
+     * @accessors cheaper(), setCheaper()
+     */
+    Q_PROPERTY(int cheaper READ cheaper WRITE setCheaper)
+    void setCheaper(int cheaper);
+    int cheaper() const;
+
+    /**
+     * Locks every page the worker has mapped once setup is done, so
+     * dispatch tables, caches and buffer pools stay resident when the
+     * host comes under memory pressure instead of being paged out and
+     * revived through fault storms. Needs CAP_IPC_LOCK or a matching
+     * RLIMIT_MEMLOCK; when locking fails a warning is logged and the
+     * worker continues unlocked.
+     * @accessors lockMemory(), setLockMemory()
+     */
+    Q_PROPERTY(bool lock_memory READ lockMemory WRITE setLockMemory)
+    void setLockMemory(bool enable);
+    bool lockMemory() const;
 #endif
 
     /**
@@ -139,6 +173,53 @@ public:
     void setSocketTimeout(int timeout);
     int socketTimeout() const;
 
+    /**
+     * Defines how many seconds a shutting down worker waits for
+     * in-flight requests to finish before dropping the remaining
+     * connections. Idle keep-alive connections are closed right away.
+     * @accessors gracefulTimeout(), setGracefulTimeout()
+     */
+    Q_PROPERTY(int graceful_timeout READ gracefulTimeout WRITE setGracefulTimeout)
+    void setGracefulTimeout(int timeout);
+    int gracefulTimeout() const;
+
+    /**
+     * Defines the maximum number of open connections per worker core,
+     * new connections beyond it are answered with a canned 503 and
+     * closed instead of queueing invisibly. 0 (the default) means
+     * unlimited.
+     * @accessors maxConnections(), setMaxConnections()
+     */
+    Q_PROPERTY(int max_connections READ maxConnections WRITE setMaxConnections)
+    void setMaxConnections(int connections);
+    int maxConnections() const;
+
+    /**
+     * Defines the maximum age in seconds a request may have waited
+     * since its first byte arrived before dispatch; older requests
+     * are shed with a 503, the client has usually given up on them
+     * already. 0 (the default) disables the deadline.
+     * @accessors maxRequestAge(), setMaxRequestAge()
+     */
+    Q_PROPERTY(int max_request_age READ maxRequestAge WRITE setMaxRequestAge)
+    void setMaxRequestAge(int seconds);
+    int maxRequestAge() const;
+
+    /**
+     * Defines a base URL, e.g. https://example.com, every request on
+     * the plain HTTP listeners is answered with as a permanent
+     * redirect to base plus the request target. The redirect is
+     * emitted right after the request line is parsed, without
+     * running the application, so a listener kept on port 80 only to
+     * send clients to HTTPS costs a fraction of a dispatched
+     * request. Connections opening with a TLS handshake instead of a
+     * request line are closed immediately.
+     * @accessors httpsRedirect(), setHttpsRedirect()
+     */
+    Q_PROPERTY(QString https_redirect READ httpsRedirect WRITE setHttpsRedirect)
+    void setHttpsRedirect(const QString &base);
+    QString httpsRedirect() const;
+
     /**
      * Defines directory to chdir to after application loading
      * @accessors chdir2(), setChdir2()
@@ -179,6 +260,42 @@ public:
     void setStaticMap2(const QStringList &staticMap);
     QStringList staticMap2() const;
 
+    /**
+     * Maps a path prefix to the maximum request body size in bytes
+     * accepted below it, as mountpoint=bytes. A longer Content-Length
+     * is answered 413 right after the headers, before a byte of the
+     * body is buffered.
+     * @accessors bodyLimit(), setBodyLimit()
+     */
+    Q_PROPERTY(QStringList body_limit READ bodyLimit WRITE setBodyLimit)
+    void setBodyLimit(const QStringList &bodyLimit);
+    QStringList bodyLimit() const;
+
+    /**
+     * Maps a path prefix to the media types accepted in request
+     * bodies below it, as mountpoint=type,type... matched as
+     * case-insensitive prefixes of the Content-Type header. A body
+     * of any other type is answered 415 right after the headers,
+     * before a byte of it is buffered.
+     * @accessors bodyContentType(), setBodyContentType()
+     */
+    Q_PROPERTY(QStringList body_content_type READ bodyContentType WRITE setBodyContentType)
+    void setBodyContentType(const QStringList &bodyContentType);
+    QStringList bodyContentType() const;
+
+    /**
+     * Marks the paths below these mountpoints as batch traffic.
+     * Dispatching a request under one of them yields the event loop
+     * first, so interactive requests already readable on other
+     * connections of the worker run ahead of it. The deferral is
+     * bounded to a few passes, past that the request is dispatched
+     * regardless, so batch endpoints cannot starve.
+     * @accessors batchEndpoint(), setBatchEndpoint()
+     */
+    Q_PROPERTY(QStringList batch_endpoint READ batchEndpoint WRITE setBatchEndpoint)
+    void setBatchEndpoint(const QStringList &batchEndpoint);
+    QStringList batchEndpoint() const;
+
     /**
      * Defines if a master process should be created to watch for it's
      * child processes
@@ -204,6 +321,26 @@ public:
     void setTouchReload(const QStringList &files);
     QStringList touchReload() const;
 
+    /**
+     * Duplicates a sample of parsed requests into per-worker capture
+     * files starting with this path, in a compact binary format the
+     * cutelyst-wsgi-replay tool can feed back through an application
+     * at a controlled rate. Capturing happens off the request path.
+     * @accessors shadow(), setShadow()
+     */
+    Q_PROPERTY(QString shadow READ shadow WRITE setShadow)
+    void setShadow(const QString &path);
+    QString shadow() const;
+
+    /**
+     * Defines the shadow sample as 1 in this many requests,
+     * defaults to 100; 1 captures every request
+     * @accessors shadowRate(), setShadowRate()
+     */
+    Q_PROPERTY(int shadow_rate READ shadowRate WRITE setShadowRate)
+    void setShadowRate(int rate);
+    int shadowRate() const;
+
     /**
      * Defines the buffer size used when parsing requests
      * @accessors bufferSize(), setBufferSize()
@@ -229,6 +366,28 @@ public:
     void setPostBufferingBufsize(qint64 size);
     qint64 postBufferingBufsize() const;
 
+    /**
+     * Back the server's large buffers (socket parse buffers and the
+     * post spool buffer) with 2 MiB huge pages when they reach that
+     * size, falling back to transparent huge pages and then to the
+     * heap. Defaults to false.
+     * @accessors hugeBuffers(), setHugeBuffers()
+     */
+    Q_PROPERTY(bool huge_buffers READ hugeBuffers WRITE setHugeBuffers)
+    void setHugeBuffers(bool enable);
+    bool hugeBuffers() const;
+
+    /**
+     * Coalesce small websocket writes landing within one event loop
+     * pass into a single send syscall per socket, trading a pass of
+     * latency for far fewer syscalls on large fanouts. Defaults to
+     * false.
+     * @accessors writeCoalesce(), setWriteCoalesce()
+     */
+    Q_PROPERTY(bool write_coalesce READ writeCoalesce WRITE setWriteCoalesce)
+    void setWriteCoalesce(bool enable);
+    bool writeCoalesce() const;
+
     /**
      * Enable TCP NODELAY on each request
      * @accessors tcpNodelay(), setTcpNodelay()
@@ -269,6 +428,19 @@ public:
     void setWebsocketMaxSize(int value);
     int websocketMaxSize() const;
 
+    /**
+     * Defines the interval in seconds between engine-managed
+     * websocket heartbeats. A connection with no traffic for one
+     * interval is sent a ping by the server, one that stays silent
+     * for a second interval is closed; the application needs no
+     * timer or ping frame of its own. 0 (the default) leaves
+     * liveness to the application.
+     * @accessors %websocketHeartbeat(), setWebsocketHeartbeat()
+     */
+    Q_PROPERTY(int websocket_heartbeat READ websocketHeartbeat WRITE setWebsocketHeartbeat)
+    void setWebsocketHeartbeat(int seconds);
+    int websocketHeartbeat() const;
+
     /**
      * Defines the pid file to be written before privileges drop
      * @accessors pidfile(), setPidfile()
@@ -333,11 +505,27 @@ public:
     Q_PROPERTY(int cpu_affinity READ cpuAffinity WRITE setCpuAffinity)
     void setCpuAffinity(int value);
     int cpuAffinity() const;
+
+    /**
+     * Defines a unix socket each worker answers profiling commands
+     * on, created with user-only access. Writing "profile <seconds>"
+     * to it samples the worker threads in-process for that long and
+     * writes the result as collapsed stacks ready for flamegraph.pl.
+     * With multiple worker processes each one listens on the path
+     * suffixed with its worker id.
+     * @accessors profilerSocket(), setProfilerSocket()
+     */
+    Q_PROPERTY(QString profiler_socket READ profilerSocket WRITE setProfilerSocket)
+    void setProfilerSocket(const QString &path);
+    QString profilerSocket() const;
 #endif
 
 #ifdef Q_OS_LINUX
     /**
-     * Enable SO_REUSEPORT for the sockets
+     * Enable SO_REUSEPORT for the sockets, so each worker core
+     * listens on its own socket clone and the kernel balances
+     * accepts across cores. Enabled by default on Linux 3.9+,
+     * falls back to a single shared listen socket on older kernels.
      * @accessors reusePort(), setReusePort()
      */
     Q_PROPERTY(bool reuse_port READ reusePort WRITE setReusePort)
@@ -345,8 +533,53 @@ public:
     bool reusePort() const;
 #endif
 
+    /**
+     * Defines if eligible response bodies should be gzip compressed
+     * when the client accepts it. Needs cutelyst-wsgi built with zlib,
+     * a no-op otherwise.
+     * @accessors httpCompression(), setHttpCompression()
+     */
+    Q_PROPERTY(bool http_compression READ httpCompression WRITE setHttpCompression)
+    void setHttpCompression(bool enable);
+    bool httpCompression() const;
+
+    /**
+     * Defines if GET /metrics is answered by the engine with request
+     * counters and per-action latency quantiles in the Prometheus
+     * text format, without going through the application dispatcher.
+     * @accessors metrics(), setMetrics()
+     */
+    Q_PROPERTY(bool metrics READ metrics WRITE setMetrics)
+    void setMetrics(bool enable);
+    bool metrics() const;
+
+    /**
+     * Defines if HTTPS sockets offer HTTP/2 through ALPN, clients
+     * that negotiate h2 get stream multiplexing over one connection
+     * while the others keep speaking HTTP/1.1.
+     * @accessors http2(), setHttp2()
+     */
+    Q_PROPERTY(bool http2 READ http2 WRITE setHttp2)
+    void setHttp2(bool enable);
+    bool http2() const;
+
     /**
      * Defines is the Application should be lazy loaded.
+     *
+     * By default the Application is loaded once in the master process,
+     * before the workers are forked, so everything built in
+     * Application::init() - routing tables, templates, big read-only
+     * lookup data - exists in a single copy that all workers share
+     * through the kernel's copy-on-write fork semantics. Keep such
+     * state untouched after init() and it will never be duplicated;
+     * a write to it in a worker makes only the touched pages private.
+     * With debug output enabled each worker logs its shared vs
+     * private resident memory after forking so the sharing can be
+     * verified in production.
+     *
+     * Lazy mode defers the load to each worker after the fork, which
+     * gives up the sharing but isolates workers whose init() is not
+     * fork safe (threads, open descriptors).
      * @accessors lazy(), setLazy()
      */
     Q_PROPERTY(bool lazy READ lazy WRITE setLazy)
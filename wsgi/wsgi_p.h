@@ -52,7 +52,8 @@ public:
     CWsgiEngine *createEngine(Cutelyst::Application *app, int core);
 
     void loadConfig(const QString &file, bool json);
-    void applyConfig(const QVariantMap &config);
+    void applyConfig(const QVariantMap &config, bool reload = false);
+    void reloadConfig();
     void loadLoggingRules(QSettings &settings);
 
     WSGI *q_ptr;
@@ -68,6 +69,9 @@ public:
     QStringList fastcgiSockets;
     QStringList staticMaps;
     QStringList staticMaps2;
+    QStringList bodyLimits;
+    QStringList bodyContentTypes;
+    QStringList batchEndpoints;
     QStringList touchReload;
     QStringList ini;
     QStringList json;
@@ -77,16 +81,19 @@ public:
     QString socketAccess;
     QString pidfile;
     QString pidfile2;
+    QString httpsRedirect;
+    QString shadow;
 #ifdef Q_OS_UNIX
     QString uid;
     QString gid;
     QString chownSocket;
     QString umask;
+    QString profilerSocket;
     bool noInitgroups = false;
     int cpuAffinity = 0;
 #endif
 #ifdef Q_OS_LINUX
-    bool reusePort = false;
+    bool reusePort = true;
 #endif
     qint64 postBuffering = -1;
     qint64 postBufferingBufsize = 4096;
@@ -97,19 +104,32 @@ public:
     int workersNotRunning = 1;
     int threads = 0;
     int processes = 0;
+    int cheaper = 0;
+    bool lockMemory = false;
     int socketSendBuf = -1;
     int socketReceiveBuf = -1;
     int socketTimeout = 4;
+    int gracefulTimeout = 30;
+    int maxConnections = 0;
+    int maxRequestAge = 0;
     int websocketMaxSize = 1024 * 1024;
+    int websocketHeartbeat = 0;
+    int shadowRate = 100;
+    bool httpCompression = false;
+    bool metrics = false;
+    bool http2 = false;
     bool lazy = false;
     bool master = false;
     bool autoReload = false;
     bool tcpNodelay = false;
+    bool hugeBuffers = false;
+    bool writeCoalesce = false;
     bool soKeepalive = false;
     bool threadBalancer = false;
 
 Q_SIGNALS:
     void postForked(int workerId);
+    void configReloaded(const QVariantMap &config);
     void killChildProcess();
     void terminateChildProcess();
     void shutdown();